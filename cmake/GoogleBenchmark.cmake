@@ -0,0 +1,42 @@
+# Google Benchmark, for src/server/nautical/benchmarks.
+# The installed one is used if there is one, otherwise it is built
+# like gtest.
+
+find_package(benchmark QUIET)
+
+if (benchmark_FOUND)
+  function(target_depends_on_benchmark target)
+    target_link_libraries(${target} benchmark::benchmark)
+  endfunction()
+else ()
+  include(ExternalProject)
+
+  set(BENCHMARK_BUILD_DIR "${CMAKE_BINARY_DIR}/third-party/benchmark-build")
+  set(BENCHMARK_SOURCE_DIR "${CMAKE_BINARY_DIR}/third-party/benchmark-src")
+  set(BENCHMARK_LIBRARY
+      "${BENCHMARK_BUILD_DIR}/src/${CMAKE_STATIC_LIBRARY_PREFIX}benchmark${CMAKE_STATIC_LIBRARY_SUFFIX}")
+
+  ExternalProject_Add(benchmark_ext
+          URL "https://github.com/google/benchmark/archive/v1.7.1.tar.gz"
+          BINARY_DIR "${BENCHMARK_BUILD_DIR}"
+          SOURCE_DIR "${BENCHMARK_SOURCE_DIR}"
+          CMAKE_ARGS "-DCMAKE_BUILD_TYPE=Release"
+          "-DBENCHMARK_ENABLE_TESTING=OFF"
+          "-DBENCHMARK_ENABLE_GTEST_TESTS=OFF"
+          "-DBENCHMARK_ENABLE_INSTALL=OFF"
+          "-DBENCHMARK_ENABLE_WERROR=OFF"
+          INSTALL_COMMAND ""
+          BUILD_BYPRODUCTS "${BENCHMARK_LIBRARY}"
+              )
+
+  find_package(Threads)
+
+  function(target_depends_on_benchmark target)
+    set_property(TARGET ${target} APPEND PROPERTY INCLUDE_DIRECTORIES
+                 "${BENCHMARK_SOURCE_DIR}/include"
+                )
+    target_link_libraries(${target} "${BENCHMARK_LIBRARY}"
+                          ${CMAKE_THREAD_LIBS_INIT})
+    add_dependencies(${target} benchmark_ext)
+  endfunction()
+endif ()
@@ -127,6 +127,9 @@ class TypedDispatchData : public DispatchData {
   virtual ValueDispatcher<T> *dispatcher() = 0;
   virtual const ValueDispatcher<T> *dispatcher() const = 0;
   virtual void setValue(T value) = 0;
+  virtual void setValues(const TimedValue<T> *begin, const TimedValue<T> *end) {
+    dispatcher()->setValues(begin, end);
+  }
   virtual bool isFresh(Duration<> maxAge = Duration<>::seconds(15)) const {
     auto d = dispatcher();
     if (d == nullptr || !d->hasValue() || !d->clock()) {
@@ -166,6 +169,9 @@ class TypedDispatchDataReal : public TypedDispatchData<T> {
   virtual const ValueDispatcher<T> *dispatcher() const { return &_dispatcher; }
 
   virtual void setValue(T value) { _dispatcher.setValue(value); }
+  virtual void setValues(const TimedValue<T> *begin, const TimedValue<T> *end) {
+    _dispatcher.setValues(begin, end);
+  }
   virtual ~TypedDispatchDataReal() {}
  private:
   ValueDispatcher<T> _dispatcher;
@@ -200,6 +206,9 @@ class DispatchDataProxy : public TypedDispatchData<T> {
   TypedDispatchData<T> *realDispatcher() const { return _forward; }
 
   virtual void setValue(T value) { _proxy.setValue(value); }
+  virtual void setValues(const TimedValue<T> *begin, const TimedValue<T> *end) {
+    _proxy.setValues(begin, end);
+  }
   virtual ~DispatchDataProxy() {}
  private:
   ValueDispatcherProxy<T> _proxy;
@@ -254,6 +263,15 @@ class Dispatcher : public Clock {
 
   virtual int maxBufferLength() const {return defaultDispatcherBufferLength;}
 
+  // Sources of 'code' created after this call keep their samples in a
+  // preallocated ring buffer (see TimedSampleCollection::useRingBuffer)
+  // large enough to cover 'window' if samples arrive at most every
+  // 'minSamplePeriod'.
+  void setRingBufferWindow(DataCode code, Duration<> window,
+                           Duration<> minSamplePeriod) {
+    _ringBufferCapacity[code] = ringBufferCapacity(window, minSamplePeriod);
+  }
+
   // Return or create a DispatchData for the given source.
   template <typename T>
   TypedDispatchData<T>* createDispatchDataForSource(
@@ -336,6 +354,18 @@ class Dispatcher : public Clock {
     dispatchData->setValue(value);
   }
 
+  // Publishes a batch of timed values, in chronological order.
+  // Listeners that accept batches get a single notification.
+  template <typename T>
+  void publishValues(DataCode code, const std::string& source,
+                     const TimedValue<T> *begin, const TimedValue<T> *end) {
+    if (begin != end) {
+      TypedDispatchData<T>* dispatchData =
+        createDispatchDataForSource<T>(code, source, maxBufferLength());
+      dispatchData->setValues(begin, end);
+    }
+  }
+
   template <typename T>
   void insertValues(DataCode code, const std::string& source,
                     const typename TimedSampleCollection<T>::TimedVector& values) {
@@ -347,6 +377,18 @@ class Dispatcher : public Clock {
     }
   }
 
+  // Same as above, but the samples are moved into the dispatcher.
+  template <typename T>
+  void insertValues(DataCode code, const std::string& source,
+                    typename TimedSampleCollection<T>::TimedVector&& values) {
+    if (!values.empty()) {
+      TypedDispatchData<T>* dispatchData =
+        createDispatchDataForSource<T>(code, source, values.size());
+
+      dispatchData->dispatcher()->insert(std::move(values));
+    }
+  }
+
   template<class T>
   void updateCurrentSource(DataCode code, TypedDispatchData<T>* dispatchData) {
     auto proxy = dynamic_cast<DispatchDataProxy<T>*>(this->dispatchData(code));
@@ -438,6 +480,7 @@ class Dispatcher : public Clock {
 
   std::map<DataCode, std::map<std::string,
     std::shared_ptr<DispatchData>>> _data;
+  std::map<DataCode, int> _ringBufferCapacity;
 
   static Dispatcher *_globalInstance;
 
@@ -498,6 +541,10 @@ TypedDispatchData<T>* Dispatcher::createDispatchDataForSource(
   TypedDispatchData<T>* dispatchData;
   if (!ptr) {
     dispatchData = createNewTypedDispatchData<T>(code, source, size);
+    auto ring = _ringBufferCapacity.find(code);
+    if (ring != _ringBufferCapacity.end()) {
+      dispatchData->dispatcher()->mutableValues()->useRingBuffer(ring->second);
+    }
     _data[code][source] = std::shared_ptr<DispatchData>(dispatchData);
     newDispatchData(dispatchData);
   } else {
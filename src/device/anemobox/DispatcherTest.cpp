@@ -169,3 +169,25 @@ TEST(DispatcherTest, hasSourceTest) {
     EXPECT_EQ(v.n, 1);
   }
 }
+
+TEST(DispatcherTest, RingBufferWindow) {
+  Dispatcher dispatcher;
+  dispatcher.setRingBufferWindow(
+      AWA, Duration<>::seconds(1), Duration<>::seconds(0.25));
+
+  for (int i = 0; i < 10; ++i) {
+    dispatcher.publishValue(AWA, "test", Angle<>::degrees(i));
+    dispatcher.publishValue(AWS, "test", Velocity<>::knots(i));
+  }
+
+  const auto &awa = dispatcher.get<AWA>("test")->dispatcher()->values();
+  EXPECT_TRUE(awa.isRingBuffer());
+  EXPECT_EQ(5, awa.size());
+  EXPECT_NEAR(9, awa.back(0).value.degrees(), 1e-9);
+  EXPECT_NEAR(5, awa.back(4).value.degrees(), 1e-9);
+
+  // Not configured.
+  EXPECT_FALSE(dispatcher.get<AWS>("test")->dispatcher()->values()
+               .isRingBuffer());
+  EXPECT_EQ(10, dispatcher.values<AWS>().size());
+}
@@ -6,11 +6,15 @@
 
 namespace sail {
 
-DispatcherTrueWindEstimator::DispatcherTrueWindEstimator(Dispatcher* dispatcher)
+DispatcherTrueWindEstimator::DispatcherTrueWindEstimator(
+    Dispatcher* dispatcher, bool incremental)
     : _dispatcher(dispatcher),
     _validParameters(false), 
     _validTargetSpeedTable(false),
     _filter(dispatcher, DispatcherFilterParams()) {
+  if (incremental) {
+    _incrementalFilter.reset(new IncrementalDispatcherFilter(dispatcher));
+  }
 }
 
 bool DispatcherTrueWindEstimator::loadCalibration(const std::string& path) {
@@ -50,6 +54,27 @@ void DispatcherTrueWindEstimator::compute() const {
 }
 
 void DispatcherTrueWindEstimator::compute(const std::string &srcName) const {
+  if (_incrementalFilter) {
+    compute(*_incrementalFilter, srcName);
+  } else {
+    compute(_filter, srcName);
+  }
+}
+
+bool DispatcherTrueWindEstimator::computeIfChanged() {
+  if (_incrementalFilter) {
+    if (!_incrementalFilter->changed()) {
+      return false;
+    }
+    _incrementalFilter->clearChanged();
+  }
+  compute();
+  return true;
+}
+
+template <typename Filter>
+void DispatcherTrueWindEstimator::compute(
+    const Filter &filter, const std::string &srcName) const {
   Angle<> twdir;
   Angle<> twa;
   Velocity<> tws;
@@ -65,7 +90,7 @@ void DispatcherTrueWindEstimator::compute(const std::string &srcName) const {
 
   if (_validParameters) {
     HorizontalMotion<double> wind =
-      TrueWindEstimator::computeTrueWind(_parameters.params, _filter);
+      TrueWindEstimator::computeTrueWind(_parameters.params, filter);
     twdir = calcTwdir(wind);
     tws = wind.norm();
 
@@ -73,7 +98,7 @@ void DispatcherTrueWindEstimator::compute(const std::string &srcName) const {
     _dispatcher->publishValue(TWS, srcName, tws);
 
     // Todo: compute TWA with TrueWindEstimator.
-    twa = (twdir - _filter.gpsBearing());
+    twa = (twdir - filter.gpsBearing());
     _dispatcher->publishValue(TWA, srcName, twa);
   } else {
     if (!_dispatcher->get<TWA>()->dispatcher()->hasFreshValue(freshLimit)
@@ -96,12 +121,102 @@ void DispatcherTrueWindEstimator::compute(const std::string &srcName) const {
 
   // TODO: When the TrueWindEstimator will handle current, use water speed
   // instead.
-  Velocity<> boatSpeed = _filter.gpsSpeed();
+  Velocity<> boatSpeed = filter.gpsSpeed();
 
   Velocity<> vmg = cos(twa) * boatSpeed;
   _dispatcher->publishValue(VMG, srcName, vmg);
 }
 
+namespace {
+  // Presents the entry i of a TrueWindBatch to TrueWindEstimator.
+  struct BatchEntry {
+    typedef double type;
+
+    const TrueWindBatch &batch;
+    size_t i;
+
+    Angle<> awa() const { return batch.awa[i]; }
+    Velocity<> aws() const { return batch.aws[i]; }
+    Angle<> gpsBearing() const { return batch.gpsBearing[i]; }
+    Velocity<> gpsSpeed() const { return batch.gpsSpeed[i]; }
+    HorizontalMotion<double> gpsMotion() const {
+      return HorizontalMotion<double>::polar(gpsSpeed(), gpsBearing());
+    }
+  };
+}
+
+namespace {
+  template <typename T>
+  void appendSamples(const typename TimedSampleCollection<T>::TimedVector &src,
+                     typename TimedSampleCollection<T>::TimedVector *dst) {
+    dst->insert(dst->end(), src.begin(), src.end());
+  }
+}
+
+void TrueWindBatchOutput::append(const TrueWindBatchOutput &other) {
+  appendSamples<Angle<>>(other.twdir, &twdir);
+  appendSamples<Angle<>>(other.twa, &twa);
+  appendSamples<Velocity<>>(other.tws, &tws);
+  appendSamples<Velocity<>>(other.targetVmg, &targetVmg);
+  appendSamples<Velocity<>>(other.vmg, &vmg);
+}
+
+void TrueWindBatchOutput::insertInto(
+    const std::string &srcName, Dispatcher *dst) const {
+  dst->insertValues<Angle<>>(TWDIR, srcName, twdir);
+  dst->insertValues<Velocity<>>(TWS, srcName, tws);
+  dst->insertValues<Angle<>>(TWA, srcName, twa);
+  dst->insertValues<Velocity<>>(TARGET_VMG, srcName, targetVmg);
+  dst->insertValues<Velocity<>>(VMG, srcName, vmg);
+}
+
+bool DispatcherTrueWindEstimator::computeBatch(
+    const TrueWindBatch &batch,
+    const std::string &srcName,
+    Dispatcher *dst) const {
+  TrueWindBatchOutput output;
+  if (!computeBatch(batch, &output)) {
+    return false;
+  }
+  output.insertInto(srcName, dst);
+  return true;
+}
+
+bool DispatcherTrueWindEstimator::computeBatch(
+    const TrueWindBatch &batch, TrueWindBatchOutput *dst) const {
+  if (!_validParameters) {
+    return false;
+  }
+
+  for (size_t i = 0; i < batch.size(); ++i) {
+    if (!batch.fresh[i]) {
+      continue;
+    }
+    TimeStamp time = batch.times[i];
+    BatchEntry entry{batch, i};
+
+    // Same computation as compute(), for a single entry.
+    HorizontalMotion<double> wind =
+      TrueWindEstimator::computeTrueWind(_parameters.params, entry);
+    Angle<> twdir = calcTwdir(wind);
+    Velocity<> tws = wind.norm();
+    Angle<> twa = twdir - entry.gpsBearing();
+    dst->twdir.push_back(TimedValue<Angle<>>(time, twdir));
+    dst->tws.push_back(TimedValue<Velocity<>>(time, tws));
+    dst->twa.push_back(TimedValue<Angle<>>(time, twa));
+
+    if (_validTargetSpeedTable) {
+      Velocity<> targetVmg = getVmgTarget(_targetSpeedTable, twa, tws);
+      if (targetVmg.knots() >= 0) {
+        dst->targetVmg.push_back(TimedValue<Velocity<>>(time, targetVmg));
+      }
+    }
+    dst->vmg.push_back(
+        TimedValue<Velocity<>>(time, cos(twa) * entry.gpsSpeed()));
+  }
+  return true;
+}
+
 std::string DispatcherTrueWindEstimator::info() const {
   std::string result;
 
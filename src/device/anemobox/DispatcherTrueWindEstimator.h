@@ -3,16 +3,57 @@
 
 #include <device/anemobox/Dispatcher.h>
 #include <device/anemobox/DispatcherFilter.h>
+#include <device/anemobox/IncrementalDispatcherFilter.h>
 #include <device/Arduino/libraries/TrueWindEstimator/TrueWindEstimator.h>
 #include <device/Arduino/libraries/TargetSpeed/TargetSpeed.h>
 
+#include <memory>
 #include <string>
+#include <vector>
 
 namespace sail {
 
+// The filtered inputs of the estimator at a sequence of times,
+// as aligned arrays. See DispatcherTrueWindEstimator::computeBatch.
+struct TrueWindBatch {
+  std::vector<TimeStamp> times;
+
+  // Non-zero if GPS speed, AWA and AWS all had fresh values.
+  std::vector<char> fresh;
+
+  std::vector<Angle<double>> awa;
+  std::vector<Velocity<double>> aws;
+  std::vector<Angle<double>> gpsBearing;
+  std::vector<Velocity<double>> gpsSpeed;
+
+  void resize(size_t n) {
+    times.resize(n);
+    fresh.resize(n);
+    awa.resize(n);
+    aws.resize(n);
+    gpsBearing.resize(n);
+    gpsSpeed.resize(n);
+  }
+  size_t size() const { return times.size(); }
+};
+
+// What DispatcherTrueWindEstimator::compute publishes, for a TrueWindBatch.
+struct TrueWindBatchOutput {
+  TimedSampleCollection<Angle<double>>::TimedVector twdir, twa;
+  TimedSampleCollection<Velocity<double>>::TimedVector tws, targetVmg, vmg;
+
+  // Appends 'other', that must come after this output in time.
+  void append(const TrueWindBatchOutput &other);
+
+  void insertInto(const std::string &srcName, Dispatcher *dst) const;
+};
+
 class DispatcherTrueWindEstimator {
  public:
-  DispatcherTrueWindEstimator(Dispatcher *dispatcher);
+  // In incremental mode, the estimator subscribes to its input channels
+  // and filters them with an IncrementalDispatcherFilter, instead of
+  // visiting the full filter windows at every computation.
+  DispatcherTrueWindEstimator(Dispatcher *dispatcher, bool incremental = false);
 
   bool loadCalibration(const std::string& path);
   bool loadCalibration(std::istream& file);
@@ -23,6 +64,25 @@ class DispatcherTrueWindEstimator {
   // Compute and publish using a specific source name
   void compute(const std::string &srcName) const;
 
+  // In incremental mode, compute only if an input changed since the last
+  // computation. Returns true if compute() was called.
+  bool computeIfChanged();
+
+  // Batch mode: computes, for every entry of 'batch', what compute()
+  // would publish, and inserts the results in 'dst' under 'srcName'.
+  // Returns false if there are no valid calibration parameters:
+  // without them compute() depends on the true wind of the dispatcher.
+  bool computeBatch(const TrueWindBatch &batch,
+                    const std::string &srcName,
+                    Dispatcher *dst) const;
+
+  // Same as above, but the results are appended to 'dst'.
+  // Can be called from several threads at the same time.
+  bool computeBatch(const TrueWindBatch &batch,
+                    TrueWindBatchOutput *dst) const;
+
+  bool hasValidParameters() const { return _validParameters; }
+
   static const char* sourceName() { return "Anemomind estimator"; }
 
   std::string info() const;
@@ -36,6 +96,10 @@ class DispatcherTrueWindEstimator {
   bool _validTargetSpeedTable;
 
   DispatcherFilter _filter;
+  std::unique_ptr<IncrementalDispatcherFilter> _incrementalFilter;
+
+  template <typename Filter>
+  void compute(const Filter &filter, const std::string &srcName) const;
 };
 
 }  // namespace sail
@@ -41,3 +41,87 @@ TEST(DispatcherTrueWindEstimatorTest, singleValTest) {
 
 
 
+
+namespace {
+  std::string boatDat() {
+    return std::string(Env::SOURCE_DIR)
+      + std::string("/src/device/Arduino/NMEAStats/test/boat.dat");
+  }
+
+  void publishInputs(FakeClockDispatcher *dispatcher, int i) {
+    dispatcher->publishValue(AWA, "test",
+        Angle<double>::degrees(330 + 10 * sin(i * .3)));
+    dispatcher->publishValue(AWS, "test",
+        Velocity<double>::knots(7.8 + sin(i * .1)));
+    dispatcher->publishValue(GPS_SPEED, "test",
+        Velocity<double>::knots(3.6 + .5 * cos(i * .2)));
+    dispatcher->publishValue(GPS_BEARING, "test",
+        Angle<double>::degrees(188 + i));
+  }
+}
+
+TEST(DispatcherTrueWindEstimatorTest, incremental) {
+  FakeClockDispatcher dispatcher;
+  DispatcherTrueWindEstimator estimator(&dispatcher);
+  DispatcherTrueWindEstimator incremental(&dispatcher, true);
+  EXPECT_TRUE(estimator.loadCalibration(boatDat()));
+  EXPECT_TRUE(incremental.loadCalibration(boatDat()));
+
+  for (int i = 0; i < 100; ++i) {
+    publishInputs(&dispatcher, i);
+    dispatcher.advance(Duration<>::seconds(.1));
+
+    estimator.compute("regular");
+    EXPECT_TRUE(incremental.computeIfChanged());
+
+    // Nothing new to compute.
+    EXPECT_FALSE(incremental.computeIfChanged());
+
+    const char *src = DispatcherTrueWindEstimator::sourceName();
+    EXPECT_NEAR(
+        dispatcher.get<TWS>("regular")->dispatcher()->lastValue().knots(),
+        dispatcher.get<TWS>(src)->dispatcher()->lastValue().knots(), 1e-6);
+    EXPECT_NEAR(
+        dispatcher.get<TWA>("regular")->dispatcher()->lastValue().degrees(),
+        dispatcher.get<TWA>(src)->dispatcher()->lastValue().degrees(), 1e-6);
+  }
+}
+
+TEST(DispatcherTrueWindEstimatorTest, batch) {
+  FakeClockDispatcher dispatcher;
+  DispatcherTrueWindEstimator estimator(&dispatcher);
+  EXPECT_TRUE(estimator.loadCalibration(boatDat()));
+  DispatcherFilter filter(&dispatcher, DispatcherFilterParams());
+
+  TrueWindBatch batch;
+  batch.resize(20);
+  for (int i = 0; i < 20; ++i) {
+    publishInputs(&dispatcher, i);
+    dispatcher.advance(Duration<>::seconds(.1));
+    estimator.compute();
+
+    batch.times[i] = dispatcher.currentTime();
+    batch.fresh[i] = (i % 2 == 0);
+    batch.awa[i] = filter.awa();
+    batch.aws[i] = filter.aws();
+    batch.gpsBearing[i] = filter.gpsBearing();
+    batch.gpsSpeed[i] = filter.gpsSpeed();
+  }
+
+  FakeClockDispatcher dst;
+  EXPECT_TRUE(estimator.computeBatch(batch, "batch", &dst));
+
+  const auto &expected = dispatcher.values<TWS>();
+  const auto &actual = dst.values<TWS>();
+  EXPECT_EQ(20, expected.size());
+  EXPECT_EQ(10, actual.size());
+  for (int i = 0; i < actual.size(); ++i) {
+    EXPECT_EQ(expected[2 * i].time, actual[i].time);
+    EXPECT_NEAR(expected[2 * i].value.knots(), actual[i].value.knots(), 1e-9);
+  }
+  EXPECT_EQ(10, dst.values<VMG>().size());
+  EXPECT_EQ(10, dst.values<TWDIR>().size());
+
+  DispatcherTrueWindEstimator uncalibrated(&dispatcher);
+  EXPECT_FALSE(uncalibrated.computeBatch(batch, "batch", &dst));
+}
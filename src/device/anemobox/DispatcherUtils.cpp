@@ -673,6 +673,30 @@ std::map<TimeStamp, std::map<std::pair<DataCode, std::string>, int>>
   return v.dst;
 }
 
+namespace {
+
+  struct CountVisitor {
+    int64_t count = 0;
+
+    template <DataCode Code, typename T>
+      void visit(const char *shortName, const std::string &sourceName,
+        const std::shared_ptr<DispatchData> &raw,
+        const TimedSampleCollection<T> &coll) {
+      count += coll.size();
+    }
+  };
+
+}
+
+int64_t countSamples(const Dispatcher *d) {
+  if (d == nullptr) {
+    return 0;
+  }
+  CountVisitor v;
+  visitDispatcherChannelsConst<CountVisitor>(d, &v);
+  return v.count;
+}
+
 namespace {
   const std::map<std::string,
         std::shared_ptr<DispatchData>> *lookUpMap(
@@ -745,8 +769,16 @@ std::set<DataCode> listDataCodesWithDifferences(
 
 namespace {
 
+class ReplayStream : public SortedStream<TimeStamp> {
+ public:
+  // Publishes the next samples, as a single batch when possible,
+  // but never any sample after 'upTo' (if defined).
+  // At least one sample is published.
+  virtual bool nextRun(TimeStamp upTo) = 0;
+};
+
 template <typename T>
-class DispatcherStream : public SortedStream<TimeStamp> {
+class DispatcherStream : public ReplayStream {
  public:
   DispatcherStream(TypedDispatchData<T> *dispatchData,
                    ReplayDispatcher *destination)
@@ -767,10 +799,53 @@ class DispatcherStream : public SortedStream<TimeStamp> {
     return _it == _dispatchData->dispatcher()->values().samples().end();
   }
 
+  virtual bool nextRun(TimeStamp upTo) {
+    assert(!end());
+    if (!acceptsBatches()) {
+      return next();
+    }
+
+    // Timeouts must be called between the samples they were
+    // scheduled for, so a batch stops right before the next one.
+    _destination->setCurrentTime(_it->time);
+    TimeStamp nextTimeout = _destination->nextTimeoutTime();
+    _batch.clear();
+    do {
+      _batch.push_back(*_it);
+      ++_it;
+    } while (!end() && (!upTo.defined() || _it->time <= upTo)
+             && (!nextTimeout.defined() || _it->time < nextTimeout));
+
+    _destination->publishTimedValues<T>(
+        _dispatchData->dataCode(), _dispatchData->source(),
+        _batch.data(), _batch.data() + _batch.size());
+    return end();
+  }
+
  private:
   TypedDispatchData<T> *_dispatchData;
   typename TimedSampleCollection<T>::TimedVector::const_iterator _it;
   ReplayDispatcher *_destination;
+  TypedDispatchData<T> *_published = nullptr;
+  DispatchDataProxy<T> *_current = nullptr;
+  std::vector<TimedValue<T>> _batch;
+
+  bool acceptsBatches() {
+    if (_published == nullptr) {
+      // The destination is created when publishing the first sample.
+      _published = dynamic_cast<TypedDispatchData<T>*>(
+          _destination->dispatchDataForSource(
+              _dispatchData->dataCode(), _dispatchData->source()).get());
+      _current = dynamic_cast<DispatchDataProxy<T>*>(
+          _destination->dispatchData(_dispatchData->dataCode()));
+    }
+    // A source that is not the current one might become it at any
+    // sample (see Dispatcher::prefers), so it is published sample by sample.
+    return _published != nullptr
+      && _current != nullptr
+      && _current->realDispatcher() == _published
+      && _published->dispatcher()->allListenersTakeBatches();
+  }
 };
 
 class DispatchDataMerger : public DispatchDataVisitor {
@@ -793,20 +868,36 @@ class DispatchDataMerger : public DispatchDataVisitor {
   virtual void run(DispatchAngularVelocityData *d) { addStream(d); }
 
   void merge() {
-    MultiMerge<TimeStamp> merger;
+    // Same order as MultiMerge, except that a stream publishes
+    // all its samples preceding the head of any other stream at once.
+    auto later = [](const ReplayStream *a, const ReplayStream *b) {
+      return b->value() < a->value();
+    };
+    std::vector<ReplayStream *> heap;
     for (auto s : _streams) {
-      merger.addStream(s.get());
+      if (!s->end()) {
+        heap.push_back(s.get());
+      }
     }
-    while (!merger.end()) {
-      // Publish occurs in the "next" method of DispatcherStream,
-      // called in the right order by _merger.
-      merger.next();
+    std::make_heap(heap.begin(), heap.end(), later);
+    while (!heap.empty()) {
+      std::pop_heap(heap.begin(), heap.end(), later);
+      ReplayStream *first = heap.back();
+      heap.pop_back();
+      TimeStamp upTo = heap.empty()?
+        TimeStamp::makeUndefined() : heap.front()->value();
+
+      // Publish occurs in the "nextRun" method of DispatcherStream.
+      if (!first->nextRun(upTo)) {
+        heap.push_back(first);
+        std::push_heap(heap.begin(), heap.end(), later);
+      }
     }
   }
  private:
   // This vector is used to delete all the allocated SortedStreams
   // when destructing the DispatchDataMerger object.
-  std::vector<std::shared_ptr<SortedStream<TimeStamp>>> _streams;
+  std::vector<std::shared_ptr<ReplayStream>> _streams;
 
   ReplayDispatcher *_destination;
 };
@@ -861,7 +952,7 @@ DispatchData* ReplayDispatcher::createNewCustomDispatchData(
   // ... and provide our own, short-term size.
   // For all LazyReplayDispatchData, once we call
   // finalize, the size will be arbitrarily large.
-  int shortSize = 30;
+  int shortSize = lazyBufferLength;
 
   if (_replayingFrom) {
     auto fCode = _replayingFrom->allSources().find(code);
@@ -878,6 +969,16 @@ DispatchData* ReplayDispatcher::createNewCustomDispatchData(
 }
 
 
+TimeStamp ReplayDispatcher::nextTimeoutTime() const {
+  TimeStamp result;
+  for (const auto &to: _timeouts) {
+    if (!result.defined() || to.time < result) {
+      result = to.time;
+    }
+  }
+  return result;
+}
+
 void ReplayDispatcher::finishTimeouts() {
   for (auto to: _timeouts) {
     to.cb();
@@ -170,6 +170,9 @@ std::map<TimeStamp, std::map<std::pair<DataCode, std::string>, int>>
       const Dispatcher* d,
       std::function<TimeStamp(TimeStamp)> roundOff);
 
+// The number of samples of all channels and sources, 0 if d is null.
+int64_t countSamples(const Dispatcher *d);
+
 
 class ReplayDispatcher : public Dispatcher {
  public:
@@ -210,6 +213,9 @@ class ReplayDispatcher : public Dispatcher {
      return std::numeric_limits<int>::max();
    }
 
+   // During the replay, the channels only keep this many recent samples.
+   static const int lazyBufferLength = 30;
+
    template <typename T>
      void publishTimedValue(DataCode code, const std::string& source,
                             TimedValue<T> value) {
@@ -217,12 +223,30 @@ class ReplayDispatcher : public Dispatcher {
      publishValue<T>(code, source, value.value);
    }
 
+   // Publishes a chronologically ordered batch as if the values
+   // had been published one by one with publishTimedValue,
+   // except that listeners accepting batches are notified only once.
+   template <typename T>
+     void publishTimedValues(DataCode code, const std::string& source,
+                             const TimedValue<T> *begin,
+                             const TimedValue<T> *end) {
+     if (begin == end) {
+       return;
+     }
+     setCurrentTime(begin->time);
+     publishValues<T>(code, source, begin, end);
+     setCurrentTime((end - 1)->time);
+   }
+
    void replay(const Dispatcher *src);
    void setTimeout(std::function<void()> cb, double delayMS);
 
 
    void finishTimeouts();
 
+   // Undefined if there are no pending timeouts.
+   TimeStamp nextTimeoutTime() const;
+
    const std::set<Timeout> &getTimeouts() const {
      return _timeouts;
    }
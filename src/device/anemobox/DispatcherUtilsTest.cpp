@@ -272,3 +272,58 @@ TEST(DispatcherUtilsTest, Replay2) {
   EXPECT_CALL(listener, onNewValue(testing::_));
   replay.publishValue(TWA, "test source", Angle<>::degrees(44));
 }
+
+namespace {
+  class BatchAngleListener : public Listener<Angle<>> {
+   public:
+    int calls = 0;
+    std::vector<TimedValue<Angle<>>> received;
+
+    void onNewValue(const ValueDispatcher<Angle<>> &dispatcher) override {
+      calls++;
+      received.push_back(TimedValue<Angle<>>(
+          dispatcher.lastTimeStamp(), dispatcher.lastValue()));
+    }
+    bool acceptsBatches() const override { return true; }
+    void onNewValues(const ValueDispatcher<Angle<>> &,
+                     const TimedValue<Angle<>> *begin,
+                     const TimedValue<Angle<>> *end) override {
+      calls++;
+      received.insert(received.end(), begin, end);
+    }
+  };
+}
+
+TEST(DispatcherUtilsTest, ReplayInBatches) {
+  auto offset = TimeStamp::UTC(2017, 6, 1, 12, 0, 0);
+  TimedSampleCollection<Angle<>>::TimedVector awa, twa;
+  for (int i = 0; i < 100; i++) {
+    awa.push_back(TimedValue<Angle<>>(
+        offset + Duration<>::seconds(i), Angle<>::degrees(i)));
+    twa.push_back(TimedValue<Angle<>>(
+        offset + Duration<>::seconds(200 + i), Angle<>::degrees(i)));
+  }
+  Dispatcher src;
+  src.insertValues<Angle<>>(AWA, "src", awa);
+  src.insertValues<Angle<>>(TWA, "src", twa);
+
+  ReplayDispatcher replay;
+  BatchAngleListener listener;
+  replay.get<AWA>()->dispatcher()->subscribe(&listener);
+  int timeoutCalls = 0;
+  replay.setCurrentTime(offset);
+  replay.setTimeout([&]() { timeoutCalls++; }, 50500);
+  replay.replay(&src);
+
+  EXPECT_EQ(1, timeoutCalls);
+
+  // The first sample creates the channel, the timeout splits the rest.
+  EXPECT_EQ(3, listener.calls);
+  EXPECT_EQ(awa.size(), listener.received.size());
+  for (int i = 0; i < awa.size(); i++) {
+    EXPECT_EQ(awa[i].time, listener.received[i].time);
+    EXPECT_EQ(awa[i].value, listener.received[i].value);
+  }
+  EXPECT_EQ(awa.size(), replay.values<AWA>("src").size());
+  EXPECT_EQ(twa.size(), replay.values<TWA>("src").size());
+}
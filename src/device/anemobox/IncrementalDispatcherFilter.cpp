@@ -0,0 +1,203 @@
+#include <device/anemobox/IncrementalDispatcherFilter.h>
+
+namespace sail {
+
+namespace {
+  // After this many removals, the sums are recomputed from the samples
+  // in the window so that rounding errors do not accumulate.
+  const int rebaseInterval = 1024;
+}
+
+void TriangularWindowSum::add(TimeStamp time, double x, double y) {
+  if (_samples.empty()) {
+    _origin = time;
+  }
+  double u = (time - _origin).seconds();
+  _samples.push_back(Sample{time, u, x, y});
+  _sumU += u;
+  _sumX += x;
+  _sumY += y;
+  _sumUX += u * x;
+  _sumUY += u * y;
+
+  if (0 < _maxCount && _maxCount < int(_samples.size())) {
+    popFront();
+  }
+}
+
+void TriangularWindowSum::advanceTo(TimeStamp now) {
+  while (!_samples.empty() && (now - _samples.front().time) > _window) {
+    popFront();
+  }
+}
+
+double TriangularWindowSum::evaluate(
+    TimeStamp now, double *x, double *y) const {
+  if (_samples.empty()) {
+    *x = 0;
+    *y = 0;
+    return 0;
+  }
+  double invWindow = 1.0 / _window.seconds();
+
+  // The weight of a sample is a + u * invWindow.
+  double a = 1 - (now - _origin).seconds() * invWindow;
+  *x = a * _sumX + _sumUX * invWindow;
+  *y = a * _sumY + _sumUY * invWindow;
+  return a * _samples.size() + _sumU * invWindow;
+}
+
+void TriangularWindowSum::clear() {
+  _samples.clear();
+  _sumU = _sumX = _sumY = _sumUX = _sumUY = 0;
+  _removedSinceRebase = 0;
+}
+
+void TriangularWindowSum::popFront() {
+  const Sample &s = _samples.front();
+  _sumU -= s.u;
+  _sumX -= s.x;
+  _sumY -= s.y;
+  _sumUX -= s.u * s.x;
+  _sumUY -= s.u * s.y;
+  _samples.pop_front();
+
+  if (_samples.empty()) {
+    clear();
+  } else if (++_removedSinceRebase >= rebaseInterval) {
+    rebase();
+  }
+}
+
+void TriangularWindowSum::rebase() {
+  _origin = _samples.front().time;
+  _sumU = _sumX = _sumY = _sumUX = _sumUY = 0;
+  for (Sample &s : _samples) {
+    s.u = (s.time - _origin).seconds();
+    _sumU += s.u;
+    _sumX += s.x;
+    _sumY += s.y;
+    _sumUX += s.u * s.x;
+    _sumUY += s.u * s.y;
+  }
+  _removedSinceRebase = 0;
+}
+
+void addToWindow(TriangularWindowSum *sum, TimeStamp time, Angle<> x) {
+  double s, c;
+  x.sincos(&s, &c);
+  sum->add(time, s, c);
+}
+
+void addToWindow(TriangularWindowSum *sum, TimeStamp time, Velocity<> x) {
+  sum->add(time, x.knots(), 0);
+}
+
+Angle<> filteredAngle(TriangularWindowSum *sum, TimeStamp now) {
+  sum->advanceTo(now);
+  double x, y;
+  double weight = sum->evaluate(now, &x, &y);
+  if (weight <= 0) {
+    // TODO: return something invalid.
+    return Angle<>::degrees(0);
+  }
+  return HorizontalMotion<double>(
+      Velocity<double>::knots(x), Velocity<double>::knots(y)).angle();
+}
+
+Velocity<> filteredVelocity(TriangularWindowSum *sum, TimeStamp now) {
+  sum->advanceTo(now);
+  double x, y;
+  double weight = sum->evaluate(now, &x, &y);
+
+  // The weight of a sample at the window limit is 0 up to rounding errors.
+  if (weight <= 1.0e-9 * sum->size()) {
+    // TODO: return something invalid.
+    return Velocity<>::knots(0);
+  }
+  return Velocity<>::knots(x / weight);
+}
+
+template <typename T>
+void IncrementalDispatcherFilter::Channel<T>::reset(
+    const TimedSampleCollection<T> &values) {
+  _sum.clear();
+  if (values.empty()) {
+    return;
+  }
+
+  // Only the samples that can still be in the window are needed.
+  TimeStamp from = values.lastTimeStamp() - _sum.window();
+  int first = values.size();
+  while (0 < first && values.back(values.size() - first).time >= from) {
+    first--;
+  }
+  for (int i = first; i < int(values.size()); i++) {
+    const TimedValue<T> &x = values.back(values.size() - 1 - i);
+    add(x.time, x.value);
+  }
+}
+
+template class IncrementalDispatcherFilter::Channel<Angle<>>;
+template class IncrementalDispatcherFilter::Channel<Velocity<>>;
+
+IncrementalDispatcherFilter::IncrementalDispatcherFilter(
+    Dispatcher* dispatcher, DispatcherFilterParams params)
+  : _dispatcher(dispatcher),
+  _awa(params.apparentWindWindow, &_changed),
+  _magHdg(params.waterMotionWindow, &_changed),
+  _gpsBearing(params.gpsMotionWindow, &_changed),
+  _aws(params.apparentWindWindow, &_changed),
+  _watSpeed(params.waterMotionWindow, &_changed),
+  _gpsSpeed(params.gpsMotionWindow, &_changed) {
+  _awa.reset(dispatcher->values<AWA>());
+  _magHdg.reset(dispatcher->values<MAG_HEADING>());
+  _gpsBearing.reset(dispatcher->values<GPS_BEARING>());
+  _aws.reset(dispatcher->values<AWS>());
+  _watSpeed.reset(dispatcher->values<WAT_SPEED>());
+  _gpsSpeed.reset(dispatcher->values<GPS_SPEED>());
+
+  dispatcher->get<AWA>()->dispatcher()->subscribe(&_awa);
+  dispatcher->get<MAG_HEADING>()->dispatcher()->subscribe(&_magHdg);
+  dispatcher->get<GPS_BEARING>()->dispatcher()->subscribe(&_gpsBearing);
+  dispatcher->get<AWS>()->dispatcher()->subscribe(&_aws);
+  dispatcher->get<WAT_SPEED>()->dispatcher()->subscribe(&_watSpeed);
+  dispatcher->get<GPS_SPEED>()->dispatcher()->subscribe(&_gpsSpeed);
+
+  _sourceSwitched = dispatcher->dataSwitchedSource.connect(
+      [this](DispatchData* data) { this->onSourceSwitched(data); });
+}
+
+void IncrementalDispatcherFilter::onSourceSwitched(DispatchData *data) {
+  // The proxy now forwards the samples of another source:
+  // the windows have to be refilled with the history of that source.
+  switch (data->dataCode()) {
+    case AWA:
+      _awa.reset(toTypedDispatchData<AWA>(data)->dispatcher()->values());
+      break;
+    case MAG_HEADING:
+      _magHdg.reset(
+          toTypedDispatchData<MAG_HEADING>(data)->dispatcher()->values());
+      break;
+    case GPS_BEARING:
+      _gpsBearing.reset(
+          toTypedDispatchData<GPS_BEARING>(data)->dispatcher()->values());
+      break;
+    case AWS:
+      _aws.reset(toTypedDispatchData<AWS>(data)->dispatcher()->values());
+      break;
+    case WAT_SPEED:
+      _watSpeed.reset(
+          toTypedDispatchData<WAT_SPEED>(data)->dispatcher()->values());
+      break;
+    case GPS_SPEED:
+      _gpsSpeed.reset(
+          toTypedDispatchData<GPS_SPEED>(data)->dispatcher()->values());
+      break;
+    default:
+      return;
+  }
+  _changed = true;
+}
+
+}  // namespace sail
@@ -0,0 +1,156 @@
+#ifndef DEVICE_ANEMOBOX_INCREMENTAL_DISPATCHER_FILTER_H
+#define DEVICE_ANEMOBOX_INCREMENTAL_DISPATCHER_FILTER_H
+
+#include <boost/signals2/connection.hpp>
+#include <deque>
+#include <device/anemobox/Dispatcher.h>
+#include <device/anemobox/DispatcherFilter.h>
+
+namespace sail {
+
+// The triangular filter of DispatcherFilter, maintained incrementally.
+// Every sample in the window (now - window, now] has the weight
+// 1 - (now - time)/window. Instead of visiting the whole window at every
+// query, we keep sums that are updated when samples enter or leave the
+// window, so that a query costs O(1) plus the number of expired samples.
+//
+// Samples are two-dimensional (x, y), so that angles can be averaged as
+// unit vectors. Samples must be added in chronological order and queries
+// must be made with non-decreasing times.
+class TriangularWindowSum {
+ public:
+  // If maxCount > 0, only the most recent maxCount samples are kept,
+  // like a TimedSampleCollection with a maximum buffer length.
+  TriangularWindowSum(Duration<> window = Duration<>::seconds(1),
+                      int maxCount = 0)
+    : _window(window), _maxCount(maxCount) { }
+
+  void add(TimeStamp time, double x, double y);
+
+  // Drops the samples that are older than now - window.
+  void advanceTo(TimeStamp now);
+
+  // Returns the sum of the weights. The weighted sums of x and y are
+  // written to *x and *y. Call advanceTo(now) first.
+  double evaluate(TimeStamp now, double *x, double *y) const;
+
+  bool empty() const { return _samples.empty(); }
+  int size() const { return _samples.size(); }
+  Duration<> window() const { return _window; }
+  void clear();
+
+ private:
+  struct Sample {
+    TimeStamp time;
+    double u;  // seconds since _origin
+    double x, y;
+  };
+
+  void popFront();
+  void rebase();
+
+  Duration<> _window;
+  int _maxCount;
+  std::deque<Sample> _samples;
+
+  // Times are expressed relative to _origin, which is moved forward
+  // from time to time to preserve precision.
+  TimeStamp _origin;
+  double _sumU = 0, _sumX = 0, _sumY = 0, _sumUX = 0, _sumUY = 0;
+  int _removedSinceRebase = 0;
+};
+
+// Adds samples to, and reads filtered values from, TriangularWindowSums
+// in the same way as the filters of DispatcherFilter. Reading
+// drops the samples that are too old (see TriangularWindowSum::advanceTo).
+void addToWindow(TriangularWindowSum *sum, TimeStamp time, Angle<> x);
+void addToWindow(TriangularWindowSum *sum, TimeStamp time, Velocity<> x);
+Angle<> filteredAngle(TriangularWindowSum *sum, TimeStamp now);
+Velocity<> filteredVelocity(TriangularWindowSum *sum, TimeStamp now);
+
+// Same interface as DispatcherFilter, but instead of visiting the sample
+// windows at every call, it subscribes to the input channels and updates
+// TriangularWindowSums as samples arrive. It also tracks whether any
+// input changed, so that an estimator can skip computations that would
+// not produce anything new.
+//
+// Note that the windows only contain samples published while the filter
+// was listening, and the samples of the current source at the time the
+// source was switched.
+class IncrementalDispatcherFilter {
+ public:
+  typedef double type;
+
+  // The dispatcher is expected to remain valid during
+  // the lifetime of the IncrementalDispatcherFilter.
+  IncrementalDispatcherFilter(Dispatcher* dispatcher,
+                              DispatcherFilterParams params
+                                = DispatcherFilterParams());
+
+  Angle<> awa() const { return _awa.angle(now()); }
+  Velocity<> aws() const { return _aws.velocity(now()); }
+  Angle<> magHdg() const { return _magHdg.angle(now()); }
+  Velocity<> watSpeed() const { return _watSpeed.velocity(now()); }
+  Velocity<> gpsSpeed() const { return _gpsSpeed.velocity(now()); }
+  Angle<> gpsBearing() const { return _gpsBearing.angle(now()); }
+
+  HorizontalMotion<double> gpsMotion() const {
+    return HorizontalMotion<double>::polar(
+        gpsSpeed(), gpsBearing());
+  }
+
+  // True if a sample arrived on any of the inputs since the last call
+  // to clearChanged().
+  bool changed() const { return _changed; }
+  void clearChanged() { _changed = false; }
+
+  template <typename T>
+  class Channel : public Listener<T> {
+   public:
+    Channel(Duration<> window, bool *changed)
+      : _sum(window), _changed(changed) { }
+
+    void onNewValue(const ValueDispatcher<T> &d) override {
+      add(d.lastTimeStamp(), d.lastValue());
+      *_changed = true;
+    }
+
+    bool acceptsBatches() const override { return true; }
+    void onNewValues(const ValueDispatcher<T> &,
+                     const TimedValue<T> *begin,
+                     const TimedValue<T> *end) override {
+      for (auto x = begin; x != end; ++x) {
+        add(x->time, x->value);
+      }
+      *_changed = true;
+    }
+
+    // Restarts from the samples stored in 'values'.
+    void reset(const TimedSampleCollection<T> &values);
+
+    Angle<> angle(TimeStamp now) const { return filteredAngle(&_sum, now); }
+    Velocity<> velocity(TimeStamp now) const {
+      return filteredVelocity(&_sum, now);
+    }
+
+   private:
+    void add(TimeStamp time, T x) { addToWindow(&_sum, time, x); }
+
+    mutable TriangularWindowSum _sum;
+    bool *_changed;
+  };
+
+ private:
+  TimeStamp now() const { return _dispatcher->currentTime(); }
+  void onSourceSwitched(DispatchData *data);
+
+  Dispatcher* _dispatcher;
+  bool _changed = false;
+  Channel<Angle<>> _awa, _magHdg, _gpsBearing;
+  Channel<Velocity<>> _aws, _watSpeed, _gpsSpeed;
+  boost::signals2::scoped_connection _sourceSwitched;
+};
+
+}  // namespace sail
+
+#endif // DEVICE_ANEMOBOX_INCREMENTAL_DISPATCHER_FILTER_H
@@ -0,0 +1,130 @@
+#include <device/anemobox/IncrementalDispatcherFilter.h>
+#include <device/anemobox/FakeClockDispatcher.h>
+#include <gtest/gtest.h>
+#include <cmath>
+
+using namespace sail;
+
+TEST(IncrementalDispatcherFilterTest, TriangularWindowSum) {
+  auto start = TimeStamp::UTC(2016, 3, 24, 18, 10, 0);
+  Duration<> window = Duration<>::seconds(2);
+  TriangularWindowSum sum(window);
+  std::vector<std::pair<TimeStamp, double>> samples;
+
+  // Many more samples than the rebase interval.
+  for (int i = 0; i < 5000; i++) {
+    TimeStamp t = start + Duration<>::seconds(0.1 * i);
+    double x = sin(i * 0.37);
+    sum.add(t, x, 2 * x);
+    samples.push_back(std::make_pair(t, x));
+
+    TimeStamp now = t + Duration<>::seconds(0.05);
+    sum.advanceTo(now);
+
+    double expectedWeight = 0, expectedX = 0;
+    for (auto s : samples) {
+      Duration<> delta = now - s.first;
+      if (delta <= window) {
+        double factor = 1 - delta.seconds() / window.seconds();
+        expectedWeight += factor;
+        expectedX += factor * s.second;
+      }
+    }
+
+    double x2, y2;
+    EXPECT_NEAR(expectedWeight, sum.evaluate(now, &x2, &y2), 1e-8);
+    EXPECT_NEAR(expectedX, x2, 1e-8);
+    EXPECT_NEAR(2 * expectedX, y2, 1e-8);
+  }
+  EXPECT_EQ(20, sum.size());
+}
+
+TEST(IncrementalDispatcherFilterTest, MaxCount) {
+  auto start = TimeStamp::UTC(2016, 3, 24, 18, 10, 0);
+  TriangularWindowSum sum(Duration<>::seconds(10), 3);
+  for (int i = 0; i < 5; i++) {
+    sum.add(start + Duration<>::seconds(i), i, 0);
+  }
+  EXPECT_EQ(3, sum.size());
+
+  TimeStamp now = start + Duration<>::seconds(4);
+  double x, y;
+  double weight = sum.evaluate(now, &x, &y);
+  EXPECT_NEAR(1.0 + 0.9 + 0.8, weight, 1e-9);
+  EXPECT_NEAR(4 * 1.0 + 3 * 0.9 + 2 * 0.8, x, 1e-9);
+}
+
+TEST(IncrementalDispatcherFilterTest, SameAsDispatcherFilter) {
+  FakeClockDispatcher dispatcher;
+  DispatcherFilter filter(&dispatcher, DispatcherFilterParams());
+  IncrementalDispatcherFilter incremental(&dispatcher);
+
+  double tolerance = 1e-6;
+  for (int i = 0; i < 300; ++i) {
+    dispatcher.publishValue(AWA, "test",
+        Angle<double>::degrees(170 + sin(i * .7213) * 20));
+    dispatcher.publishValue(AWS, "test",
+        Velocity<double>::knots(12 + sin(i * .343)));
+    if (i % 3 == 0) {
+      dispatcher.publishValue(GPS_SPEED, "test",
+          Velocity<double>::knots(7 + cos(i * .1)));
+      dispatcher.publishValue(GPS_BEARING, "test",
+          Angle<double>::degrees(i));
+    }
+    dispatcher.advance(Duration<>::seconds(.1));
+
+    EXPECT_NEAR(filter.awa().degrees(), incremental.awa().degrees(),
+                tolerance);
+    EXPECT_NEAR(filter.aws().knots(), incremental.aws().knots(), tolerance);
+    EXPECT_NEAR(filter.gpsSpeed().knots(), incremental.gpsSpeed().knots(),
+                tolerance);
+    EXPECT_NEAR(filter.gpsBearing().degrees(),
+                incremental.gpsBearing().degrees(), tolerance);
+  }
+
+  // Long after the last sample, both filters are empty.
+  dispatcher.advance(Duration<>::seconds(60));
+  EXPECT_EQ(0, incremental.awa().degrees());
+  EXPECT_EQ(0, incremental.aws().knots());
+}
+
+TEST(IncrementalDispatcherFilterTest, Changed) {
+  FakeClockDispatcher dispatcher;
+  dispatcher.publishValue(AWS, "test", Velocity<double>::knots(3));
+
+  IncrementalDispatcherFilter filter(&dispatcher);
+
+  // Samples published before the filter was created are used.
+  EXPECT_NEAR(3, filter.aws().knots(), 1e-9);
+  EXPECT_FALSE(filter.changed());
+
+  dispatcher.publishValue(MAG_HEADING, "test", Angle<double>::degrees(3));
+  EXPECT_TRUE(filter.changed());
+  filter.clearChanged();
+  EXPECT_FALSE(filter.changed());
+
+  // Not an input of the filter.
+  dispatcher.publishValue(TWS, "test", Velocity<double>::knots(3));
+  EXPECT_FALSE(filter.changed());
+
+  dispatcher.publishValue(AWS, "test", Velocity<double>::knots(5));
+  EXPECT_TRUE(filter.changed());
+}
+
+TEST(IncrementalDispatcherFilterTest, SourceSwitch) {
+  FakeClockDispatcher dispatcher;
+  dispatcher.setSourcePriority("low", 0);
+  dispatcher.setSourcePriority("high", 1);
+
+  IncrementalDispatcherFilter filter(&dispatcher);
+
+  dispatcher.publishValue(AWS, "low", Velocity<double>::knots(3));
+  EXPECT_NEAR(3, filter.aws().knots(), 1e-9);
+
+  dispatcher.publishValue(AWS, "high", Velocity<double>::knots(5));
+  EXPECT_NEAR(5, filter.aws().knots(), 1e-9);
+
+  // Not the current source.
+  dispatcher.publishValue(AWS, "low", Velocity<double>::knots(3));
+  EXPECT_NEAR(5, filter.aws().knots(), 1e-9);
+}
@@ -48,6 +48,29 @@ public:
     stepIterator();
   }
 
+  void setValues(const TimedValue<T> *begin, const TimedValue<T> *end) {
+    if (_prototype) {
+      // As long as the batch is identical to the prototype, we only
+      // need to step the iterator. Otherwise, we have to migrate
+      // *before* the short buffer drops samples of the batch.
+      auto proto = _sameUpTo;
+      auto protoEnd = samplesOf(_prototype).end();
+      const TimedValue<T> *x = begin;
+      while (x != end && proto != protoEnd
+             && x->time == proto->time && x->value == proto->value) {
+        ++x;
+        ++proto;
+      }
+      if (x == end) {
+        _sameUpTo = proto;
+      } else {
+        migrateFromPrototypeToDispatcher();
+      }
+    }
+    _counter += end - begin;
+    _dispatcher.setValues(begin, end);
+  }
+
   /*
    * Call this method once we know that no new samples will be inserted.
    * This will ensure that the 'dispatcher()' method returns a
@@ -138,3 +138,51 @@ TEST(LazyReplayDispatchData, VariousTests) {
     EXPECT_NE(dst->dispatcher(), prototype->dispatcher());
   }
 }
+
+TEST(LazyReplayDispatchData, Batches) {
+  int n = 8;
+  auto fn = [](double x) {return 0.3*x + 0.1;};
+  const SampleSource original(fn);
+
+  auto protoSrc = original;
+  auto prototype = std::make_shared<TypedDispatchDataReal<T>>(
+      dc, src, &protoSrc, 20);
+  for (int i = 0; i < n; i++) {
+    prototype->setValue(protoSrc.generate().value);
+  }
+
+  auto generateBatch = [](SampleSource *s, int count) {
+    std::vector<TimedValue<T>> batch;
+    for (int i = 0; i < count; i++) {
+      batch.push_back(s->generate());
+    }
+    return batch;
+  };
+
+  { // Duplication, in batches larger than the buffer
+    auto otherSrc = original;
+    auto dst = std::make_shared<LazyReplayDispatchData<T>>(
+        &otherSrc, 2,
+        std::static_pointer_cast<TypedDispatchData<T>>(prototype));
+    auto a = generateBatch(&otherSrc, 5);
+    auto b = generateBatch(&otherSrc, 3);
+    dst->setValues(a.data(), a.data() + a.size());
+    dst->setValues(b.data(), b.data() + b.size());
+    EXPECT_TRUE(dst->finalize());
+    EXPECT_TRUE(matches(dst, otherSrc));
+    EXPECT_EQ(dst->dispatcher(), prototype->dispatcher());
+  }{ // A batch that differs in the middle
+    auto fn2 = [fn](double x) {return x < 4? fn(x) : 9.0;};
+    SampleSource otherSrc(fn2);
+    auto dst = std::make_shared<LazyReplayDispatchData<T>>(
+        &otherSrc, 2,
+        std::static_pointer_cast<TypedDispatchData<T>>(prototype));
+    auto a = generateBatch(&otherSrc, 2);
+    auto b = generateBatch(&otherSrc, 6);
+    dst->setValues(a.data(), a.data() + a.size());
+    dst->setValues(b.data(), b.data() + b.size());
+    EXPECT_TRUE(dst->finalize());
+    EXPECT_TRUE(matches(dst, otherSrc));
+    EXPECT_NE(dst->dispatcher(), prototype->dispatcher());
+  }
+}
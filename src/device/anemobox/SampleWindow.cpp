@@ -0,0 +1,185 @@
+#include <device/anemobox/SampleWindow.h>
+
+#include <limits>
+
+namespace sail {
+
+namespace {
+
+template <typename T> struct Components { };
+
+template <> struct Components<Angle<double>> {
+  static std::vector<std::string> names() { return {"value"}; }
+  static void get(const Angle<double> &x, double *dst) {
+    dst[0] = x.degrees();
+  }
+};
+
+template <> struct Components<Velocity<double>> {
+  static std::vector<std::string> names() { return {"value"}; }
+  static void get(const Velocity<double> &x, double *dst) {
+    dst[0] = x.knots();
+  }
+};
+
+template <> struct Components<AngularVelocity<double>> {
+  static std::vector<std::string> names() { return {"value"}; }
+  static void get(const AngularVelocity<double> &x, double *dst) {
+    dst[0] = x.degreesPerSecond();
+  }
+};
+
+template <> struct Components<Length<double>> {
+  static std::vector<std::string> names() { return {"value"}; }
+  static void get(const Length<double> &x, double *dst) {
+    dst[0] = x.nauticalMiles();
+  }
+};
+
+template <> struct Components<BinaryEdge> {
+  static std::vector<std::string> names() { return {"value"}; }
+  static void get(const BinaryEdge &x, double *dst) {
+    dst[0] = (x == BinaryEdge::ToOn ? 1 : 0);
+  }
+};
+
+template <> struct Components<TimeStamp> {
+  static std::vector<std::string> names() { return {"value"}; }
+  static void get(const TimeStamp &x, double *dst) {
+    dst[0] = double(x.toMilliSecondsSince1970());
+  }
+};
+
+template <> struct Components<GeographicPosition<double>> {
+  static std::vector<std::string> names() { return {"lon", "lat"}; }
+  static void get(const GeographicPosition<double> &x, double *dst) {
+    dst[0] = x.lon().degrees();
+    dst[1] = x.lat().degrees();
+  }
+};
+
+template <> struct Components<AbsoluteOrientation> {
+  static std::vector<std::string> names() {
+    return {"heading", "roll", "pitch"};
+  }
+  static void get(const AbsoluteOrientation &x, double *dst) {
+    dst[0] = x.heading.degrees();
+    dst[1] = x.roll.degrees();
+    dst[2] = x.pitch.degrees();
+  }
+};
+
+// Index of the first sample with a time >= t.
+template <typename T>
+int firstAtOrAfter(const TimedSampleCollection<T> &values, TimeStamp t) {
+  int lo = 0, hi = values.size();
+  while (lo < hi) {
+    int mid = (lo + hi) / 2;
+    if (values.back(values.size() - 1 - mid).time < t) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return lo;
+}
+
+template <typename T>
+void initWindow(int n, SampleWindow *dst) {
+  dst->components = Components<T>::names();
+  dst->times.reserve(n);
+  dst->columns.assign(dst->components.size(), std::vector<double>());
+  for (auto &column : dst->columns) {
+    column.reserve(n);
+  }
+}
+
+template <typename T>
+void addSample(TimeStamp time, const T &value, SampleWindow *dst) {
+  double numbers[3];
+  Components<T>::get(value, numbers);
+  dst->times.push_back(double(time.toMilliSecondsSince1970()));
+  for (size_t i = 0; i < dst->columns.size(); ++i) {
+    dst->columns[i].push_back(numbers[i]);
+  }
+}
+
+class WindowVisitor {
+ public:
+  WindowVisitor(TimeStamp from, TimeStamp to) : _from(from), _to(to) { }
+
+  template <typename T>
+  void visit(DataCode, TypedDispatchData<T> *data) {
+    const TimedSampleCollection<T> &values = data->dispatcher()->values();
+    int n = values.size();
+    int begin = _from.defined() ? firstAtOrAfter(values, _from) : 0;
+    int end = begin;
+    while (end < n && !(_to.defined()
+                        && _to < values.back(n - 1 - end).time)) {
+      end++;
+    }
+
+    initWindow<T>(end - begin, &result);
+    for (int i = begin; i < end; ++i) {
+      const TimedValue<T> &x = values.back(n - 1 - i);
+      addSample(x.time, x.value, &result);
+    }
+  }
+
+  SampleWindow result;
+ private:
+  TimeStamp _from, _to;
+};
+
+class ResampleVisitor {
+ public:
+  ResampleVisitor(const std::vector<TimeStamp> &times, Duration<> maxAge)
+    : _times(times), _maxAge(maxAge) { }
+
+  template <typename T>
+  void visit(DataCode, TypedDispatchData<T> *data) {
+    const TimedSampleCollection<T> &values = data->dispatcher()->values();
+    int n = values.size();
+    initWindow<T>(_times.size(), &result);
+
+    // Both the samples and the times are sorted:
+    // a single pass over the samples is enough.
+    int next = _times.empty() ? 0 : firstAtOrAfter(values, _times.front());
+    for (TimeStamp t : _times) {
+      while (next < n && !(t < values.back(n - 1 - next).time)) {
+        next++;
+      }
+      if (next > 0 && t - values.back(n - next).time <= _maxAge) {
+        const TimedValue<T> &x = values.back(n - next);
+        addSample(t, x.value, &result);
+      } else {
+        result.times.push_back(double(t.toMilliSecondsSince1970()));
+        for (auto &column : result.columns) {
+          column.push_back(std::numeric_limits<double>::quiet_NaN());
+        }
+      }
+    }
+  }
+
+  SampleWindow result;
+ private:
+  const std::vector<TimeStamp> &_times;
+  Duration<> _maxAge;
+};
+
+}  // namespace
+
+SampleWindow sampleWindow(DispatchData *data, TimeStamp from, TimeStamp to) {
+  WindowVisitor visitor(from, to);
+  data->visitX(&visitor);
+  return visitor.result;
+}
+
+SampleWindow resample(DispatchData *data, const std::vector<TimeStamp> &times,
+                      Duration<> maxAge) {
+  ResampleVisitor visitor(times, maxAge);
+  data->visitX(&visitor);
+  return visitor.result;
+}
+
+}  // namespace sail
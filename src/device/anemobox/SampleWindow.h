@@ -0,0 +1,41 @@
+#ifndef DEVICE_ANEMOBOX_SAMPLE_WINDOW_H
+#define DEVICE_ANEMOBOX_SAMPLE_WINDOW_H
+
+#include <device/anemobox/Dispatcher.h>
+#include <string>
+#include <vector>
+
+namespace sail {
+
+// The samples of a channel over a time range, as flat arrays of numbers,
+// so that they can be handed over in one go (see JsDispatchData::window).
+// Values are in the units of the javascript API: degrees, knots,
+// nautical miles, milliseconds since 1970, and 0 or 1 for binary edges.
+struct SampleWindow {
+  // The names of the numeric components of a sample,
+  // for example {"value"} or {"lon", "lat"}.
+  std::vector<std::string> components;
+
+  // Milliseconds since 1970.
+  std::vector<double> times;
+
+  // One column per component, with as many values as 'times'.
+  std::vector<std::vector<double>> columns;
+
+  int size() const { return times.size(); }
+};
+
+// The samples of 'data' with from <= time <= to. An undefined bound
+// means no limit on that side.
+SampleWindow sampleWindow(DispatchData *data, TimeStamp from, TimeStamp to);
+
+// The value of 'data' at each of the sorted 'times': the last sample at
+// or before that time, or NaN if there is none or if it is older than
+// 'maxAge'. Several channels resampled at the same times can be
+// displayed or compared together.
+SampleWindow resample(DispatchData *data, const std::vector<TimeStamp> &times,
+                      Duration<> maxAge);
+
+}  // namespace sail
+
+#endif  // DEVICE_ANEMOBOX_SAMPLE_WINDOW_H
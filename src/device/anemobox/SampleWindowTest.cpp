@@ -0,0 +1,87 @@
+#include <device/anemobox/SampleWindow.h>
+#include <device/anemobox/FakeClockDispatcher.h>
+#include <gtest/gtest.h>
+#include <cmath>
+
+using namespace sail;
+
+namespace {
+
+TimeStamp start() { return TimeStamp::UTC(2016, 6, 1, 12, 0, 0); }
+
+double ms(TimeStamp t) { return double(t.toMilliSecondsSince1970()); }
+
+}  // namespace
+
+TEST(SampleWindowTest, Window) {
+  FakeClockDispatcher dispatcher;
+  dispatcher.setTime(start());
+  for (int i = 0; i < 10; ++i) {
+    dispatcher.publishValue(AWS, "test", Velocity<double>::knots(i));
+    dispatcher.advance(Duration<>::seconds(1));
+  }
+  DispatchData *aws = dispatcher.dispatchData(AWS);
+
+  SampleWindow all = sampleWindow(aws, TimeStamp(), TimeStamp());
+  ASSERT_EQ(10, all.size());
+  EXPECT_EQ(std::vector<std::string>{"value"}, all.components);
+  ASSERT_EQ(1, all.columns.size());
+  EXPECT_EQ(ms(start()), all.times[0]);
+  EXPECT_EQ(9, all.columns[0][9]);
+
+  // Both bounds are included.
+  SampleWindow some = sampleWindow(aws,
+      start() + Duration<>::seconds(2.5), start() + Duration<>::seconds(5));
+  ASSERT_EQ(3, some.size());
+  EXPECT_EQ(ms(start() + Duration<>::seconds(3)), some.times[0]);
+  EXPECT_NEAR(3, some.columns[0][0], 1e-9);
+  EXPECT_NEAR(5, some.columns[0][2], 1e-9);
+
+  EXPECT_EQ(0, sampleWindow(aws, start() + Duration<>::seconds(20),
+                            TimeStamp()).size());
+}
+
+TEST(SampleWindowTest, Components) {
+  FakeClockDispatcher dispatcher;
+  dispatcher.setTime(start());
+  dispatcher.publishValue(GPS_POS, "test", GeographicPosition<double>(
+      Angle<double>::degrees(6), Angle<double>::degrees(46)));
+
+  SampleWindow pos = sampleWindow(
+      dispatcher.dispatchData(GPS_POS), TimeStamp(), TimeStamp());
+  EXPECT_EQ((std::vector<std::string>{"lon", "lat"}), pos.components);
+  ASSERT_EQ(1, pos.size());
+  EXPECT_NEAR(6, pos.columns[0][0], 1e-9);
+  EXPECT_NEAR(46, pos.columns[1][0], 1e-9);
+}
+
+TEST(SampleWindowTest, Resample) {
+  FakeClockDispatcher dispatcher;
+  dispatcher.setTime(start());
+  for (int i = 0; i < 5; ++i) {
+    dispatcher.publishValue(AWA, "test", Angle<double>::degrees(10 * i));
+    dispatcher.advance(Duration<>::seconds(1));
+  }
+  dispatcher.advance(Duration<>::seconds(10));
+  dispatcher.publishValue(AWA, "test", Angle<double>::degrees(100));
+
+  std::vector<TimeStamp> times;
+  for (int i = -1; i < 20; ++i) {
+    times.push_back(start() + Duration<>::seconds(i + 0.5));
+  }
+  SampleWindow awa = resample(dispatcher.dispatchData(AWA), times,
+                              Duration<>::seconds(2));
+  ASSERT_EQ(times.size(), awa.size());
+  EXPECT_EQ(ms(times[0]), awa.times[0]);
+
+  // Nothing before the first sample.
+  EXPECT_TRUE(std::isnan(awa.columns[0][0]));
+  for (int i = 0; i < 5; ++i) {
+    EXPECT_NEAR(10 * i, awa.columns[0][i + 1], 1e-9);
+  }
+  // Samples older than 2 seconds are not used.
+  EXPECT_NEAR(40, awa.columns[0][6], 1e-9);
+  EXPECT_TRUE(std::isnan(awa.columns[0][7]));
+  EXPECT_TRUE(std::isnan(awa.columns[0][15]));
+  EXPECT_NEAR(100, awa.columns[0][16], 1e-9);
+}
@@ -2,15 +2,25 @@
 #define NAUTICAL_TIMEDSAMPLECOLLECTION_H
 
 #include <algorithm>
+#include <cmath>
 #include <deque>
 #include <server/common/Optional.h>
 #include <server/common/TimeStamp.h>
 #include <server/common/TimedValue.h>
 #include <server/nautical/types/SampledSignal.h>
 #include <iostream>
+#include <iterator>
+#include <limits>
+#include <vector>
 
 namespace sail {
 
+// The number of samples needed to cover 'window' if there is at least
+// 'minSamplePeriod' between two samples.
+inline int ringBufferCapacity(Duration<> window, Duration<> minSamplePeriod) {
+  return int(ceil(window.seconds() / minSamplePeriod.seconds())) + 1;
+}
+
 template<typename T>
 class TimedSampleCollection : public SampledSignal<T> {
  public:
@@ -30,8 +40,17 @@ class TimedSampleCollection : public SampledSignal<T> {
      insert(entries);
    }
 
+   TimedSampleCollection(TimedVector&& entries) :
+     _maxBufferLength(std::numeric_limits<int>::max()) {
+     insert(std::move(entries));
+   }
+
    void insert(const TimedVector& entries);
 
+   // Same as above, but the collection takes over the storage
+   // of 'entries' if it is empty, instead of copying the samples.
+   void insert(TimedVector&& entries);
+
    // This method will insert a range of elements at
    // the front of the collection. It is your responsibility
    // to ensure that (i) no element inserted is older than any
@@ -46,10 +65,19 @@ class TimedSampleCollection : public SampledSignal<T> {
    void append(const TimedValue<T>& x);
    void append(TimeStamp t, T value) { append(TimedValue<T>(t, value)); }
 
-   const TimedVector& samples() const { return _samples; }
+   // In ring buffer mode, this returns a copy that is rebuilt by the
+   // first call after a change. Rebuilding it invalidates the references
+   // returned by earlier calls, and it is not thread-safe even though
+   // the method is const: the collection must not be read from another
+   // thread meanwhile. Live code should use size(), back() and operator[]
+   // instead.
+   const TimedVector& samples() const;
 
    const TimedValue<T>& back(int backIndex) const {
-     assert(backIndex >= 0 && size_t(backIndex) < _samples.size());
+     assert(backIndex >= 0 && size_t(backIndex) < size());
+     if (isRingBuffer()) {
+       return ringAt(_ringSize - 1 - backIndex);
+     }
      return _samples[_samples.size() - 1 - backIndex];
    }
 
@@ -59,52 +87,210 @@ class TimedSampleCollection : public SampledSignal<T> {
    // If 0: unlimited buffer.
    // Otherwise: after insert, only the most recent <_maxBufferLength> samples
    // are kept.
-   void setMaxBufferLength(int maxBufferLength) {
-     _maxBufferLength = maxBufferLength;
-     trim();
-   }
+   void setMaxBufferLength(int maxBufferLength);
 
-   size_t size() const override { return _samples.size(); }
+   // Switches to a ring buffer of 'capacity' samples, allocated once
+   // and for all: append() never allocates after this call, and only the
+   // most recent 'capacity' samples are kept. Meant for the live
+   // dispatchers on the box. The samples already in the collection are kept.
+   void useRingBuffer(int capacity);
+   bool isRingBuffer() const { return _ringCapacity > 0; }
+
+   size_t size() const override {
+     return isRingBuffer()? _ringSize : _samples.size();
+   }
 
    TimedValue<T> operator[](int i) const override {
-     return _samples[i];
+     return isRingBuffer()? ringAt(i) : _samples[i];
    }
 
-   bool empty() const { return _samples.empty(); }
-   T lastValue() const { return _samples.back().value; }
-   TimeStamp lastTimeStamp() const { return _samples.back().time; }
+   bool empty() const { return size() == 0; }
+   T lastValue() const { return back(0).value; }
+   TimeStamp lastTimeStamp() const { return back(0).time; }
 
-   void clear() { _samples.clear(); }
+   void clear();
 
  private:
   void trim();
-  TimedVector _samples;
+
+  // The i-th oldest sample in the ring.
+  const TimedValue<T>& ringAt(int i) const {
+    int k = _ringBegin + i;
+    return _ring[k < _ringCapacity? k : k - _ringCapacity];
+  }
+
+  // Ring buffer mode keeps the samples in _ring: this moves them
+  // to _samples, for the operations that are not on the live path.
+  void ringToSamples();
+  void samplesToRing();
+
+  // After appending samples at the end of _samples.
+  void finishInsert();
+
+  // In ring buffer mode, a copy of the ring made by samples().
+  mutable TimedVector _samples;
+  mutable bool _samplesUpToDate = true;
 
   int _maxBufferLength;
+
+  std::vector<TimedValue<T>> _ring;
+  int _ringCapacity = 0;
+  int _ringBegin = 0;
+  int _ringSize = 0;
 };
 
+template <typename T>
+const typename TimedSampleCollection<T>::TimedVector&
+TimedSampleCollection<T>::samples() const {
+  if (!_samplesUpToDate) {
+    _samples.assign(_ring.begin() + _ringBegin, _ring.end());
+    _samples.insert(_samples.end(), _ring.begin(), _ring.begin() + _ringBegin);
+    _samplesUpToDate = true;
+  }
+  return _samples;
+}
+
+template <typename T>
+void TimedSampleCollection<T>::setMaxBufferLength(int maxBufferLength) {
+  if (isRingBuffer()) {
+    // The capacity of the ring is the limit.
+    return;
+  }
+  _maxBufferLength = maxBufferLength;
+  trim();
+}
+
+template <typename T>
+void TimedSampleCollection<T>::useRingBuffer(int capacity) {
+  assert(0 < capacity);
+  ringToSamples();
+  _ringCapacity = capacity;
+  _maxBufferLength = capacity;
+  _ring.clear();
+  _ring.shrink_to_fit();
+  _ring.reserve(capacity);
+  samplesToRing();
+}
+
+template <typename T>
+void TimedSampleCollection<T>::clear() {
+  _samples.clear();
+  _samplesUpToDate = true;
+  _ring.clear();
+  _ringBegin = 0;
+  _ringSize = 0;
+}
+
+template <typename T>
+void TimedSampleCollection<T>::ringToSamples() {
+  if (isRingBuffer()) {
+    samples();
+    _ring.clear();
+    _ringBegin = 0;
+    _ringSize = 0;
+  }
+}
+
+template <typename T>
+void TimedSampleCollection<T>::samplesToRing() {
+  if (isRingBuffer()) {
+    trim();
+    // _ring has the capacity reserved: no allocation here.
+    _ring.assign(_samples.begin(), _samples.end());
+    _ringBegin = 0;
+    _ringSize = _ring.size();
+    _samples.clear();
+    _samplesUpToDate = _ring.empty();
+  }
+}
+
 template <typename T>
 void TimedSampleCollection<T>::append(const TimedValue<T>& x) {
-  if (_samples.size() > 0 && _samples.back().time > x.time) {
+  // In ring buffer mode, _samples is a copy that may be out of date.
+  if (!empty() && lastTimeStamp() > x.time) {
     // TODO: Including <server/common/logging.h> causes
     // compilation error when this header is included together
     // with Ceres.
     std::cerr << "WARNING: "
       << "appending sample "
-      << (_samples.back().time - x.time).milliseconds()
+      << (lastTimeStamp() - x.time).milliseconds()
       << " ms in the future";
   }
+  if (isRingBuffer()) {
+    if (int(_ring.size()) < _ringCapacity) {
+      // Still filling the preallocated ring.
+      _ring.push_back(x);
+      _ringSize++;
+    } else {
+      _ring[_ringBegin] = x;
+      _ringBegin = (_ringBegin + 1 == _ringCapacity? 0 : _ringBegin + 1);
+    }
+    _samplesUpToDate = false;
+    return;
+  }
   if (_maxBufferLength > 0 && _samples.size() >= size_t(_maxBufferLength)) {
     _samples.pop_front();
   }
   _samples.push_back(x);
 }
 
+// Sorts the values by time. Sorted values only cost a pass over
+// them, and values made of a few sorted runs, like the samples of
+// consecutive log files, are merged run by run. Otherwise, it falls
+// back to std::sort.
+template <typename Iterator>
+void sortChronologically(Iterator begin, Iterator end) {
+  static const size_t maxRuns = 32;
+  std::vector<Iterator> bounds{begin};
+  for (auto it = begin; it != end && it + 1 != end; ++it) {
+    if (*(it + 1) < *it) {
+      if (bounds.size() == maxRuns) {
+        std::sort(begin, end);
+        return;
+      }
+      bounds.push_back(it + 1);
+    }
+  }
+  bounds.push_back(end);
+  while (bounds.size() > 2) {
+    std::vector<Iterator> merged{begin};
+    for (size_t i = 0; i + 2 < bounds.size(); i += 2) {
+      std::inplace_merge(bounds[i], bounds[i + 1], bounds[i + 2]);
+      merged.push_back(bounds[i + 2]);
+    }
+    if (bounds.size() % 2 == 0) {
+      merged.push_back(end);
+    }
+    bounds.swap(merged);
+  }
+}
+
 template <typename T>
 void TimedSampleCollection<T>::insert(const TimedVector& entries) {
+  ringToSamples();
   _samples.insert(_samples.end(), entries.begin(), entries.end());
-  sort(_samples.begin(), _samples.end());
+  finishInsert();
+}
+
+template <typename T>
+void TimedSampleCollection<T>::insert(TimedVector&& entries) {
+  ringToSamples();
+  if (_samples.empty()) {
+    _samples = std::move(entries);
+  } else {
+    _samples.insert(_samples.end(),
+                    std::make_move_iterator(entries.begin()),
+                    std::make_move_iterator(entries.end()));
+  }
+  entries.clear();
+  finishInsert();
+}
+
+template <typename T>
+void TimedSampleCollection<T>::finishInsert() {
+  sortChronologically(_samples.begin(), _samples.end());
   trim();
+  samplesToRing();
 }
 
 template <typename T>
@@ -113,9 +299,11 @@ void TimedSampleCollection<T>::insertAtFront(
     typename TimedVector::const_iterator end) {
   assert(std::is_sorted(begin, end));
   assert(implies(
-    0 < _samples.size() && begin < end,
-    *(end - 1) < *_samples.begin()));
+    0 < size() && begin < end,
+    *(end - 1) < (*this)[0]));
+  ringToSamples();
   _samples.insert(_samples.begin(), begin, end);
+  samplesToRing();
 }
 
 
@@ -142,6 +330,21 @@ Optional<TimedValue<T> > findNearestTimedValue(Iterator begin, Iterator end, Tim
 
 template <typename T>
 Optional<TimedValue<T> > TimedSampleCollection<T>::nearestTimedValue(TimeStamp t) const {
+  if (isRingBuffer()) {
+    // The ring is made of two chronological halves:
+    // [_ringBegin, end) followed by [0, _ringBegin).
+    auto first = _ring.begin() + _ringBegin;
+    if (_ringBegin == 0 || t <= _ring.back().time) {
+      return findNearestTimedValue<T>(first, _ring.end(), t);
+    }
+    if (t >= _ring.front().time) {
+      return findNearestTimedValue<T>(_ring.begin(), first, t);
+    }
+    const TimedValue<T> &a = _ring.back();
+    const TimedValue<T> &b = _ring.front();
+    return Optional<TimedValue<T> >(
+        (t - a.time).fabs() <= (b.time - t).fabs()? a : b);
+  }
   typedef typename TimedVector::const_iterator Iterator;
   return findNearestTimedValue<T, Iterator>(_samples.begin(), _samples.end(), t);
 }
@@ -4,6 +4,7 @@
 #include <array>
 #include <gtest/gtest.h>
 #include <random>
+#include <sstream>
 
 using namespace sail;
 using namespace std;
@@ -80,3 +81,129 @@ TEST(TimedSampleCollection, MaxBufferLength) {
   for (int i = 0; i < 20; ++i) { EXPECT_EQ(81 + i, samples.samples()[i].value); }
 }
 
+
+TEST(TimedSampleCollection, RingBuffer) {
+  TimeStamp base = TimeStamp::UTC(2016, 5, 10, 12, 0, 0);
+  auto at = [&](int i) { return base + Duration<>::seconds(i); };
+
+  TimedSampleCollection<int> ring;
+  ring.append(at(0), 0);
+  ring.useRingBuffer(5);
+  EXPECT_TRUE(ring.isRingBuffer());
+  EXPECT_EQ(1, ring.size());
+
+  for (int i = 1; i < 13; ++i) {
+    ring.append(at(i), i);
+    EXPECT_EQ(std::min(i + 1, 5), ring.size());
+    EXPECT_EQ(i, ring.lastValue());
+    EXPECT_EQ(at(i), ring.lastTimeStamp());
+
+    int oldest = std::max(0, i - 4);
+    for (int j = 0; j < ring.size(); ++j) {
+      EXPECT_EQ(oldest + j, ring[j].value);
+      EXPECT_EQ(i - j, ring.back(j).value);
+      EXPECT_EQ(oldest + j, ring.samples()[j].value);
+    }
+  }
+
+  // The ring now starts in the middle of its storage.
+  EXPECT_FALSE(ring.nearest(at(7)).defined());
+  EXPECT_FALSE(ring.nearest(at(13)).defined());
+  for (int i = 8; i <= 12; ++i) {
+    EXPECT_EQ(i, ring.nearest(at(i))());
+  }
+  for (int i = 8; i < 12; ++i) {
+    EXPECT_EQ(i, ring.nearest(at(i) + Duration<>::seconds(.4))());
+    EXPECT_EQ(i + 1, ring.nearest(at(i) + Duration<>::seconds(.6))());
+  }
+
+  // Inserting keeps the capacity.
+  deque<TimedValue<int>> older;
+  older.push_back(TimedValue<int>(at(2), 2));
+  older.push_back(TimedValue<int>(at(20), 20));
+  ring.insert(older);
+  EXPECT_EQ(5, ring.size());
+  EXPECT_EQ(9, ring[0].value);
+  EXPECT_EQ(20, ring.lastValue());
+
+  ring.clear();
+  EXPECT_TRUE(ring.empty());
+  ring.append(at(30), 30);
+  EXPECT_EQ(30, ring.back(0).value);
+  EXPECT_EQ(1, ring.samples().size());
+}
+
+// The ordering check of append() is on the ring, not on the copy
+// made by samples().
+TEST(TimedSampleCollection, RingBufferAppendOrder) {
+  TimeStamp base = TimeStamp::UTC(2016, 5, 10, 12, 0, 0);
+  auto at = [&](int i) { return base + Duration<>::seconds(i); };
+
+  TimedSampleCollection<int> ring;
+  ring.useRingBuffer(3);
+
+  std::stringstream warnings;
+  auto cerrBuffer = std::cerr.rdbuf(warnings.rdbuf());
+  ring.append(at(0), 0);
+  ring.append(at(1), 1);
+  EXPECT_EQ(2, ring.samples().size());
+  ring.append(at(2), 2);
+  ring.append(at(3), 3);
+  bool warnedInOrder = !warnings.str().empty();
+  ring.append(at(2), 2);
+  bool warnedOutOfOrder = !warnings.str().empty();
+  std::cerr.rdbuf(cerrBuffer);
+
+  EXPECT_FALSE(warnedInOrder);
+  EXPECT_TRUE(warnedOutOfOrder);
+}
+
+TEST(TimedSampleCollection, RingBufferCapacity) {
+  EXPECT_EQ(151, ringBufferCapacity(
+      Duration<>::seconds(15), Duration<>::seconds(0.1)));
+  EXPECT_EQ(4, ringBufferCapacity(
+      Duration<>::seconds(1), Duration<>::seconds(0.4)));
+}
+
+TEST(TimedSampleCollection, MoveInsert) {
+  TimeStamp base = TimeStamp::now();
+  auto at = [&](int s) { return base + Duration<>::seconds(s); };
+
+  // Three sorted runs, as when concatenating log files.
+  deque<TimedValue<int>> runs;
+  for (int start : {20, 0, 10}) {
+    for (int i = start; i < start + 10; i++) {
+      runs.push_back(TimedValue<int>(at(i), i));
+    }
+  }
+  TimedSampleCollection<int> samples(std::move(runs));
+  EXPECT_TRUE(runs.empty());
+  EXPECT_EQ(30, samples.size());
+  for (int i = 0; i < samples.size(); ++i) {
+    EXPECT_EQ(i, samples[i].value);
+  }
+
+  deque<TimedValue<int>> more;
+  for (int i = 35; i >= 30; i--) {
+    more.push_back(TimedValue<int>(at(i), i));
+  }
+  samples.insert(std::move(more));
+  EXPECT_EQ(36, samples.size());
+  for (int i = 0; i < samples.size(); ++i) {
+    EXPECT_EQ(i, samples[i].value);
+  }
+}
+
+TEST(TimedSampleCollection, SortChronologically) {
+  TimeStamp base = TimeStamp::now();
+  for (int runLength : {1, 3, 50, 1000}) {
+    deque<TimedValue<int>> values;
+    for (int i = 0; i < 1000; i++) {
+      int t = (i % runLength)/2;
+      values.push_back(TimedValue<int>(base + Duration<>::seconds(t), i));
+    }
+    sortChronologically(values.begin(), values.end());
+    EXPECT_TRUE(std::is_sorted(values.begin(), values.end()));
+    EXPECT_EQ(1000, values.size());
+  }
+}
@@ -1,6 +1,7 @@
 #ifndef VALUE_DISPATCHER_H
 #define VALUE_DISPATCHER_H
 
+#include <algorithm>
 #include <deque>
 #include <set>
 #include <vector>
@@ -18,8 +19,50 @@ namespace sail {
 
 template <typename T> class ValueDispatcher;
 
+// Collects the listeners that asked to be woken up at most once
+// per tick (see Listener::setCoalescer). Whoever owns the event loop
+// calls flush() once per tick to deliver the pending notifications.
+class NotificationCoalescer {
+ public:
+  class Pending {
+   public:
+    virtual void deliverPending() = 0;
+    virtual ~Pending() {}
+  };
+
+  void postpone(Pending *p) { _pending.push_back(p); }
+
+  // Called when a pending listener is destroyed before being delivered.
+  void cancel(Pending *p) {
+    std::replace(_pending.begin(), _pending.end(), p, (Pending *)nullptr);
+    std::replace(_delivering.begin(), _delivering.end(), p, (Pending *)nullptr);
+  }
+
+  bool hasPending() const { return !_pending.empty(); }
+
+  // Returns the number of listeners that were notified.
+  int flush() {
+    // Listeners might postpone new notifications or be destroyed
+    // while we are delivering, so we work on our own list.
+    _delivering.swap(_pending);
+    int counter = 0;
+    for (size_t i = 0; i < _delivering.size(); ++i) {
+      if (_delivering[i]) {
+        _delivering[i]->deliverPending();
+        counter++;
+      }
+    }
+    _delivering.clear();
+    return counter;
+  }
+
+ private:
+  std::vector<Pending *> _pending;
+  std::vector<Pending *> _delivering;
+};
+
 template <typename T>
-class Listener {
+class Listener : public NotificationCoalescer::Pending {
  public:
   Listener(Duration<> minInterval = Duration<>::seconds(0))
     : minInterval_(minInterval), listeningTo_(0) { }
@@ -28,7 +71,31 @@ class Listener {
   Duration<> minInterval() const { return minInterval; }
   virtual void onNewValue(const ValueDispatcher<T> &dispatcher) = 0;
 
+  // Listeners that can consume several samples in one call
+  // should return true here and override onNewValues. Otherwise,
+  // ValueDispatcher::setValues calls onNewValue once per sample.
+  virtual bool acceptsBatches() const { return false; }
+
+  // Receives the samples [begin, end) published by a single
+  // call to ValueDispatcher::setValues. They are already
+  // in dispatcher.values() when this method is called.
+  virtual void onNewValues(const ValueDispatcher<T> &dispatcher,
+                           const TimedValue<T> *begin,
+                           const TimedValue<T> *end) { }
+
+  // In coalescing mode, notifications are not delivered right away:
+  // the listener gets a single onNewValue call the next time
+  // 'coalescer' is flushed, no matter how many samples arrived meanwhile.
+  // Pass nullptr to go back to immediate notification.
+  void setCoalescer(NotificationCoalescer *coalescer);
+  bool isCoalescing() const { return coalescer_ != nullptr; }
+
   void notify(const ValueDispatcher<T> &dispatcher);
+  void notifyBatch(const ValueDispatcher<T> &dispatcher,
+                   const TimedValue<T> *begin,
+                   const TimedValue<T> *end);
+
+  void deliverPending() override;
 
   bool isListening() const { return listeningTo_ != 0; }
   void listen(ValueDispatcher<T> *dispatcher);
@@ -48,10 +115,50 @@ class Listener {
     }
   }
 
+  // Notifies listeners about the samples [begin, end) that have just been
+  // appended to 'dispatcher'. Listeners that do not accept batches are
+  // notified after each sample, as if they had been set one by one.
+  template <typename Append>
+  static void safelyNotifyListenerSetOfBatch(
+      const std::set<Listener<T> *>& listeners,
+      const ValueDispatcher<T> &dispatcher,
+      const TimedValue<T> *begin, const TimedValue<T> *end,
+      Append append) {
+    LocalArrayCopy<Listener<T> *, 30> listenersToCall(
+        listeners.begin(), listeners.end());
+    bool perSample = false;
+    for (Listener<T> *listener : listenersToCall) {
+      perSample = perSample || !listener->takesBatches();
+    }
+    for (const TimedValue<T> *x = begin; x != end; ++x) {
+      append(*x);
+      if (perSample) {
+        for (Listener<T> *listener : listenersToCall) {
+          if (!listener->takesBatches()) {
+            listener->notify(dispatcher);
+          }
+        }
+      }
+    }
+    for (Listener<T> *listener : listenersToCall) {
+      if (listener->takesBatches()) {
+        listener->notifyBatch(dispatcher, begin, end);
+      }
+    }
+  }
+
+  bool takesBatches() const { return isCoalescing() || acceptsBatches(); }
+
  private:
+  bool shouldNotify(TimeStamp time) const {
+    return !lastNotified_.defined() || (time - lastNotified_) >= minInterval_;
+  }
+
   TimeStamp lastNotified_;
   Duration<> minInterval_;
   ValueDispatcher<T> *listeningTo_;
+  NotificationCoalescer *coalescer_ = nullptr;
+  const ValueDispatcher<T> *pendingFrom_ = nullptr;
 };
 
 template <typename T>
@@ -70,6 +177,24 @@ class ValueDispatcher {
 
   virtual void setValue(T value);
 
+  // Publishes a batch of chronologically ordered samples. Listeners
+  // accepting batches are called once for the whole batch.
+  virtual void setValues(const TimedValue<T> *begin, const TimedValue<T> *end);
+  void setValues(const std::vector<TimedValue<T>> &values) {
+    setValues(values.data(), values.data() + values.size());
+  }
+
+  // True if publishing a batch will not result in
+  // one notification per sample.
+  bool allListenersTakeBatches() const {
+    for (auto listener : listeners_) {
+      if (!listener->takesBatches()) {
+        return false;
+      }
+    }
+    return true;
+  }
+
   virtual bool hasValue() const { return values_.size() > 0; }
   virtual T lastValue() const { return values_.lastValue(); }
   virtual TimeStamp lastTimeStamp() const { return values_.lastTimeStamp(); }
@@ -84,6 +209,9 @@ class ValueDispatcher {
   void insert(const typename TimedSampleCollection<T>::TimedVector& values) {
     values_.insert(values);
   }
+  void insert(typename TimedSampleCollection<T>::TimedVector&& values) {
+    values_.insert(std::move(values));
+  }
 
   virtual Clock* clock() const { return clock_; }
 
@@ -100,16 +228,56 @@ class ValueDispatcher {
 
 template <typename T>
 Listener<T>::~Listener() {
+  setCoalescer(nullptr);
   stopListening();
 }
 
+template <typename T>
+void Listener<T>::setCoalescer(NotificationCoalescer *coalescer) {
+  if (coalescer_ && pendingFrom_) {
+    coalescer_->cancel(this);
+    pendingFrom_ = nullptr;
+  }
+  coalescer_ = coalescer;
+}
+
 template <typename T>
 void Listener<T>::notify(const ValueDispatcher<T> &dispatcher)
 {
-  if (!lastNotified_.defined()
-      || (dispatcher.lastTimeStamp() - lastNotified_) >= minInterval_) {
+  if (shouldNotify(dispatcher.lastTimeStamp())) {
     lastNotified_ = dispatcher.lastTimeStamp();
-    onNewValue(dispatcher);
+    if (coalescer_) {
+      if (!pendingFrom_) {
+        coalescer_->postpone(this);
+      }
+      pendingFrom_ = &dispatcher;
+    } else {
+      onNewValue(dispatcher);
+    }
+  }
+}
+
+template <typename T>
+void Listener<T>::notifyBatch(const ValueDispatcher<T> &dispatcher,
+                              const TimedValue<T> *begin,
+                              const TimedValue<T> *end) {
+  if (begin == end) {
+    return;
+  }
+  if (coalescer_ || !acceptsBatches()) {
+    notify(dispatcher);
+  } else if (shouldNotify((end - 1)->time)) {
+    lastNotified_ = (end - 1)->time;
+    onNewValues(dispatcher, begin, end);
+  }
+}
+
+template <typename T>
+void Listener<T>::deliverPending() {
+  const ValueDispatcher<T> *from = pendingFrom_;
+  pendingFrom_ = nullptr;
+  if (from) {
+    onNewValue(*from);
   }
 }
 
@@ -145,6 +313,14 @@ void ValueDispatcher<T>::setValue(T value) {
   }
 }
 
+template <typename T>
+void ValueDispatcher<T>::setValues(const TimedValue<T> *begin,
+                                   const TimedValue<T> *end) {
+  Listener<T>::safelyNotifyListenerSetOfBatch(
+      listeners_, *this, begin, end,
+      [this](const TimedValue<T> &x) { values_.append(x); });
+}
+
 // Pre-define a few types
 typedef ValueDispatcher<Angle<double>> AngleDispatcher;
 typedef ValueDispatcher<Velocity<double>> VelocityDispatcher;
@@ -160,6 +336,9 @@ class ValueDispatcherProxy : Listener<T>, public ValueDispatcher<T> {
   ValueDispatcherProxy() : ValueDispatcher<T>(0, 1), _forward(0) { }
 
   virtual void setValue(T value) { if (_forward) _forward->setValue(value); }
+  virtual void setValues(const TimedValue<T> *begin, const TimedValue<T> *end) {
+    if (_forward) _forward->setValues(begin, end);
+  }
 
   virtual bool hasValue() const { return _forward && _forward->hasValue(); }
   virtual T lastValue() const { return _forward ? _forward->lastValue() : T(); }
@@ -189,6 +368,18 @@ class ValueDispatcherProxy : Listener<T>, public ValueDispatcher<T> {
   virtual void onNewValue(const ValueDispatcher<T> &dispatcher) {
     Listener<T>::safelyNotifyListenerSet(this->listeners_, *this);
   }
+
+  // The forwarded samples are already stored in the real dispatcher,
+  // so we can only accept batches if our own listeners do.
+  virtual bool acceptsBatches() const {
+    return this->allListenersTakeBatches();
+  }
+  virtual void onNewValues(const ValueDispatcher<T> &dispatcher,
+                           const TimedValue<T> *begin,
+                           const TimedValue<T> *end) {
+    Listener<T>::safelyNotifyListenerSetOfBatch(
+        this->listeners_, *this, begin, end, [](const TimedValue<T> &) {});
+  }
  private:
   TimedSampleCollection<T> emptyValues_;
   ValueDispatcher<T> *_forward;
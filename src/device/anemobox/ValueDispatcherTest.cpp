@@ -62,3 +62,105 @@ TEST(ValueDispatcher, Proxy) {
   EXPECT_EQ(7, proxy.lastValue());
   EXPECT_EQ(7, real.lastValue());
 }
+
+namespace {
+  class BatchListener : public Listener<int> {
+   public:
+    int singleCalls = 0;
+    std::vector<int> received;
+
+    void onNewValue(const ValueDispatcher<int> &dispatcher) override {
+      singleCalls++;
+      received.push_back(dispatcher.lastValue());
+    }
+    bool acceptsBatches() const override { return true; }
+    void onNewValues(const ValueDispatcher<int> &,
+                     const TimedValue<int> *begin,
+                     const TimedValue<int> *end) override {
+      batches++;
+      for (auto x = begin; x != end; ++x) {
+        received.push_back(x->value);
+      }
+    }
+    int batches = 0;
+  };
+
+  std::vector<TimedValue<int>> makeBatch(int n) {
+    auto t = TimeStamp::UTC(2017, 6, 1, 12, 0, 0);
+    std::vector<TimedValue<int>> batch;
+    for (int i = 0; i < n; i++) {
+      batch.push_back(TimedValue<int>(t + Duration<>::seconds(i), i));
+    }
+    return batch;
+  }
+}
+
+TEST(ValueDispatcher, SetValuesBatch) {
+  Clock clock;
+  ValueDispatcher<int> dispatcher(&clock, 10);
+  BatchListener batchListener;
+  MockListener listener;
+  dispatcher.subscribe(&batchListener);
+  dispatcher.subscribe(&listener);
+
+  // Listeners not accepting batches still see every sample,
+  // with the dispatcher state as it was at that sample.
+  EXPECT_CALL(listener, gotValue(0));
+  EXPECT_CALL(listener, gotValue(1));
+  EXPECT_CALL(listener, gotValue(2));
+  dispatcher.setValues(makeBatch(3));
+
+  EXPECT_EQ(1, batchListener.batches);
+  EXPECT_EQ(0, batchListener.singleCalls);
+  EXPECT_EQ((std::vector<int>{0, 1, 2}), batchListener.received);
+  EXPECT_EQ(3, dispatcher.values().size());
+  EXPECT_EQ(2, dispatcher.lastValue());
+  EXPECT_FALSE(dispatcher.allListenersTakeBatches());
+}
+
+TEST(ValueDispatcher, ProxyForwardsBatches) {
+  Clock clock;
+  ValueDispatcher<int> real(&clock, 10);
+  ValueDispatcherProxy<int> proxy;
+  BatchListener listener;
+  proxy.subscribe(&listener);
+  proxy.proxy(&real);
+
+  EXPECT_TRUE(real.allListenersTakeBatches());
+  real.setValues(makeBatch(4));
+  EXPECT_EQ(1, listener.batches);
+  EXPECT_EQ((std::vector<int>{0, 1, 2, 3}), listener.received);
+}
+
+TEST(ValueDispatcher, Coalescing) {
+  Clock clock;
+  ValueDispatcher<int> dispatcher(&clock, 10);
+  NotificationCoalescer coalescer;
+  MockListener listener;
+  listener.setCoalescer(&coalescer);
+  dispatcher.subscribe(&listener);
+
+  dispatcher.setValues(makeBatch(3));
+  dispatcher.setValue(7);
+  dispatcher.setValue(8);
+  EXPECT_TRUE(coalescer.hasPending());
+
+  // Only one wake-up, with the latest value.
+  EXPECT_CALL(listener, gotValue(8));
+  EXPECT_EQ(1, coalescer.flush());
+  EXPECT_FALSE(coalescer.hasPending());
+  EXPECT_EQ(0, coalescer.flush());
+}
+
+TEST(ValueDispatcher, CoalescingListenerDestroyed) {
+  Clock clock;
+  ValueDispatcher<int> dispatcher(&clock, 10);
+  NotificationCoalescer coalescer;
+  {
+    MockListener listener;
+    listener.setCoalescer(&coalescer);
+    dispatcher.subscribe(&listener);
+    dispatcher.setValue(1);
+  }
+  EXPECT_EQ(0, coalescer.flush());
+}
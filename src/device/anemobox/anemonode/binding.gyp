@@ -42,6 +42,10 @@
         "../TimedSampleCollection.h",
         "../DispatcherFilter.cpp",
         "../DispatcherFilter.h",
+        "../IncrementalDispatcherFilter.cpp",
+        "../IncrementalDispatcherFilter.h",
+        "../SampleWindow.cpp",
+        "../SampleWindow.h",
         "../DispatcherTrueWindEstimator.h",
         "../DispatcherTrueWindEstimator.cpp",
         "../Nmea0183Source.cpp",
@@ -30,7 +30,8 @@ function start() {
     }
   }
   for (var i in triggeringFields) {
-    anemonode.dispatcher.values[triggeringFields[i]].subscribe(update);
+    // update() only needs to be woken up once per tick.
+    anemonode.dispatcher.values[triggeringFields[i]].subscribe(update, 0, true);
   }
 }
 
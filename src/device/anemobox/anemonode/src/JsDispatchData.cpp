@@ -3,6 +3,9 @@
 
 #include <device/anemobox/BinarySignal.h>
 #include <device/anemobox/Dispatcher.h>
+#include <device/anemobox/SampleWindow.h>
+#include <cstring>
+#include <uv.h>
 
 using namespace v8;
 using namespace node;
@@ -265,6 +268,28 @@ class SetValueVisitor : public DispatchDataVisitor {
   bool success_;
 };
 
+// Coalescing listeners are woken up at most once per event loop
+// iteration: a libuv check handle flushes them right after I/O callbacks.
+NotificationCoalescer jsCoalescer;
+uv_check_t jsCoalescerCheck;
+bool jsCoalescerStarted = false;
+
+void flushJsCoalescer(uv_check_t *) {
+  Nan::HandleScope scope;
+  jsCoalescer.flush();
+}
+
+NotificationCoalescer *startJsCoalescer() {
+  if (!jsCoalescerStarted) {
+    uv_check_init(uv_default_loop(), &jsCoalescerCheck);
+    uv_check_start(&jsCoalescerCheck, flushJsCoalescer);
+    // The check handle alone should not keep node running.
+    uv_unref(reinterpret_cast<uv_handle_t *>(&jsCoalescerCheck));
+    jsCoalescerStarted = true;
+  }
+  return &jsCoalescer;
+}
+
 class JsListener:
   public Listener<Angle<double>>,
   public Listener<Velocity<double>>,
@@ -285,6 +310,17 @@ class JsListener:
     callback_.Reset();
   }
 
+  void coalesce(NotificationCoalescer *coalescer) {
+    Listener<Angle<double>>::setCoalescer(coalescer);
+    Listener<Velocity<double>>::setCoalescer(coalescer);
+    Listener<AngularVelocity<double>>::setCoalescer(coalescer);
+    Listener<Length<double>>::setCoalescer(coalescer);
+    Listener<BinaryEdge>::setCoalescer(coalescer);
+    Listener<GeographicPosition<double>>::setCoalescer(coalescer);
+    Listener<TimeStamp>::setCoalescer(coalescer);
+    Listener<AbsoluteOrientation>::setCoalescer(coalescer);
+  }
+
   virtual void onNewValue(const ValueDispatcher<Angle<double>> &) { valueChanged(); }
   virtual void onNewValue(const ValueDispatcher<Velocity<double>> &) { valueChanged(); }
   virtual void onNewValue(const ValueDispatcher<AngularVelocity<double>> &) { valueChanged(); }
@@ -363,6 +399,7 @@ Local<FunctionTemplate> JsDispatchData::functionTemplate() {
   Nan::SetMethod(proto, "length", JsDispatchData::length);
   Nan::SetMethod(proto, "value", JsDispatchData::value);
   Nan::SetMethod(proto, "time", JsDispatchData::time);
+  Nan::SetMethod(proto, "window", JsDispatchData::window);
   Nan::SetMethod(proto, "setValue", JsDispatchData::setValue);
   Nan::SetMethod(proto, "subscribe", JsDispatchData::subscribe);
   Nan::SetMethod(proto, "unsubscribe", JsDispatchData::unsubscribe);
@@ -460,6 +497,59 @@ NAN_METHOD(JsDispatchData::time) {
   }
 }
 
+// The numbers are written straight into the backing store of the
+// ArrayBuffer, no JS value is created per sample.
+Local<Float64Array> JsDispatchData::toFloat64Array(
+    const std::vector<double> &values) {
+  size_t bytes = values.size() * sizeof(double);
+  Local<ArrayBuffer> buffer = ArrayBuffer::New(Isolate::GetCurrent(), bytes);
+  if (bytes > 0) {
+    memcpy(buffer->GetContents().Data(), values.data(), bytes);
+  }
+  return Float64Array::New(buffer, 0, values.size());
+}
+
+Local<Object> JsDispatchData::windowToJs(const SampleWindow &window,
+                                         bool withTime) {
+  Local<Object> result = Nan::New<Object>();
+  if (withTime) {
+    result->Set(Nan::New("time").ToLocalChecked(),
+                toFloat64Array(window.times));
+  }
+  for (size_t i = 0; i < window.components.size(); ++i) {
+    result->Set(Nan::New(window.components[i]).ToLocalChecked(),
+                toFloat64Array(window.columns[i]));
+  }
+  return result;
+}
+
+bool JsDispatchData::tryExtractTime(Local<Value> value, TimeStamp *dst) {
+  if (value->IsUndefined() || value->IsNull()) {
+    *dst = TimeStamp();
+    return true;
+  }
+  if (value->IsDate() || value->IsNumber()) {
+    *dst = TimeStamp::fromMilliSecondsSince1970(value->NumberValue());
+    return true;
+  }
+  return false;
+}
+
+NAN_METHOD(JsDispatchData::window) {
+  Nan::HandleScope scope;
+
+  std::shared_ptr<DispatchData> dispatchData = obj(info.This())->_dispatchData;
+
+  TimeStamp from, to;
+  if (!tryExtractTime(info[0], &from) || !tryExtractTime(info[1], &to)) {
+    return Nan::ThrowTypeError(
+        "window expects two Dates or times in milliseconds since 1970");
+  }
+
+  info.GetReturnValue().Set(
+      windowToJs(sampleWindow(dispatchData.get(), from, to)));
+}
+
 NAN_METHOD(JsDispatchData::setValue) {
   Nan::HandleScope scope;
   JsDispatchData* zis = obj(info.This());
@@ -521,6 +611,10 @@ NAN_METHOD(JsDispatchData::subscribe) {
   }
   JsListener *listener = new JsListener(
       dispatchData, cb, minInterval);
+  if (info.Length() >= 3 && info[2]->BooleanValue()) {
+    // Called at most once per tick, with the latest value.
+    listener->coalesce(startJsCoalescer());
+  }
   int index = subscriptionIndex++;
   registeredCallbacks[index] = listener;
 
@@ -6,11 +6,14 @@
 
 #include <map>
 #include <memory>
+#include <vector>
 
 namespace sail {
 
 class DispatchData;
 class Dispatcher;
+class TimeStamp;
+struct SampleWindow;
 
 namespace {
 class JsListener;
@@ -29,11 +32,24 @@ class JsDispatchData : public Nan::ObjectWrap {
   static void setDispatchData(
       v8::Handle<v8::Object> object, std::shared_ptr<DispatchData> data, Dispatcher* dispatcher);
 
+  // Returns an object with a Float64Array per component of the
+  // samples and, if withTime, a Float64Array 'time' in milliseconds
+  // since 1970.
+  static v8::Local<v8::Object> windowToJs(const SampleWindow &window,
+                                          bool withTime = true);
+  static v8::Local<v8::Float64Array> toFloat64Array(
+      const std::vector<double> &values);
+
+  // Accepts a Date, a number of milliseconds since 1970, or
+  // undefined/null for an undefined time.
+  static bool tryExtractTime(v8::Local<v8::Value> value, TimeStamp *dst);
+
  protected:
   static NAN_METHOD(New);
   static NAN_METHOD(length);
   static NAN_METHOD(value);
   static NAN_METHOD(time);
+  static NAN_METHOD(window);
   static NAN_METHOD(setValue);
   static NAN_METHOD(unsubscribe);
   static NAN_METHOD(subscribe);
@@ -1,6 +1,7 @@
 #include <device/anemobox/anemonode/src/JsDispatcher.h>
 
 #include <device/anemobox/Dispatcher.h>
+#include <device/anemobox/SampleWindow.h>
 #include <device/anemobox/anemonode/src/JsDispatchData.h>
 
 using namespace sail;
@@ -29,6 +30,7 @@ Local<FunctionTemplate> JsDispatcher::functionTemplate() {
   Nan::SetMethod(proto, "setSourcePriority", JsDispatcher::setSourcePriority);
   Nan::SetMethod(proto, "sourcePriority", JsDispatcher::sourcePriority);
   Nan::SetMethod(proto, "allSources", JsDispatcher::allSources);
+  Nan::SetMethod(proto, "resample", JsDispatcher::resample);
   return t;
 }
    
@@ -108,3 +110,73 @@ NAN_METHOD(JsDispatcher::allSources) {
 
   info.GetReturnValue().Set(sources);
 }
+
+// Bounds what a single call to resample allocates on the box.
+const int maxResampleRows = 100000;
+
+// resample(channels, from, to, stepSec, maxAgeSec)
+// Returns the current source of each of the 'channels' (an array of
+// short names such as 'awa') sampled every stepSec seconds from 'from'
+// to 'to', all in a single call. The result has a 'time' Float64Array and,
+// per channel, an object of Float64Arrays as returned by window().
+// A value is NaN when the last sample is older than maxAgeSec, which
+// defaults to stepSec. It throws if stepSec is less than a millisecond
+// or if there would be more than maxResampleRows times.
+NAN_METHOD(JsDispatcher::resample) {
+  Nan::HandleScope scope;
+  Dispatcher* dispatcher = obj(info.This())->_dispatcher;
+
+  const char *usage = "resample expects an array of channel names, "
+    "two Dates, a step in seconds, and optionally a max age in seconds";
+  TimeStamp from, to;
+  if (info.Length() < 4 || !info[0]->IsArray()
+      || !JsDispatchData::tryExtractTime(info[1], &from)
+      || !JsDispatchData::tryExtractTime(info[2], &to)
+      || !from.defined() || !to.defined() || !info[3]->IsNumber()) {
+    return Nan::ThrowTypeError(usage);
+  }
+  Duration<> step = Duration<>::seconds(info[3]->NumberValue());
+  Duration<> maxAge = (info.Length() > 4 && info[4]->IsNumber())
+    ? Duration<>::seconds(info[4]->NumberValue()) : step;
+  // Time stamps have a resolution of a millisecond: a shorter step
+  // would not move forward.
+  if (!(step >= Duration<>::milliseconds(1))) {
+    return Nan::ThrowTypeError("the step should be at least 1 ms");
+  }
+  if (from <= to && (to - from)/step >= maxResampleRows) {
+    return Nan::ThrowRangeError(
+        (std::string("resample would return more than ")
+         + std::to_string(maxResampleRows) + " rows").c_str());
+  }
+
+  std::vector<TimeStamp> times;
+  for (TimeStamp t = from; t <= to; t = t + step) {
+    times.push_back(t);
+  }
+
+  std::map<std::string, DispatchData *> channels;
+  for (auto entry : dispatcher->dispatchers()) {
+    channels[entry.second->wordIdentifier()] = entry.second.get();
+  }
+
+  std::vector<double> timesMs;
+  for (TimeStamp t : times) {
+    timesMs.push_back(double(t.toMilliSecondsSince1970()));
+  }
+  Local<Object> result = Nan::New<Object>();
+  result->Set(Nan::New("time").ToLocalChecked(),
+              JsDispatchData::toFloat64Array(timesMs));
+
+  Local<Array> names = Local<Array>::Cast(info[0]);
+  for (uint32_t i = 0; i < names->Length(); ++i) {
+    v8::String::Utf8Value name(names->Get(i)->ToString());
+    auto found = channels.find(*name);
+    if (found == channels.end()) {
+      return Nan::ThrowError(
+          (std::string("unknown channel: ") + *name).c_str());
+    }
+    result->Set(names->Get(i), JsDispatchData::windowToJs(
+            sail::resample(found->second, times, maxAge), false));
+  }
+  info.GetReturnValue().Set(result);
+}
@@ -28,6 +28,7 @@ class JsDispatcher : public Nan::ObjectWrap {
   static NAN_METHOD(setSourcePriority);
   static NAN_METHOD(sourcePriority);
   static NAN_METHOD(allSources);
+  static NAN_METHOD(resample);
 
  private:
   Dispatcher* _dispatcher;
@@ -13,7 +13,7 @@ Nan::Persistent<v8::FunctionTemplate> estimator_constructor;
 }  // namespace
 
 JsEstimator::JsEstimator()
-  : _estimator(globalAnemonodeDispatcher) {
+  : _estimator(globalAnemonodeDispatcher, true) {
 }
 
 void JsEstimator::Init(v8::Handle<v8::Object> target) {
@@ -71,7 +71,7 @@ NAN_METHOD(JsEstimator::compute) {
     Nan::ThrowTypeError("This is not a Logger");
     return;
   }
-  obj->_estimator.compute();
+  obj->_estimator.computeIfChanged();
   return;
 }
 
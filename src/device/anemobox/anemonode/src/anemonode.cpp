@@ -7,6 +7,7 @@
 #include <node.h>
 #include <nan.h>
 
+#include <device/anemobox/DispatcherFilter.h>
 #include <device/anemobox/anemonode/src/JsDispatcher.h>
 #include <device/anemobox/anemonode/src/JsNmea0183Source.h>
 #include <device/anemobox/anemonode/src/JsNmea2000Source.h>
@@ -38,6 +39,32 @@ class MonotonicClockDispatcher : public Dispatcher {
     virtual TimeStamp currentTime() { return MonotonicClock::now(); }
 };
 
+// Live channels keep their samples in preallocated ring buffers, so that
+// publishing never allocates. Each buffer covers the history that is read
+// from it: the filter window for the estimator inputs, and the last minute
+// for the rest (see timeest.js).
+void useRingBuffers(Dispatcher *dispatcher) {
+  Duration<> history = Duration<>::seconds(60);
+  Duration<> period = Duration<>::seconds(0.1);
+#define USE_RING_BUFFER(HANDLE, CODE, SHORTNAME, TYPE, DESCRIPTION) \
+  dispatcher->setRingBufferWindow(HANDLE, history, period);
+  FOREACH_CHANNEL(USE_RING_BUFFER)
+#undef USE_RING_BUFFER
+
+  DispatcherFilterParams filter;
+  Duration<> inputPeriod = Duration<>::seconds(0.05);
+  dispatcher->setRingBufferWindow(AWA, filter.apparentWindWindow, inputPeriod);
+  dispatcher->setRingBufferWindow(AWS, filter.apparentWindWindow, inputPeriod);
+  dispatcher->setRingBufferWindow(
+      MAG_HEADING, filter.waterMotionWindow, inputPeriod);
+  dispatcher->setRingBufferWindow(
+      WAT_SPEED, filter.waterMotionWindow, inputPeriod);
+  dispatcher->setRingBufferWindow(
+      GPS_SPEED, filter.gpsMotionWindow, inputPeriod);
+  dispatcher->setRingBufferWindow(
+      GPS_BEARING, filter.gpsMotionWindow, inputPeriod);
+}
+
 NAN_METHOD(adjTime) {
   Nan::HandleScope scope;
 
@@ -75,6 +102,7 @@ NAN_METHOD(currentTime) {
 void RegisterModule(Handle<Object> target) {
   Dispatcher *dispatcher = new MonotonicClockDispatcher();
   globalAnemonodeDispatcher = dispatcher;
+  useRingBuffers(dispatcher);
 
   JsDispatcher::Init(dispatcher, target);
   JsNmea0183Source::Init(target);
@@ -0,0 +1,507 @@
+#include <device/anemobox/logger/LogScan.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <device/Arduino/libraries/NmeaParser/NmeaParser.h>
+#include <device/anemobox/Dispatcher.h>
+#include <device/anemobox/Nmea0183Adaptor.h>
+#include <fcntl.h>
+#include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/io/gzip_stream.h>
+#include <google/protobuf/io/zero_copy_stream_impl.h>
+#include <google/protobuf/wire_format_lite.h>
+#include <limits>
+#include <server/common/logging.h>
+#include <thread>
+#include <unistd.h>
+
+namespace sail {
+
+using google::protobuf::io::CodedInputStream;
+using google::protobuf::io::FileInputStream;
+using google::protobuf::io::GzipInputStream;
+using google::protobuf::internal::WireFormatLite;
+
+namespace {
+
+// Field numbers of logger.proto
+namespace LogFileField {
+  enum {Stream = 1, Anemobox = 2, BoatId = 3, BoatName = 4, Text = 5,
+    BootCount = 6, RawNmea2000 = 7};
+}
+
+namespace ValueSetField {
+  enum {ShortName = 1, TimeStamps = 2, Text = 7, Source = 8, Priority = 9,
+    ExtTimes = 11, TimeStampsSinceBoot = 12};
+}
+
+namespace Nmea2000SentencesField {
+  enum {TimeStampsSinceBoot = 2};
+}
+
+// Same bounds as in ProtobufLogLoader
+const TimeStamp kMinValidTime = TimeStamp::UTC(2014, 1, 1, 0, 0, 0);
+const TimeStamp kMaxValidTime = TimeStamp::now() + Duration<>::hours(24);
+
+// Reads a repeated int64 field, packed or not.
+bool readInt64s(CodedInputStream *input, uint32_t tag,
+                std::vector<int64_t> *dst) {
+  google::protobuf::uint64 x = 0;
+  if (WireFormatLite::GetTagWireType(tag)
+      == WireFormatLite::WIRETYPE_VARINT) {
+    if (!input->ReadVarint64(&x)) {
+      return false;
+    }
+    dst->push_back(x);
+    return true;
+  }
+  uint32_t length = 0;
+  if (!input->ReadVarint32(&length)) {
+    return false;
+  }
+  auto limit = input->PushLimit(length);
+  while (input->BytesUntilLimit() > 0) {
+    if (!input->ReadVarint64(&x)) {
+      return false;
+    }
+    dst->push_back(x);
+  }
+  input->PopLimit(limit);
+  return true;
+}
+
+// Counts the elements of a repeated varint field, without keeping them.
+bool countVarints(CodedInputStream *input, uint32_t tag, int *count) {
+  google::protobuf::uint64 x = 0;
+  if (WireFormatLite::GetTagWireType(tag)
+      == WireFormatLite::WIRETYPE_VARINT) {
+    (*count)++;
+    return input->ReadVarint64(&x);
+  }
+  uint32_t length = 0;
+  if (!input->ReadVarint32(&length)) {
+    return false;
+  }
+  auto limit = input->PushLimit(length);
+  while (input->BytesUntilLimit() > 0) {
+    if (!input->ReadVarint64(&x)) {
+      return false;
+    }
+    (*count)++;
+  }
+  input->PopLimit(limit);
+  return true;
+}
+
+void undoDeltaCoding(std::vector<int64_t> *x) {
+  int64_t sum = 0;
+  for (auto &y : *x) {
+    sum += y;
+    y = sum;
+  }
+}
+
+// The offset of a stream and how well it fits, to pick the best one
+// like ProtobufLogLoader does: highest priority first, then smallest error.
+struct OffsetEstimate {
+  int priority = -std::numeric_limits<int>::max();
+  double error = std::numeric_limits<double>::infinity();
+  Duration<double> offset = Duration<double>::seconds(0.0);
+
+  bool operator<(const OffsetEstimate &other) const {
+    return std::make_pair(-priority, error)
+      < std::make_pair(-other.priority, other.error);
+  }
+};
+
+OffsetEstimate estimateOffset(const std::vector<int64_t> &times,
+                              const std::vector<int64_t> &extTimes,
+                              int priority) {
+  OffsetEstimate dst;
+  if (times.size() != extTimes.size()) {
+    return dst;
+  }
+  std::vector<int64_t> diffs;
+  for (int i = 0; i < times.size(); i++) {
+    auto t = TimeStamp::fromMilliSecondsSince1970(extTimes[i]);
+    if (kMinValidTime < t && t < kMaxValidTime) {
+      diffs.push_back(extTimes[i] - times[i]);
+    }
+  }
+  int n = diffs.size();
+  if (n <= 30) {
+    return dst;
+  }
+  auto at = diffs.begin() + n/2;
+  std::nth_element(diffs.begin(), at, diffs.end());
+  int64_t median = *at;
+  double totalError = 0.0;
+  for (auto x : diffs) {
+    totalError += 0.001*std::abs(x - median);
+  }
+  dst.priority = priority;
+  dst.error = totalError/n;
+  dst.offset = Duration<double>::milliseconds(median);
+  return dst;
+}
+
+// Collects the dates and times of the NMEA 0183 text of a stream
+// without external times, with the times since boot of the bytes that
+// complete them. They are the external times that ProtobufLogLoader
+// finds in the text in that case. Like Nmea0183LogLoaderAdaptor, a
+// date after a time of day is given the time of the next byte.
+class NmeaDateTimes {
+ public:
+  template <DataCode Code>
+  void add(const std::string &, const typename TypeForCode<Code>::type &) {}
+
+  void setTimeOfDay(int hour, int minute, int second) {
+    _timeOfDay = true;
+  }
+
+  void setTime(TimeStamp t) {
+    if (!_lastTime.defined() || _lastTime < t) {
+      _lastTime = t;
+    }
+    flush();
+  }
+
+  void addDateTime(TimeStamp value) {
+    if (!isFinite(value)) {
+      return;
+    }
+    if (_timeOfDay) {
+      _pending.push_back(value);
+    } else if (_lastTime.defined()) {
+      _times.push_back(_lastTime.toMilliSecondsSince1970());
+      _extTimes.push_back(value.toMilliSecondsSince1970());
+    }
+  }
+
+  void flush() {
+    for (auto value : _pending) {
+      _times.push_back(_lastTime.toMilliSecondsSince1970());
+      _extTimes.push_back(value.toMilliSecondsSince1970());
+    }
+    _pending.clear();
+  }
+
+  const std::vector<int64_t> &times() const { return _times; }
+  const std::vector<int64_t> &extTimes() const { return _extTimes; }
+ private:
+  TimeStamp _lastTime;
+  bool _timeOfDay = false;
+  std::vector<TimeStamp> _pending;
+  std::vector<int64_t> _times, _extTimes;
+};
+
+template <>
+void NmeaDateTimes::add<DATE_TIME>(const std::string &,
+                                   const TimeStamp &value) {
+  addDateTime(value);
+}
+
+// Parses the text like loadTextData in ProtobufLogLoader does: the bytes
+// of a chunk of text are spread evenly before its time.
+OffsetEstimate estimateOffsetFromNmea0183(const std::vector<int64_t> &times,
+                                          const std::vector<std::string> &text,
+                                          int priority) {
+  int n = text.size();
+  if (n == 0 || times.size() < n) {
+    return OffsetEstimate();
+  }
+  int64_t byteCount = 0;
+  for (const auto &chunk : text) {
+    byteCount += chunk.size();
+  }
+  Duration<> interval = byteCount > 0?
+    Duration<>::milliseconds(times[n - 1] - times[0]).scaled(
+        1.0/double(byteCount))
+    : Duration<>::seconds(1/4800.0);
+
+  NmeaParser parser;
+  parser.setIgnoreWrongChecksum(true);
+  NmeaDateTimes dateTimes;
+  for (int i = 0; i < n; i++) {
+    TimeStamp t = TimeStamp::fromMilliSecondsSince1970(times[i])
+      - interval.scaled(text[i].size());
+    for (auto c : text[i]) {
+      dateTimes.setTime(t);
+      t += interval;
+      Nmea0183ProcessByte(std::string(), c, &parser, &dateTimes);
+    }
+  }
+  dateTimes.flush();
+  return estimateOffset(dateTimes.times(), dateTimes.extTimes(), priority);
+}
+
+class Scanner {
+ public:
+  Scanner(LogFileSummary *dst) : _dst(dst) {}
+
+  bool scanLogFile(CodedInputStream *input);
+ private:
+  bool scanValueSet(CodedInputStream *input, bool text);
+  bool scanNmea2000Sentences(CodedInputStream *input);
+  void finish();
+
+  LogFileSummary *_dst;
+  OffsetEstimate _offset;
+
+  // Reused between the streams.
+  std::vector<int64_t> _timeStamps, _timeStampsSinceBoot, _extTimes;
+  std::vector<std::string> _text;
+};
+
+bool Scanner::scanLogFile(CodedInputStream *input) {
+  bool hasStreams = false;
+  uint32_t tag = 0;
+  while ((tag = input->ReadTag()) != 0) {
+    bool ok = true;
+    switch (WireFormatLite::GetTagFieldNumber(tag)) {
+      case LogFileField::Stream:
+        hasStreams = true;
+        ok = scanValueSet(input, false);
+        break;
+      case LogFileField::Text:
+        ok = scanValueSet(input, true);
+        break;
+      case LogFileField::RawNmea2000:
+        ok = scanNmea2000Sentences(input);
+        break;
+      case LogFileField::Anemobox:
+        ok = WireFormatLite::ReadString(input, &_dst->anemobox);
+        break;
+      case LogFileField::BoatId:
+        ok = WireFormatLite::ReadString(input, &_dst->boatId);
+        break;
+      case LogFileField::BoatName:
+        ok = WireFormatLite::ReadString(input, &_dst->boatName);
+        break;
+      case LogFileField::BootCount: {
+        google::protobuf::uint64 x = 0;
+        ok = input->ReadVarint64(&x);
+        _dst->bootCount = x;
+        break;
+      }
+      default:
+        ok = WireFormatLite::SkipField(input, tag);
+    };
+    if (!ok) {
+      return false;
+    }
+  }
+  finish();
+  // Like Logger::read, a file without streams is not valid.
+  return hasStreams;
+}
+
+bool Scanner::scanValueSet(CodedInputStream *input, bool text) {
+  uint32_t length = 0;
+  if (!input->ReadVarint32(&length)) {
+    return false;
+  }
+  auto limit = input->PushLimit(length);
+
+  LogStreamSummary stream;
+  stream.text = text;
+  _timeStamps.clear();
+  _timeStampsSinceBoot.clear();
+  _extTimes.clear();
+  _text.clear();
+
+  uint32_t tag = 0;
+  while ((tag = input->ReadTag()) != 0) {
+    bool ok = true;
+    switch (WireFormatLite::GetTagFieldNumber(tag)) {
+      case ValueSetField::ShortName:
+        ok = WireFormatLite::ReadString(input, &stream.shortName);
+        break;
+      case ValueSetField::Source:
+        ok = WireFormatLite::ReadString(input, &stream.source);
+        break;
+      case ValueSetField::Priority: {
+        google::protobuf::uint32 x = 0;
+        ok = input->ReadVarint32(&x);
+        stream.priority = int32_t(x);
+        break;
+      }
+      case ValueSetField::TimeStamps:
+        ok = readInt64s(input, tag, &_timeStamps);
+        break;
+      case ValueSetField::TimeStampsSinceBoot:
+        ok = readInt64s(input, tag, &_timeStampsSinceBoot);
+        break;
+      case ValueSetField::ExtTimes:
+        ok = readInt64s(input, tag, &_extTimes);
+        break;
+      case ValueSetField::Text:
+        // Only parsed if there are no external times, see below.
+        _text.push_back(std::string());
+        ok = WireFormatLite::ReadString(input, &_text.back());
+        break;
+      default:
+        // The values.
+        ok = WireFormatLite::SkipField(input, tag);
+    };
+    if (!ok) {
+      return false;
+    }
+  }
+  if (!input->ConsumedEntireMessage()) {
+    return false;
+  }
+  input->PopLimit(limit);
+
+  // See getBestKnownTimeStamps in Logger.cpp
+  auto &times = (_timeStamps.size() > _timeStampsSinceBoot.size()?
+      _timeStamps : _timeStampsSinceBoot);
+  undoDeltaCoding(&times);
+  stream.count = times.size();
+  if (!times.empty()) {
+    auto bounds = std::minmax_element(times.begin(), times.end());
+    stream.lowerBound = TimeStamp::fromMilliSecondsSince1970(*bounds.first);
+    stream.upperBound = TimeStamp::fromMilliSecondsSince1970(*bounds.second);
+  }
+  if (!_extTimes.empty()) {
+    undoDeltaCoding(&_extTimes);
+    _offset = std::min(_offset, estimateOffset(times, _extTimes, stream.priority));
+  } else if (!_text.empty() && _offset.priority <= stream.priority) {
+    // Like ProtobufLogLoader, look for dates in the NMEA 0183 text. Not
+    // needed if a stream of higher priority already gave the offset.
+    _offset = std::min(_offset,
+        estimateOffsetFromNmea0183(times, _text, stream.priority));
+  }
+  _dst->streams.push_back(stream);
+  return true;
+}
+
+bool Scanner::scanNmea2000Sentences(CodedInputStream *input) {
+  uint32_t length = 0;
+  if (!input->ReadVarint32(&length)) {
+    return false;
+  }
+  auto limit = input->PushLimit(length);
+  uint32_t tag = 0;
+  while ((tag = input->ReadTag()) != 0) {
+    bool ok = (WireFormatLite::GetTagFieldNumber(tag)
+               == Nmea2000SentencesField::TimeStampsSinceBoot?
+        countVarints(input, tag, &_dst->rawNmea2000Count)
+        : WireFormatLite::SkipField(input, tag));
+    if (!ok) {
+      return false;
+    }
+  }
+  if (!input->ConsumedEntireMessage()) {
+    return false;
+  }
+  input->PopLimit(limit);
+  return true;
+}
+
+void Scanner::finish() {
+  _dst->timeOffset = _offset.offset;
+  for (auto &stream : _dst->streams) {
+    if (stream.count == 0) {
+      continue;
+    }
+    stream.lowerBound = stream.lowerBound + _dst->timeOffset;
+    stream.upperBound = stream.upperBound + _dst->timeOffset;
+    if (!_dst->lowerBound.defined() || stream.lowerBound < _dst->lowerBound) {
+      _dst->lowerBound = stream.lowerBound;
+    }
+    if (!_dst->upperBound.defined() || _dst->upperBound < stream.upperBound) {
+      _dst->upperBound = stream.upperBound;
+    }
+  }
+}
+
+}  // namespace
+
+int64_t LogFileSummary::sampleCount() const {
+  int64_t n = 0;
+  for (const auto &stream : streams) {
+    n += stream.count;
+  }
+  return n;
+}
+
+std::string LogFileSummary::boatKey() const {
+  return boatId.empty()? anemobox : boatId;
+}
+
+bool LogFileSummary::overlaps(TimeStamp from, TimeStamp to) const {
+  if (!lowerBound.defined() || !upperBound.defined()) {
+    return false;
+  }
+  return (!from.defined() || !(upperBound < from))
+    && (!to.defined() || !(to < lowerBound));
+}
+
+bool scanLogFile(const std::string &filename, LogFileSummary *dst) {
+  *dst = LogFileSummary();
+  dst->filename = filename;
+
+  int fd = open(filename.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+  bool ok = false;
+  {
+    FileInputStream file(fd);
+    GzipInputStream gzip(&file);
+    CodedInputStream input(&gzip);
+    // Same limit as in Logger::read
+    input.SetTotalBytesLimit(500 * 1024 * 1024, 400 * 1024 * 1024);
+    Scanner scanner(dst);
+    ok = scanner.scanLogFile(&input) && 0 <= gzip.ZlibErrorCode();
+  }
+  close(fd);
+  dst->valid = ok;
+  return ok;
+}
+
+std::vector<LogFileSummary> scanLogFiles(
+    const std::vector<std::string> &filenames, int threadCount) {
+  int n = filenames.size();
+  std::vector<LogFileSummary> dst(n);
+  std::atomic<int> next(0);
+  auto work = [&]() {
+    int i = 0;
+    while ((i = next++) < n) {
+      if (!scanLogFile(filenames[i], &dst[i])) {
+        LOG(WARNING) << filenames[i] << ": can't read log file.";
+      }
+    }
+  };
+  std::vector<std::thread> threads;
+  for (int i = 1; i < std::min(threadCount, n); i++) {
+    threads.push_back(std::thread(work));
+  }
+  work();
+  for (auto &t : threads) {
+    t.join();
+  }
+  return dst;
+}
+
+std::map<std::string, std::vector<LogFileSummary> > indexLogFilesByBoat(
+    const std::vector<LogFileSummary> &summaries) {
+  std::map<std::string, std::vector<LogFileSummary> > dst;
+  for (const auto &summary : summaries) {
+    if (summary.valid) {
+      dst[summary.boatKey()].push_back(summary);
+    }
+  }
+  for (auto &kv : dst) {
+    std::stable_sort(kv.second.begin(), kv.second.end(),
+        [](const LogFileSummary &a, const LogFileSummary &b) {
+      return a.lowerBound.defined() && (!b.lowerBound.defined()
+          || a.lowerBound < b.lowerBound);
+    });
+  }
+  return dst;
+}
+
+}  // namespace sail
@@ -0,0 +1,76 @@
+/*
+ * Fast scanning of the metadata of log files: the header, and for every
+ * stream its name, source, number of samples and time span. The values are
+ * not decoded: the scanner walks the protobuf wire format and skips them,
+ * so that large directories of logs can be indexed in seconds, in parallel.
+ * Only the NMEA 0183 text of files without external times is parsed, for
+ * the dates it contains.
+ */
+
+#ifndef ANEMOBOX_LOGSCAN_H
+#define ANEMOBOX_LOGSCAN_H
+
+#include <cstdint>
+#include <map>
+#include <server/common/TimeStamp.h>
+#include <string>
+#include <vector>
+
+namespace sail {
+
+struct LogStreamSummary {
+  std::string shortName;
+  std::string source;
+  int priority = 0;
+
+  // Whether the stream is one of the text streams of the file,
+  // such as raw NMEA 0183.
+  bool text = false;
+
+  int count = 0;
+  TimeStamp lowerBound, upperBound;
+};
+
+struct LogFileSummary {
+  std::string filename;
+
+  // False if the file could not be read.
+  bool valid = false;
+
+  std::string anemobox, boatId, boatName;
+  int64_t bootCount = -1;
+
+  // Added to the times of the streams, estimated like
+  // ProtobufLogLoader does from the external times of the streams, or
+  // else from the dates in their NMEA 0183 text. Zero if there are none.
+  Duration<double> timeOffset = Duration<double>::seconds(0.0);
+
+  std::vector<LogStreamSummary> streams;
+  int rawNmea2000Count = 0;
+
+  // The span of all the streams.
+  TimeStamp lowerBound, upperBound;
+
+  int64_t sampleCount() const;
+
+  // The boat id if there is one, otherwise the anemobox id.
+  std::string boatKey() const;
+
+  // Whether the span of the file overlaps [from, to]. Undefined bounds are open.
+  bool overlaps(TimeStamp from, TimeStamp to) const;
+};
+
+bool scanLogFile(const std::string &filename, LogFileSummary *dst);
+
+// Scans the files with 'threadCount' threads. The summaries are
+// returned in the order of the files.
+std::vector<LogFileSummary> scanLogFiles(
+    const std::vector<std::string> &filenames, int threadCount);
+
+// The valid summaries grouped by boat (see boatKey), ordered by time.
+std::map<std::string, std::vector<LogFileSummary> > indexLogFilesByBoat(
+    const std::vector<LogFileSummary> &summaries);
+
+}  // namespace sail
+
+#endif  // ANEMOBOX_LOGSCAN_H
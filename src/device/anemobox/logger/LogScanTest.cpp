@@ -0,0 +1,233 @@
+#include <device/anemobox/logger/LogScan.h>
+
+#include <boost/filesystem.hpp>
+#include <cstdio>
+#include <ctime>
+#include <device/anemobox/logger/Logger.h>
+#include <fstream>
+#include <gtest/gtest.h>
+
+using namespace sail;
+
+namespace {
+  TimeStamp boot = TimeStamp::fromMilliSecondsSince1970(1000);
+  TimeStamp utc = TimeStamp::UTC(2016, 6, 1, 12, 0, 0);
+
+  TimeStamp sinceBoot(int seconds) {
+    return boot + Duration<double>::seconds(seconds);
+  }
+
+  LogFile makeLogFile(const std::string &boatId, int startSeconds) {
+    LogFile data;
+    data.set_boatid(boatId);
+    data.set_bootcount(7);
+
+    // The external times give the offset of the times since boot.
+    ValueSet *dateTime = data.add_stream();
+    dateTime->set_shortname("dateTime");
+    dateTime->set_source("Internal GPS");
+    dateTime->set_priority(3);
+    int64_t base = 0, extBase = 0;
+    for (int i = 0; i < 40; i++) {
+      int t = startSeconds + i;
+      addTimeStampToRepeatedFields(
+          &base, dateTime->mutable_timestampssinceboot(), sinceBoot(t));
+      addTimeStampToRepeatedFields(
+          &extBase, dateTime->mutable_exttimes(),
+          utc + Duration<double>::seconds(t));
+    }
+
+    ValueSet *awa = data.add_stream();
+    awa->set_shortname("awa");
+    awa->set_source("NMEA2000");
+    base = 0;
+    for (int i = 0; i < 10; i++) {
+      addTimeStampToRepeatedFields(
+          &base, awa->mutable_timestampssinceboot(),
+          sinceBoot(startSeconds + 100 + i));
+      awa->mutable_angles()->add_deltaangle(i == 0? 4500 : 10);
+    }
+
+    ValueSet *text = data.add_text();
+    text->set_shortname("NMEA0183 input");
+    text->set_source("NMEA0183");
+    base = 0;
+    for (int i = 0; i < 3; i++) {
+      addTimeStampToRepeatedFields(
+          &base, text->mutable_timestampssinceboot(),
+          sinceBoot(startSeconds + 10 + i));
+      text->add_text("$IIMWV,045.0,R,10.0,N,A*00");
+    }
+
+    Nmea2000Sentences *raw = data.add_rawnmea2000();
+    raw->set_sentence_id(0x09F80100);
+    base = 0;
+    for (int i = 0; i < 5; i++) {
+      addTimeStampToRepeatedFields(
+          &base, raw->mutable_timestampssinceboot(), sinceBoot(startSeconds + i));
+      raw->add_regularsizesentences(i);
+    }
+    return data;
+  }
+
+  std::string withChecksum(const std::string &sentence) {
+    unsigned char checksum = 0;
+    for (char c : sentence) {
+      checksum ^= c;
+    }
+    char suffix[8];
+    snprintf(suffix, sizeof(suffix), "*%02X\r\n", checksum);
+    return "$" + sentence + suffix;
+  }
+
+  // A GPRMC sentence with the date and time of 'utc + seconds'.
+  std::string rmcSentence(int seconds) {
+    char fields[64];
+    time_t t = (utc + Duration<double>::seconds(seconds))
+      .toMilliSecondsSince1970()/1000;
+    strftime(fields, sizeof(fields), "%H%M%S.00,A,4807.038,N,01131.000,E,"
+             "5.5,084.4,%d%m%y", gmtime(&t));
+    return withChecksum(std::string("GPRMC,") + fields + ",003.1,W");
+  }
+
+  // Without external times: like on boxes without their own GPS, the
+  // time is only in the NMEA 0183 text.
+  LogFile makeLogFileWithoutExtTimes() {
+    LogFile data;
+    data.set_boatid("boat");
+
+    ValueSet *awa = data.add_stream();
+    awa->set_shortname("awa");
+    awa->set_source("NMEA2000");
+    int64_t base = 0;
+    for (int i = 0; i < 10; i++) {
+      addTimeStampToRepeatedFields(
+          &base, awa->mutable_timestampssinceboot(), sinceBoot(100 + i));
+      awa->mutable_angles()->add_deltaangle(i == 0? 4500 : 10);
+    }
+
+    ValueSet *text = data.add_text();
+    text->set_shortname("NMEA0183 input");
+    text->set_source("NMEA0183");
+    base = 0;
+    for (int i = 0; i < 40; i++) {
+      addTimeStampToRepeatedFields(
+          &base, text->mutable_timestampssinceboot(), sinceBoot(i));
+      text->add_text(rmcSentence(i));
+    }
+    return data;
+  }
+}
+
+TEST(LogScanTest, ScanFile) {
+  const char filename[] = "./LogScanTest.log";
+  LogFile data = makeLogFile("boat", 0);
+  ASSERT_TRUE(Logger::save(filename, data));
+
+  LogFileSummary summary;
+  EXPECT_TRUE(scanLogFile(filename, &summary));
+  EXPECT_TRUE(summary.valid);
+  EXPECT_EQ("boat", summary.boatId);
+  EXPECT_EQ("boat", summary.boatKey());
+  EXPECT_EQ(7, summary.bootCount);
+  EXPECT_EQ(5, summary.rawNmea2000Count);
+  EXPECT_NEAR((utc - boot).seconds(), summary.timeOffset.seconds(), 1.0e-6);
+
+  ASSERT_EQ(3, summary.streams.size());
+  EXPECT_EQ("dateTime", summary.streams[0].shortName);
+  EXPECT_EQ(3, summary.streams[0].priority);
+  EXPECT_FALSE(summary.streams[0].text);
+
+  const LogStreamSummary &awa = summary.streams[1];
+  EXPECT_EQ("awa", awa.shortName);
+  EXPECT_EQ("NMEA2000", awa.source);
+  EXPECT_EQ(10, awa.count);
+  EXPECT_EQ(utc + Duration<double>::seconds(100), awa.lowerBound);
+  EXPECT_EQ(utc + Duration<double>::seconds(109), awa.upperBound);
+
+  EXPECT_TRUE(summary.streams[2].text);
+  EXPECT_EQ(3, summary.streams[2].count);
+
+  EXPECT_EQ(53, summary.sampleCount());
+  EXPECT_EQ(utc, summary.lowerBound);
+  EXPECT_EQ(utc + Duration<double>::seconds(109), summary.upperBound);
+
+  // The same counts as when the file is fully decoded
+  LogFile loaded;
+  ASSERT_TRUE(Logger::read(filename, &loaded));
+  for (int i = 0; i < loaded.stream_size(); i++) {
+    std::vector<TimeStamp> times;
+    Logger::unpackTime(loaded.stream(i), &times);
+    EXPECT_EQ(times.size(), summary.streams[i].count);
+  }
+  boost::filesystem::remove(filename);
+}
+
+TEST(LogScanTest, OffsetFromNmea0183) {
+  const char filename[] = "./LogScanTest_nmea0183.log";
+  ASSERT_TRUE(Logger::save(filename, makeLogFileWithoutExtTimes()));
+
+  LogFileSummary summary;
+  EXPECT_TRUE(scanLogFile(filename, &summary));
+
+  // The sentences end a few bytes before the times of their chunks.
+  EXPECT_NEAR((utc - boot).seconds(), summary.timeOffset.seconds(), 0.2);
+  ASSERT_EQ(2, summary.streams.size());
+  EXPECT_NEAR(0.0, (summary.streams[0].lowerBound
+        - (utc + Duration<double>::seconds(100))).seconds(), 0.2);
+  EXPECT_TRUE(summary.overlaps(utc + Duration<double>::seconds(50),
+                               TimeStamp()));
+  boost::filesystem::remove(filename);
+}
+
+TEST(LogScanTest, InvalidFiles) {
+  LogFileSummary summary;
+  EXPECT_FALSE(scanLogFile("./LogScanTest_missing.log", &summary));
+  EXPECT_FALSE(summary.valid);
+
+  const char filename[] = "./LogScanTest_text.log";
+  {
+    std::ofstream file(filename);
+    file << "This is not a log file.";
+  }
+  EXPECT_FALSE(scanLogFile(filename, &summary));
+  boost::filesystem::remove(filename);
+}
+
+TEST(LogScanTest, IndexByBoat) {
+  std::vector<std::string> filenames;
+  for (int i = 0; i < 5; i++) {
+    std::string filename = "./LogScanTest" + std::to_string(i) + ".log";
+    // Files of two boats, one hour apart, saved in reverse order.
+    ASSERT_TRUE(Logger::save(filename,
+          makeLogFile(i % 2 == 0? "a" : "b", 3600*(5 - i))));
+    filenames.push_back(filename);
+  }
+  filenames.push_back("./LogScanTest_missing.log");
+
+  auto summaries = scanLogFiles(filenames, 3);
+  ASSERT_EQ(6, summaries.size());
+  for (int i = 0; i < 5; i++) {
+    EXPECT_EQ(filenames[i], summaries[i].filename);
+    EXPECT_TRUE(summaries[i].valid);
+  }
+  EXPECT_FALSE(summaries[5].valid);
+
+  auto index = indexLogFilesByBoat(summaries);
+  ASSERT_EQ(2, index.size());
+  const auto &a = index["a"];
+  ASSERT_EQ(3, a.size());
+  EXPECT_EQ(filenames[4], a[0].filename);
+  EXPECT_EQ(filenames[2], a[1].filename);
+  EXPECT_EQ(filenames[0], a[2].filename);
+  EXPECT_EQ(2, index["b"].size());
+
+  TimeStamp since = utc + Duration<double>::hours(3.5);
+  EXPECT_TRUE(a[2].overlaps(since, TimeStamp()));
+  EXPECT_FALSE(a[1].overlaps(since, TimeStamp()));
+  EXPECT_TRUE(a[1].overlaps(TimeStamp(), TimeStamp()));
+
+  for (const auto &filename : filenames) {
+    boost::filesystem::remove(filename);
+  }
+}
@@ -211,9 +211,13 @@ bool Logger::save(const std::string& filename, const LogFile& data) {
 
 bool Logger::read(const std::string& filename, LogFile *dst) {
     ifstream file(filename, ios_base::in | ios_base::binary);
+    return read(&file, dst);
+}
+
+bool Logger::read(std::istream* file, LogFile *dst) {
     filtering_istream in;
     in.push(gzip_decompressor());
-    in.push(file);
+    in.push(*file);
     google::protobuf::io::IstreamInputStream zero_copy_input(&in);
     google::protobuf::io::CodedInputStream decoder(&zero_copy_input);
     // By default, google protobufs have a limit of about 60MB.
@@ -2,6 +2,7 @@
 #define ANEMOBOX_LOGGER_H
 
 #include <cstdint>
+#include <iosfwd>
 #include <device/anemobox/Dispatcher.h>
 #include <device/anemobox/logger/logger.pb.h>
 #include <boost/signals2/connection.hpp>
@@ -75,16 +76,16 @@ public:
     *base = value;
   }
 
-  virtual void onNewValue(const ValueDispatcher<Angle<double>> &angle) {
-    addTimestamp(angle.lastTimeStamp());
+  void add(TimeStamp time, const Angle<double> &angle) {
+    addTimestamp(time);
 
-    accumulateAngle(angle.lastValue(), &intBase, _valueSet.mutable_angles());
+    accumulateAngle(angle, &intBase, _valueSet.mutable_angles());
   }
 
-  virtual void onNewValue(const ValueDispatcher<Velocity<double>> &v) {
-    addTimestamp(v.lastTimeStamp());
+  void add(TimeStamp time, const Velocity<double> &v) {
+    addTimestamp(time);
 
-    int value = int(v.lastValue().knots() * 100.0);
+    int value = int(v.knots() * 100.0);
     int delta = value;
     if (_valueSet.velocity().deltavelocity_size() > 0) {
       delta -= intBase;
@@ -93,10 +94,10 @@ public:
     intBase = value;
   }
 
-  virtual void onNewValue(const ValueDispatcher<Length<double>> &v) {
-    addTimestamp(v.lastTimeStamp());
+  void add(TimeStamp time, const Length<double> &v) {
+    addTimestamp(time);
 
-    int value = int(v.lastValue().meters());
+    int value = int(v.meters());
     int delta = value;
     if (_valueSet.length().deltalength_size() > 0) {
       delta -= intBase;
@@ -105,41 +106,40 @@ public:
     intBase = value;
   }
 
-  virtual void onNewValue(const ValueDispatcher<GeographicPosition<double>> &v) {
-    addTimestamp(v.lastTimeStamp());
+  void add(TimeStamp time, const GeographicPosition<double> &v) {
+    addTimestamp(time);
     GeoPosValueSet_Pos* pos = _valueSet.mutable_pos()->add_pos();
-    pos->set_lat(v.lastValue().lat().degrees());
-    pos->set_lon(v.lastValue().lon().degrees());
+    pos->set_lat(v.lat().degrees());
+    pos->set_lon(v.lon().degrees());
   }
 
-  virtual void onNewValue(const ValueDispatcher<TimeStamp> &v) {
-    addTimestamp(v.lastTimeStamp());
-    TimeStamp t = v.lastValue();
+  void add(TimeStamp time, const TimeStamp &t) {
+    addTimestamp(time);
     addTimeStampToRepeatedFields(&extTimesBase, _valueSet.mutable_exttimes(), t);
   }
 
-  virtual void onNewValue(const ValueDispatcher<AbsoluteOrientation> &v) {
-    addTimestamp(v.lastTimeStamp());
+  void add(TimeStamp time, const AbsoluteOrientation &v) {
+    addTimestamp(time);
 
-    accumulateAngle(v.lastValue().heading, &intBase, 
+    accumulateAngle(v.heading, &intBase, 
                     _valueSet.mutable_orient()->mutable_heading());
 
-    accumulateAngle(v.lastValue().roll, &intBaseRoll, 
+    accumulateAngle(v.roll, &intBaseRoll, 
                     _valueSet.mutable_orient()->mutable_roll());
 
-    accumulateAngle(v.lastValue().pitch, &intBasePitch, 
+    accumulateAngle(v.pitch, &intBasePitch, 
                     _valueSet.mutable_orient()->mutable_pitch());
   }
 
-  virtual void onNewValue(const ValueDispatcher<BinaryEdge> &v) {
-    addTimestamp(v.lastTimeStamp());
-    _valueSet.mutable_binary()->add_edges(v.lastValue() == BinaryEdge::ToOn);
+  void add(TimeStamp time, const BinaryEdge &v) {
+    addTimestamp(time);
+    _valueSet.mutable_binary()->add_edges(v == BinaryEdge::ToOn);
   }
 
-  virtual void onNewValue(const ValueDispatcher<AngularVelocity<double>> &v) {
-    addTimestamp(v.lastTimeStamp());
+  void add(TimeStamp time, const AngularVelocity<double> &v) {
+    addTimestamp(time);
 
-    int value = int(v.lastValue().radiansPerSecond() * 1000.0);
+    int value = int(v.radiansPerSecond() * 1000.0);
     int delta = value;
     if (_valueSet.angularvelocity().delta_size() > 0) {
       delta -= intBase;
@@ -148,6 +148,35 @@ public:
     intBase = value;
   }
 
+  template <typename T>
+  void addAll(const TimedValue<T> *begin, const TimedValue<T> *end) {
+    for (auto x = begin; x != end; ++x) {
+      add(x->time, x->value);
+    }
+  }
+
+#define LOGGER_ON_NEW_VALUE(TYPE) \
+  virtual void onNewValue(const ValueDispatcher<TYPE> &v) { \
+    add(v.lastTimeStamp(), v.lastValue()); \
+  } \
+  virtual void onNewValues(const ValueDispatcher<TYPE> &, \
+                           const TimedValue<TYPE> *begin, \
+                           const TimedValue<TYPE> *end) { \
+    addAll(begin, end); \
+  }
+  LOGGER_ON_NEW_VALUE(Angle<double>)
+  LOGGER_ON_NEW_VALUE(Velocity<double>)
+  LOGGER_ON_NEW_VALUE(Length<double>)
+  LOGGER_ON_NEW_VALUE(GeographicPosition<double>)
+  LOGGER_ON_NEW_VALUE(TimeStamp)
+  LOGGER_ON_NEW_VALUE(AbsoluteOrientation)
+  LOGGER_ON_NEW_VALUE(BinaryEdge)
+  LOGGER_ON_NEW_VALUE(AngularVelocity<double>)
+#undef LOGGER_ON_NEW_VALUE
+
+  // Logging a batch is just a loop over its samples.
+  virtual bool acceptsBatches() const { return true; }
+
   void addText(TimeStamp t, const std::string& text) {
     addTimestamp(t);
     _valueSet.add_text(text);
@@ -206,6 +235,8 @@ class Logger {
   // Save invokes gzip, it might be slightly time consuming.
   static bool save(const std::string& filename, const LogFile& data);
   static bool read(const std::string& filename, LogFile *dst);
+  // Same as above, reading the gzipped data from a stream.
+  static bool read(std::istream* file, LogFile *dst);
 
   static void unpack(const AngleValueSet& values,
                      std::vector<Angle<double>>* angles);
@@ -1,8 +1,14 @@
 /*
  * To get the internal GPS NMEA stream, use:
  * ./anemobox_logcat -t "Internal GPS NMEA" <logfile>
+ *
+ * To list the log files of a directory by boat, with their time spans,
+ * without decoding them:
+ * ./anemobox_logcat --scan --since 2016-06-01T00:00:00 <directory>
  */
 
+#include <boost/filesystem.hpp>
+#include <device/anemobox/logger/LogScan.h>
 #include <device/anemobox/logger/Logger.h>
 #include <device/anemobox/logger/logger.pb.h>
 #include <server/common/ArgMap.h>
@@ -12,6 +18,7 @@
 #include <algorithm>
 #include <iomanip>
 #include <iostream>
+#include <thread>
 #include <vector>
 
 using namespace sail;
@@ -496,11 +503,57 @@ void logCat(const std::string& file,
   }
 }
 
-struct LexicalOrder {
-  bool operator() (const ArgMap::Arg* a, const ArgMap::Arg* b) {
-    return a->valueUntraced() < b->valueUntraced();
+// The files of the arguments, with the .log files of directories.
+std::vector<std::string> listLogFiles(const Array<ArgMap::Arg*> &args) {
+  std::vector<std::string> files;
+  for (auto arg : args) {
+    boost::filesystem::path path(arg->value());
+    if (!boost::filesystem::is_directory(path)) {
+      files.push_back(path.string());
+      continue;
+    }
+    for (boost::filesystem::recursive_directory_iterator it(path), end;
+         it != end; ++it) {
+      if (boost::filesystem::is_regular_file(it->path())
+          && it->path().extension() == ".log") {
+        files.push_back(it->path().string());
+      }
+    }
   }
-};
+  std::sort(files.begin(), files.end());
+  return files;
+}
+
+void displayIndex(
+    const std::map<std::string, std::vector<LogFileSummary> > &index) {
+  for (const auto &kv : index) {
+    const auto &files = kv.second;
+    int64_t sampleCount = 0;
+    std::map<Key, int64_t> channels;
+    for (const auto &file : files) {
+      sampleCount += file.sampleCount();
+      for (const auto &stream : file.streams) {
+        channels[Key(stream.shortName, stream.source)] += stream.count;
+      }
+    }
+    cout << "Boat '" << kv.first << "'"
+      << (files.back().boatName.empty()?
+          "" : " (" + files.back().boatName + ")")
+      << ": " << files.size() << " files, " << sampleCount << " samples"
+      << " from " << files.front().lowerBound
+      << " to " << files.back().upperBound << endl;
+    for (const auto &file : files) {
+      cout << "  - " << file.filename << ": " << file.sampleCount()
+        << " samples from " << file.lowerBound << " to " << file.upperBound
+        << endl;
+    }
+    for (const auto &channel : channels) {
+      cout << "  * code='" << channel.first.first << "' src='"
+        << channel.first.second << "': " << channel.second << " samples"
+        << endl;
+    }
+  }
+}
 
 }  // namespace
 
@@ -529,6 +582,22 @@ int main(int argc, const char* argv[]) {
       "--raw-nmea2000",
       "Only raw NMEA 2000 data, formatted to be replayed.");
 
+  cmdLine.registerOption("--scan", "List the files by boat, with their "
+      "streams and time spans, without decoding the values.")
+      .setArgCount(0)
+      .setUnique();
+
+  std::string since;
+  cmdLine.registerOption("--since", "Only the files with data after "
+      "the given time, e.g. 2016-06-01T00:00:00")
+      .store(&since)
+      .setUnique();
+
+  int threadCount = std::max(1u, std::thread::hardware_concurrency());
+  cmdLine.registerOption("--threads", "Number of threads to scan the files")
+      .store(&threadCount)
+      .setUnique();
+
   if (cmdLine.parse(argc, argv) != ArgMap::Continue) {
     return -1;
   }
@@ -537,8 +606,34 @@ int main(int argc, const char* argv[]) {
     summaryThreshold = std::numeric_limits<double>::infinity();
   }
 
-  Array<ArgMap::Arg*> files = cmdLine.freeArgs();
-  sort(files.begin(), files.end(), LexicalOrder());
+  std::vector<std::string> files = listLogFiles(cmdLine.freeArgs());
+
+  TimeStamp sinceTime;
+  if (!since.empty()) {
+    sinceTime = TimeStamp::parse(since);
+    if (!sinceTime.defined()) {
+      LOG(ERROR) << "Failed to parse time " << since;
+      return -1;
+    }
+  }
+
+  // Only the headers are read to select the files.
+  if (cmdLine.optionProvided("--scan") || sinceTime.defined()) {
+    std::vector<LogFileSummary> summaries;
+    for (const auto &summary : scanLogFiles(files, threadCount)) {
+      if (summary.overlaps(sinceTime, TimeStamp())) {
+        summaries.push_back(summary);
+      }
+    }
+    if (cmdLine.optionProvided("--scan")) {
+      displayIndex(indexLogFilesByBoat(summaries));
+      return 0;
+    }
+    files.clear();
+    for (const auto &summary : summaries) {
+      files.push_back(summary.filename);
+    }
+  }
 
   Context summary(summaryThreshold*1.0_s);
   if (cmdLine.optionProvided("--raw-nmea2000")) {
@@ -548,8 +643,8 @@ int main(int argc, const char* argv[]) {
     summary.withNmea2000 = true;
     summary.dateFormat = DateFormat::Nmea2000Replay;
   }
-  for (auto arg : cmdLine.freeArgs()) {
-    logCat(arg->value(), textField, &summary);
+  for (const auto &file : files) {
+    logCat(file, textField, &summary);
   }
   if (summary.briefReport()) {
     std::cout << summary << std::endl;
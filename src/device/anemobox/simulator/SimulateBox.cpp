@@ -2,10 +2,14 @@
 
 #include <device/Arduino/libraries/TrueWindEstimator/TrueWindEstimator.h>
 #include <device/anemobox/DispatcherTrueWindEstimator.h>
+#include <algorithm>
+#include <atomic>
 #include <fstream>
+#include <map>
 #include <server/common/Functional.h>
 #include <server/common/Span.h>
 #include <server/common/logging.h>
+#include <thread>
 
 namespace sail {
 
@@ -31,13 +35,45 @@ namespace {
       EstimateOnNewValue* _estimator;
   };
 
+  // What the estimator sees of an input channel when it runs.
+  struct ChannelState {
+    // The current source in the replay dispatcher, if any.
+    DispatchData *source = nullptr;
+
+    // The time of the last sample published by that source.
+    TimeStamp last;
+  };
+
+  // A moment where the estimator would run during the replay.
+  struct ComputeEvent {
+    TimeStamp time;
+    ChannelState awa, aws, gpsSpeed, gpsBearing;
+  };
+
+  template <DataCode Code>
+  ChannelState channelState(Dispatcher *dispatcher) {
+    typedef typename TypeForCode<Code>::type T;
+    ChannelState state;
+    auto proxy = dynamic_cast<DispatchDataProxy<T>*>(
+        dispatcher->dispatchData(Code));
+    if (proxy != nullptr && proxy->dispatcher()->hasValue()) {
+      state.source = proxy->realDispatcher();
+      state.last = proxy->dispatcher()->lastTimeStamp();
+    }
+    return state;
+  }
+
   class EstimateOnNewValue {
    public:
+     // If 'events' is not null, the moments where the estimator would run
+     // are recorded there instead of running the estimator.
      EstimateOnNewValue(DispatcherTrueWindEstimator *estimator,
                         const std::string& srcName,
-                        ReplayDispatcher *replayDispatcher)
+                        ReplayDispatcher *replayDispatcher,
+                        std::vector<ComputeEvent> *events = nullptr)
          : _estimator(estimator), _srcName(srcName), _timer(false),
          _replayDispatcher(replayDispatcher),
+         _events(events),
           awaListener(this),
           awsListener(this),
           gpsSpeedListener(this),
@@ -57,7 +93,11 @@ namespace {
        // The methode estimate() is called many time during replay.
        _onTimeout = [&]() {
          _timer = false;
-         _estimator->compute(_srcName);
+         if (_events) {
+           recordEvent();
+         } else {
+           _estimator->compute(_srcName);
+         }
        };
      }
 
@@ -70,11 +110,22 @@ namespace {
     }
 
    private:
+    void recordEvent() {
+      ComputeEvent event;
+      event.time = _replayDispatcher->currentTime();
+      event.awa = channelState<AWA>(_replayDispatcher);
+      event.aws = channelState<AWS>(_replayDispatcher);
+      event.gpsSpeed = channelState<GPS_SPEED>(_replayDispatcher);
+      event.gpsBearing = channelState<GPS_BEARING>(_replayDispatcher);
+      _events->push_back(event);
+    }
+
     DispatcherTrueWindEstimator* _estimator;
     std::string _srcName;
     bool _timer;
     std::function<void()> _onTimeout;
     ReplayDispatcher *_replayDispatcher;
+    std::vector<ComputeEvent> *_events;
 
     // A Listener can listen only to one channel at a time, so we need one
     // listener per channel.
@@ -92,6 +143,418 @@ void OnValue<T>::onNewValue(const ValueDispatcher<T>&) {
   _estimator->estimate();
 }
 
+// The delay of the timer that runs the estimator, in milliseconds.
+// See the function 'start' in anemonode/components/estimator.js
+const double estimatorDelayMs = 20;
+
+// Sessions are separated by at least this long without computations.
+// They are simulated in parallel.
+const Duration<> sessionGap = Duration<>::minutes(30);
+
+void readFiltered(TriangularWindowSum *sum, TimeStamp now, Angle<> *dst) {
+  *dst = filteredAngle(sum, now);
+}
+
+void readFiltered(TriangularWindowSum *sum, TimeStamp now, Velocity<> *dst) {
+  *dst = filteredVelocity(sum, now);
+}
+
+// Computes, for the events in [begin, end), what DispatcherFilter would
+// return for the channel 'Code' at the time of the event. The samples are
+// read from 'src', the dispatcher that was replayed, one source at a time.
+// The result for events[i] is written to (*dst)[i - begin].
+template <DataCode Code>
+void filterChannel(const Dispatcher *src,
+                   const std::vector<ComputeEvent> &events,
+                   int begin, int end,
+                   ChannelState ComputeEvent::*channel,
+                   Duration<> window,
+                   std::vector<typename TypeForCode<Code>::type> *dst) {
+  typedef typename TypeForCode<Code>::type T;
+
+  if (begin == end) {
+    return;
+  }
+
+  // Without source, the filter has no samples, and what it returns
+  // does not depend on the time.
+  T noSamples;
+  {
+    TriangularWindowSum empty(window);
+    readFiltered(&empty, events[begin].time, &noSamples);
+  }
+
+  std::map<DispatchData*, std::vector<int>> eventsPerSource;
+  for (int i = begin; i < end; i++) {
+    (*dst)[i - begin] = noSamples;
+
+    const ChannelState &state = events[i].*channel;
+    if (state.source != nullptr) {
+      eventsPerSource[state.source].push_back(i);
+    }
+  }
+
+  for (const auto &entry : eventsPerSource) {
+    auto data = src->get<Code>(entry.first->source());
+    if (data == nullptr) {
+      continue;
+    }
+    const typename TimedSampleCollection<T>::TimedVector &samples =
+      data->dispatcher()->values().samples();
+
+    // Earlier samples are out of the window of all the events.
+    auto next = std::lower_bound(samples.begin(), samples.end(),
+                                 events[entry.second.front()].time - window);
+
+    // During the replay, the filter only sees the most recent samples.
+    TriangularWindowSum sum(window, ReplayDispatcher::lazyBufferLength);
+    for (int i : entry.second) {
+      const ChannelState &state = events[i].*channel;
+      while (next != samples.end() && next->time <= state.last) {
+        addToWindow(&sum, next->time, next->value);
+        ++next;
+      }
+      readFiltered(&sum, events[i].time, &((*dst)[i - begin]));
+    }
+  }
+}
+
+bool isFresh(const ChannelState &state, TimeStamp limit) {
+  return state.source != nullptr && state.last >= limit;
+}
+
+// Evaluates the estimator filters at the time of the events in
+// [begin, end), as DispatcherTrueWindEstimator::compute would have done.
+TrueWindBatch makeBatch(const Dispatcher *src,
+                        const std::vector<ComputeEvent> &events,
+                        int begin, int end) {
+  DispatcherFilterParams params;
+  TrueWindBatch batch;
+  batch.resize(end - begin);
+  for (int i = begin; i < end; i++) {
+    const ComputeEvent &event = events[i];
+    TimeStamp freshLimit = event.time - Duration<double>::seconds(5);
+    batch.times[i - begin] = event.time;
+    batch.fresh[i - begin] = isFresh(event.gpsSpeed, freshLimit)
+      && isFresh(event.awa, freshLimit)
+      && isFresh(event.aws, freshLimit);
+  }
+  filterChannel<AWA>(src, events, begin, end, &ComputeEvent::awa,
+                     params.apparentWindWindow, &batch.awa);
+  filterChannel<AWS>(src, events, begin, end, &ComputeEvent::aws,
+                     params.apparentWindWindow, &batch.aws);
+  filterChannel<GPS_SPEED>(src, events, begin, end, &ComputeEvent::gpsSpeed,
+                           params.gpsMotionWindow, &batch.gpsSpeed);
+  filterChannel<GPS_BEARING>(src, events, begin, end,
+                             &ComputeEvent::gpsBearing,
+                             params.gpsMotionWindow, &batch.gpsBearing);
+  return batch;
+}
+
+// Runs the estimator for all the events. The events are split in sessions
+// that are processed in parallel: the result does not depend on the split.
+TrueWindBatchOutput estimateInParallel(
+    const DispatcherTrueWindEstimator &estimator,
+    const Dispatcher *src,
+    const std::vector<ComputeEvent> &events) {
+  std::vector<std::pair<int, int>> sessions;
+  for (int i = 0; i < int(events.size()); i++) {
+    if (i == 0 || events[i].time - events[i - 1].time > sessionGap) {
+      sessions.push_back(std::make_pair(i, i));
+    }
+    sessions.back().second = i + 1;
+  }
+
+  std::vector<TrueWindBatchOutput> outputs(sessions.size());
+  std::atomic<int> nextSession(0);
+  auto work = [&]() {
+    for (int i = nextSession++; i < int(sessions.size()); i = nextSession++) {
+      estimator.computeBatch(
+          makeBatch(src, events, sessions[i].first, sessions[i].second),
+          &outputs[i]);
+    }
+  };
+
+  int threadCount = std::min<int>(sessions.size(),
+                                  std::thread::hardware_concurrency());
+  std::vector<std::thread> threads;
+  for (int i = 1; i < threadCount; i++) {
+    threads.push_back(std::thread(work));
+  }
+  work();
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  TrueWindBatchOutput result;
+  for (const auto &output : outputs) {
+    result.append(output);
+  }
+  return result;
+}
+
+// Gives the time of the first sample, in any channel of a dispatcher,
+// at or after a given time. This is when a ReplayDispatcher calls a
+// timeout. Queries must be made in chronological order.
+class NextSampleTime {
+ public:
+  NextSampleTime(const Dispatcher *src) {
+    visitDispatcherChannelsConst(src, this);
+    for (int i = 0; i < int(_streams.size()); i++) {
+      _heap.push_back(i);
+    }
+    std::make_heap(_heap.begin(), _heap.end(), later());
+  }
+
+  template <DataCode Code, typename T>
+  void visit(const char *, const std::string &,
+             const std::shared_ptr<DispatchData> &,
+             const TimedSampleCollection<T> &values) {
+    if (values.empty()) {
+      return;
+    }
+    _streams.push_back(std::shared_ptr<Stream>(new TypedStream<T>(values)));
+    TimeStamp last = values.lastTimeStamp();
+    if (!_last.defined() || _last < last) {
+      _last = last;
+    }
+  }
+
+  // Undefined if there is no such sample.
+  TimeStamp atOrAfter(TimeStamp time) {
+    while (!_heap.empty() && head(_heap.front()) < time) {
+      std::pop_heap(_heap.begin(), _heap.end(), later());
+      Stream *stream = _streams[_heap.back()].get();
+      stream->skipBefore(time);
+      if (stream->end()) {
+        _heap.pop_back();
+      } else {
+        std::push_heap(_heap.begin(), _heap.end(), later());
+      }
+    }
+    return _heap.empty()? TimeStamp() : head(_heap.front());
+  }
+
+  // The time of the last sample.
+  TimeStamp last() const { return _last; }
+
+ private:
+  class Stream {
+   public:
+    virtual TimeStamp head() const = 0;
+    virtual bool end() const = 0;
+    virtual void skipBefore(TimeStamp time) = 0;
+    virtual ~Stream() { }
+  };
+
+  template <typename T>
+  class TypedStream : public Stream {
+   public:
+    TypedStream(const TimedSampleCollection<T> &values)
+      : _it(values.samples().begin()), _end(values.samples().end()) { }
+    TimeStamp head() const override { return _it->time; }
+    bool end() const override { return _it == _end; }
+    void skipBefore(TimeStamp time) override {
+      // The queries are close to each other: a linear scan visits every
+      // sample at most once, which is cheaper than bisecting a deque.
+      while (_it != _end && _it->time < time) {
+        ++_it;
+      }
+    }
+   private:
+    typename TimedSampleCollection<T>::TimedVector::const_iterator _it, _end;
+  };
+
+  TimeStamp head(int stream) const { return _streams[stream]->head(); }
+
+  std::function<bool(int, int)> later() const {
+    return [this](int a, int b) { return head(b) < head(a); };
+  }
+
+  std::vector<std::shared_ptr<Stream>> _streams;
+  std::vector<int> _heap;
+  TimeStamp _last;
+};
+
+// Follows the current source of a channel, as selected by the dispatcher
+// (see Dispatcher::updateCurrentSource) when the samples of all sources
+// are published in chronological order.
+template <DataCode Code>
+class SourceTimeline {
+ public:
+  typedef typename TypeForCode<Code>::type T;
+
+  // The times of the samples published by the current source, those
+  // that trigger the estimator, are appended to 'triggers'.
+  SourceTimeline(const Dispatcher *src, std::vector<TimeStamp> *triggers) {
+    auto found = src->allSources().find(Code);
+    if (found == src->allSources().end()) {
+      return;
+    }
+
+    struct Sample {
+      TimeStamp time;
+      int source;
+      bool operator<(const Sample &other) const { return time < other.time; }
+    };
+    std::vector<Sample> samples;
+    std::vector<int> priorities;
+    for (const auto &entry : found->second) {
+      int source = _sources.size();
+      _sources.push_back(toTypedDispatchData<Code>(entry.second.get()));
+      priorities.push_back(src->sourcePriority(entry.first));
+      for (const auto &x : _sources.back()->dispatcher()->values().samples()) {
+        samples.push_back(Sample{x.time, source});
+      }
+    }
+    std::stable_sort(samples.begin(), samples.end());
+    _nextSample.resize(_sources.size(), 0);
+
+    // See Dispatcher::prefers and DispatchData::isFresh
+    Duration<> maxAge = Duration<>::seconds(15);
+    int current = -1;
+    std::vector<TimeStamp> lastTime(_sources.size());
+    for (const Sample &x : samples) {
+      if (x.source != current
+          && (current < 0
+              || !(x.time - lastTime[current] < maxAge)
+              || priorities[x.source] > priorities[current])) {
+        current = x.source;
+        _switches.push_back(Switch{x.time, current});
+      }
+      lastTime[x.source] = x.time;
+      if (x.source == current && triggers != nullptr) {
+        triggers->push_back(x.time);
+      }
+    }
+  }
+
+  // What the estimator sees when it runs right before the samples at
+  // 'time' are published, or after all samples if 'time' is undefined.
+  // The times must be non-decreasing, undefined coming last.
+  ChannelState stateBefore(TimeStamp time) {
+    while (_nextSwitch < int(_switches.size())
+           && (!time.defined() || _switches[_nextSwitch].time < time)) {
+      _nextSwitch++;
+    }
+
+    ChannelState state;
+    if (_nextSwitch == 0) {
+      return state;
+    }
+    int source = _switches[_nextSwitch - 1].source;
+    const auto &samples = _sources[source]->dispatcher()->values().samples();
+
+    // The sample that made the switch comes before 'time'.
+    int &next = _nextSample[source];
+    while (next < int(samples.size())
+           && (!time.defined() || samples[next].time < time)) {
+      next++;
+    }
+    state.source = _sources[source];
+    state.last = samples[next - 1].time;
+    return state;
+  }
+
+ private:
+  struct Switch {
+    TimeStamp time;
+    int source;
+  };
+
+  std::vector<TypedDispatchData<T>*> _sources;
+  std::vector<Switch> _switches;
+
+  // Cursors of stateBefore.
+  int _nextSwitch = 0;
+  std::vector<int> _nextSample;
+};
+
+// Computes directly from the sample times of 'src' the ComputeEvents
+// that EstimateOnNewValue records during a replay of 'src'.
+std::vector<ComputeEvent> computeEvents(const Dispatcher *src) {
+  // This list should match the 'triggeringFields' in estimator.js
+  std::vector<TimeStamp> triggers;
+  SourceTimeline<AWA> awa(src, &triggers);
+  SourceTimeline<AWS> aws(src, &triggers);
+  SourceTimeline<GPS_SPEED> gpsSpeed(src, &triggers);
+  SourceTimeline<GPS_BEARING> gpsBearing(src, &triggers);
+  SourceTimeline<WAT_SPEED> watSpeed(src, &triggers);
+  SourceTimeline<MAG_HEADING> magHeading(src, &triggers);
+  std::sort(triggers.begin(), triggers.end());
+
+  std::vector<ComputeEvent> events;
+  auto addEvent = [&](TimeStamp time, TimeStamp publishedBefore) {
+    ComputeEvent event;
+    event.time = time;
+    event.awa = awa.stateBefore(publishedBefore);
+    event.aws = aws.stateBefore(publishedBefore);
+    event.gpsSpeed = gpsSpeed.stateBefore(publishedBefore);
+    event.gpsBearing = gpsBearing.stateBefore(publishedBefore);
+    events.push_back(event);
+  };
+
+  NextSampleTime nextSample(src);
+  auto trigger = triggers.begin();
+  while (trigger != triggers.end()) {
+    // The timer is set by a trigger when it is not already running,
+    // and expires at the next sample after the delay.
+    TimeStamp timeout =
+      *trigger + Duration<double>::milliseconds(estimatorDelayMs);
+    TimeStamp time = nextSample.atOrAfter(timeout);
+    if (!time.defined()) {
+      // See ReplayDispatcher::finishTimeouts
+      addEvent(nextSample.last(), TimeStamp());
+      break;
+    }
+    addEvent(time, time);
+
+    // The samples at 'time' are published after the timeout.
+    while (trigger != triggers.end() && *trigger < time) {
+      ++trigger;
+    }
+  }
+  return events;
+}
+
+// Adds the samples to the channel 'Code' of 'srcName' in 'dst'. The
+// channels of 'dst' can share their samples with other dispatchers
+// (see LazyReplayDispatchData and cloneAndfilterDispatcher), so the
+// channel is replaced by a new one instead of being modified.
+template <DataCode Code>
+void insertCopy(
+    const typename TimedSampleCollection<
+      typename TypeForCode<Code>::type>::TimedVector &values,
+    const std::string &srcName, Dispatcher *dst) {
+  typedef typename TypeForCode<Code>::type T;
+  if (values.empty()) {
+    return;
+  }
+  auto data = std::make_shared<TypedDispatchDataReal<T>>(
+      Code, srcName, dst, std::numeric_limits<int>::max());
+  auto existing = dst->get<Code>(srcName);
+  if (existing != nullptr) {
+    data->dispatcher()->insert(existing->dispatcher()->values().samples());
+  }
+  data->dispatcher()->insert(values);
+
+  // The current source of the channel should not point to the old data.
+  auto proxy = dynamic_cast<DispatchDataProxy<T>*>(dst->dispatchData(Code));
+  if (proxy != nullptr && proxy->realDispatcher() == existing) {
+    proxy->setActiveDispatcher(data.get());
+  }
+  dst->set(Code, srcName, data);
+}
+
+void insertCopy(const TrueWindBatchOutput &output,
+                const std::string &srcName, Dispatcher *dst) {
+  insertCopy<TWDIR>(output.twdir, srcName, dst);
+  insertCopy<TWS>(output.tws, srcName, dst);
+  insertCopy<TWA>(output.twa, srcName, dst);
+  insertCopy<TARGET_VMG>(output.targetVmg, srcName, dst);
+  insertCopy<VMG>(output.vmg, srcName, dst);
+}
+
 }  // namespace
 
 /*
@@ -132,28 +595,54 @@ void generateComputeCallbacks(Dispatcher *src,
 }
 */
 
-NavDataset SimulateBox(const std::string& boatDat, const NavDataset &ds) {
+NavDataset SimulateBox(const std::string& boatDat, const NavDataset &ds,
+                       SimulateBoxMode mode) {
   std::ifstream file(boatDat);
-  return SimulateBox(file, ds);
+  return SimulateBox(file, ds, mode);
 }
 
-NavDataset SimulateBox(std::istream &boatDat, const NavDataset &src) {
+NavDataset SimulateBox(std::istream &boatDat, const NavDataset &src,
+                       SimulateBoxMode mode) {
   auto replay = std::make_shared<ReplayDispatcher>();
   DispatcherTrueWindEstimator estimator(replay.get());
   if (!estimator.loadCalibration(boatDat)) {
     return NavDataset();
   }
   auto srcName = std::string("Simulated ") + estimator.sourceName();
+  Dispatcher *srcDispatcher = src.dispatcher().get();
 
-  EstimateOnNewValue listener(&estimator, srcName, replay.get());
-
-  copyPriorities(src.dispatcher().get(), replay.get());
+  // Without calibration parameters, the estimator reads the true wind
+  // published during the replay, and has to run during the replay.
+  if (!estimator.hasValidParameters() || srcDispatcher == nullptr) {
+    mode = SimulateBoxMode::Replay;
+  }
 
-  replay.get()->replay(src.dispatcher().get());
+  std::shared_ptr<Dispatcher> dst;
+  if (mode == SimulateBoxMode::Fast) {
+    dst = shallowCopy(srcDispatcher);
+    insertCopy(estimateInParallel(estimator, srcDispatcher,
+                                  computeEvents(srcDispatcher)),
+               srcName, dst.get());
+  } else {
+    bool batch = mode == SimulateBoxMode::Batch;
+    std::vector<ComputeEvent> events;
+    EstimateOnNewValue listener(&estimator, srcName, replay.get(),
+                                batch ? &events : nullptr);
+
+    copyPriorities(srcDispatcher, replay.get());
+
+    replay.get()->replay(srcDispatcher);
+
+    if (batch) {
+      insertCopy(estimateInParallel(estimator, srcDispatcher, events),
+                 srcName, replay.get());
+    }
+    dst = replay;
+  }
 
-  replay->setSourcePriority(srcName, replay->sourcePriority(estimator.sourceName()) + 1);
+  dst->setSourcePriority(srcName, dst->sourcePriority(estimator.sourceName()) + 1);
 
-  NavDataset result(std::static_pointer_cast<Dispatcher>(replay));
+  NavDataset result(dst);
 
   for (DataCode code : allDataCodes()) {
     std::shared_ptr<DispatchData> active(src.activeChannelOrNull(code));
@@ -9,8 +9,25 @@
 
 namespace sail {
 
-NavDataset SimulateBox(const std::string& boatDat, const NavDataset &ds);
-NavDataset SimulateBox(std::istream& boatDat, const NavDataset &ds);
+enum class SimulateBoxMode {
+  // The estimator runs at every timeout of the replay, as on the box.
+  Replay,
+
+  // The replay only records when the estimator would run and what
+  // it would see. The filters and the estimator are then evaluated
+  // for all these moments at once. Same result as Replay, faster.
+  Batch,
+
+  // No replay at all: the times where the estimator would run, and
+  // the sources it would read, are computed from the sample times.
+  // Sessions are processed in parallel. Same result as Replay.
+  Fast
+};
+
+NavDataset SimulateBox(const std::string& boatDat, const NavDataset &ds,
+                       SimulateBoxMode mode = SimulateBoxMode::Fast);
+NavDataset SimulateBox(std::istream& boatDat, const NavDataset &ds,
+                       SimulateBoxMode mode = SimulateBoxMode::Fast);
 
 }  // namespace sail
 
@@ -1,5 +1,8 @@
 #include <gtest/gtest.h>
 #include <device/anemobox/simulator/SimulateBox.h>
+#include <algorithm>
+#include <fstream>
+#include <server/common/Env.h>
 #include <server/nautical/calib/Calibrator.h>
 
 using namespace sail;
@@ -74,3 +77,144 @@ TEST(SimulateBox, Replay) {
   EXPECT_EQ(0, original.samples<TWDIR>().size());
   EXPECT_EQ(2, simulated.samples<TWDIR>().size());
 }
+
+namespace {
+  template <typename T>
+  void addSamples(TimeStamp start, double periodSeconds, int count,
+                  std::function<T(int)> f,
+                  typename TimedSampleCollection<T>::TimedVector *dst) {
+    for (int i = 0; i < count; i++) {
+      dst->push_back(TimedValue<T>(
+          start + Duration<>::seconds(i * periodSeconds), f(i)));
+    }
+  }
+
+  // Samples at the same time can come in any order.
+  template <typename T>
+  std::vector<std::pair<TimeStamp, double>> sortedSamples(
+      const TimedSampleRange<T> &samples, std::function<double(T)> f) {
+    std::vector<std::pair<TimeStamp, double>> result;
+    for (const auto &x : samples) {
+      result.push_back(std::make_pair(x.time, f(x.value)));
+    }
+    std::sort(result.begin(), result.end());
+    return result;
+  }
+
+  template <typename T>
+  void expectSameSamples(const TimedSampleRange<T> &expected,
+                         const TimedSampleRange<T> &actual,
+                         std::function<double(T)> f) {
+    auto a = sortedSamples(expected, f);
+    auto b = sortedSamples(actual, f);
+    ASSERT_EQ(a.size(), b.size());
+    for (int i = 0; i < a.size(); i++) {
+      EXPECT_EQ(a[i].first, b[i].first);
+      EXPECT_NEAR(a[i].second, b[i].second, 1.0e-6);
+    }
+  }
+
+  // Wind, GPS from two sources and other channels, with gaps.
+  NavDataset makeTestDataset() {
+    typedef Angle<double> A;
+    typedef Velocity<double> V;
+    auto start = TimeStamp::UTC(2016, 3, 24, 18, 10, 0);
+    auto s = [&](double seconds) { return start + Duration<>::seconds(seconds); };
+
+    auto src = std::make_shared<Dispatcher>();
+    src->setSourcePriority("low", 0);
+    src->setSourcePriority("high", 1);
+
+    // Wind at 10 Hz, with a gap of one minute.
+    TimedSampleCollection<A>::TimedVector awa;
+    TimedSampleCollection<V>::TimedVector aws;
+    addSamples<A>(s(0), 0.1, 1000,
+        [](int i) { return A::degrees(40 + 10 * sin(i * 0.01)); }, &awa);
+    addSamples<V>(s(0), 0.1, 1000,
+        [](int i) { return V::knots(12 + sin(i * 0.02)); }, &aws);
+    addSamples<A>(s(160), 0.1, 500,
+        [](int i) { return A::degrees(-40 + 10 * sin(i * 0.01)); }, &awa);
+    addSamples<V>(s(160), 0.1, 500,
+        [](int i) { return V::knots(10 + sin(i * 0.02)); }, &aws);
+    src->insertValues<A>(AWA, "low", awa);
+    src->insertValues<V>(AWS, "low", aws);
+
+    // Two GPS: the preferred one is only there for a while.
+    TimedSampleCollection<A>::TimedVector lowBearing, highBearing;
+    TimedSampleCollection<V>::TimedVector lowSpeed, highSpeed;
+    addSamples<V>(s(0.05), 1, 210,
+        [](int i) { return V::knots(6 + cos(i * 0.1)); }, &lowSpeed);
+    addSamples<A>(s(0.05), 1, 210,
+        [](int i) { return A::degrees(i); }, &lowBearing);
+    addSamples<V>(s(30.03), 0.2, 200,
+        [](int i) { return V::knots(5 + cos(i * 0.1)); }, &highSpeed);
+    addSamples<A>(s(30.03), 0.2, 200,
+        [](int i) { return A::degrees(100 - i); }, &highBearing);
+    src->insertValues<V>(GPS_SPEED, "low", lowSpeed);
+    src->insertValues<A>(GPS_BEARING, "low", lowBearing);
+    src->insertValues<V>(GPS_SPEED, "high", highSpeed);
+    src->insertValues<A>(GPS_BEARING, "high", highBearing);
+
+    // Water speed also triggers the estimator. The rudder angle does not,
+    // but its samples decide when the timeouts are called.
+    TimedSampleCollection<V>::TimedVector watSpeed;
+    TimedSampleCollection<A>::TimedVector rudderAngle;
+    addSamples<V>(s(0.07), 0.5, 300,
+        [](int i) { return V::knots(5); }, &watSpeed);
+    addSamples<A>(s(0.013), 0.037, 5000,
+        [](int i) { return A::degrees(i % 7); }, &rudderAngle);
+    src->insertValues<V>(WAT_SPEED, "low", watSpeed);
+    src->insertValues<A>(RUDDER_ANGLE, "low", rudderAngle);
+
+    return NavDataset(src);
+  }
+
+  NavDataset simulate(const NavDataset &src, SimulateBoxMode mode) {
+    std::ifstream calibFile(std::string(Env::SOURCE_DIR)
+        + std::string("/src/device/Arduino/NMEAStats/test/boat.dat"));
+    return SimulateBox(calibFile, src, mode);
+  }
+
+  void expectSameOutput(const NavDataset &expected, const NavDataset &actual) {
+    std::function<double(Velocity<double>)> knots =
+      [](Velocity<double> x) { return x.knots(); };
+    std::function<double(Angle<double>)> degrees =
+      [](Angle<double> x) { return x.normalizedAt0().degrees(); };
+
+    expectSameSamples(expected.samples<TWS>(), actual.samples<TWS>(), knots);
+    expectSameSamples(expected.samples<VMG>(), actual.samples<VMG>(), knots);
+    expectSameSamples(expected.samples<TARGET_VMG>(),
+                      actual.samples<TARGET_VMG>(), knots);
+    expectSameSamples(expected.samples<TWA>(), actual.samples<TWA>(),
+                      degrees);
+    expectSameSamples(expected.samples<TWDIR>(), actual.samples<TWDIR>(),
+                      degrees);
+  }
+}  // namespace
+
+// The batch and fast modes should produce exactly what the estimator
+// produces when it runs during the replay, including across source
+// switches and gaps in the data.
+TEST(SimulateBox, SameAsReplay) {
+  NavDataset original = makeTestDataset();
+  NavDataset replayed = simulate(original, SimulateBoxMode::Replay);
+  EXPECT_LT(1400, replayed.samples<TWS>().size());
+
+  expectSameOutput(replayed, simulate(original, SimulateBoxMode::Batch));
+  expectSameOutput(replayed, simulate(original, SimulateBoxMode::Fast));
+}
+
+// A simulated dataset already contains the output of the estimator.
+TEST(SimulateBox, SimulateTwice) {
+  NavDataset original = makeTestDataset();
+  NavDataset once = simulate(original, SimulateBoxMode::Fast);
+  int count = once.samples<TWS>().size();
+
+  NavDataset replayed = simulate(once, SimulateBoxMode::Replay);
+  EXPECT_EQ(2 * count, replayed.samples<TWS>().size());
+  expectSameOutput(replayed, simulate(once, SimulateBoxMode::Batch));
+  expectSameOutput(replayed, simulate(once, SimulateBoxMode::Fast));
+
+  // The first simulation is not modified.
+  EXPECT_EQ(count, once.samples<TWS>().size());
+}
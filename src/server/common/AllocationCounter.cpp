@@ -0,0 +1,34 @@
+/*
+ * AllocationCounter.cpp
+ *
+ *  Linking this replaces the global operator new of the program, to
+ *  count the heap allocations of every thread for the StageProfiler.
+ *  They are only counted while a profiler is active: otherwise, an
+ *  allocation costs one more atomic load than with the default
+ *  operator new.
+ */
+
+#include <cstdlib>
+#include <new>
+#include <server/common/StageProfiler.h>
+
+namespace {
+  struct Registration {
+    Registration() {sail::markAllocationsCounted();}
+  } registration;
+}
+
+void *operator new(size_t n) {
+  if (sail::StageProfiler::active() != nullptr) {
+    sail::countAllocation(n);
+  }
+  void *p = malloc(n == 0 ? 1 : n);
+  if (p == nullptr) {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+void operator delete(void *p) noexcept {
+  free(p);
+}
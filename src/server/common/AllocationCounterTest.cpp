@@ -0,0 +1,66 @@
+/*
+ * AllocationCounterTest.cpp
+ */
+
+#include <gtest/gtest.h>
+#include <server/common/StageProfiler.h>
+#include <thread>
+
+using namespace sail;
+
+namespace {
+  // Calls to the allocation functions, that the compiler cannot
+  // leave out as it can for new-expressions.
+  void allocate(int count) {
+    for (int i = 0; i < count; i++) {
+      ::operator delete(::operator new(16));
+    }
+  }
+
+  StageRecord findRecord(const StageProfiler &profiler,
+                         const std::string &name) {
+    for (const auto &r: profiler.records()) {
+      if (r.name == name) {
+        return r;
+      }
+    }
+    ADD_FAILURE() << "No stage " << name;
+    return StageRecord();
+  }
+}
+
+TEST(AllocationCounterTest, CountsOnlyWhileProfiling) {
+  EXPECT_TRUE(allocationsAreCounted());
+  int64_t before = threadAllocationCounts().count;
+  allocate(10);
+  EXPECT_EQ(before, threadAllocationCounts().count);
+
+  StageProfiler profiler(Duration<double>::seconds(0.0));
+  profiler.activate();
+  {
+    ScopedStage outer("Outer");
+    allocate(10);
+    {
+      ScopedStage inner("Inner");
+      allocate(20);
+    }
+    std::thread worker([]() {
+      ScopedStage stage("Worker");
+      allocate(30);
+    });
+    worker.join();
+  }
+  profiler.deactivate();
+
+  auto outer = findRecord(profiler, "Outer");
+  auto inner = findRecord(profiler, "Inner");
+  auto worker = findRecord(profiler, "Worker");
+  EXPECT_LE(20, inner.allocations);
+  EXPECT_LE(16*20, inner.allocatedBytes);
+  EXPECT_LE(10 + inner.allocations, outer.allocations);
+  EXPECT_LE(30, worker.allocations);
+
+  AllocationCounts total = profiler.allocations();
+  EXPECT_EQ(outer.allocations + worker.allocations, total.count);
+  EXPECT_EQ(outer.allocatedBytes + worker.allocatedBytes, total.bytes);
+}
@@ -0,0 +1,128 @@
+/*
+ * ArrayArena.h
+ *
+ *  Use ScopedArrayArena to let the arrays allocated by a processing
+ *  stage take their elements from a few large blocks, instead of
+ *  allocating every one of them on the heap.
+ */
+
+#ifndef SERVER_COMMON_ARRAYARENA_H_
+#define SERVER_COMMON_ARRAYARENA_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+
+namespace sail {
+
+// A monotonic allocator for array elements. Every allocation refers
+// to the block it was taken from, and a block is released when
+// neither the arena nor any array refers to it anymore. So the
+// arrays can safely outlive the arena, but a long-lived array keeps
+// the whole block it is in.
+class ArrayArena {
+ public:
+  ArrayArena(size_t blockBytes = 64*1024) : _blockBytes(blockBytes) {}
+
+  ArrayArena(const ArrayArena &) = delete;
+  ArrayArena &operator=(const ArrayArena &) = delete;
+
+  // Whether elements of type T can be taken from an arena: It
+  // does not call destructors, and aligns to blocks from 'new'.
+  template <typename T>
+  struct Allocates : std::integral_constant<bool,
+    std::is_trivially_destructible<T>::value
+    && alignof(T) <= alignof(std::max_align_t)> {};
+
+  // Allocates 'n' value-initialized elements,
+  // and sets 'owner' to what keeps them alive.
+  template <typename T>
+  T *allocate(int n, std::shared_ptr<void> *owner) {
+    static_assert(Allocates<T>::value, "Cannot allocate T in an arena");
+    // At least one element, so that every allocation has its own address.
+    size_t bytes = std::max(n, 1)*sizeof(T);
+    T *dst = static_cast<T *>(allocateBytes(bytes, alignof(T), owner));
+    for (int i = 0; i < n; i++) {
+      new (dst + i) T();
+    }
+    return dst;
+  }
+
+  int64_t allocationCount() const {return _allocationCount;}
+  int64_t blockCount() const {return _blockCount;}
+
+  // The arena of the innermost ScopedArrayArena of this thread, if any.
+  static ArrayArena *current() {
+    return currentRef();
+  }
+ private:
+  friend class ScopedArrayArena;
+
+  static ArrayArena *&currentRef() {
+    static thread_local ArrayArena *arena = nullptr;
+    return arena;
+  }
+
+  static std::shared_ptr<char> newBlock(size_t bytes) {
+    return std::shared_ptr<char>(new char[bytes], std::default_delete<char[]>());
+  }
+
+  void *allocateBytes(size_t bytes, size_t alignment,
+                      std::shared_ptr<void> *owner) {
+    _allocationCount++;
+
+    // Large allocations get a block of their own,
+    // not to waste the rest of the current block.
+    if (4*bytes > _blockBytes) {
+      _blockCount++;
+      auto block = newBlock(bytes);
+      *owner = block;
+      return block.get();
+    }
+
+    size_t offset = (_used + alignment - 1)/alignment*alignment;
+    if (!_block || _blockBytes < offset + bytes) {
+      _blockCount++;
+      _block = newBlock(_blockBytes);
+      offset = 0;
+    }
+    _used = offset + bytes;
+    *owner = _block;
+    return _block.get() + offset;
+  }
+
+  size_t _blockBytes;
+  std::shared_ptr<char> _block;
+  size_t _used = 0;
+  int64_t _allocationCount = 0;
+  int64_t _blockCount = 0;
+};
+
+// Makes the arrays allocated by this thread take their elements from
+// an arena while it is alive, if the elements need no destructor.
+class ScopedArrayArena {
+ public:
+  ScopedArrayArena(size_t blockBytes = 64*1024)
+    : _arena(blockBytes), _previous(ArrayArena::currentRef()) {
+    ArrayArena::currentRef() = &_arena;
+  }
+
+  ~ScopedArrayArena() {
+    ArrayArena::currentRef() = _previous;
+  }
+
+  ScopedArrayArena(const ScopedArrayArena &) = delete;
+  ScopedArrayArena &operator=(const ScopedArrayArena &) = delete;
+
+  const ArrayArena &arena() const {return _arena;}
+ private:
+  ArrayArena _arena;
+  ArrayArena *_previous;
+};
+
+}
+
+#endif /* SERVER_COMMON_ARRAYARENA_H_ */
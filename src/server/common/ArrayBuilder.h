@@ -20,7 +20,7 @@ class ArrayBuilder {
   typedef typename ArrayStorage<T>::VectorPtr VectorPtr;
  public:
   ArrayBuilder(int expectedMaxCount = 1) {
-    _data = VectorPtr(new Vector());
+    _data = std::make_shared<Vector>();
     _data->reserve(expectedMaxCount);
     assert(bool(_data));
   }
@@ -45,7 +45,9 @@ class ArrayBuilder {
   }
 
   Array<T> get() {
-    return Array<T>(ArrayStorage<T>(VectorPtr(new Vector(*_data))));
+    Array<T> dst(_data->size());
+    std::copy(_data->begin(), _data->end(), dst.begin());
+    return dst;
   }
   T &last() {return _data->back();}
   bool empty() {return _data->empty();}
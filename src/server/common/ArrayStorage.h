@@ -6,9 +6,11 @@
 #ifndef ARRAYSTORAGE_H_
 #define ARRAYSTORAGE_H_
 
+#include <algorithm>
 #include <memory>
 #include <vector>
 #include <cassert>
+#include <server/common/ArrayArena.h>
 
 namespace sail {
 
@@ -43,41 +45,68 @@ template <typename T>
 class ArrayStorage {
  private:
   typedef ArrayStorage<T> ThisType;
+  typedef typename ArrayStorageInternal::ElementType<T>::InternalType InternalType;
  public:
-  typedef std::vector<typename ArrayStorageInternal::ElementType<T>::InternalType> Vector;
+  typedef std::vector<InternalType> Vector;
   typedef std::shared_ptr<Vector> VectorPtr;
 
   ArrayStorage() {}
 
-  ArrayStorage(int s) : _data(new Vector(s)) {}
+  // The elements are taken from the ArrayArena of this
+  // thread if there is one, otherwise from the heap.
+  ArrayStorage(int s) : _size(s) {
+    _data = allocate(s, &_owner, ArrayArena::Allocates<InternalType>());
+  }
 
-  ArrayStorage(const VectorPtr &ptr) : _data(ptr) {}
+  ArrayStorage(const VectorPtr &ptr) : _owner(ptr) {
+    if (ptr) {
+      _data = ptr->data();
+      _size = ptr->size();
+    }
+  }
 
-  ThisType dup() const {return ThisType(_data(new Vector(vector())));}
+  ThisType dup() const {
+    ThisType dst(size());
+    std::copy(_data, _data + _size, dst._data);
+    return dst;
+  }
 
-  bool allocated() const {return bool(_data);}
+  bool allocated() const {return bool(_owner);}
 
   int size() const {
     assert(allocated());
-    return _data->size();
+    return _size;
   }
 
   T *ptr() {
     assert(allocated());
-    Vector &v = *_data;
-    return (T *)(&(v[0]));
-  }
-
-  const Vector &vector() const {
-    assert(allocated());
-    return *_data;
+    return (T *)_data;
   }
 
   bool operator== (const ThisType &other) const {
-    return _data == other._data;
+    return _owner == other._owner && _data == other._data;
   }
  private:
-  VectorPtr _data;
+  static InternalType *allocate(int s, std::shared_ptr<void> *owner,
+                                std::true_type) {
+    ArrayArena *arena = ArrayArena::current();
+    if (arena != nullptr) {
+      return arena->allocate<InternalType>(s, owner);
+    }
+    return allocate(s, owner, std::false_type());
+  }
+
+  static InternalType *allocate(int s, std::shared_ptr<void> *owner,
+                                std::false_type) {
+    auto v = std::make_shared<Vector>(s);
+    *owner = v;
+    return v->data();
+  }
+
+  // Keeps the elements alive: Either a Vector, or a block of an ArrayArena.
+  std::shared_ptr<void> _owner;
+  InternalType *_data = nullptr;
+  int _size = 0;
 };
 
 }
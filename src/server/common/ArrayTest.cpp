@@ -191,3 +191,54 @@ TEST(ArrayTest, RangeDemo2) {
   }
   EXPECT_EQ(mCount, 2);
 }
+
+TEST(ArrayTest, ArenaTest) {
+  Arrayi outlived;
+  Arrayb flags;
+  {
+    ScopedArrayArena scope(1024);
+    EXPECT_EQ(ArrayArena::current(), &scope.arena());
+    Arrayi A(30);
+    for (int i = 0; i < 30; i++) {
+      EXPECT_EQ(A[i], 0);
+      A[i] = i;
+    }
+    Arrayi B = A.dup();
+    EXPECT_FALSE(A.identicTo(B));
+    Arrayi C(0);
+    Arrayi D(0);
+    EXPECT_FALSE(C.identicTo(D));
+    flags = Arrayb::fill(3, true);
+    outlived = makeRange(1000); // Larger than a fourth of a block.
+    EXPECT_EQ(scope.arena().allocationCount(), 6);
+    EXPECT_EQ(scope.arena().blockCount(), 2);
+    EXPECT_EQ(B[29], 29);
+  }
+  EXPECT_EQ(ArrayArena::current(), nullptr);
+  EXPECT_EQ(outlived[999], 999);
+  EXPECT_TRUE(flags[2]);
+}
+
+TEST(ArrayTest, NestedArenaTest) {
+  ScopedArrayArena outer;
+  {
+    ScopedArrayArena inner;
+    Arrayd A(3);
+    EXPECT_EQ(inner.arena().allocationCount(), 1);
+  }
+  Arrayd B(3);
+  EXPECT_EQ(outer.arena().allocationCount(), 1);
+  EXPECT_EQ(ArrayArena::current(), &outer.arena());
+}
+
+TEST(ArrayTest, ArenaWithDestructorsTest) {
+  ScopedArrayArena scope;
+  {
+    TestArray A(30);
+    EXPECT_EQ(MemoryTestObj::InstanceCounter, 30);
+  }
+  EXPECT_EQ(MemoryTestObj::InstanceCounter, 0);
+  Array<Arrayi> nested(2);
+  nested[0] = Arrayi{1, 2};
+  EXPECT_EQ(scope.arena().allocationCount(), 1);
+}
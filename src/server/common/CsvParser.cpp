@@ -5,27 +5,29 @@
 
 #include <server/common/CsvParser.h>
 #include <fstream>
+#include <server/common/CsvReader.h>
 #include <server/common/string.h>
 
 namespace sail {
 
 MDArray<std::string, 2> parseCsv(std::istream *s) {
-  std::string line;
-  std::vector<Array<std::string> > tokenizedLines;
+  CsvReader reader(s);
+  std::vector<std::vector<std::string> > tokenizedLines;
 
   int maxCols = 0;
-  while (std::getline(*s, line)) {
-    if (!line.empty()) {
-      auto tokens = split(line, ',');
-      maxCols = std::max(maxCols, tokens.size());
-      if (!tokens.empty()) {
-        tokenizedLines.push_back(tokens);
-      }
+  while (reader.next()) {
+    const auto &fields = reader.fields();
+    maxCols = std::max(maxCols, int(fields.size()));
+    std::vector<std::string> tokens;
+    tokens.reserve(fields.size());
+    for (auto f: fields) {
+      tokens.push_back(f.str());
     }
+    tokenizedLines.push_back(std::move(tokens));
   }
   MDArray<std::string, 2> results(tokenizedLines.size(), maxCols);
   for (int i = 0; i < tokenizedLines.size(); i++) {
-    auto tokens = tokenizedLines[i];
+    const auto &tokens = tokenizedLines[i];
     for (int j = 0; j < tokens.size(); j++) {
       results(i, j) = tokens[j];
     }
@@ -4,7 +4,9 @@
  */
 
 #include <server/common/CsvParser.h>
+#include <cmath>
 #include <gtest/gtest.h>
+#include <server/common/CsvReader.h>
 #include <sstream>
 
 using namespace sail;
@@ -24,3 +26,44 @@ TEST(CsvParserTest, NumbersAndStrings) {
 }
 
 
+TEST(CsvParserTest, ReaderSplitsLikeSplit) {
+  // Tiny buffer, to exercise refilling and lines longer than it.
+  std::stringstream ss;
+  ss << "a,b,\n\r\n,x,,yyyyyyyyyyyyyyyy\n\nlast";
+  CsvReader reader(&ss, ',', 4);
+  ASSERT_TRUE(reader.next());
+  ASSERT_EQ(2, reader.fields().size());
+  EXPECT_TRUE(reader.fields()[1] == "b");
+  ASSERT_TRUE(reader.next());
+  ASSERT_EQ(1, reader.fields().size());
+  EXPECT_TRUE(reader.fields()[0] == "\r");
+  ASSERT_TRUE(reader.next());
+  ASSERT_EQ(4, reader.fields().size());
+  EXPECT_TRUE(reader.fields()[0].empty());
+  EXPECT_EQ("yyyyyyyyyyyyyyyy", reader.fields()[3].str());
+  ASSERT_TRUE(reader.next());
+  EXPECT_EQ("last", reader.fields()[0].str());
+  EXPECT_FALSE(reader.next());
+  EXPECT_EQ(ss.str().size(), reader.bytesRead());
+}
+
+TEST(CsvParserTest, TrimField) {
+  std::string s = "  \"quoted\" \r";
+  auto f = trimCsvField(CsvField(s.data(), s.data() + s.size()));
+  EXPECT_EQ("quoted", f.str());
+}
+
+TEST(CsvParserTest, ParseDoubleLikeStod) {
+  for (std::string s: {"0", "-0", "12.5", "-3.25e2", "1.5E-3", ".5", "7.",
+                       "6.998944799999999", "43.4739143", "0.1", "-71.92339",
+                       "123456789012345678901234", "1e300", "12abc",
+                       "inf", "nan", "0x1A", "", "-", "e5", "1e", "abc"}) {
+    double expected = 0, x = 0;
+    bool ok = tryParseDouble(s, &expected);
+    EXPECT_EQ(ok, tryParseCsvDouble(CsvField(s.data(), s.data() + s.size()),
+                                    &x)) << s;
+    if (ok && !std::isnan(expected)) {
+      EXPECT_EQ(expected, x) << s;
+    }
+  }
+}
@@ -0,0 +1,168 @@
+#include <server/common/CsvReader.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <istream>
+#include <server/common/string.h>
+
+namespace sail {
+
+bool CsvField::operator==(const char *s) const {
+  size_t n = strlen(s);
+  return n == size() && std::equal(begin, end, s);
+}
+
+CsvField trimCsvField(CsvField f) {
+  while (f.begin < f.end && isspace(static_cast<unsigned char>(*f.begin))) {
+    f.begin++;
+  }
+  while (f.begin < f.end && isspace(static_cast<unsigned char>(f.end[-1]))) {
+    f.end--;
+  }
+  if (f.size() > 2 && *f.begin == '"' && f.end[-1] == '"') {
+    f.begin++;
+    f.end--;
+  }
+  return f;
+}
+
+namespace {
+  // Exactly representable powers of ten.
+  const double powersOfTen[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+  };
+
+  // Numbers like -12.345 or 1.5e-3. When both the digits and the
+  // power of ten are exactly representable, a single multiplication
+  // or division gives the correctly rounded result, the same as
+  // strtod. Otherwise we return false and let strtod do it.
+  bool tryParsePlainDecimal(const char *p, const char *end, double *out) {
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')) {
+      negative = *p == '-';
+      p++;
+    }
+    uint64_t digits = 0;
+    int digitCount = 0;
+    int exponent = 0;
+    bool any = false;
+    for (; p < end && isdigit(static_cast<unsigned char>(*p)); p++) {
+      digits = 10*digits + (*p - '0');
+      digitCount += (digits > 0? 1 : 0);
+      any = true;
+    }
+    if (p < end && *p == '.') {
+      p++;
+      for (; p < end && isdigit(static_cast<unsigned char>(*p)); p++) {
+        digits = 10*digits + (*p - '0');
+        digitCount += (digits > 0? 1 : 0);
+        exponent--;
+        any = true;
+      }
+    }
+    if (!any || 15 < digitCount) {
+      return false;
+    }
+    if (p < end && (*p == 'e' || *p == 'E')) {
+      p++;
+      bool negativeExponent = false;
+      if (p < end && (*p == '-' || *p == '+')) {
+        negativeExponent = *p == '-';
+        p++;
+      }
+      if (p == end) {
+        return false;
+      }
+      int e = 0;
+      for (; p < end && isdigit(static_cast<unsigned char>(*p)); p++) {
+        if (e > 1000) {
+          return false;
+        }
+        e = 10*e + (*p - '0');
+      }
+      exponent += negativeExponent? -e : e;
+    }
+    if (p != end || exponent < -22 || 22 < exponent) {
+      return false;
+    }
+    double x = double(digits);
+    x = exponent < 0? x/powersOfTen[-exponent] : x*powersOfTen[exponent];
+    *out = negative? -x : x;
+    return true;
+  }
+}
+
+bool tryParseCsvDouble(CsvField field, double *out) {
+  return tryParsePlainDecimal(field.begin, field.end, out)
+    || tryParseDouble(field.str(), out);
+}
+
+void splitCsvLine(const char *begin, const char *end, char delimiter,
+                  std::vector<CsvField> *fields) {
+  fields->clear();
+  const char *p = begin;
+  while (p < end) {
+    const char *d = static_cast<const char *>(memchr(p, delimiter, end - p));
+    if (d == nullptr) {
+      fields->push_back(CsvField(p, end));
+      break;
+    }
+    fields->push_back(CsvField(p, d));
+    p = d + 1;
+  }
+}
+
+CsvReader::CsvReader(std::istream *src, char delimiter, size_t bufferSize)
+  : _src(src), _delimiter(delimiter), _buffer(bufferSize) {}
+
+bool CsvReader::fill() {
+  if (!_src || !_src->good()) {
+    return false;
+  }
+  if (0 < _begin) {
+    std::memmove(_buffer.data(), _buffer.data() + _begin, _end - _begin);
+    _end -= _begin;
+    _begin = 0;
+  }
+  if (_end == _buffer.size()) {
+    // A line longer than the buffer.
+    _buffer.resize(2*_buffer.size());
+  }
+  _src->read(_buffer.data() + _end, _buffer.size() - _end);
+  size_t n = _src->gcount();
+  _end += n;
+  _bytesRead += n;
+  return 0 < n;
+}
+
+bool CsvReader::next() {
+  while (true) {
+    const char *data = _buffer.data();
+    const char *newline = static_cast<const char *>(
+        memchr(data + _begin, '\n', _end - _begin));
+    const char *lineBegin = data + _begin;
+    const char *lineEnd = nullptr;
+    if (newline != nullptr) {
+      lineEnd = newline;
+      _begin = newline + 1 - data;
+    } else if (!fill()) {
+      if (_begin == _end) {
+        return false;
+      }
+      // The last line, without a newline.
+      lineBegin = _buffer.data() + _begin;
+      lineEnd = _buffer.data() + _end;
+      _begin = _end;
+    } else {
+      continue;
+    }
+    if (lineBegin < lineEnd) {
+      splitCsvLine(lineBegin, lineEnd, _delimiter, &_fields);
+      return true;
+    }
+  }
+}
+
+}
@@ -0,0 +1,78 @@
+/*
+ * Streaming CSV reading: lines are read from the stream in large
+ * chunks and split into fields in place, so that no string is
+ * allocated per cell.
+ */
+
+#ifndef SERVER_COMMON_CSVREADER_H_
+#define SERVER_COMMON_CSVREADER_H_
+
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+namespace sail {
+
+// A field of a CSV line. It points into the buffer of the
+// CsvReader and is only valid until the next line is read.
+// This is a pointer pair because the code is built as C++11,
+// which has no std::string_view.
+struct CsvField {
+  const char *begin = nullptr;
+  const char *end = nullptr;
+
+  CsvField() {}
+  CsvField(const char *b, const char *e) : begin(b), end(e) {}
+
+  size_t size() const { return end - begin; }
+  bool empty() const { return begin == end; }
+  std::string str() const { return std::string(begin, end); }
+  bool operator==(const char *s) const;
+};
+
+// Removes the blanks around the field, and then the quotes
+// around it if there are any.
+CsvField trimCsvField(CsvField field);
+
+// Same result as tryParseDouble(field.str(), out), but plain
+// decimal numbers are parsed without allocating or calling strtod.
+bool tryParseCsvDouble(CsvField field, double *out);
+
+// Splits a line like sail::split(line, delimiter) does:
+// an empty last field is dropped.
+void splitCsvLine(const char *begin, const char *end, char delimiter,
+                  std::vector<CsvField> *fields);
+
+class CsvReader {
+ public:
+  CsvReader(std::istream *src, char delimiter = ',',
+            size_t bufferSize = 1 << 20);
+
+  // Moves to the next non-empty line. Returns false at the
+  // end of the stream.
+  bool next();
+
+  const std::vector<CsvField> &fields() const { return _fields; }
+
+  // The number of bytes consumed from the stream so far.
+  int64_t bytesRead() const { return _bytesRead; }
+ private:
+  CsvReader(const CsvReader &) = delete;
+  CsvReader &operator=(const CsvReader &) = delete;
+
+  // Reads more data after the unconsumed part of the buffer.
+  // Returns false if nothing could be read.
+  bool fill();
+
+  std::istream *_src;
+  char _delimiter;
+  std::vector<char> _buffer;
+  size_t _begin = 0, _end = 0;
+  int64_t _bytesRead = 0;
+  std::vector<CsvField> _fields;
+};
+
+}
+
+#endif /* SERVER_COMMON_CSVREADER_H_ */
@@ -0,0 +1,41 @@
+#include <server/common/QuantileSketch.h>
+
+#include <algorithm>
+#include <cmath>
+#include <server/common/logging.h>
+
+namespace sail {
+
+void QuantileSketch::add(double value) {
+  if (std::isnan(value)) {
+    return;
+  }
+  _buckets[int64_t(std::floor(value/_resolution + 0.5))]++;
+  _count++;
+}
+
+void QuantileSketch::merge(const QuantileSketch &other) {
+  CHECK(_resolution == other._resolution);
+  for (const auto &bucket : other._buckets) {
+    _buckets[bucket.first] += bucket.second;
+  }
+  _count += other._count;
+}
+
+double QuantileSketch::quantile(double q) const {
+  if (empty()) {
+    return NAN;
+  }
+  int64_t index = std::min(_count - 1,
+      std::max(int64_t(0), int64_t(std::floor(q*_count))));
+  int64_t seen = 0;
+  for (const auto &bucket : _buckets) {
+    seen += bucket.second;
+    if (index < seen) {
+      return bucket.first*_resolution;
+    }
+  }
+  return _buckets.rbegin()->first*_resolution;
+}
+
+}  // namespace sail
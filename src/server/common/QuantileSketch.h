@@ -0,0 +1,46 @@
+#ifndef SERVER_COMMON_QUANTILESKETCH_H_
+#define SERVER_COMMON_QUANTILESKETCH_H_
+
+#include <cstdint>
+#include <map>
+
+namespace sail {
+
+// Summarizes a stream of numbers so that quantiles can be computed
+// without storing and sorting all of them.
+//
+// The values are counted in buckets of width 'resolution', so that
+// a quantile is within resolution/2 of the exact value that would be
+// obtained by sorting the values. The memory used depends on the range
+// of the values divided by the resolution, not on the number of values.
+// Two sketches with the same resolution can be merged, which gives the
+// same result as adding all values to a single sketch.
+class QuantileSketch {
+ public:
+  explicit QuantileSketch(double resolution = 0.001)
+    : _resolution(resolution) { }
+
+  // NaN values are ignored.
+  void add(double value);
+
+  void merge(const QuantileSketch &other);
+
+  // The value at index floor(q*count()) of the sorted values,
+  // up to the resolution. NaN if the sketch is empty.
+  double quantile(double q) const;
+
+  int64_t count() const { return _count; }
+  bool empty() const { return _count == 0; }
+  double resolution() const { return _resolution; }
+
+  // The number of non-empty buckets.
+  int bucketCount() const { return _buckets.size(); }
+ private:
+  double _resolution;
+  int64_t _count = 0;
+  std::map<int64_t, int64_t> _buckets;
+};
+
+}  // namespace sail
+
+#endif  // SERVER_COMMON_QUANTILESKETCH_H_
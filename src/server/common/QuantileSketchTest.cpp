@@ -0,0 +1,64 @@
+#include <gtest/gtest.h>
+#include <server/common/QuantileSketch.h>
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+using namespace sail;
+
+namespace {
+
+double exactQuantile(std::vector<double> values, double q) {
+  std::sort(values.begin(), values.end());
+  return values[int(std::floor(q*values.size()))];
+}
+
+}  // namespace
+
+TEST(QuantileSketchTest, Empty) {
+  QuantileSketch sketch;
+  EXPECT_TRUE(sketch.empty());
+  EXPECT_TRUE(std::isnan(sketch.quantile(0.5)));
+  sketch.add(NAN);
+  EXPECT_TRUE(sketch.empty());
+}
+
+TEST(QuantileSketchTest, ErrorBound) {
+  const double resolution = 0.01;
+  std::default_random_engine engine(3);
+  std::normal_distribution<double> distribution(6.0, 2.0);
+
+  QuantileSketch sketch(resolution);
+  std::vector<double> values;
+  for (int i = 0; i < 20000; i++) {
+    double x = distribution(engine);
+    values.push_back(x);
+    sketch.add(x);
+  }
+  EXPECT_EQ(values.size(), sketch.count());
+
+  for (double q : {0.0, 0.1, 0.25, 0.5, 0.75, 0.9, 0.999}) {
+    EXPECT_NEAR(exactQuantile(values, q), sketch.quantile(q),
+                0.5*resolution + 1.0e-12);
+  }
+}
+
+TEST(QuantileSketchTest, Merge) {
+  std::default_random_engine engine(4);
+  std::uniform_real_distribution<double> distribution(-3.0, 12.0);
+
+  QuantileSketch all, a, b;
+  for (int i = 0; i < 5000; i++) {
+    double x = distribution(engine);
+    all.add(x);
+    (i % 3 == 0 ? a : b).add(x);
+  }
+  a.merge(b);
+  EXPECT_EQ(all.count(), a.count());
+  EXPECT_EQ(all.bucketCount(), a.bucketCount());
+  for (double q : {0.1, 0.5, 0.9}) {
+    EXPECT_EQ(all.quantile(q), a.quantile(q));
+  }
+}
@@ -0,0 +1,336 @@
+/*
+ * StageProfiler.cpp
+ */
+
+#include <server/common/StageProfiler.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <iostream>
+#include <server/common/logging.h>
+#include <server/common/string.h>
+#include <sstream>
+#include <sys/resource.h>
+#include <unistd.h>
+
+namespace sail {
+
+namespace {
+
+std::atomic<bool> allocationsCounted(false);
+std::atomic<StageProfiler *> activeProfiler(nullptr);
+std::atomic<int> threadCount(0);
+
+int threadIndex() {
+  static thread_local int index = threadCount++;
+  return index;
+}
+
+// Stages of the calling thread that have not ended.
+int &threadDepth() {
+  static thread_local int depth = 0;
+  return depth;
+}
+
+std::string jsonString(const std::string &s) {
+  std::string dst = "\"";
+  for (char c: s) {
+    if (c == '"' || c == '\\') {
+      dst += '\\';
+      dst += c;
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      dst += stringFormat("\\u%04x", c);
+    } else {
+      dst += c;
+    }
+  }
+  return dst + "\"";
+}
+
+}  // namespace
+
+AllocationCounts &threadAllocationCounts() {
+  static thread_local AllocationCounts counts;
+  return counts;
+}
+
+void markAllocationsCounted() {
+  allocationsCounted = true;
+}
+
+bool allocationsAreCounted() {
+  return allocationsCounted;
+}
+
+long currentRssKb() {
+#ifdef __linux__
+  long pages = 0;
+  FILE *f = fopen("/proc/self/statm", "r");
+  if (f == nullptr) {
+    return 0;
+  }
+  if (fscanf(f, "%*s %ld", &pages) != 1) {
+    pages = 0;
+  }
+  fclose(f);
+  return pages*(sysconf(_SC_PAGESIZE)/1024);
+#else
+  return 0;
+#endif
+}
+
+long peakRssKb() {
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0) {
+    return 0;
+  }
+#ifdef __APPLE__
+  return usage.ru_maxrss/1024;  // In bytes on OS X.
+#else
+  return usage.ru_maxrss;
+#endif
+}
+
+void StageTotal::add(const StageRecord &record) {
+  double s = 1.0e-6*record.durationMicros;
+  count++;
+  seconds += s;
+  maxSeconds = std::max(maxSeconds, s);
+  allocations += std::max(int64_t(0), record.allocations);
+  allocatedBytes += record.allocatedBytes;
+  maxPeakRssKb = std::max(maxPeakRssKb, record.peakRssKb);
+  samplesIn += std::max(int64_t(0), record.samplesIn);
+  samplesOut += std::max(int64_t(0), record.samplesOut);
+}
+
+void StageTotal::add(const StageTotal &other) {
+  count += other.count;
+  seconds += other.seconds;
+  maxSeconds = std::max(maxSeconds, other.maxSeconds);
+  allocations += other.allocations;
+  allocatedBytes += other.allocatedBytes;
+  maxPeakRssKb = std::max(maxPeakRssKb, other.maxPeakRssKb);
+  samplesIn += other.samplesIn;
+  samplesOut += other.samplesOut;
+}
+
+namespace {
+  const char stageTotalsHeader[] = "stage\tcount\tseconds\tmax_seconds"
+    "\tallocations\tallocated_bytes\tmax_peak_rss_kb\tsamples_in\tsamples_out";
+}
+
+void writeStageTotals(const StageTotals &totals, std::ostream *dst) {
+  *dst << stageTotalsHeader << "\n";
+  for (const auto &kv: totals) {
+    const StageTotal &t = kv.second;
+    *dst << kv.first << "\t" << t.count << "\t" << t.seconds
+      << "\t" << t.maxSeconds << "\t" << t.allocations
+      << "\t" << t.allocatedBytes << "\t" << t.maxPeakRssKb
+      << "\t" << t.samplesIn << "\t" << t.samplesOut << "\n";
+  }
+}
+
+bool readStageTotals(std::istream *src, StageTotals *dst) {
+  std::string line;
+  if (!std::getline(*src, line) || line != stageTotalsHeader) {
+    return false;
+  }
+  while (std::getline(*src, line)) {
+    if (line.empty()) {
+      continue;
+    }
+    auto tab = line.find('\t');
+    if (tab == std::string::npos) {
+      return false;
+    }
+    StageTotal t;
+    std::stringstream fields(line.substr(tab + 1));
+    if (!(fields >> t.count >> t.seconds >> t.maxSeconds >> t.allocations
+          >> t.allocatedBytes >> t.maxPeakRssKb >> t.samplesIn
+          >> t.samplesOut)) {
+      return false;
+    }
+    (*dst)[line.substr(0, tab)].add(t);
+  }
+  return true;
+}
+
+StageProfiler::StageProfiler(Duration<double> samplingPeriod)
+  : _start(std::chrono::steady_clock::now()),
+    _samplingPeriod(samplingPeriod) {}
+
+StageProfiler::~StageProfiler() {
+  deactivate();
+}
+
+void StageProfiler::activate() {
+  StageProfiler *expected = nullptr;
+  if (!activeProfiler.compare_exchange_strong(expected, this)) {
+    if (expected != this) {
+      LOG(ERROR) << "Another StageProfiler is already active";
+    }
+    return;
+  }
+  if (0 < _samplingPeriod.seconds()) {
+    _sampling = true;
+    _sampler = std::thread([this]() {sampleMemory();});
+  }
+}
+
+void StageProfiler::deactivate() {
+  StageProfiler *expected = this;
+  if (!activeProfiler.compare_exchange_strong(expected, nullptr)) {
+    return;
+  }
+  if (_sampler.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _sampling = false;
+    }
+    _stopSampling.notify_all();
+    _sampler.join();
+  }
+}
+
+StageProfiler *StageProfiler::active() {
+  return activeProfiler;
+}
+
+std::vector<StageRecord> StageProfiler::records() const {
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _records;
+}
+
+std::vector<StageProfiler::MemorySample>
+    StageProfiler::memorySamples() const {
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _memory;
+}
+
+StageTotals StageProfiler::totals() const {
+  StageTotals dst;
+  for (const auto &r: records()) {
+    dst[r.name].add(r);
+  }
+  return dst;
+}
+
+AllocationCounts StageProfiler::allocations() const {
+  AllocationCounts dst;
+  if (!allocationsAreCounted()) {
+    dst.count = -1;
+    return dst;
+  }
+  for (const auto &r: records()) {
+    if (r.depth == 0) {
+      dst.count += r.allocations;
+      dst.bytes += r.allocatedBytes;
+    }
+  }
+  return dst;
+}
+
+int64_t StageProfiler::microsSinceStart() const {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now() - _start).count();
+}
+
+void StageProfiler::add(const StageRecord &record) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  _records.push_back(record);
+}
+
+void StageProfiler::sampleMemory() {
+  auto period = std::chrono::microseconds(
+      int64_t(1.0e6*_samplingPeriod.seconds()));
+  std::unique_lock<std::mutex> lock(_mutex);
+  while (_sampling) {
+    MemorySample sample;
+    sample.micros = microsSinceStart();
+    sample.rssKb = currentRssKb();
+    _memory.push_back(sample);
+    _stopSampling.wait_for(lock, period);
+  }
+}
+
+void StageProfiler::writeChromeTrace(std::ostream *dst) const {
+  auto records = this->records();
+  std::stable_sort(records.begin(), records.end(),
+      [](const StageRecord &a, const StageRecord &b) {
+    return a.beginMicros < b.beginMicros;
+  });
+  int threads = 0;
+  for (const auto &r: records) {
+    threads = std::max(threads, r.thread + 1);
+  }
+
+  *dst << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+  const char *separator = "";
+  for (int i = 0; i < threads; i++) {
+    *dst << separator << "{\"name\": \"thread_name\", \"ph\": \"M\", "
+      << "\"pid\": 1, \"tid\": " << i << ", \"args\": {\"name\": "
+      << jsonString(stringFormat("thread %d", i)) << "}}";
+    separator = ",\n";
+  }
+  for (const auto &r: records) {
+    *dst << separator << "{\"name\": " << jsonString(r.name)
+      << ", \"cat\": \"stage\", \"ph\": \"X\", \"pid\": 1, \"tid\": "
+      << r.thread << ", \"ts\": " << r.beginMicros
+      << ", \"dur\": " << r.durationMicros << ", \"args\": {";
+    if (0 <= r.allocations) {
+      *dst << "\"allocations\": " << r.allocations
+        << ", \"allocated_bytes\": " << r.allocatedBytes << ", ";
+    }
+    if (0 <= r.samplesIn) {
+      *dst << "\"samples_in\": " << r.samplesIn << ", ";
+    }
+    if (0 <= r.samplesOut) {
+      *dst << "\"samples_out\": " << r.samplesOut << ", ";
+    }
+    *dst << "\"rss_growth_kb\": " << r.rssGrowthKb
+      << ", \"peak_rss_kb\": " << r.peakRssKb << "}}";
+    separator = ",\n";
+  }
+  for (const auto &m: memorySamples()) {
+    *dst << separator << "{\"name\": \"Memory\", \"ph\": \"C\", \"pid\": 1, "
+      << "\"ts\": " << m.micros << ", \"args\": {\"rss_kb\": "
+      << m.rssKb << "}}";
+    separator = ",\n";
+  }
+  *dst << "\n]}\n";
+}
+
+ScopedStage::ScopedStage(const std::string &name)
+  : _profiler(StageProfiler::active()) {
+  if (_profiler == nullptr) {
+    return;
+  }
+  _record.name = name;
+  _record.thread = threadIndex();
+  _record.depth = threadDepth()++;
+  _rssBeforeKb = currentRssKb();
+  _allocationsBefore = threadAllocationCounts();
+  _record.beginMicros = _profiler->microsSinceStart();
+}
+
+void ScopedStage::finish() {
+  if (_profiler == nullptr) {
+    return;
+  }
+  _record.durationMicros = _profiler->microsSinceStart() - _record.beginMicros;
+  const AllocationCounts &after = threadAllocationCounts();
+  if (allocationsAreCounted()) {
+    _record.allocations = after.count - _allocationsBefore.count;
+    _record.allocatedBytes = after.bytes - _allocationsBefore.bytes;
+  } else {
+    _record.allocations = -1;
+  }
+  _record.rssGrowthKb = currentRssKb() - _rssBeforeKb;
+  _record.peakRssKb = peakRssKb();
+  threadDepth()--;
+  _profiler->add(_record);
+  _profiler = nullptr;
+}
+
+}
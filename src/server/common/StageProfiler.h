@@ -0,0 +1,186 @@
+/*
+ * StageProfiler.h
+ *
+ *  Measures the stages of a long processing, such as the processing of
+ *  the logs of a boat: how long every stage takes and in which thread,
+ *  how much it allocates, how the memory of the process grows and how
+ *  many samples go in and out of it.
+ *
+ *  Usage:
+ *
+ *    StageProfiler profiler;
+ *    profiler.activate();
+ *    {
+ *      ScopedStage stage("Filter GPS");
+ *      stage.setSamplesIn(countSamples(navs));
+ *      ...
+ *      stage.setSamplesOut(countSamples(filtered));
+ *    }
+ *    profiler.deactivate();
+ *    profiler.writeChromeTrace(&file);
+ *
+ *  Stages can be nested, and used in any thread. They cost nothing
+ *  more than a check when no profiler is active.
+ */
+
+#ifndef SERVER_COMMON_STAGEPROFILER_H_
+#define SERVER_COMMON_STAGEPROFILER_H_
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <iosfwd>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <device/Arduino/libraries/PhysicalQuantity/PhysicalQuantity.h>
+
+namespace sail {
+
+// The heap allocations made by a thread. They are only counted in
+// programs linked with common_AllocationCounter, that replaces the
+// global operator new, and only while a profiler is active.
+struct AllocationCounts {
+  int64_t count = 0;
+  int64_t bytes = 0;
+};
+
+// The counts of the calling thread.
+AllocationCounts &threadAllocationCounts();
+
+inline void countAllocation(size_t bytes) {
+  AllocationCounts &counts = threadAllocationCounts();
+  counts.count++;
+  counts.bytes += bytes;
+}
+
+// Called once by common_AllocationCounter.
+void markAllocationsCounted();
+bool allocationsAreCounted();
+
+// Resident set size of the process, now and at its peak, in kilobytes.
+// 0 where it is not known.
+long currentRssKb();
+long peakRssKb();
+
+// One stage, as run by one thread.
+struct StageRecord {
+  std::string name;
+  int thread = 0;  // Numbered in the order they first enter a stage.
+  int depth = 0;   // The number of stages of the same thread it is in.
+  int64_t beginMicros = 0;  // Since the profiler was constructed.
+  int64_t durationMicros = 0;
+  int64_t allocations = 0;  // By the thread, -1 if not counted.
+  int64_t allocatedBytes = 0;
+  long rssGrowthKb = 0;     // Of the process, during the stage.
+  long peakRssKb = 0;       // Of the process, at the end of the stage.
+  int64_t samplesIn = -1;   // -1 if not set by the stage.
+  int64_t samplesOut = -1;
+};
+
+// The sum over the records of a stage with the same name, possibly
+// from several threads or several runs.
+struct StageTotal {
+  int64_t count = 0;
+  double seconds = 0;
+  double maxSeconds = 0;
+  int64_t allocations = 0;
+  int64_t allocatedBytes = 0;
+  long maxPeakRssKb = 0;
+  int64_t samplesIn = 0;
+  int64_t samplesOut = 0;
+
+  void add(const StageRecord &record);
+  void add(const StageTotal &other);
+};
+
+typedef std::map<std::string, StageTotal> StageTotals;
+
+// Tab separated, with a header line and then one line per stage.
+void writeStageTotals(const StageTotals &totals, std::ostream *dst);
+
+// Adds the totals written by writeStageTotals to 'dst'.
+// Returns false if the input is not such totals.
+bool readStageTotals(std::istream *src, StageTotals *dst);
+
+class StageProfiler {
+ public:
+  // The memory of the process is sampled every 'samplingPeriod'
+  // while the profiler is active, unless it is zero.
+  StageProfiler(Duration<double> samplingPeriod
+                  = Duration<double>::seconds(0.1));
+  ~StageProfiler();
+
+  StageProfiler(const StageProfiler &) = delete;
+  StageProfiler &operator=(const StageProfiler &) = delete;
+
+  // While a profiler is active, the stages of all threads are recorded
+  // by it. At most one profiler is active at a time, and all stages
+  // should have ended when it is deactivated.
+  void activate();
+  void deactivate();
+
+  // The active profiler, or nullptr.
+  static StageProfiler *active();
+
+  struct MemorySample {
+    int64_t micros = 0;
+    long rssKb = 0;
+  };
+
+  std::vector<StageRecord> records() const;
+  std::vector<MemorySample> memorySamples() const;
+  StageTotals totals() const;
+
+  // The allocations of the stages that are not nested in other stages,
+  // over all threads. The count is -1 if allocations are not counted.
+  AllocationCounts allocations() const;
+
+  // In the Trace Event Format, to be opened with chrome://tracing or
+  // https://ui.perfetto.dev, with the stages as complete events on the
+  // timeline of their threads and the memory samples as counters.
+  void writeChromeTrace(std::ostream *dst) const;
+
+  int64_t microsSinceStart() const;
+  void add(const StageRecord &record);
+ private:
+  void sampleMemory();
+
+  std::chrono::steady_clock::time_point _start;
+  Duration<double> _samplingPeriod;
+  mutable std::mutex _mutex;
+  std::condition_variable _stopSampling;
+  bool _sampling = false;
+  std::thread _sampler;
+  std::vector<StageRecord> _records;
+  std::vector<MemorySample> _memory;
+};
+
+// Records the stage from its construction to its destruction,
+// or to the call to finish(), if a profiler is active.
+class ScopedStage {
+ public:
+  explicit ScopedStage(const std::string &name);
+  ~ScopedStage() {finish();}
+
+  ScopedStage(const ScopedStage &) = delete;
+  ScopedStage &operator=(const ScopedStage &) = delete;
+
+  bool active() const {return _profiler != nullptr;}
+
+  void setSamplesIn(int64_t n) {_record.samplesIn = n;}
+  void setSamplesOut(int64_t n) {_record.samplesOut = n;}
+
+  void finish();
+ private:
+  StageProfiler *_profiler;
+  StageRecord _record;
+  AllocationCounts _allocationsBefore;
+  long _rssBeforeKb = 0;
+};
+
+}
+
+#endif /* SERVER_COMMON_STAGEPROFILER_H_ */
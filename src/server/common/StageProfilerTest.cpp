@@ -0,0 +1,125 @@
+/*
+ * StageProfilerTest.cpp
+ */
+
+#include <gtest/gtest.h>
+#include <server/common/StageProfiler.h>
+#include <sstream>
+#include <thread>
+
+using namespace sail;
+
+namespace {
+  StageRecord findRecord(const StageProfiler &profiler,
+                         const std::string &name) {
+    for (const auto &r: profiler.records()) {
+      if (r.name == name) {
+        return r;
+      }
+    }
+    ADD_FAILURE() << "No stage " << name;
+    return StageRecord();
+  }
+}
+
+TEST(StageProfilerTest, NothingRecordedWhenInactive) {
+  StageProfiler profiler(Duration<double>::seconds(0.0));
+  {
+    ScopedStage stage("Inactive");
+    EXPECT_FALSE(stage.active());
+  }
+  EXPECT_TRUE(profiler.records().empty());
+}
+
+TEST(StageProfilerTest, NestedStagesAndThreads) {
+  StageProfiler profiler(Duration<double>::seconds(0.001));
+  profiler.activate();
+  EXPECT_EQ(&profiler, StageProfiler::active());
+  {
+    ScopedStage outer("Outer");
+    EXPECT_TRUE(outer.active());
+    outer.setSamplesIn(100);
+    {
+      ScopedStage inner("Inner");
+      std::vector<double> x(1000, 1.0);
+      inner.setSamplesOut(x.size());
+    }
+    std::thread worker([]() {
+      ScopedStage stage("Worker");
+    });
+    worker.join();
+    outer.setSamplesOut(50);
+  }
+  ScopedStage finished("Finished");
+  finished.finish();
+  profiler.deactivate();
+  EXPECT_EQ(nullptr, StageProfiler::active());
+
+  EXPECT_EQ(4, profiler.records().size());
+  auto outer = findRecord(profiler, "Outer");
+  auto inner = findRecord(profiler, "Inner");
+  auto worker = findRecord(profiler, "Worker");
+  EXPECT_EQ(0, outer.depth);
+  EXPECT_EQ(1, inner.depth);
+  EXPECT_EQ(0, worker.depth);
+  EXPECT_EQ(outer.thread, inner.thread);
+  EXPECT_NE(outer.thread, worker.thread);
+  EXPECT_LE(outer.beginMicros, inner.beginMicros);
+  EXPECT_LE(inner.beginMicros + inner.durationMicros,
+            outer.beginMicros + outer.durationMicros);
+  EXPECT_EQ(100, outer.samplesIn);
+  EXPECT_EQ(50, outer.samplesOut);
+  EXPECT_EQ(-1, inner.samplesIn);
+  EXPECT_EQ(1000, inner.samplesOut);
+  EXPECT_EQ(0, findRecord(profiler, "Finished").depth);
+
+  // This test is not linked with common_AllocationCounter.
+  EXPECT_FALSE(allocationsAreCounted());
+  EXPECT_EQ(-1, inner.allocations);
+  EXPECT_FALSE(profiler.memorySamples().empty());
+
+  std::stringstream trace;
+  profiler.writeChromeTrace(&trace);
+  EXPECT_NE(std::string::npos, trace.str().find(
+      "{\"name\": \"Inner\", \"cat\": \"stage\", \"ph\": \"X\""));
+  EXPECT_NE(std::string::npos, trace.str().find("\"samples_out\": 1000"));
+  EXPECT_NE(std::string::npos, trace.str().find("\"ph\": \"C\""));
+}
+
+TEST(StageProfilerTest, TotalsRoundTrip) {
+  StageRecord a;
+  a.name = "Load logs";
+  a.durationMicros = 2000000;
+  a.allocations = 10;
+  a.allocatedBytes = 1000;
+  a.peakRssKb = 300;
+  a.samplesOut = 7;
+  StageRecord b = a;
+  b.durationMicros = 1000000;
+  b.peakRssKb = 500;
+
+  StageTotals totals;
+  totals[a.name].add(a);
+  totals[b.name].add(b);
+
+  std::stringstream ss;
+  writeStageTotals(totals, &ss);
+  ss.seekg(0);
+  StageTotals fleet;
+  EXPECT_TRUE(readStageTotals(&ss, &fleet));
+  std::stringstream again(ss.str());
+  EXPECT_TRUE(readStageTotals(&again, &fleet));
+
+  const StageTotal &t = fleet["Load logs"];
+  EXPECT_EQ(4, t.count);
+  EXPECT_NEAR(6.0, t.seconds, 1.0e-9);
+  EXPECT_NEAR(2.0, t.maxSeconds, 1.0e-9);
+  EXPECT_EQ(40, t.allocations);
+  EXPECT_EQ(4000, t.allocatedBytes);
+  EXPECT_EQ(500, t.maxPeakRssKb);
+  EXPECT_EQ(0, t.samplesIn);
+  EXPECT_EQ(28, t.samplesOut);
+
+  std::stringstream bad("not totals\n");
+  EXPECT_FALSE(readStageTotals(&bad, &fleet));
+}
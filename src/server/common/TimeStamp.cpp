@@ -27,8 +27,6 @@ namespace sail {
 
 
 namespace {
-  // Special value reserved for signalling undefined time.
-  const int64_t UndefinedTime = std::numeric_limits<int64_t>::max();
   const int TimeRes = 1000; // How precisely we store the time.
 }
 
@@ -40,13 +38,22 @@ namespace {
   bool inRange(int x, int a, int b) {
     return a <= x && x <= b;
   }
-}
 
-TimeStamp::TimeStamp() : _time(UndefinedTime) {
+  // Number of days from 1970-01-01 to the date in the proleptic
+  // Gregorian calendar, for any date that has a month in 1..12.
+  // Days past the end of a month count into the next month, like
+  // with timegm. See http://howardhinnant.github.io/date_algorithms.html
+  int64_t daysFromCivil(int64_t year, int month, int day) {
+    year -= (month <= 2);
+    int64_t era = (0 <= year? year : year - 399)/400;
+    int64_t yearOfEra = year - era*400;
+    int64_t dayOfYear = (153*(month + (2 < month? -3 : 9)) + 2)/5 + day - 1;
+    int64_t dayOfEra = yearOfEra*365 + yearOfEra/4 - yearOfEra/100 + dayOfYear;
+    return era*146097 + dayOfEra - 719468;
+  }
 }
 
-bool TimeStamp::defined() const {
-  return _time != UndefinedTime;
+TimeStamp::TimeStamp() : _time(undefinedTime()) {
 }
 
 
@@ -83,23 +90,17 @@ struct tm TimeStamp::makeGMTimeStruct() const {
 }
 
 TimeStamp::TimeStamp(int year_ad, int month_1to12, int day_1to31,
-    int hour, int minute, double seconds) : _time(UndefinedTime) {
+    int hour, int minute, double seconds) : _time(undefinedTime()) {
   if (!(inRange(month_1to12, 1, 12) && inRange(day_1to31, 1, 31)
       && inRange(hour, 0, 23) && inRange(minute, 0, 59) && (seconds >= 0))) {
     return;
   }
 
-  struct tm time;
-  memset(&time, 0, sizeof(tm));
-  time.tm_year = year_ad - 1900;
-  time.tm_mon = month_1to12 - 1;
-  time.tm_mday = day_1to31;
-  time.tm_hour = hour;
-  time.tm_min = minute;
-  time.tm_sec = int(seconds);
-
-  time_t t = timegm(&time);
-  _time = int64_t(t) * 1000 + int64_t((seconds - time.tm_sec) * 1000);
+  // Same as timegm, but without going through struct tm.
+  int wholeSeconds = int(seconds);
+  int64_t t = daysFromCivil(year_ad, month_1to12, day_1to31)*86400
+    + hour*3600 + minute*60 + wholeSeconds;
+  _time = t * 1000 + int64_t((seconds - wholeSeconds) * 1000);
 }
 
 TimeStamp TimeStamp::now() {
@@ -154,12 +155,177 @@ TimeStamp TimeStamp::parseFromRegex(const std::string& s)
   return UTC(year, month, day, hour, minutes, sec);
 }
 
+namespace {
+
+// Reads a number of 'minDigits' to 'maxDigits' digits.
+bool readDigits(const char **s, const char *end,
+                int minDigits, int maxDigits, int *dst) {
+  const char *p = *s;
+  int x = 0;
+  int n = 0;
+  while (n < maxDigits && p < end && '0' <= *p && *p <= '9') {
+    x = 10*x + (*p - '0');
+    p++;
+    n++;
+  }
+  if (n < minDigits) {
+    return false;
+  }
+  *s = p;
+  *dst = x;
+  return true;
+}
+
+bool readNumber(const char **s, const char *end,
+                int maxDigits, int lo, int hi, int *dst) {
+  return readDigits(s, end, 1, maxDigits, dst) && inRange(*dst, lo, hi);
+}
+
+// Does what strptime does for the formats of numeric dates and times
+// that our importers use, made of %Y %y %m %d %H %M %S %F %T %D and
+// literal characters other than blanks. Returns nullptr if it could
+// not parse 'src', also where strptime might, e.g. for other formats,
+// so strptime should be called then.
+const char *parseNumericTime(const char *src, const char *fmt,
+                             struct tm *dst) {
+  const char *end = src + strlen(src);
+  int x = 0;
+  for (const char *f = fmt; *f != 0; f++) {
+    if (*f != '%') {
+      if (isspace(static_cast<unsigned char>(*f))
+          || src == end || *src != *f) {
+        return nullptr;
+      }
+      src++;
+      continue;
+    }
+    f++;
+    switch (*f) {
+      case 'Y':
+        if (!readNumber(&src, end, 4, 0, 9999, &x)) {return nullptr;}
+        dst->tm_year = x - 1900;
+        break;
+      case 'y':
+        if (!readNumber(&src, end, 2, 0, 99, &x)) {return nullptr;}
+        dst->tm_year = (69 <= x? x : x + 100);
+        break;
+      case 'm':
+        if (!readNumber(&src, end, 2, 1, 12, &x)) {return nullptr;}
+        dst->tm_mon = x - 1;
+        break;
+      case 'd':
+        if (!readNumber(&src, end, 2, 1, 31, &x)) {return nullptr;}
+        dst->tm_mday = x;
+        break;
+      case 'H':
+        if (!readNumber(&src, end, 2, 0, 23, &x)) {return nullptr;}
+        dst->tm_hour = x;
+        break;
+      case 'M':
+        if (!readNumber(&src, end, 2, 0, 59, &x)) {return nullptr;}
+        dst->tm_min = x;
+        break;
+      case 'S':
+        if (!readNumber(&src, end, 2, 0, 61, &x)) {return nullptr;}
+        dst->tm_sec = x;
+        break;
+      case 'F':
+        src = parseNumericTime(src, "%Y-%m-%d", dst);
+        break;
+      case 'T':
+        src = parseNumericTime(src, "%H:%M:%S", dst);
+        break;
+      case 'D':
+        src = parseNumericTime(src, "%m/%d/%y", dst);
+        break;
+      default:
+        return nullptr;
+    };
+    if (src == nullptr) {
+      return nullptr;
+    }
+  }
+  return src;
+}
+
+// strptime, with a fast path for parseNumericTime.
+const char *parseTimeFields(const char *src, const char *fmt,
+                            struct tm *dst) {
+  struct tm fields = *dst;
+  const char *ret = parseNumericTime(src, fmt, &fields);
+  if (ret != nullptr) {
+    *dst = fields;
+    return ret;
+  }
+  // http://man7.org/linux/man-pages/man3/strptime.3.html
+  return strptime(src, fmt, dst);
+}
+
+}  // namespace
+
+TimeStamp TimeStamp::parseIso8601(const char *begin, const char *end) {
+  const char *s = begin;
+  auto skip = [&](const char *chars) {
+    if (s < end && *s != 0 && strchr(chars, *s) != nullptr) {
+      s++;
+      return true;
+    }
+    return false;
+  };
+
+  int year = 0, month = 0, day = 0;
+  if (!(readDigits(&s, end, 4, 4, &year) && skip("-/")
+        && readNumber(&s, end, 2, 1, 12, &month))) {
+    return TimeStamp();
+  }
+  bool dashes = (begin[4] == '-' && s < end && *s == '-');
+  if (!(skip("-/") && readNumber(&s, end, 2, 1, 31, &day))) {
+    return TimeStamp();
+  }
+  if (s == end) {
+    // Only a date, as parsed with "%F".
+    return dashes? TimeStamp(year, month, day, 0, 0, 0.0) : TimeStamp();
+  }
+
+  int hour = 0, minute = 0, wholeSeconds = 0;
+  if (!(skip("T ") && readNumber(&s, end, 2, 0, 23, &hour) && skip(":")
+        && readNumber(&s, end, 2, 0, 59, &minute) && skip(":")
+        && readNumber(&s, end, 2, 0, 60, &wholeSeconds))) {
+    return TimeStamp();
+  }
+
+  // The fraction is parsed to the same double as tryParseDouble
+  // would: A quotient of two exact integers is correctly rounded.
+  int64_t scaled = wholeSeconds;
+  double scale = 1.0;
+  if (skip(".")) {
+    int digits = 0;
+    for (; s < end && '0' <= *s && *s <= '9'; s++, digits++) {
+      if (12 <= digits) {
+        return TimeStamp();
+      }
+      scaled = 10*scaled + (*s - '0');
+      scale *= 10.0;
+    }
+    if (digits == 0) {
+      return TimeStamp();
+    }
+  }
+  skip("Z");
+  if (s != end) {
+    return TimeStamp();
+  }
+  return TimeStamp(year, month, day, hour, minute, double(scaled)/scale);
+}
+
+TimeStamp TimeStamp::parseIso8601(const std::string &x) {
+  return parseIso8601(x.data(), x.data() + x.size());
+}
+
 TimeStamp tryParseTime(const char *fmt, const std::string& s) {
   struct tm tm = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, nullptr};
 
-  char *ret = nullptr;
-  // http://man7.org/linux/man-pages/man3/strptime.3.html
-  ret = strptime(s.c_str(), fmt, &tm);
+  const char *ret = parseTimeFields(s.c_str(), fmt, &tm);
 
   if (ret == nullptr) {
     return TimeStamp();
@@ -173,7 +339,12 @@ TimeStamp tryParseTime(const char *fmt, const std::string& s) {
 #define TRY_PARSE_TIME(FMT, X) {auto res = tryParseTime(FMT, X); if (res.defined()) {return res;}}
 
 TimeStamp TimeStamp::parse(const std::string &x0) {
-  TimeStamp result = TimeStamp::parseFromRegex(x0);
+  TimeStamp result = TimeStamp::parseIso8601(x0);
+  if (result.defined()) {
+    return result;
+  }
+
+  result = TimeStamp::parseFromRegex(x0);
   if (result.defined()) {
     return result;
   }
@@ -197,8 +368,7 @@ Optional<struct tm> parseTimeToStruct(
   auto src = removeFractionalParts(src0);
   struct tm dst = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, nullptr};
 
-  // http://man7.org/linux/man-pages/man3/strptime.3.html
-  auto ret = strptime(src.c_str(), fmt, &dst);
+  auto ret = parseTimeFields(src.c_str(), fmt, &dst);
   return ret == nullptr? Optional<struct tm>() : dst;
 }
 
@@ -211,15 +381,19 @@ TimeStamp TimeStamp::parse(const char* fmt, const std::string &x) {
 }
 
 TimeStamp TimeStamp::makeUndefined() {
-  return TimeStamp(UndefinedTime);
+  return TimeStamp(undefinedTime());
 }
 
 
-bool TimeStamp::operator<(const TimeStamp &x) const {
-  assert(x.defined());
-  CHECK(defined());
-  CHECK(x.defined());
-  return _time < x._time;
+bool TimeStamp::checkedLess(const TimeStamp &a, const TimeStamp &b) {
+  CHECK(a.defined());
+  CHECK(b.defined());
+  return a._time < b._time;
+}
+
+Duration<double> TimeStamp::checkedDifference(
+    const TimeStamp &a, const TimeStamp &b) {
+  return Duration<double>::seconds(difSeconds(a, b));
 }
 
 double TimeStamp::difSeconds(const TimeStamp &a, const TimeStamp &b) {
@@ -255,10 +429,6 @@ TimeStamp TimeStamp::offset1970() {
 }
 
 
-Duration<double> operator-(const TimeStamp &a, const TimeStamp &b) {
-  return Duration<double>::seconds(TimeStamp::difSeconds(a, b));
-}
-
 TimeStamp operator-(const TimeStamp &a, const Duration<double> &b) {
   return a + (-b);
 }
@@ -267,7 +437,7 @@ TimeStamp operator+(const TimeStamp &a, const Duration<double> &b) {
   CHECK(a.defined());
   CHECK(!std::isnan(b.seconds()));
   int64_t res = a._time + int64_t(TimeRes*b.seconds());
-  CHECK(res != UndefinedTime);
+  CHECK(res != TimeStamp::undefinedTime());
   return TimeStamp(res);
 }
 
@@ -6,9 +6,11 @@
 #ifndef TIMESTAMP_H_
 #define TIMESTAMP_H_
 
+#include <cassert>
 #include <ctime>
 #include <cinttypes>
 #include <iosfwd>
+#include <limits>
 #include <server/common/Optional.h>
 #include <device/Arduino/libraries/PhysicalQuantity/PhysicalQuantity.h>
 
@@ -37,16 +39,32 @@ class TimeStamp {
   static TimeStamp parse(const std::string &x);
   static TimeStamp parse(const char* fmt, const std::string &x);
 
-
-  bool operator<(const TimeStamp &x) const;
+  // Parses "2024-08-27T14:05:12.731Z" and the variants accepted by
+  // parseFromRegex, and plain dates such as "2024-08-27", without
+  // allocating and independently of the locale. Returns an undefined
+  // timestamp if the text is not such a time.
+  static TimeStamp parseIso8601(const char *begin, const char *end);
+  static TimeStamp parseIso8601(const std::string &x);
+
+  // The comparisons and differences are plain integer operations, that
+  // only assert that the timestamps are defined. Use the checked
+  // versions where undefined timestamps should fail also in release.
+  bool operator<(const TimeStamp &x) const {
+    assert(defined() && x.defined());
+    return _time < x._time;
+  }
   bool operator>(const TimeStamp &x) const {return x < (*this);}
   bool operator<=(const TimeStamp &x) const {return !(x < (*this));}
   bool operator>=(const TimeStamp &x) const {return !((*this) < x);}
   TimeStamp& operator += (Duration<> delta) { return *this = *this + delta; }
 
+  static bool checkedLess(const TimeStamp &a, const TimeStamp &b);
+  static Duration<double> checkedDifference(
+      const TimeStamp &a, const TimeStamp &b);
+
   TimeStamp(); // Default contructor of an object with defined() returning false.
 
-  bool defined() const;
+  bool defined() const {return _time != undefinedTime();}
   bool undefined() const {return !defined();}
 
   std::string toString(const char *fmt) const;
@@ -74,7 +92,15 @@ class TimeStamp {
   TimeStamp(int64_t is);
   static double difSeconds(const TimeStamp &a, const TimeStamp &b);
 
-  friend Duration<double> operator-(const TimeStamp &a, const TimeStamp &b);
+  // Special value reserved for signalling undefined time.
+  static int64_t undefinedTime() {
+    return std::numeric_limits<int64_t>::max();
+  }
+
+  friend Duration<double> operator-(const TimeStamp &a, const TimeStamp &b) {
+    assert(a.defined() && b.defined());
+    return Duration<double>::seconds(0.001*double(a._time - b._time));
+  }
   friend TimeStamp operator+(const TimeStamp &a, const Duration<double> &b);
 
   int64_t _time;
@@ -96,3 +96,68 @@ TEST(TimeStampTest, ParseSubSec2)
   TimeStamp ts2 = TimeStamp::UTC(2024, 8, 27, 14, 5, 12.731);
   EXPECT_EQ(ts, ts2);
 }
+
+TEST(TimeStampTest, SameAsTimegm) {
+  for (int year = 1950; year < 2100; year += 7) {
+    for (int month = 1; month <= 12; month++) {
+      for (int day = 1; day <= 31; day += 3) {
+        struct tm tm = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, nullptr};
+        tm.tm_year = year - 1900;
+        tm.tm_mon = month - 1;
+        tm.tm_mday = day;
+        tm.tm_hour = 17;
+        tm.tm_min = 43;
+        tm.tm_sec = 9;
+        EXPECT_EQ(int64_t(timegm(&tm))*1000,
+                  TimeStamp::UTC(year, month, day, 17, 43, 9.0)
+                    .toMilliSecondsSince1970());
+      }
+    }
+  }
+}
+
+TEST(TimeStampTest, ParseIso8601) {
+  TimeStamp expected = TimeStamp::UTC(2024, 8, 27, 14, 5, 12.731);
+  EXPECT_EQ(expected, TimeStamp::parseIso8601("2024-08-27T14:05:12.731Z"));
+  EXPECT_EQ(expected, TimeStamp::parseIso8601("2024/08/27 14:05:12.731"));
+  EXPECT_EQ(TimeStamp::UTC(2024, 8, 7, 4, 5, 2),
+            TimeStamp::parseIso8601("2024-8-7T4:5:2"));
+  EXPECT_EQ(TimeStamp::date(2024, 8, 7),
+            TimeStamp::parseIso8601("2024-08-07"));
+  EXPECT_EQ(TimeStamp::parseFromRegex("2016-02-29 23:59:59.999999"),
+            TimeStamp::parseIso8601("2016-02-29 23:59:59.999999"));
+
+  EXPECT_TRUE(TimeStamp::parseIso8601("2024/08/07").undefined());
+  EXPECT_TRUE(TimeStamp::parseIso8601("2024-13-07T10:00:00").undefined());
+  EXPECT_TRUE(TimeStamp::parseIso8601("2024-08-07T10:00").undefined());
+  EXPECT_TRUE(TimeStamp::parseIso8601("2024-08-07T10:00:00.").undefined());
+  EXPECT_TRUE(TimeStamp::parseIso8601("2024-08-07T10:00:00+02").undefined());
+  EXPECT_TRUE(TimeStamp::parseIso8601("").undefined());
+
+  std::string field = "2024-08-27T14:05:12.731Z,12.3";
+  EXPECT_EQ(expected, TimeStamp::parseIso8601(
+      field.data(), field.data() + field.find(',')));
+}
+
+TEST(TimeStampTest, ParseFormats) {
+  EXPECT_EQ(TimeStamp::date(2018, 3, 9), TimeStamp::parse("%d/%m/%y", "09/03/18"));
+  EXPECT_EQ(TimeStamp::date(1998, 3, 9), TimeStamp::parse("%d/%m/%y", "9/3/98"));
+  EXPECT_EQ(TimeStamp::date(2018, 3, 9), TimeStamp::parse("%Y/%m/%d", "2018/03/09"));
+  EXPECT_EQ(TimeStamp::UTC(2018, 3, 9, 8, 2, 31),
+            TimeStamp::parse("%FT%T", "2018-03-09T08:02:31"));
+  EXPECT_EQ(TimeStamp::UTC(2018, 3, 9, 8, 2, 31),
+            TimeStamp::parse("03/09/18 08:02:31"));
+  EXPECT_TRUE(TimeStamp::parse("%d/%m/%y", "31/13/18").undefined());
+  EXPECT_EQ(8.0_h + 2.0_minutes + 31.0_s,
+            parseTimeOfDay("%T", "08:02:31").get());
+  EXPECT_FALSE(parseTimeOfDay("%T", "08:02").defined());
+}
+
+TEST(TimeStampTest, Checked) {
+  TimeStamp a = TimeStamp::UTC(1986, 5, 14, 13, 5, 2.0);
+  TimeStamp b = TimeStamp::UTC(1986, 5, 14, 13, 5, 2.25);
+  EXPECT_TRUE(TimeStamp::checkedLess(a, b));
+  EXPECT_FALSE(TimeStamp::checkedLess(b, a));
+  EXPECT_NEAR(TimeStamp::checkedDifference(b, a).seconds(), 0.25, 1.0e-9);
+  EXPECT_ANY_THROW(TimeStamp::checkedLess(a, TimeStamp()));
+}
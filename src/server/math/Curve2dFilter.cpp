@@ -73,97 +73,92 @@ Span<TimeStamp> getReliableSpan(
 
 
 
-Cost::Ptr toCommonCost(const std::shared_ptr<DataCost>& x) {
-  return std::static_pointer_cast<Cost>(x);
-}
-
-Array<Cost::Ptr> toCommonCosts(const Array<std::shared_ptr<DataCost>>& src) {
-  return transduce(src, trMap(&toCommonCost), IntoArray<Cost::Ptr>());
-}
-
-Array<std::shared_ptr<DataCost>> makePositionCosts(
+std::shared_ptr<DataCosts> makePositionCosts(
     const TimeMapper& mapper,
     const Array<TimedValue<Vec2<Length<double>>>>& positions,
     const Settings& settings,
     const BasisData& b) {
-  ArrayBuilder<std::shared_ptr<DataCost>> costs(positions.size());
-
   ExponentialWeighting weights(settings.iterations,
       settings.initialWeight, settings.finalWeight);
+  auto costs = std::make_shared<DataCosts>(
+      weights, settings.inlierThreshold.meters());
+  costs->reserve(positions.size());
 
   auto span = b.basis.raw().dataSpan();
-  for (auto p: positions) {
+  for (const auto& p: positions) {
     double t = mapper.toRealIndex(p.time);
     if (span.contains(t)) {
       CoefsWithOffset<Basis> coefs(b.basis.build(t));
-      auto x = std::make_shared<DataCost>(
-                coefs.offset, coefs.coefs,
-                mat1x2(p.value[0].meters(), p.value[1].meters()),
-                weights, settings.inlierThreshold.meters());
-      x->time = p.time;
-      x->position = p.value;
-      costs.add(x);
+      costs->add(coefs.offset, coefs.coefs,
+          mat1x2(p.value[0].meters(), p.value[1].meters()));
     }
   }
-  return costs.get();
+  return costs;
 }
 
-
-Array<std::shared_ptr<DataCost>> makeMotionCosts(
+template <typename Motion>
+std::shared_ptr<DataCosts> makeMotionCosts(
     const TimeMapper& mapper,
-    const Array<TimedValue<Vec2<Velocity<double>>>>& motions,
+    const Array<TimedValue<Motion>>& motions,
     const Settings& settings,
     const BasisData& b) {
-  ArrayBuilder<std::shared_ptr<DataCost>> costs(motions.size());
-
   ExponentialWeighting weights(settings.iterations,
       settings.initialWeight, settings.finalWeight);
+  auto costs = std::make_shared<DataCosts>(
+      weights, settings.inlierThreshold.meters(),
+      settings.motionWeight);
+  costs->reserve(motions.size());
+
   auto span = b.basis.raw().dataSpan();
   double period = mapper.period().seconds();
-  for (auto m: motions) {
+  for (const auto& m: motions) {
     double t = mapper.toRealIndex(m.time);
     if (span.contains(t)) {
       CoefsWithOffset<Basis> coefs(b.speed.build(t));
-      costs.add(std::make_shared<DataCost>(
+      costs->add(
           coefs.offset, coefs.coefs, // Don't multipy by period here...
           period*mat1x2( // ...but multiply by period here.
               m.value[0].metersPerSecond(),
-              m.value[1].metersPerSecond()),
-          weights,
-          settings.inlierThreshold.meters(),
-          settings.motionWeight));
+              m.value[1].metersPerSecond()));
     }
   }
-  return costs.get();
+  return costs;
 }
 
-
-
-Array<Cost::Ptr> makeRegCosts(
+Cost::Ptr makeRegCosts(
     double weight,
     const TimeMapper& mapper,
     const Settings& settings,
     const BasisData& b) {
-  ArrayBuilder<Cost::Ptr> costs(mapper.sampleCount());
+  auto costs = std::make_shared<RegCosts>();
+  costs->reserve(mapper.sampleCount());
   for (int i = 0; i < mapper.sampleCount(); i++) {
     CoefsWithOffset<Basis> coefs(b.acceleration.build(i));
-    costs.add(Cost::Ptr(new StaticCost<1, BasisData::dim, 2>(
-        coefs.offset, weight*coefs.coefs, mat1x2(0, 0))));
+    costs->add(coefs.offset, weight*coefs.coefs, mat1x2(0, 0));
   }
-  return costs.get();
+  return costs;
 }
 
-
-
+// The position costs were built from the positions inside
+// the span of the basis, in the same order.
 Array<TimedPosition> getInlierPositions(
-    const Array<std::shared_ptr<DataCost>>& positionCosts,
+    const TimeMapper& mapper,
+    const BasisData& b,
+    const Array<TimedPosition>& positions,
+    const DataCosts& positionCosts,
     const MDArray2d& X) {
   ArrayBuilder<TimedPosition> dst(positionCosts.size());
-  for (const auto& c: positionCosts) {
-    if (c->isInlier(X)) {
-      dst.add(TimedPosition(c->time, c->position));
+  auto span = b.basis.raw().dataSpan();
+  int costIndex = 0;
+  for (const auto& p: positions) {
+    if (span.contains(mapper.toRealIndex(p.time))) {
+      if (positionCosts.isInlier(costIndex, X)) {
+        dst.add(p);
+      }
+      costIndex++;
     }
   }
+  CHECK(costIndex == positionCosts.size());
   return dst.get();
 }
 
@@ -178,10 +173,11 @@ Span<int> mapToIndexSpan(const TimeMapper& m,
       : Span<int>();
 }
 
-Results optimize(
+template <typename Motion>
+Results optimizeSub(
   const TimeMapper& mapper,
   const Array<TimedValue<Vec2<Length<double>>>>& positions,
-  const Array<TimedValue<Vec2<Velocity<double>>>>& motions,
+  const Array<TimedValue<Motion>>& motions,
   const Settings& settings,
   const MDArray2d& Xinit) {
 
@@ -197,39 +193,32 @@ Results optimize(
   auto motionCosts = makeMotionCosts(
       mapper, motions, settings, b);
 
-  auto dataCosts = transduce(
-      Array<Array<Cost::Ptr>>({
-        toCommonCosts(positionCosts),
-        toCommonCosts(motionCosts)
-      }), trCat(), IntoArray<Cost::Ptr>());
-
   BandedIrls::Results solution;
   Array<TimedValue<Vec2<Length<double>>>> inlierPositions;
   BandedIrls::Settings birls;
   for (auto w: settings.regWeights) {
-    auto regCosts = makeRegCosts(w, mapper, settings, b);
-    auto costs = transduce(Array<Array<Cost::Ptr>>{
-      dataCosts, regCosts
-    }, trCat(), IntoArray<Cost::Ptr>());
+    Array<Cost::Ptr> costs{
+      positionCosts, motionCosts,
+      makeRegCosts(w, mapper, settings, b)
+    };
     solution = solve(birls, costs, solution.X);
 
     if (!solution.OK()) {
       LOG(ERROR) << "Curve filter failed";
       return Results();
     }
-    inlierPositions = getInlierPositions(positionCosts, solution.X);
+    inlierPositions = getInlierPositions(
+        mapper, b, positions, *positionCosts, solution.X);
     if (inlierPositions.size() < settings.minimumInlierCount) {
       LOG(ERROR) << "Not enough inlier positions";
       return Results();
     }
   }
   if (settings.postReg.defined()) {
-    solution = BandedIrls::constantSolve(birls,
-        transduce(Array<Array<Cost::Ptr>>{
-          dataCosts,
-          makeRegCosts(settings.postReg.get(), mapper,
-              settings, b)
-    }, trCat(), IntoArray<Cost::Ptr>()));
+    solution = BandedIrls::constantSolve(birls, Array<Cost::Ptr>{
+      positionCosts, motionCosts,
+      makeRegCosts(settings.postReg.get(), mapper, settings, b)
+    });
     if (!solution.OK()) {
       LOG(ERROR) << "Post reg failed";
       return Results();
@@ -245,7 +234,7 @@ Results optimize(
 
   return Results{
     solution,
-    positionCosts.size(),
+    positionCosts->size(),
     inlierPositions,
     mapper,
     b, solution.X,
@@ -253,6 +242,24 @@ Results optimize(
   };
 }
 
+Results optimize(
+  const TimeMapper& mapper,
+  const Array<TimedValue<Vec2<Length<double>>>>& positions,
+  const Array<TimedValue<Vec2<Velocity<double>>>>& motions,
+  const Settings& settings,
+  const MDArray2d& Xinit) {
+  return optimizeSub(mapper, positions, motions, settings, Xinit);
+}
+
+Results optimize(
+  const TimeMapper& mapper,
+  const Array<TimedValue<Vec2<Length<double>>>>& positions,
+  const Array<TimedValue<HorizontalMotion<double>>>& motions,
+  const Settings& settings,
+  const MDArray2d& Xinit) {
+  return optimizeSub(mapper, positions, motions, settings, Xinit);
+}
+
 Results::Curve Results::curve() const {
   return OK()? Results::Curve(
           timeMapper,
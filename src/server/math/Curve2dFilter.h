@@ -40,14 +40,10 @@ struct BasisData {
 template <typename T>
 using Vec2 = sail::Vectorize<T, 2>;
 
-typedef BandedIrls::RobustCost<1, BasisData::dim, 2> DataCostBase;
-
-class DataCost : public DataCostBase {
-public:
-  TimeStamp time;
-  Vec2<Length<double>> position;
-  using DataCostBase::DataCostBase;
-};
+// All position (or motion) observations of a problem are stored
+// in a single cost object, with the coefficients in flat arrays.
+typedef BandedIrls::RobustCostArray<1, BasisData::dim, 2> DataCosts;
+typedef BandedIrls::StaticCostArray<1, BasisData::dim, 2> RegCosts;
 
 struct Settings {
   // Parameters related to the optimization algorithm
@@ -97,6 +93,15 @@ Results optimize(
   const Settings& options,
   const MDArray2d& Xinit = MDArray2d());
 
+// Same as above, but reading the motions as they come from the GPS,
+// so that the caller does not need to convert them first.
+Results optimize(
+  const TimeMapper& mapper,
+  const Array<TimedValue<Vec2<Length<double>>>>& positions,
+  const Array<TimedValue<HorizontalMotion<double>>>& motions,
+  const Settings& options,
+  const MDArray2d& Xinit = MDArray2d());
+
 }
 } /* namespace sail */
 
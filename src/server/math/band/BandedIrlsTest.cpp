@@ -106,3 +106,35 @@ TEST(BandedIrlsTest, LineFit) {
     EXPECT_NEAR(solution.X(i, 0), gt(i), 0.2);
   }
 }
+
+TEST(BandedIrlsTest, LineFitWithCostArrays) {
+  Settings options;
+  options.iterations = 30;
+  ExponentialWeighting weights(options.iterations, 0.1, 10000.0);
+
+  int samples = 8;
+
+  Eigen::Matrix<double, 1, 3> coefs;
+  coefs << 1, -2, 1;
+
+  auto reg = std::make_shared<StaticCostArray<1, 3, 1>>();
+  for (int i = 0; i < samples-2; i++) {
+    reg->add(i, coefs, mat1x1(0.0));
+  }
+
+  auto data = std::make_shared<RobustCostArray<1, 1, 1>>(weights, 1.0);
+  LineKM gt(0, samples-1, 3, 9);
+  for (int i = 0; i < samples; i++) {
+    auto y = i == 4? 100 : gt(i) + 0.1*sin(30*sin(34.4*i));
+    data->add(i, mat1x1(1.0), mat1x1(y));
+  }
+  EXPECT_EQ(data->size(), samples);
+  EXPECT_EQ(data->minimumProblemDimension(), samples);
+
+  auto solution = solve(options, {reg, data});
+
+  for (int i = 0; i < samples; i++) {
+    EXPECT_NEAR(solution.X(i, 0), gt(i), 0.2);
+    EXPECT_EQ(data->isInlier(i, solution.X), i != 4);
+  }
+}
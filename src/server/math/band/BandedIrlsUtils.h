@@ -11,6 +11,7 @@
 #include <server/math/band/BandedIrls.h>
 #include <server/math/OutlierRejector.h>
 #include <server/common/LineKM.h>
+#include <vector>
 
 namespace sail {
 namespace BandedIrls {
@@ -133,6 +134,157 @@ private:
   OutlierRejector _rejector;
 };
 
+// The classes below hold many cost terms of the same shape in flat
+// arrays, so that a problem with one term per observation does not
+// need one heap-allocated Cost object per observation.
+template <int rows, int cols, int rhs=1>
+class StaticCostArray : public Cost {
+public:
+  typedef Eigen::Matrix<double, rows, cols> MatrixA;
+  typedef Eigen::Matrix<double, rows, rhs> MatrixB;
+
+  void reserve(int n) {
+    _at.reserve(n);
+    _A.reserve(n*rows*cols);
+    _B.reserve(n*rows*rhs);
+  }
+
+  void add(int at, const MatrixA& A, const MatrixB& B) {
+    _at.push_back(at);
+    _A.insert(_A.end(), A.data(), A.data() + rows*cols);
+    _B.insert(_B.end(), B.data(), B.data() + rows*rhs);
+    _dim = std::max(_dim, at + cols);
+  }
+
+  int size() const {return _at.size();}
+
+  void initialize(BandProblem* dst) override {
+    constantApply(dst);
+  }
+
+  void constantApply(BandProblem* dst) const override {
+    for (int i = 0; i < size(); i++) {
+      dst->addNormalEquations<rows, cols, rhs>(
+          _at[i], MatrixA(A(i)), MatrixB(B(i)));
+    }
+  }
+
+  int minimumProblemDimension() const override {return _dim;}
+  int maximumDiagonalWidth() const override {return cols;}
+  int rightHandSideDimension() const override {return rhs;}
+private:
+  Eigen::Map<const MatrixA> A(int i) const {
+    return Eigen::Map<const MatrixA>(_A.data() + i*rows*cols);
+  }
+
+  Eigen::Map<const MatrixB> B(int i) const {
+    return Eigen::Map<const MatrixB>(_B.data() + i*rows*rhs);
+  }
+
+  int _dim = 0;
+  std::vector<int> _at;
+  std::vector<double> _A, _B;
+};
+
+// Same as an array of RobustCost sharing weighting, threshold
+// and constant weight, but with one OutlierRejector per term.
+template <int rows, int cols, int rhs=1>
+class RobustCostArray : public Cost {
+public:
+  typedef Eigen::Matrix<double, rows, cols> MatrixA;
+  typedef Eigen::Matrix<double, rows, rhs> MatrixB;
+
+  RobustCostArray(
+      const ExponentialWeighting& weighting,
+      double inlierThreshold,
+      double constantWeight = 1.0) :
+        _weighting(weighting), _constantWeight(constantWeight) {
+    OutlierRejector::Settings s;
+    s.initialAlpha = weighting.evaluate(0);
+    s.initialBeta = s.initialAlpha;
+    s.sigma = inlierThreshold;
+    _initialRejector = OutlierRejector(s);
+  }
+
+  void reserve(int n) {
+    _at.reserve(n);
+    _A.reserve(n*rows*cols);
+    _B.reserve(n*rows*rhs);
+    _rejectors.reserve(n);
+  }
+
+  void add(int at, const MatrixA& A, const MatrixB& B) {
+    _at.push_back(at);
+    _A.insert(_A.end(), A.data(), A.data() + rows*cols);
+    _B.insert(_B.end(), B.data(), B.data() + rows*rhs);
+    _rejectors.push_back(_initialRejector);
+    _dim = std::max(_dim, at + cols);
+  }
+
+  int size() const {return _at.size();}
+
+  bool isInlier(int i, const MDArray2d& currentSolution) const {
+    return computeError(i, currentSolution) < _rejectors[i].sigma();
+  }
+
+  void initialize(BandProblem* dst) override {
+    constantApply(dst);
+  }
+
+  void constantApply(BandProblem* dst) const override {
+    for (int i = 0; i < size(); i++) {
+      addWithWeight(i, _rejectors[i].computeWeight(), dst);
+    }
+  }
+
+  void apply(
+      int iteration,
+      const MDArray2d& currentSolution,
+      BandProblem* dst) override {
+    double weight = _weighting.evaluate(iteration);
+    for (int i = 0; i < size(); i++) {
+      _rejectors[i].update(weight, computeError(i, currentSolution));
+      addWithWeight(i, _rejectors[i].computeWeight(), dst);
+    }
+  }
+
+  int minimumProblemDimension() const override {return _dim;}
+  int maximumDiagonalWidth() const override {return cols;}
+  int rightHandSideDimension() const override {return rhs;}
+private:
+  Eigen::Map<const MatrixA> A(int i) const {
+    return Eigen::Map<const MatrixA>(_A.data() + i*rows*cols);
+  }
+
+  Eigen::Map<const MatrixB> B(int i) const {
+    return Eigen::Map<const MatrixB>(_B.data() + i*rows*rhs);
+  }
+
+  void addWithWeight(int i, double w0, BandProblem *dst) const {
+    double w = w0*_constantWeight;
+    dst->addNormalEquations<rows, cols, rhs>(
+        _at[i], MatrixA(w*A(i)), MatrixB(w*B(i)));
+  }
+
+  double computeError(int i, const MDArray2d& X) const {
+    double sum = 0.0;
+    for (int j = 0; j < rhs; j++) {
+      sum += (A(i)*Eigen::Map<Eigen::Matrix<
+          double, cols, 1>>(X.getPtrAt(_at[i], j))
+          - B(i).template block<rows, 1>(0, j)).squaredNorm();
+    }
+    return sqrt(sum);
+  }
+
+  int _dim = 0;
+  ExponentialWeighting _weighting;
+  double _constantWeight;
+  OutlierRejector _initialRejector;
+  std::vector<int> _at;
+  std::vector<double> _A, _B;
+  std::vector<OutlierRejector> _rejectors;
+};
+
 }
 } /* namespace sail */
 
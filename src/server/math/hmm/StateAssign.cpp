@@ -7,31 +7,109 @@
 
 #include "StateAssign.h"
 #include <server/common/ArrayIO.h>
+#include <server/common/ArrayArena.h>
 #include <server/common/ArrayBuilder.h>
+#include <server/common/StageProfiler.h>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
 #include <limits>
+#include <thread>
 #include <server/common/logging.h>
 #include <server/common/string.h>
 
 namespace sail {
 
 Arrayi StateAssign::solve() {
-  MDArray2d costs;
-  MDArray2i ptrs;
-  accumulateCosts(&costs, &ptrs);
-  return unwind(costs, ptrs);
+  return unwind(std::vector<Trellis>{accumulateCosts(0, getLength())}, Arrayi{0});
+}
+
+Arrayi StateAssign::solveInChunks(Arrayi cuts, int overlap, int threadCount) {
+  int length = getLength();
+  ArrayBuilder<int> firstsBuilder;
+  firstsBuilder.add(0);
+  for (auto cut : cuts) {
+    if (firstsBuilder.last() < cut && cut < length) {
+      firstsBuilder.add(cut);
+    }
+  }
+  Arrayi firsts = firstsBuilder.get();
+  int chunkCount = firsts.size();
+  if (chunkCount == 1 || threadCount <= 1) {
+    return solve();
+  }
+
+  std::vector<Trellis> chunks(chunkCount);
+  auto chunkEnd = [&](int i) {
+    return (i + 1 < chunkCount? firsts[i + 1] : length);
+  };
+  auto chunkBegin = [&](int i) {
+    return (i == 0? 0 : std::max(firsts[i - 1], firsts[i] - overlap));
+  };
+  {
+    std::atomic<int> next(0);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < std::min(threadCount, chunkCount); t++) {
+      threads.push_back(std::thread([&]() {
+        for (int i = next++; i < chunkCount; i = next++) {
+          ScopedStage stage("Accumulate state costs of chunk");
+          chunks[i] = accumulateCosts(chunkBegin(i), chunkEnd(i));
+        }
+      }));
+    }
+    for (auto &t : threads) {
+      t.join();
+    }
+  }
+
+  // Every chunk must agree with the previous one, which is exact, before
+  // its first time index. Because the costs are normalized, agreeing means
+  // being equal, and from there on the chunk is computed exactly as the
+  // previous one would have been.
+  for (int i = 1; i < chunkCount; i++) {
+    const Trellis &prev = chunks[i - 1];
+    Trellis &chunk = chunks[i];
+    bool coupled = false;
+    for (int time = chunk.begin; time < firsts[i] && !coupled; time++) {
+      int n = chunk.stepEnd(time) - chunk.stepBegin(time);
+      coupled = n == prev.stepEnd(time) - prev.stepBegin(time)
+        && std::equal(chunk.states.begin() + chunk.stepBegin(time),
+                      chunk.states.begin() + chunk.stepEnd(time),
+                      prev.states.begin() + prev.stepBegin(time))
+        && std::equal(chunk.costs.begin() + chunk.stepBegin(time),
+                      chunk.costs.begin() + chunk.stepEnd(time),
+                      prev.costs.begin() + prev.stepBegin(time));
+    }
+    if (!coupled) {
+      chunk = accumulateCosts(firsts[i] - 1, chunkEnd(i), &prev);
+    }
+  }
+  return unwind(chunks, firsts);
 }
 
 MDArray2d StateAssign::makeCostMatrix() {
-  MDArray2d costs;
-  MDArray2i ptrs;
-  accumulateCosts(&costs, &ptrs);
+  Trellis trellis = accumulateCosts(0, getLength());
+  MDArray2d costs(getStateCount(), getLength());
+  costs.setAll(std::numeric_limits<double>::infinity());
+  for (int time = 0; time < getLength(); time++) {
+    for (int k = trellis.stepBegin(time); k < trellis.stepEnd(time); k++) {
+      costs(trellis.states[k], time) = trellis.costs[k];
+    }
+  }
   return costs;
 }
 
 MDArray2i StateAssign::makeRefMatrix() {
-  MDArray2d costs;
-  MDArray2i ptrs;
-  accumulateCosts(&costs, &ptrs);
+  Trellis trellis = accumulateCosts(0, getLength());
+  MDArray2i ptrs(getStateCount(), getLength());
+  ptrs.setAll(-1);
+  for (int time = 1; time < getLength(); time++) {
+    int prev = trellis.stepBegin(time - 1);
+    for (int k = trellis.stepBegin(time); k < trellis.stepEnd(time); k++) {
+      int ptr = trellis.ptrs[k];
+      ptrs(trellis.states[k], time) = (ptr == -1? -1 : trellis.states[prev + ptr]);
+    }
+  }
   return ptrs;
 }
 
@@ -51,91 +129,163 @@ Arrayi StateAssign::listStateInds() {
   return makeRange(getStateCount());
 }
 
-void StateAssign::accumulateCosts(MDArray2d *costsOut, MDArray2i *ptrsOut) {
-  int length = getLength();
-  int stateCount = getStateCount();
-  MDArray2d costs(stateCount, length);
-  MDArray2i ptrs(stateCount, length);
-  costs.setAll(0.0);
-  ptrs.setAll(-1);
-  for (int state = 0; state < stateCount; state++) {
-    costs(state, 0) = getStateCost(state, 0);
-  }
-
-  for (int time = 1; time < length; time++) { // For every time index >= 1
-    for (int state = 0; state < stateCount; state++) { // For every state at that time index
-      int bestPredIndex = -1;
-      Arrayi preds = getPrecedingStates(state, time);
-      costs(state, time) = getStateCost(state, time) + calcBestPred(costs, preds, state, time-1, &bestPredIndex);
-      if (bestPredIndex == -1) {
-        costs(state, time) = std::numeric_limits<double>::infinity();
+namespace {
+  template <typename Trellis>
+  void normalizeStep(Trellis *trellis, int time) {
+    auto begin = trellis->costs.begin() + trellis->stepBegin(time);
+    auto end = trellis->costs.begin() + trellis->stepEnd(time);
+    if (begin == end) {
+      return;
+    }
+    double minCost = *std::min_element(begin, end);
+    if (std::isfinite(minCost)) {
+      for (auto c = begin; c != end; c++) {
+        *c -= minCost;
       }
-      ptrs(state, time) = bestPredIndex;
     }
   }
-
-  // Output the results
-  *costsOut = costs;
-  *ptrsOut = ptrs;
 }
 
-double StateAssign::calcBestPred(MDArray2d costs, Arrayi preds, int toState, int fromTime,
-                                 int *bestPredIndexOut) {
-  if (preds.empty()) {
-    *bestPredIndexOut = -1;
-    return 1.0e9;
+StateAssign::Trellis StateAssign::accumulateCosts(int begin, int end,
+    const Trellis *init) {
+  // The arrays of allowed and preceding states returned for every
+  // time index are short-lived, so they are taken from an arena.
+  ScopedArrayArena arena;
+  int stateCount = getStateCount();
+  Trellis trellis;
+  trellis.begin = begin;
+  trellis.offsets = Arrayi::fill(std::max(0, end - begin) + 1, 0);
+  if (end <= begin) {
+    return trellis;
+  }
+
+  if (init != nullptr) {
+    for (int k = init->stepBegin(begin); k < init->stepEnd(begin); k++) {
+      trellis.states.push_back(init->states[k]);
+      trellis.costs.push_back(init->costs[k]);
+      trellis.ptrs.push_back(-1);
+    }
   } else {
-    int bestIndex = preds[0];
-    double bestCost = std::numeric_limits<double>::infinity();
-    int count = preds.size();
-    for (int state = 0; state < count; state++) {
-      int stateIndex = preds[state];
-      double cost = costs(stateIndex, fromTime) + getTransitionCost(stateIndex, toState, fromTime);
-      if (cost < bestCost) {
-        bestCost = cost;
-        bestIndex = stateIndex;
+    for (auto state : getAllowedStates(begin)) {
+      trellis.states.push_back(state);
+      trellis.costs.push_back(getStateCost(state, begin));
+      trellis.ptrs.push_back(-1);
+    }
+    if (std::none_of(trellis.costs.begin(), trellis.costs.end(),
+                     [](double c) {return std::isfinite(c);})) {
+      // As for the following time indices below.
+      trellis.states.clear();
+      trellis.costs.clear();
+      trellis.ptrs.clear();
+      for (auto state : listStateInds()) {
+        trellis.states.push_back(state);
+        trellis.costs.push_back(getStateCost(state, begin));
+        trellis.ptrs.push_back(-1);
       }
     }
-    *bestPredIndexOut = bestIndex;
-    return bestCost;
   }
-}
+  trellis.offsets[1] = trellis.states.size();
+  normalizeStep(&trellis, begin);
 
-namespace {
-int getLastBestState(MDArray2d costs) {
-  int last = costs.cols()-1;
-  int count = costs.rows();
-  int bestIndex = 0;
-  double bestCost = costs(0, last);
-  for (int state = 1; state < count; state++) {
-    double cost = costs(state, last);
-    if (cost < bestCost) {
-      bestCost = cost; // <-- THE ABSENCE OF THIS LINE IS A SERIOUS BUG!!!
-      bestIndex = state;
-    }
-  }
-  return bestIndex;
-}
+  // The index of every state allowed at the previous time
+  // among the elements of that time, or -1.
+  Arrayi slots = Arrayi::fill(stateCount, -1);
 
+  for (int time = begin + 1; time < end; time++) { // For every following time index
+    int prevBegin = trellis.stepBegin(time - 1);
+    int prevEnd = trellis.stepEnd(time - 1);
+    for (int k = prevBegin; k < prevEnd; k++) {
+      slots[trellis.states[k]] = k - prevBegin;
+    }
+
+    // Returns false if none of 'states' has a finite cost.
+    auto addStates = [&](const Arrayi &states, bool constrained) {
+      bool finite = false;
+      for (auto state : states) {
+        int bestPredIndex = -1;
+        double bestCost = std::numeric_limits<double>::infinity();
+        Arrayi preds = constrained? getPrecedingStates(state, time)
+          : getUnconstrainedPrecedingStates(state, time);
+        for (auto pred : preds) {
+          int slot = slots[pred];
+          if (slot == -1) {
+            continue;
+          }
+          double c = trellis.costs[prevBegin + slot] + getTransitionCost(pred, state, time - 1);
+          if (bestPredIndex == -1 || c < bestCost) {
+            bestCost = c;
+            bestPredIndex = slot;
+          }
+        }
+        double cost = bestPredIndex == -1?
+            std::numeric_limits<double>::infinity()
+            : getStateCost(state, time) + bestCost;
+        finite = finite || std::isfinite(cost);
+        trellis.states.push_back(state);
+        trellis.costs.push_back(cost);
+        trellis.ptrs.push_back(bestPredIndex);
+      }
+      return finite;
+    };
+
+    if (!addStates(getAllowedStates(time), true)) {
+      // The constraints leave no path to this time index.
+      trellis.states.resize(prevEnd);
+      trellis.costs.resize(prevEnd);
+      trellis.ptrs.resize(prevEnd);
+      addStates(listStateInds(), false);
+    }
+    trellis.offsets[time - begin + 1] = trellis.states.size();
+    normalizeStep(&trellis, time);
+
+    for (int k = prevBegin; k < prevEnd; k++) {
+      slots[trellis.states[k]] = -1;
+    }
+  }
+  return trellis;
 }
 
-Arrayi StateAssign::unwind(MDArray2d costs, MDArray2i ptrs) {
-  int stateCount = getStateCount();
+Arrayi StateAssign::unwind(const std::vector<Trellis> &chunks, Arrayi firsts) {
   int length = getLength();
-  assert(costs.isMatrix(stateCount, length));
-  assert(ptrs.isMatrix(stateCount, length));
-
   Arrayi states(length);
   states.setTo(-1);
+  if (length == 0) {
+    return states;
+  }
   int last = length - 1;
-  states[last] = getLastBestState(costs);
+  int c = chunks.size() - 1;
+  const Trellis *trellis = &chunks[c];
+
+  // The best allowed state at the last time.
+  int begin = trellis->stepBegin(last);
+  int end = trellis->stepEnd(last);
+  if (begin == end) {
+    LOG(FATAL) << "No state is allowed at time " << last;
+  }
+  int best = begin;
+  for (int k = begin + 1; k < end; k++) {
+    if (trellis->costs[k] < trellis->costs[best]) {
+      best = k;
+    }
+  }
 
-  for (int time = last-1; time >= 0; time--) {
-    int next = time + 1;
-    int nextState = states[next];
-    int index = ptrs(nextState, next);
-    assert(index != -1);
-    states[time] = index;
+  states[last] = trellis->states[best];
+  for (int time = last; time > 0; time--) {
+    int ptr = trellis->ptrs[best];
+    if (ptr == -1) {
+      LOG(FATAL) << "No allowed predecessor of state "
+        << states[time] << " at time " << time;
+    }
+    best = trellis->stepBegin(time - 1) + ptr;
+    int state = trellis->states[best];
+    states[time - 1] = state;
+    if (time - 1 < firsts[c]) {
+      // Continue with the previous chunk, from the same state.
+      trellis = &chunks[--c];
+      auto from = trellis->states.begin() + trellis->stepBegin(time - 1);
+      auto to = trellis->states.begin() + trellis->stepEnd(time - 1);
+      best = std::lower_bound(from, to, state) - trellis->states.begin();
+    }
   }
   return states;
 }
@@ -143,15 +293,21 @@ Arrayi StateAssign::unwind(MDArray2d costs, MDArray2i ptrs) {
 Array<Arrayi> StateAssign::makePredecessorsPerState(MDArray2b con) {
   int n = con.rows();
   assert(con.isSquare());
-  Array<Arrayi> preds(n);
+  Arrayi offsets(n + 1);
+  ArrayBuilder<int> all;
   for (int j = 0; j < n; j++) {
-    ArrayBuilder<int> builder(n);
+    offsets[j] = all.size();
     for (int i = 0; i < n; i++) {
       if (con(i, j)) {
-        builder.add(i);
+        all.add(i);
       }
     }
-    preds[j] = builder.get();
+  }
+  offsets[n] = all.size();
+  Arrayi flat = all.get();
+  Array<Arrayi> preds(n);
+  for (int j = 0; j < n; j++) {
+    preds[j] = flat.slice(offsets[j], offsets[j + 1]);
   }
   return preds;
 }
@@ -10,6 +10,7 @@
 
 #include <server/common/Array.h>
 #include <server/common/MDArray.h>
+#include <vector>
 
 namespace sail {
 
@@ -43,16 +44,47 @@ class StateAssign {
   // of a state 'stateIndex' at a time 'timeIndex'.
   virtual Arrayi getPrecedingStates(int stateIndex, int timeIndex) = 0;
 
+  // This method returns the sorted indices of the states that can be assigned
+  // at time 'timeIndex'. The other states are skipped entirely by solve(),
+  // so its time and memory scale with the number of allowed states.
+  // By default, all states are allowed.
+  virtual Arrayi getAllowedStates(int timeIndex) {
+    return listStateInds();
+  }
+
+  // The predecessors of a state without the constraints that
+  // getPrecedingStates and getAllowedStates may add. Where those leave no
+  // state with a finite cost at a time index, solve() decodes that time
+  // index again with all states and these predecessors, so that
+  // contradictory constraints still give an assignment.
+  // By default, the same as getPrecedingStates.
+  virtual Arrayi getUnconstrainedPrecedingStates(int stateIndex, int timeIndex) {
+    return getPrecedingStates(stateIndex, timeIndex);
+  }
+
   // Computes an optimal state assignment with this
   // for the problem specified by this object.
   Arrayi solve();
 
+  // Same result as solve(), but the sequence is split at the time indices 'cuts'
+  // into chunks that are decoded in parallel with 'threadCount' threads. Every
+  // chunk but the first one also decodes the 'overlap' time steps before it:
+  // from the time where its relative costs are equal to those of the previous
+  // chunk, it is the same as if it had been decoded from the beginning of the
+  // sequence.
+  // A chunk for which that does not happen inside the overlap is decoded again,
+  // from the costs of the previous chunk.
+  //
+  // This object is called from several threads at the same time.
+  Arrayi solveInChunks(Arrayi cuts, int overlap, int threadCount);
+
   // Lists all state indices, 0..(getStateCount() - 1). This list is suitable to return from
   // the method getPrecedingStates.
   Arrayi listStateInds();
 
   // Precompute an array of arrays that can be returned by the method
-  // 'getPrecedingStates', from a connectivity matrix.
+  // 'getPrecedingStates', from a connectivity matrix. The arrays are
+  // slices of a single array of all connections (compressed sparse columns).
   static Array<Arrayi> makePredecessorsPerState(MDArray2b con);
 
   // Mostly for debugging
@@ -61,10 +93,29 @@ class StateAssign {
 
   double calcCost(Arrayi stateSeq);
  private:
-  void accumulateCosts(MDArray2d *costsOut, MDArray2i *ptrsOut);
-  double calcBestPred(MDArray2d costs, Arrayi preds, int toState, int fromTime,
-                      int *bestPredIndexOut);
-  Arrayi unwind(MDArray2d costs, MDArray2i ptrs);
+  // The accumulated costs of the allowed states only, from time 'begin': the
+  // states, costs and best predecessors at time i are the elements
+  // offsets[i - begin]..offsets[i - begin + 1]-1. A predecessor is an
+  // index into the elements of the previous time. The costs of every time
+  // are relative to the lowest one, so that they stay small over long sequences
+  // and that chunks decoded from different beginnings can become equal.
+  struct Trellis {
+    int begin = 0;
+    Arrayi offsets;
+    std::vector<int> states, ptrs;
+    std::vector<double> costs;
+
+    int end() const {return begin + offsets.size() - 1;}
+    int stepBegin(int time) const {return offsets[time - begin];}
+    int stepEnd(int time) const {return offsets[time - begin + 1];}
+  };
+
+  // Accumulates the costs from 'begin' to 'end'. The costs at 'begin' are
+  // copied from 'init' if provided, or otherwise only the state costs.
+  Trellis accumulateCosts(int begin, int end, const Trellis *init = nullptr);
+
+  // Chunk i is used for the time indices from firsts[i].
+  Arrayi unwind(const std::vector<Trellis> &chunks, Arrayi firsts);
 };
 
 } /* namespace sail */
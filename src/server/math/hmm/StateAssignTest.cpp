@@ -6,6 +6,7 @@
  */
 
 #include "StateAssign.h"
+#include <cmath>
 #include <gtest/gtest.h>
 
 using namespace sail;
@@ -150,3 +151,77 @@ TEST(StateAssignTest, NoisyStepGrammar) {
 }
 
 
+
+namespace {
+// Only the states of 'mask' are allowed, where it is not '-'.
+class MaskedNoisyStep : public NoisyStep {
+ public:
+  MaskedNoisyStep(std::string noisy, std::string mask) :
+    NoisyStep(noisy), _mask(mask) {}
+
+  Arrayi getAllowedStates(int timeIndex) {
+    if (_mask[timeIndex] == '-') {
+      return listStateInds();
+    }
+    return Arrayi{_mask[timeIndex] - '0'};
+  }
+ private:
+  std::string _mask;
+};
+}
+
+TEST(StateAssignTest, AllowedStates) {
+  std::string noisy = "000010010100011111110111001111";
+  std::string mask  = "------1----------------0------";
+  std::string gt    = "000000111111111111111110000000";
+
+  MaskedNoisyStep test(noisy, mask);
+  Arrayi result = test.solve();
+  EXPECT_EQ(gt.length(), result.size());
+  for (int i = 0; i < result.size(); i++) {
+    EXPECT_EQ(gt[i], toChar(result[i])) << "index: " << i;
+  }
+
+  MDArray2d costs = test.makeCostMatrix();
+  EXPECT_TRUE(std::isinf(costs(0, 6)));
+  EXPECT_TRUE(std::isinf(costs(1, 23)));
+  EXPECT_EQ(-1, test.makeRefMatrix()(0, 6));
+}
+
+namespace {
+class Noisy4 : public StateAssign {
+ public:
+  Noisy4(int length) : _length(length), _preds(listStateInds()) {}
+
+  double getStateCost(int stateIndex, int timeIndex) {
+    int level = (timeIndex/97) % 4;
+    return std::abs(stateIndex - level) + 2.0*std::abs(sin(12.345*timeIndex + stateIndex));
+  }
+
+  double getTransitionCost(int fromStateIndex, int toStateIndex, int fromTimeIndex) {
+    return 1.5*std::abs(fromStateIndex - toStateIndex);
+  }
+
+  int getStateCount() {return 4;}
+  int getLength() {return _length;}
+
+  Arrayi getPrecedingStates(int stateIndex, int timeIndex) {
+    return _preds;
+  }
+ private:
+  int _length;
+  Arrayi _preds;
+};
+}
+
+TEST(StateAssignTest, SolveInChunks) {
+  Noisy4 test(3000);
+  Arrayi expected = test.solve();
+  Arrayi cuts{700, 1500, 1501, 2300};
+  EXPECT_EQ(expected, test.solveInChunks(cuts, 200, 3));
+
+  // Without overlap, every chunk is decoded again from the previous one.
+  EXPECT_EQ(expected, test.solveInChunks(cuts, 0, 3));
+
+  EXPECT_EQ(expected, test.solveInChunks(Arrayi(), 200, 3));
+}
@@ -16,6 +16,7 @@
 #include <server/common/Env.h>
 #include <server/common/PathBuilder.h>
 #include <server/common/ScopedLog.h>
+#include <server/common/StageProfiler.h>
 #include <server/common/logging.h>
 #include <server/common/string.h>
 #include <server/nautical/DownsampleGps.h>
@@ -47,15 +48,13 @@ void collectSpeedSamplesGrammar(
       std::shared_ptr<HTree> tree, Array<HNode> nodeinfo,
       const NavDataset& allnavs,
       std::string description,
-      Array<Velocity<>> *twsResult,
-      Array<Velocity<>> *vmgResult) {
+      TargetSpeedSketch *dst) {
     // TODO: How to best select upwind/downwind navs? Is the grammar reliable for this?
     //   Maybe replace AWA by TWA in order to label states in Grammar001.
     Array<std::pair<TimeStamp, TimeStamp>> sel =
       markNavsByDesc(tree, nodeinfo, allnavs, description);
 
-    ArrayBuilder<Velocity<double>> twsArray;
-    ArrayBuilder<Velocity<double>> vmgArray;
+    int64_t measures = 0;
 
     for (const std::pair<TimeStamp, TimeStamp>& it : sel) {
       NavDataset leg = allnavs.slice(it.first, it.second);
@@ -74,10 +73,10 @@ void collectSpeedSamplesGrammar(
           // This is because the grammar labels as "upwind-leg" startionary
           // episodes.
           if (vmg.get().value.fabs() > .5_kn) {
-            twsArray.add(tws.get().value);
             // vmg is negative for downwind sailing, but the TargetSpeed logic
             // only handles positive values. Therefore, take the abs value.
-            vmgArray.add(fabs(vmg.get().value));
+            dst->add(tws.get().value, fabs(vmg.get().value));
+            measures++;
             if (debugVmgSamples) {
             LOG(INFO) << "At " << time.fullPrecisionString() << ": "
               << "vmg: " << vmg.get().value.knots()
@@ -97,26 +96,21 @@ void collectSpeedSamplesGrammar(
       }
     }
 
-    *twsResult = twsArray.get();
-    *vmgResult = vmgArray.get();
-
     LOG(INFO) << __FUNCTION__ << ": "
       << " " << description << ": " << sel.size() << " legs "
-      << twsResult->size() << " measures";
+      << measures << " measures";
 }
 
 
 void collectSpeedSamplesBlind(const NavDataset& navs,
                               bool isUpwind,
-                              Array<Velocity<>> *twsResult,
-                              Array<Velocity<>> *vmgResult) {
+                              TargetSpeedSketch *dst) {
   TimedSampleRange<Angle<double>> allTwa = navs.samples<TWA>();
   TimedSampleRange<Velocity<double>> allGpsSpeed = navs.samples<GPS_SPEED>();
   TimedSampleRange<Velocity<double>> allVmg = navs.samples<VMG>();
   TimedSampleRange<Velocity<double>> allTws = navs.samples<TWS>();
 
-  ArrayBuilder<Velocity<double>> twsArray;
-  ArrayBuilder<Velocity<double>> vmgArray;
+  int64_t measures = 0;
 
   if (allGpsSpeed.size() == 0) {
     return;
@@ -145,17 +139,15 @@ void collectSpeedSamplesBlind(const NavDataset& navs,
     bool upwind = cos(twa.get().value) > 0;
 
     if (isUpwind == upwind) {
-      twsArray.add(tws.get().value);
       // vmg is negative for downwind sailing, but the TargetSpeed logic
       // only handles positive values. Therefore, take the abs value.
-      vmgArray.add(fabs(vmg.get().value));
+      dst->add(tws.get().value, fabs(vmg.get().value));
+      measures++;
     }
   }
-  *twsResult = twsArray.get();
-  *vmgResult = vmgArray.get();
 
   LOG(INFO) << __FUNCTION__ << ": " << (isUpwind ? "upwind" : "downwind")
-    << twsResult->size() << " measures";
+    << measures << " measures";
 }
 
   TargetSpeed makeTargetSpeedTable(
@@ -164,24 +156,23 @@ void collectSpeedSamplesBlind(const NavDataset& navs,
       std::shared_ptr<HTree> tree, Array<HNode> nodeinfo,
       const NavDataset& allnavs,
       std::string description) {
-    Array<Velocity<>> twsArr;
-    Array<Velocity<>> vmgArr;
+    // TODO: Adapt these values to the amount of recorded data.
+    Velocity<double> minvel = Velocity<double>::knots(0);
+    Velocity<double> maxvel = Velocity<double>::knots(TargetSpeedTable::NUM_ENTRIES-1);
+    Array<Velocity<double> > bounds = makeBoundsFromBinCenters(TargetSpeedTable::NUM_ENTRIES, minvel, maxvel);
+    TargetSpeedSketch sketch(bounds);
 
     switch (vmgSampleSelection) {
       case VMG_SAMPLES_FROM_GRAMMAR:
         collectSpeedSamplesGrammar(tree, nodeinfo, allnavs, description,
-                                   &twsArr, &vmgArr);
+                                   &sketch);
         break;
       case VMG_SAMPLES_BLIND:
-        collectSpeedSamplesBlind(allnavs, isUpwind, &twsArr, &vmgArr);
+        collectSpeedSamplesBlind(allnavs, isUpwind, &sketch);
         break;
     }
 
-    // TODO: Adapt these values to the amount of recorded data.
-    Velocity<double> minvel = Velocity<double>::knots(0);
-    Velocity<double> maxvel = Velocity<double>::knots(TargetSpeedTable::NUM_ENTRIES-1);
-    Array<Velocity<double> > bounds = makeBoundsFromBinCenters(TargetSpeedTable::NUM_ENTRIES, minvel, maxvel);
-    return TargetSpeed(isUpwind, twsArr, vmgArr, bounds);
+    return TargetSpeed(isUpwind, sketch);
   }
 
   void outputTargetSpeedTable(
@@ -235,6 +226,32 @@ Nav::Id extractBoatId(Poco::Path path) {
   return path.directory(path.depth()-1);
 }
 
+namespace {
+
+// A stage of processLogs. Counting the samples that go in and out of it
+// visits all the channels, so it is only done if the stage is recorded.
+class NavStage {
+ public:
+  explicit NavStage(const std::string& name) : _stage(name) {}
+  NavStage(const std::string& name, const NavDataset& in) : _stage(name) {
+    if (_stage.active()) {
+      _stage.setSamplesIn(countSamples(in));
+    }
+  }
+
+  void finish() { _stage.finish(); }
+  void finish(const NavDataset& out) {
+    if (_stage.active()) {
+      _stage.setSamplesOut(countSamples(out));
+    }
+    _stage.finish();
+  }
+ private:
+  ScopedStage _stage;
+};
+
+}  // namespace
+
 std::string grammarNodeInfo(const NavDataset& navs, std::shared_ptr<HTree> tree) {
   CHECK(tree->left() < tree->right());
   Nav right = getNav(navs, tree->right()-1);
@@ -254,7 +271,7 @@ NavDataset loadNavs(ArgMap &amap, std::string boatId) {
   for (auto fileNameObj: amap.optionArgs("--file")) {
     loader.load(fileNameObj->value());
   }
-  return loader.makeNavDataset();
+  return loader.takeNavDataset();
 }
 
 Nav::Id getBoatId(ArgMap &amap) {
@@ -314,6 +331,44 @@ void outputInfoPerSession(
 }
 
 
+bool BoatLogProcessor::process(ArgMap* amap) {
+  TimeStamp start = TimeStamp::now();
+
+  if (!prepare(amap)) {
+    return false;
+  }
+
+  StageProfiler profiler;
+  if (_profile) {
+    profiler.activate();
+  }
+  bool success = processLogs(amap);
+  if (_profile) {
+    profiler.deactivate();
+    writeProfile(profiler);
+  }
+  if (!success) {
+    return false;
+  }
+
+  // Logging to cout and not LOG(INFO) because LOG(INFO) is disabled in
+  // production and we want to keep track of processing time.
+  std::cout << "Processing time for " << _boatid << ": "
+    << (TimeStamp::now() - start).seconds() << " seconds." << std::endl;
+  return true;
+}
+
+void BoatLogProcessor::writeProfile(const StageProfiler& profiler) const {
+  std::ofstream trace(_dstPath.toString() + "/profile.json");
+  profiler.writeChromeTrace(&trace);
+
+  std::ofstream totals(_dstPath.toString() + "/profile.tsv");
+  writeStageTotals(profiler.totals(), &totals);
+  if (!trace || !totals) {
+    LOG(WARNING) << "Failed to write the profile to " << _dstPath.toString();
+  }
+}
+
 //
 // high-level processing logic
 //
@@ -323,35 +378,41 @@ void outputInfoPerSession(
 // members), while raw and derived data are kept in local variables,
 // to improve data flow readability.
 
-bool BoatLogProcessor::process(ArgMap* amap) {
-  TimeStamp start = TimeStamp::now();
-
-  if (!prepare(amap)) {
-    return false;
-  }
+bool BoatLogProcessor::processLogs(ArgMap* amap) {
+  ScopedStage processing("Process boat logs");
 
   hack::ConfigureForBoat(_boatid);
 
   NavDataset current;
 
   if (_resumeAfterPrepare.size() > 0) {
+    NavStage stage("Load prepared data");
     current = LogLoader::loadNavDataset(_resumeAfterPrepare);
+    stage.finish(current);
   } else {
+    NavStage loading("Load logs");
     NavDataset loaded = loadNavs(*amap, _boatid);
     hack::SelectSources(&loaded);
     loaded.dispatcher()->setSourcePriority(" reparsed", -1);
+    loading.finish(loaded);
 
+    NavStage removal("Remove strange GPS positions", loaded);
     current = removeStrangeGpsPositions(loaded);
+    removal.finish(current);
     infoNavDataset("After loading", current);
 
+    NavStage merging("Merge GPS channels", current);
     auto minGpsSamplingPeriod = 0.01_s; // Should be enough, right?
     current = current.createMergedChannels(
         std::set<DataCode>{GPS_POS, GPS_SPEED, GPS_BEARING},
         minGpsSamplingPeriod);
+    merging.finish(current);
     infoNavDataset("After resampling GPS", current);
 
     if (_gpsFilter) {
+      NavStage filtering("Filter GPS", current);
       current = filterNavs(current, &_htmlReport, _gpsFilterSettings);
+      filtering.finish(current);
       infoNavDataset("After filtering", current);
     }
   }
@@ -363,12 +424,16 @@ bool BoatLogProcessor::process(ArgMap* amap) {
   // Note: the grammar does not have access to proper true wind.
   // It has to do its own estimate.
   hack::SelectSources(&current);
+  NavStage windMerging("Merge wind channels", current);
   current = current.createMergedChannels(
       std::set<DataCode>{AWA, AWS, MAG_HEADING}, Duration<>::seconds(.3));
+  windMerging.finish(current);
 
+  NavStage parsing("Parse grammar", current);
   std::shared_ptr<HTree> fulltree = _grammar.parse(
       current.stripSource("Anemomind estimator") // avoid "loop back" effects
       );
+  parsing.finish();
   std::shared_ptr<DispatchData> treeBaseChannel = current.activeChannel(GPS_POS);
 
   if (!fulltree) {
@@ -385,6 +450,7 @@ bool BoatLogProcessor::process(ArgMap* amap) {
   CHECK(boatDatFile.is_open()) << "Error opening " << boatDatPath;
 
   // Calibrate. TODO: use filtered data instead of resampled.
+  NavStage calibrating("Calibrate", current);
   if (calibrator.calibrate(current, fulltree, _boatid)) {
       calibrator.saveCalibration(&boatDatFile);
   } else {
@@ -394,9 +460,12 @@ bool BoatLogProcessor::process(ArgMap* amap) {
       calibrator.saveCalibration(&boatDatFile);
     }
   }
+  calibrating.finish();
 
   // First simulation pass: adds true wind
+  NavStage simulating("Simulate true wind", current);
   current = calibrator.simulate(current.stripSource("Anemomind estimator"));
+  simulating.finish(current);
 
   // This choice should be left to the user.
   // TODO: add a per-boat configuration system
@@ -408,24 +477,29 @@ bool BoatLogProcessor::process(ArgMap* amap) {
     saveDispatcher(_saveSimulated.c_str(), *(current.dispatcher()));
   }
 
+  NavStage targetSpeed("Target speed tables", current);
   outputTargetSpeedTable(_debug, 
                          fulltree,
                          _grammar.grammar.nodeInfo(),
                          current,
                          _vmgSampleSelection,
                          &boatDatFile);
+  targetSpeed.finish();
 
   // write calibration and target speed to disk
   boatDatFile.close();
 
   // Second simulation path to apply target speed.
   // Todo: simply lookup the target speed instead of recomputing true wind.
-  current = SimulateBox(boatDatPath, current);
+  NavStage simulatingBox("Simulate box", current);
+  current = SimulateBox(boatDatPath, current, SimulateBoxMode::Fast);
+  simulatingBox.finish(current);
 
   if (_debug) {
     visualizeBoatDat(_dstPath);
   }
 
+  NavStage finalMerging("Merge channels", current);
   auto unmerged = current.unmergedChannels();
 
   // Merging of GPS data has been done at filtering time, or before.
@@ -434,9 +508,11 @@ bool BoatLogProcessor::process(ArgMap* amap) {
   unmerged.erase(GPS_BEARING);
   unmerged.erase(GPS_SPEED);
   current = current.createMergedChannels(unmerged);
+  finalMerging.finish(current);
 
   HTML_DISPLAY(_generateTiles, &_htmlReport);
   if (_generateTiles) {
+    NavStage stage("Generate tiles", current);
     // Make sure the GPS_POS source is the one used to create fulltree
     // otherwise, the indices it contains will be invalid.
     current.selectSource(GPS_POS, treeBaseChannel->source());
@@ -451,16 +527,13 @@ bool BoatLogProcessor::process(ArgMap* amap) {
 
   HTML_DISPLAY(_generateChartTiles, &_htmlReport);
   if (_generateChartTiles) {
+    NavStage stage("Generate chart tiles", current);
     if (!uploadChartTiles(
         current, _boatid, _chartTileSettings, db.db)) {
       LOG(ERROR) << "Failed to upload chart tiles!";
       return false;
     }
   }
-  // Logging to cout and not LOG(INFO) because LOG(INFO) is disabled in
-  // production and we want to keep track of processing time.
-  std::cout << "Processing time for " << _boatid << ": "
-    << (TimeStamp::now() - start).seconds() << " seconds." << std::endl;
   return true;
 }
 
@@ -509,6 +582,7 @@ void BoatLogProcessor::readArgs(ArgMap* amap) {
 
   _exploreGrammar = amap->optionProvided("--explore");
   _logGrammar = amap->optionProvided("--log-grammar");
+  _profile = amap->optionProvided("--profile");
 
   _chartTileSettings.dbName = _tileParams.dbName();
   if (_debug) {
@@ -625,6 +699,12 @@ int mainProcessBoatLogs(int argc, const char **argv) {
   amap.registerOption("--log-grammar",
       "Produce a log file with the parsed result");
 
+  amap.registerOption("--profile",
+      "Write a trace of the processing stages to profile.json, to open "
+      "with chrome://tracing, and their totals to profile.tsv, in the "
+      "destination directory")
+    .setArgCount(0);
+
   auto status = amap.parse(argc, argv);
   switch (status) {
    case ArgMap::Error:
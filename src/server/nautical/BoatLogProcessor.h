@@ -9,6 +9,7 @@
 #include <Poco/Path.h>
 #include <server/common/ArgMap.h>
 #include <server/common/DOMUtils.h>
+#include <server/common/StageProfiler.h>
 #include <server/nautical/Nav.h>
 #include <server/nautical/filters/SmoothGpsFilter.h>
 #include <server/nautical/grammars/WindOrientedGrammar.h>
@@ -60,12 +61,15 @@ struct BoatLogProcessor {
   bool _exploreGrammar = false;
   bool _logGrammar = false;
   bool _saveDefaultCalib = false;
+  bool _profile = false;
 
   MongoDBConnection db;
 
   DOM::Node _htmlReport;
 
 private:
+  bool processLogs(ArgMap* amap);
+  void writeProfile(const StageProfiler& profiler) const;
   void grammarDebug(
       const std::shared_ptr<HTree> &fulltree,
       const NavDataset &resampled) const;
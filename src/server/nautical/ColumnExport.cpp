@@ -0,0 +1,385 @@
+#include <server/nautical/ColumnExport.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <server/common/logging.h>
+#include <server/common/string.h>
+#include <server/nautical/AbsoluteOrientation.h>
+
+namespace sail {
+
+namespace {
+  // How every type of sample is split into columns of doubles.
+  template <typename T> struct Columns {};
+
+  template <> struct Columns<Angle<double> > {
+    static std::vector<std::string> names() { return {"degrees"}; }
+    static void add(const Angle<double> &x, std::vector<std::vector<double> > *dst) {
+      (*dst)[0].push_back(x.degrees());
+    }
+  };
+
+  template <> struct Columns<Velocity<double> > {
+    static std::vector<std::string> names() { return {"knots"}; }
+    static void add(const Velocity<double> &x, std::vector<std::vector<double> > *dst) {
+      (*dst)[0].push_back(x.knots());
+    }
+  };
+
+  template <> struct Columns<Length<double> > {
+    static std::vector<std::string> names() { return {"meters"}; }
+    static void add(const Length<double> &x, std::vector<std::vector<double> > *dst) {
+      (*dst)[0].push_back(x.meters());
+    }
+  };
+
+  template <> struct Columns<AngularVelocity<double> > {
+    static std::vector<std::string> names() { return {"degreesPerSecond"}; }
+    static void add(const AngularVelocity<double> &x,
+                    std::vector<std::vector<double> > *dst) {
+      (*dst)[0].push_back(x.degreesPerSecond());
+    }
+  };
+
+  template <> struct Columns<GeographicPosition<double> > {
+    static std::vector<std::string> names() { return {"lon", "lat"}; }
+    static void add(const GeographicPosition<double> &x,
+                    std::vector<std::vector<double> > *dst) {
+      (*dst)[0].push_back(x.lon().degrees());
+      (*dst)[1].push_back(x.lat().degrees());
+    }
+  };
+
+  template <> struct Columns<TimeStamp> {
+    static std::vector<std::string> names() { return {"millisecondsSince1970"}; }
+    static void add(const TimeStamp &x, std::vector<std::vector<double> > *dst) {
+      (*dst)[0].push_back(x.defined()? double(x.toMilliSecondsSince1970()) : NAN);
+    }
+  };
+
+  template <> struct Columns<AbsoluteOrientation> {
+    static std::vector<std::string> names() { return {"heading", "roll", "pitch"}; }
+    static void add(const AbsoluteOrientation &x,
+                    std::vector<std::vector<double> > *dst) {
+      (*dst)[0].push_back(x.heading.degrees());
+      (*dst)[1].push_back(x.roll.degrees());
+      (*dst)[2].push_back(x.pitch.degrees());
+    }
+  };
+
+  template <> struct Columns<BinaryEdge> {
+    static std::vector<std::string> names() { return {"on"}; }
+    static void add(const BinaryEdge &x, std::vector<std::vector<double> > *dst) {
+      (*dst)[0].push_back(x == BinaryEdge::ToOn? 1.0 : 0.0);
+    }
+  };
+
+  TimeStamp laterBound(TimeStamp a, TimeStamp b) {
+    return !a.defined()? b : (!b.defined()? a : std::max(a, b));
+  }
+
+  TimeStamp earlierBound(TimeStamp a, TimeStamp b) {
+    return !a.defined()? b : (!b.defined()? a : std::min(a, b));
+  }
+
+  DispatchData *channelData(const NavDataset &ds, DataCode code) {
+    auto active = ds.activeChannelOrNull(code);
+    if (active) {
+      return active.get();
+    }
+    const auto &dispatcher = ds.dispatcher();
+    if (!dispatcher) {
+      return nullptr;
+    }
+    auto sources = dispatcher->allSources().find(code);
+    if (sources == dispatcher->allSources().end()) {
+      return nullptr;
+    }
+    DispatchData *best = nullptr;
+    int bestPriority = 0;
+    for (const auto &kv : sources->second) {
+      int priority = dispatcher->sourcePriority(kv.first);
+      if (best == nullptr || bestPriority < priority) {
+        best = kv.second.get();
+        bestPriority = priority;
+      }
+    }
+    return best;
+  }
+
+  template <DataCode Code>
+  void visitChannel(const NavDataset &ds, TimeStamp from, TimeStamp to,
+                    std::function<void(const ChannelColumns &)> f) {
+    typedef typename TypeForCode<Code>::type T;
+    DispatchData *data = channelData(ds, Code);
+    if (data == nullptr) {
+      return;
+    }
+    const auto &samples =
+      toTypedDispatchData<Code>(data)->dispatcher()->values().samples();
+    auto begin = (from.defined()?
+        std::lower_bound(samples.begin(), samples.end(), from) : samples.begin());
+    auto end = (to.defined()?
+        std::upper_bound(samples.begin(), samples.end(), to) : samples.end());
+    if (end <= begin) {
+      return;
+    }
+
+    int n = end - begin;
+    ChannelColumns dst;
+    dst.code = Code;
+    dst.source = data->source();
+    dst.names = Columns<T>::names();
+    dst.times.reserve(n);
+    dst.values.resize(dst.names.size());
+    for (auto &column : dst.values) {
+      column.reserve(n);
+    }
+    for (auto x = begin; x != end; x++) {
+      dst.times.push_back(x->time.toMilliSecondsSince1970());
+      Columns<T>::add(x->value, &dst.values);
+    }
+    f(dst);
+  }
+
+  const int64_t powersOf10[] = {1, 10, 100, 1000, 10000, 100000, 1000000,
+    10000000, 100000000, 1000000000};
+
+  // Writes the digits of x > 0 backwards, returns the number of digits.
+  int reverseDigits(uint64_t x, char *dst) {
+    int n = 0;
+    do {
+      dst[n++] = '0' + (x % 10);
+      x /= 10;
+    } while (x != 0);
+    return n;
+  }
+
+  void writeNpyHeader(const char *descr, size_t count, std::ostream *dst) {
+    std::string header = stringFormat(
+        "{'descr': '%s', 'fortran_order': False, 'shape': (%lu,), }",
+        descr, (unsigned long)count);
+    // Magic, version and header length take 10 bytes. The data
+    // starts at a multiple of 64 bytes, after a newline.
+    int padding = 63 - (10 + header.size()) % 64;
+    header += std::string(padding, ' ') + "\n";
+    uint16_t len = header.size();
+    dst->write("\x93NUMPY\x01\x00", 8);
+    char lenBytes[2] = {char(len & 0xff), char(len >> 8)};
+    dst->write(lenBytes, 2);
+    dst->write(header.data(), header.size());
+  }
+
+  // Closing flushes what is left in the buffer of the stream, so the
+  // state is checked after that.
+  bool closeFile(const std::string &filename, std::ofstream *file) {
+    file->close();
+    if (!file->good()) {
+      LOG(ERROR) << "Failed to write " << filename;
+      return false;
+    }
+    return true;
+  }
+
+  bool isLittleEndian() {
+    uint16_t x = 1;
+    return *reinterpret_cast<const char *>(&x) == 1;
+  }
+}
+
+void forEachChannelColumns(const NavDataset &ds,
+    const ColumnExportSettings &settings,
+    std::function<void(const ChannelColumns &)> f) {
+  TimeStamp from = laterBound(
+      ds.hasLowerBound()? ds.lowerBound() : TimeStamp(), settings.from);
+  TimeStamp to = earlierBound(
+      ds.hasUpperBound()? ds.upperBound() : TimeStamp(), settings.to);
+  auto selected = [&](DataCode code) {
+    return settings.channels.empty()
+      || settings.channels.find(code) != settings.channels.end();
+  };
+#define VISIT_CHANNEL(HANDLE, CODE, SHORTNAME, TYPE, DESCRIPTION) \
+  if (selected(HANDLE)) { \
+    visitChannel<HANDLE>(ds, from, to, f); \
+  }
+  FOREACH_CHANNEL(VISIT_CHANNEL)
+#undef VISIT_CHANNEL
+}
+
+bool parseChannelNames(const std::string &names, std::set<DataCode> *dst) {
+  for (auto name : split(names, ',')) {
+    if (name.empty()) {
+      continue;
+    }
+    bool found = false;
+#define FIND_CHANNEL(HANDLE, CODE, SHORTNAME, TYPE, DESCRIPTION) \
+    if (name == SHORTNAME) { \
+      dst->insert(HANDLE); \
+      found = true; \
+    }
+    FOREACH_CHANNEL(FIND_CHANNEL)
+#undef FIND_CHANNEL
+    if (!found) {
+      LOG(ERROR) << "Unknown channel: " << name;
+      return false;
+    }
+  }
+  return true;
+}
+
+CsvWriter::CsvWriter(std::ostream *dst, int bufferSize) :
+  _dst(dst), _buffer(std::max(bufferSize, 64)) {}
+
+CsvWriter::~CsvWriter() {
+  flush();
+}
+
+void CsvWriter::flush() {
+  _dst->write(_buffer.data(), _size);
+  _size = 0;
+}
+
+void CsvWriter::addText(const std::string &x) {
+  for (auto c : x) {
+    addChar(c);
+  }
+}
+
+void CsvWriter::addInt(int64_t x) {
+  char digits[24];
+  reserve(sizeof(digits));
+  uint64_t abs = x;
+  if (x < 0) {
+    _buffer[_size++] = '-';
+    abs = -uint64_t(x);
+  }
+  int n = reverseDigits(abs, digits);
+  while (n > 0) {
+    _buffer[_size++] = digits[--n];
+  }
+}
+
+void CsvWriter::addFixed(double x, int decimals) {
+  if (!std::isfinite(x)) {
+    return;
+  }
+  decimals = std::max(0, std::min(9, decimals));
+  int64_t scale = powersOf10[decimals];
+  double scaled = std::round(x*scale);
+  if (!(std::abs(scaled) < 9.0e15)) { // Too large to be rounded as an integer.
+    char text[400];
+    int n = snprintf(text, sizeof(text), "%.*f", decimals, x);
+    if (0 < decimals) { // No trailing zeros, as below
+      while (text[n - 1] == '0') {
+        n--;
+      }
+      if (text[n - 1] == '.') {
+        n--;
+      }
+    }
+    addText(std::string(text, n));
+    return;
+  }
+
+  int64_t i = int64_t(scaled);
+  char digits[24];
+  reserve(sizeof(digits) + 2);
+  if (i < 0) {
+    _buffer[_size++] = '-';
+    i = -i;
+  }
+  int64_t whole = i/scale;
+  int64_t fraction = i % scale;
+  int n = reverseDigits(whole, digits);
+  while (n > 0) {
+    _buffer[_size++] = digits[--n];
+  }
+  if (fraction != 0) {
+    _buffer[_size++] = '.';
+    int width = decimals;
+    while (fraction % 10 == 0) { // No trailing zeros
+      fraction /= 10;
+      width--;
+    }
+    n = reverseDigits(fraction, digits);
+    for (int k = n; k < width; k++) {
+      _buffer[_size++] = '0';
+    }
+    while (n > 0) {
+      _buffer[_size++] = digits[--n];
+    }
+  }
+}
+
+void writeColumnsCsv(const ChannelColumns &columns, int decimals,
+                     std::ostream *dst) {
+  CsvWriter csv(dst);
+  csv.addText("time");
+  for (const auto &name : columns.names) {
+    csv.addSeparator();
+    csv.addText(name);
+  }
+  csv.endLine();
+
+  int n = columns.rowCount();
+  for (int i = 0; i < n; i++) {
+    csv.addInt(columns.times[i]);
+    for (const auto &column : columns.values) {
+      csv.addSeparator();
+      csv.addFixed(column[i], decimals);
+    }
+    csv.endLine();
+  }
+}
+
+void writeNpy(const std::vector<double> &values, std::ostream *dst) {
+  CHECK(isLittleEndian());
+  writeNpyHeader("<f8", values.size(), dst);
+  dst->write(reinterpret_cast<const char *>(values.data()),
+             values.size()*sizeof(double));
+}
+
+void writeNpy(const std::vector<int64_t> &values, std::ostream *dst) {
+  CHECK(isLittleEndian());
+  writeNpyHeader("<i8", values.size(), dst);
+  dst->write(reinterpret_cast<const char *>(values.data()),
+             values.size()*sizeof(int64_t));
+}
+
+int exportColumns(const NavDataset &ds, const ColumnExportSettings &settings,
+                  ColumnFormat format, const std::string &dir) {
+  int count = 0;
+  bool ok = true;
+  forEachChannelColumns(ds, settings, [&](const ChannelColumns &columns) {
+    if (!ok) {
+      return;
+    }
+    std::string prefix = dir + "/" + wordIdentifierForCode(columns.code);
+    if (format == ColumnFormat::Csv) {
+      std::ofstream file(prefix + ".csv", std::ios::binary);
+      writeColumnsCsv(columns, settings.decimals, &file);
+      ok = closeFile(prefix + ".csv", &file);
+    } else {
+      std::ofstream times(prefix + ".time.npy", std::ios::binary);
+      writeNpy(columns.times, &times);
+      ok = closeFile(prefix + ".time.npy", &times);
+      for (int i = 0; ok && i < columns.names.size(); i++) {
+        std::string filename = prefix + "." + columns.names[i] + ".npy";
+        std::ofstream file(filename, std::ios::binary);
+        writeNpy(columns.values[i], &file);
+        ok = closeFile(filename, &file);
+      }
+    }
+    if (ok) {
+      LOG(INFO) << "Exported " << columns.rowCount() << " samples of "
+        << descriptionForCode(columns.code) << " from " << columns.source;
+      count++;
+    }
+  });
+  return ok? count : -1;
+}
+
+}
@@ -0,0 +1,109 @@
+/*
+ * Exports the channels of a NavDataset column by column, straight from
+ * their samples, without assembling Navs. Every channel becomes a table
+ * with the time in milliseconds since 1970 and one or more value columns,
+ * e.g. "lon" and "lat" for GPS positions.
+ */
+
+#ifndef SERVER_NAUTICAL_COLUMNEXPORT_H_
+#define SERVER_NAUTICAL_COLUMNEXPORT_H_
+
+#include <functional>
+#include <iosfwd>
+#include <set>
+#include <server/nautical/NavDataset.h>
+#include <string>
+#include <vector>
+
+namespace sail {
+
+struct ColumnExportSettings {
+  // Only the samples inside these bounds, and inside the bounds of
+  // the dataset, are visited. Undefined bounds are open.
+  TimeStamp from, to;
+
+  // The channels to export, or all channels if empty.
+  std::set<DataCode> channels;
+
+  // The values written as CSV are rounded to this number of decimals (at most 9).
+  int decimals = 6;
+};
+
+// The samples of a channel inside the bounds, as columns.
+struct ChannelColumns {
+  DataCode code;
+  std::string source;
+  std::vector<int64_t> times;
+  std::vector<std::string> names;
+  std::vector<std::vector<double> > values; // values[column][row]
+
+  int rowCount() const { return times.size(); }
+};
+
+// Calls 'f' with the columns of every selected channel that has samples inside
+// the bounds. For a channel with several sources, the active source is used if
+// one is selected, otherwise the one with the highest priority.
+void forEachChannelColumns(const NavDataset &ds,
+    const ColumnExportSettings &settings,
+    std::function<void(const ChannelColumns &)> f);
+
+// Parses a comma separated list of channel names, such as "awa,aws,pos"
+// (see FOREACH_CHANNEL). Returns false if a name is unknown.
+bool parseChannelNames(const std::string &names, std::set<DataCode> *dst);
+
+// Formats CSV in a large buffer that is written to the stream when full.
+class CsvWriter {
+ public:
+  CsvWriter(std::ostream *dst, int bufferSize = 1 << 20);
+  ~CsvWriter();
+
+  void addText(const std::string &x);
+  void addInt(int64_t x);
+
+  // Rounded to 'decimals' decimals, without trailing zeros.
+  // Nothing is written for a value that is not finite.
+  void addFixed(double x, int decimals);
+
+  void addSeparator() { addChar(','); }
+  void endLine() { addChar('\n'); }
+
+  void flush();
+ private:
+  void addChar(char c) {
+    if (_size == _buffer.size()) {
+      flush();
+    }
+    _buffer[_size++] = c;
+  }
+
+  void reserve(int n) {
+    if (_buffer.size() < _size + n) {
+      flush();
+    }
+  }
+
+  std::ostream *_dst;
+  std::vector<char> _buffer;
+  size_t _size = 0;
+};
+
+// Writes a table as CSV, with a header line.
+void writeColumnsCsv(const ChannelColumns &columns, int decimals,
+                     std::ostream *dst);
+
+// Writes a column in the .npy format of numpy, that numpy.load
+// reads without parsing.
+void writeNpy(const std::vector<double> &values, std::ostream *dst);
+void writeNpy(const std::vector<int64_t> &values, std::ostream *dst);
+
+enum class ColumnFormat {Csv, Npy};
+
+// Writes every channel to the existing directory 'dir', as <channel>.csv, or as
+// <channel>.time.npy, <channel>.<column>.npy, ... Returns the number of channels,
+// or -1 if a file could not be written.
+int exportColumns(const NavDataset &ds, const ColumnExportSettings &settings,
+                  ColumnFormat format, const std::string &dir);
+
+}
+
+#endif /* SERVER_NAUTICAL_COLUMNEXPORT_H_ */
@@ -0,0 +1,141 @@
+#include <server/nautical/ColumnExport.h>
+
+#include <cstring>
+#include <device/anemobox/Dispatcher.h>
+#include <gtest/gtest.h>
+#include <sstream>
+
+using namespace sail;
+
+namespace {
+  std::string formatFixed(double x, int decimals) {
+    std::stringstream ss;
+    {
+      CsvWriter csv(&ss);
+      csv.addFixed(x, decimals);
+    }
+    return ss.str();
+  }
+
+  TimeStamp offset = TimeStamp::UTC(2016, 6, 1, 12, 0, 0);
+
+  TimeStamp at(int seconds) {
+    return offset + Duration<double>::seconds(seconds);
+  }
+
+  NavDataset makeDataset() {
+    TimedSampleCollection<Angle<double> >::TimedVector awa;
+    TimedSampleCollection<GeographicPosition<double> >::TimedVector pos;
+    for (int i = 0; i < 10; i++) {
+      awa.push_back(TimedValue<Angle<double> >(
+          at(i), Angle<double>::degrees(i)));
+      pos.push_back(TimedValue<GeographicPosition<double> >(
+          at(2*i), GeographicPosition<double>(
+              Angle<double>::degrees(10 + i), Angle<double>::degrees(50))));
+    }
+    auto dispatcher = std::make_shared<Dispatcher>();
+    dispatcher->insertValues<Angle<double> >(AWA, "NMEA2000", awa);
+    dispatcher->insertValues<GeographicPosition<double> >(GPS_POS, "NMEA2000", pos);
+    return NavDataset(dispatcher).fitBounds();
+  }
+}
+
+TEST(ColumnExportTest, Formatting) {
+  EXPECT_EQ("1.5", formatFixed(1.5, 6));
+  EXPECT_EQ("-0.25", formatFixed(-0.25, 2));
+  EXPECT_EQ("3", formatFixed(3.0, 6));
+  EXPECT_EQ("0.000001", formatFixed(0.000001, 6));
+  EXPECT_EQ("0", formatFixed(-0.0000004, 6));
+  EXPECT_EQ("0.33", formatFixed(1.0/3, 2));
+  EXPECT_EQ("", formatFixed(NAN, 6));
+  // Too large for the integer formatting: same format anyway.
+  EXPECT_EQ("100000000000000000000", formatFixed(1.0e20, 2));
+  EXPECT_EQ("100000000000000000000", formatFixed(1.0e20, 0));
+  EXPECT_EQ("12345678901.5", formatFixed(12345678901.5, 6));
+
+  // Much more data than the buffer.
+  std::stringstream ss;
+  {
+    CsvWriter csv(&ss, 64);
+    for (int i = 0; i < 1000; i++) {
+      csv.addInt(-i);
+      csv.endLine();
+    }
+  }
+  std::string line;
+  for (int i = 0; i < 1000; i++) {
+    std::getline(ss, line);
+    EXPECT_EQ(std::to_string(-i), line);
+  }
+}
+
+TEST(ColumnExportTest, Selection) {
+  NavDataset ds = makeDataset();
+
+  ColumnExportSettings settings;
+  settings.from = at(3);
+  settings.to = at(6);
+  std::vector<ChannelColumns> visited;
+  forEachChannelColumns(ds, settings, [&](const ChannelColumns &x) {
+    visited.push_back(x);
+  });
+  ASSERT_EQ(2, visited.size());
+
+  EXPECT_EQ(AWA, visited[0].code);
+  EXPECT_EQ(4, visited[0].rowCount());
+  EXPECT_EQ(at(3).toMilliSecondsSince1970(), visited[0].times[0]);
+  EXPECT_EQ(6.0, visited[0].values[0][3]);
+
+  EXPECT_EQ(GPS_POS, visited[1].code);
+  EXPECT_EQ((std::vector<std::string>{"lon", "lat"}), visited[1].names);
+  EXPECT_EQ(2, visited[1].rowCount());
+  EXPECT_NEAR(12.0, visited[1].values[0][0], 1.0e-9);
+
+  std::stringstream csv;
+  writeColumnsCsv(visited[1], 3, &csv);
+  EXPECT_EQ("time,lon,lat\n"
+      + std::to_string(at(4).toMilliSecondsSince1970()) + ",12,50\n"
+      + std::to_string(at(6).toMilliSecondsSince1970()) + ",13,50\n",
+      csv.str());
+
+  EXPECT_TRUE(parseChannelNames("pos", &settings.channels));
+  visited.clear();
+  forEachChannelColumns(ds, settings, [&](const ChannelColumns &x) {
+    visited.push_back(x);
+  });
+  ASSERT_EQ(1, visited.size());
+  EXPECT_EQ(GPS_POS, visited[0].code);
+
+  EXPECT_FALSE(parseChannelNames("awa,nonsense", &settings.channels));
+}
+
+TEST(ColumnExportTest, Npy) {
+  std::vector<double> values{1.0, -2.5, 3.25};
+  std::stringstream ss;
+  writeNpy(values, &ss);
+  std::string data = ss.str();
+
+  EXPECT_EQ(std::string("\x93NUMPY\x01\x00", 8), data.substr(0, 8));
+  int headerLength = (unsigned char)data[8] + 256*(unsigned char)data[9];
+  int offset = 10 + headerLength;
+  EXPECT_EQ(0, offset % 64);
+  EXPECT_EQ('\n', data[offset - 1]);
+  EXPECT_NE(std::string::npos, data.find("'shape': (3,)"));
+  ASSERT_EQ(offset + 3*sizeof(double), data.size());
+
+  double loaded[3];
+  memcpy(loaded, data.data() + offset, sizeof(loaded));
+  EXPECT_EQ(-2.5, loaded[1]);
+}
+
+TEST(ColumnExportTest, Files) {
+  ColumnExportSettings settings;
+  EXPECT_EQ(2, exportColumns(makeDataset(), settings, ColumnFormat::Csv,
+                             "/tmp"));
+  EXPECT_EQ(2, exportColumns(makeDataset(), settings, ColumnFormat::Npy,
+                             "/tmp"));
+  EXPECT_EQ(-1, exportColumns(makeDataset(), settings, ColumnFormat::Csv,
+                              "/nonexistent/ColumnExportTest"));
+  EXPECT_EQ(-1, exportColumns(makeDataset(), settings, ColumnFormat::Npy,
+                              "/nonexistent/ColumnExportTest"));
+}
@@ -0,0 +1,178 @@
+#include <server/nautical/FleetProcessor.h>
+
+#include <algorithm>
+#include <cstring>
+#include <errno.h>
+#include <iostream>
+#include <server/common/logging.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+
+namespace sail {
+
+namespace {
+
+double seconds(const struct timeval &t) {
+  return t.tv_sec + 1.0e-6 * t.tv_usec;
+}
+
+std::string trim(const std::string &s) {
+  auto begin = s.find_first_not_of(" \t\r");
+  if (begin == std::string::npos) {
+    return "";
+  }
+  return s.substr(begin, s.find_last_not_of(" \t\r") + 1 - begin);
+}
+
+}  // namespace
+
+std::string boatReportHeader() {
+  return "boat\tstatus\twall_s\tcpu_s\tmax_rss_mb";
+}
+
+std::ostream &operator<<(std::ostream &s, const BoatReport &report) {
+  s << report.boatId << "\t";
+  if (report.signal != 0) {
+    s << "signal " << report.signal;
+  } else if (report.exitCode != 0) {
+    s << "failed " << report.exitCode;
+  } else {
+    s << "ok";
+  }
+  return s << "\t" << report.wallSeconds
+    << "\t" << report.cpuSeconds
+    << "\t" << report.maxRssKb / 1024;
+}
+
+std::vector<std::string> readBoatIds(std::istream *src) {
+  std::vector<std::string> ids;
+  std::string line;
+  while (std::getline(*src, line)) {
+    std::string id = trim(line.substr(0, line.find('#')));
+    if (!id.empty()) {
+      ids.push_back(id);
+    }
+  }
+  return ids;
+}
+
+FleetProcessor::FleetProcessor(const FleetSettings &settings, Job job)
+  : _settings(settings), _job(job) { }
+
+int FleetProcessor::concurrency() const {
+  if (_settings.concurrency > 0) {
+    return _settings.concurrency;
+  }
+  return std::max(1, int(std::thread::hardware_concurrency()));
+}
+
+void FleetProcessor::enqueue(const std::string &boatId) {
+  _queue.push_back(boatId);
+}
+
+void FleetProcessor::startQueued() {
+  while (!_queue.empty() && running() < concurrency()) {
+    std::string boatId = _queue.front();
+    _queue.pop_front();
+    start(boatId);
+  }
+}
+
+void FleetProcessor::start(const std::string &boatId) {
+  // Whatever is buffered would otherwise be written by both processes.
+  std::cout.flush();
+  std::cerr.flush();
+
+  pid_t pid = fork();
+  if (pid < 0) {
+    LOG(ERROR) << "Cannot start a process for boat " << boatId
+      << ": " << strerror(errno);
+    BoatReport report;
+    report.boatId = boatId;
+    _reports.push_back(report);
+    if (_callback) {
+      _callback(report);
+    }
+    return;
+  }
+
+  if (pid == 0) {
+    if (_settings.maxMemoryMb > 0) {
+      struct rlimit limit;
+      limit.rlim_cur = limit.rlim_max = rlim_t(_settings.maxMemoryMb) << 20;
+      if (setrlimit(RLIMIT_AS, &limit) != 0) {
+        LOG(WARNING) << "Cannot limit the memory of boat " << boatId;
+      }
+    }
+    int code = _job(boatId);
+    std::cout.flush();
+    std::cerr.flush();
+    // Skip the static destructors and atexit handlers of the parent.
+    _exit(code);
+  }
+
+  LOG(INFO) << "Processing boat " << boatId << " in process " << pid;
+  _running[pid] = Worker{boatId, TimeStamp::now()};
+}
+
+void FleetProcessor::done(pid_t pid, int status, const struct rusage &usage) {
+  auto found = _running.find(pid);
+  if (found == _running.end()) {
+    return;
+  }
+
+  BoatReport report;
+  report.boatId = found->second.boatId;
+  report.wallSeconds = (TimeStamp::now() - found->second.start).seconds();
+  report.cpuSeconds = seconds(usage.ru_utime) + seconds(usage.ru_stime);
+  report.maxRssKb = usage.ru_maxrss;
+  if (WIFSIGNALED(status)) {
+    report.signal = WTERMSIG(status);
+  } else if (WIFEXITED(status)) {
+    report.exitCode = WEXITSTATUS(status);
+  }
+  _running.erase(found);
+
+  if (report.ok()) {
+    LOG(INFO) << "Boat " << report.boatId << " done in "
+      << report.wallSeconds << " s";
+  } else {
+    LOG(WARNING) << "Processing failed for boat " << report.boatId;
+  }
+  _reports.push_back(report);
+  if (_callback) {
+    _callback(report);
+  }
+}
+
+int FleetProcessor::poll(bool wait) {
+  startQueued();
+
+  int finished = 0;
+  while (!_running.empty()) {
+    int status = 0;
+    struct rusage usage;
+    pid_t pid = wait4(-1, &status, (wait && finished == 0 ? 0 : WNOHANG),
+                      &usage);
+    if (pid < 0 && errno == EINTR) {
+      continue;
+    }
+    if (pid <= 0) {
+      break;
+    }
+    done(pid, status, usage);
+    finished++;
+    startQueued();
+  }
+  return finished;
+}
+
+void FleetProcessor::finish() {
+  while (!_queue.empty() || !_running.empty()) {
+    poll(true);
+  }
+}
+
+}  // namespace sail
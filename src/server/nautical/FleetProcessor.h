@@ -0,0 +1,104 @@
+#ifndef SERVER_NAUTICAL_FLEETPROCESSOR_H_
+#define SERVER_NAUTICAL_FLEETPROCESSOR_H_
+
+#include <deque>
+#include <functional>
+#include <iosfwd>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <server/common/TimeStamp.h>
+#include <sys/resource.h>
+#include <sys/types.h>
+
+namespace sail {
+
+struct FleetSettings {
+  // The maximum number of boats processed at the same time.
+  // 0 means one per core.
+  int concurrency = 0;
+
+  // Address space limit of the process handling a boat, in megabytes.
+  // 0 means no limit.
+  int maxMemoryMb = 0;
+};
+
+// How the processing of a boat went.
+struct BoatReport {
+  std::string boatId;
+  int exitCode = -1;
+  // The signal that killed the worker, or 0.
+  int signal = 0;
+  double wallSeconds = 0;
+  double cpuSeconds = 0;
+  long maxRssKb = 0;
+
+  bool ok() const { return signal == 0 && exitCode == 0; }
+};
+
+std::ostream &operator<<(std::ostream &s, const BoatReport &report);
+
+// The header line matching operator<< for a BoatReport.
+std::string boatReportHeader();
+
+// Reads one boat id per line. Empty lines and text after '#' are ignored.
+std::vector<std::string> readBoatIds(std::istream *src);
+
+// Processes a queue of boats, several at the same time.
+//
+// Every boat is processed by calling 'job' in a process forked from
+// this one: a boat that crashes, asserts or runs out of memory does not
+// affect the others, and everything initialized before the fork (static
+// tables, loaded libraries) is shared with the workers instead of being
+// set up again for each boat.
+class FleetProcessor {
+ public:
+  // Runs in the worker process. Returns the exit code of the worker.
+  typedef std::function<int(const std::string& boatId)> Job;
+
+  // Called in this process each time a boat is done.
+  typedef std::function<void(const BoatReport&)> ReportCallback;
+
+  FleetProcessor(const FleetSettings &settings, Job job);
+
+  void setReportCallback(ReportCallback callback) { _callback = callback; }
+
+  void enqueue(const std::string &boatId);
+
+  // Starts queued boats while fewer than 'concurrency' are running,
+  // then collects the workers that are done. If 'wait' is true and
+  // some workers are running, blocks until at least one of them is done.
+  // Returns the number of boats that finished.
+  int poll(bool wait);
+
+  // Processes everything in the queue and waits for it.
+  void finish();
+
+  int running() const { return _running.size(); }
+  int queued() const { return _queue.size(); }
+
+  const std::vector<BoatReport> &reports() const { return _reports; }
+
+  int concurrency() const;
+ private:
+  struct Worker {
+    std::string boatId;
+    TimeStamp start;
+  };
+
+  void startQueued();
+  void start(const std::string &boatId);
+  void done(pid_t pid, int status, const struct rusage &usage);
+
+  FleetSettings _settings;
+  Job _job;
+  ReportCallback _callback;
+  std::deque<std::string> _queue;
+  std::map<pid_t, Worker> _running;
+  std::vector<BoatReport> _reports;
+};
+
+}  // namespace sail
+
+#endif  // SERVER_NAUTICAL_FLEETPROCESSOR_H_
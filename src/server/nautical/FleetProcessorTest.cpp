@@ -0,0 +1,64 @@
+#include <gtest/gtest.h>
+#include <server/nautical/FleetProcessor.h>
+#include <signal.h>
+#include <sstream>
+#include <vector>
+
+using namespace sail;
+
+TEST(FleetProcessorTest, ReadBoatIds) {
+  std::stringstream src("a\n\n  b  # comment\n# only a comment\nc\r\n");
+  EXPECT_EQ((std::vector<std::string>{"a", "b", "c"}), readBoatIds(&src));
+}
+
+TEST(FleetProcessorTest, ProcessAll) {
+  FleetSettings settings;
+  settings.concurrency = 2;
+  FleetProcessor fleet(settings, [](const std::string &boatId) {
+    if (boatId == "crash") {
+      raise(SIGKILL);
+    }
+    return boatId == "fail" ? 3 : 0;
+  });
+
+  int callbacks = 0;
+  fleet.setReportCallback([&](const BoatReport &) { callbacks++; });
+
+  for (auto id : {"a", "fail", "b", "crash", "c"}) {
+    fleet.enqueue(id);
+  }
+  EXPECT_EQ(5, fleet.queued());
+  fleet.finish();
+  EXPECT_EQ(0, fleet.queued());
+  EXPECT_EQ(0, fleet.running());
+  EXPECT_EQ(5, callbacks);
+
+  std::map<std::string, BoatReport> reports;
+  for (const auto &r : fleet.reports()) {
+    reports[r.boatId] = r;
+  }
+  ASSERT_EQ(5, reports.size());
+  EXPECT_TRUE(reports["a"].ok());
+  EXPECT_TRUE(reports["c"].ok());
+  EXPECT_FALSE(reports["fail"].ok());
+  EXPECT_EQ(3, reports["fail"].exitCode);
+  EXPECT_FALSE(reports["crash"].ok());
+  EXPECT_EQ(SIGKILL, reports["crash"].signal);
+}
+
+TEST(FleetProcessorTest, MemoryLimit) {
+  FleetSettings settings;
+  settings.maxMemoryMb = 256;
+  FleetProcessor fleet(settings, [](const std::string &) {
+    try {
+      std::vector<char> big(size_t(1) << 30, 1);
+      return int(big[12345]);
+    } catch (const std::bad_alloc &) {
+      return 2;
+    }
+  });
+  fleet.enqueue("big");
+  fleet.finish();
+  ASSERT_EQ(1, fleet.reports().size());
+  EXPECT_EQ(2, fleet.reports()[0].exitCode);
+}
@@ -497,6 +497,10 @@ FOREACH_CHANNEL(CHECK_CHANNEL)
   return result;
 }
 
+int64_t countSamples(const NavDataset &ds) {
+  return countSamples(ds.dispatcher().get());
+}
+
 const std::set<DataCode>& AllDataCodes() {
   static std::set<DataCode> all{
 #define CHANNEL_ITEM(HANDLE, CODE, SHORTNAME, TYPE, DESC) HANDLE,
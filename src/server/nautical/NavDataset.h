@@ -340,6 +340,10 @@ private:
 
 std::ostream &operator<<(std::ostream &s, const NavDataset &ds);
 
+// The number of samples of all channels and sources of the dispatcher,
+// also outside of the time bounds. See countSamples of DispatcherUtils.
+int64_t countSamples(const NavDataset &ds);
+
 } // namespace sail
 
 #endif /* SERVER_NAUTICAL_NAVDATASET_H_ */
@@ -65,43 +65,18 @@ namespace {
     return index;
   }
 
-  Arrayi lookUp(Array<Velocity<double> > bounds, Array<Velocity<double> > tws) {
-    return transduce(tws, trMap([&](Velocity<double> x) {return lookUp(bounds, x);}),
-        IntoArray<int>());
-  }
-
-  Array<Array<Velocity<double> > > groupVmg(int binCount, Arrayi bins, Array<Velocity<double> > vmg) {
-    Array<ArrayBuilder<Velocity<double> > > builders(binCount);
-    int count = vmg.size();
+  // we need at least 15 minutes of measurement at this wind speed
+  const int minSamplesPerBin = 15 * 60;
+
+  TargetSpeedSketch makeSketch(Array<Velocity<double> > tws,
+                               Array<Velocity<double> > vmg,
+                               Array<Velocity<double> > bounds) {
+    TargetSpeedSketch sketch(bounds);
+    int count = std::min(tws.size(), vmg.size());
     for (int i = 0; i < count; i++) {
-      int bin = bins[i];
-      if (bin != -1) {
-        builders[bin].add(vmg[i]);
-      }
-    }
-    Array<Array<Velocity<double> > > groups = transduce(
-        builders, trMap([=](ArrayBuilder<Velocity<double> > x) {return x.get();}),
-        IntoArray<Array<Velocity<double>>>());
-    for (int i = 0; i < binCount; i++) {
-      std::sort(groups[i].begin(), groups[i].end());
-    }
-    return groups;
-  }
-
-  void outputMedianValues(Array<Velocity<double> > data, Arrayd quantiles,
-                          int index, int minDataSize,
-                          Array<Array<Velocity<double> > > out) {
-    int qCount = quantiles.size();
-    LineKM map(0, 1.0, 0, data.size());
-    for (int i = 0; i < qCount; i++) {
-      if (data.size() >= minDataSize) {
-        int i2 = int(floor(map(quantiles[i])));
-        assert(0 <= i2 && i2 < data.size());
-        out[i][index] = data[i2];
-      } else {
-        out[i][index] = Velocity<double>::knots(NAN);
-      }
+      sketch.add(tws[i], vmg[i]);
     }
+    return sketch;
   }
 }
 
@@ -117,26 +92,53 @@ int lookUpForUnitTest(Array<Velocity<double> > bounds, Velocity<double> tws) {
 
 
 
+TargetSpeedSketch::TargetSpeedSketch(Array<Velocity<double> > bounds)
+  : _bounds(bounds), _bins(std::max(0, bounds.size() - 1)) { }
+
+void TargetSpeedSketch::add(Velocity<double> tws, Velocity<double> vmg) {
+  int bin = lookUp(_bounds, tws);
+  if (bin != -1) {
+    _bins[bin].add(vmg.knots());
+  }
+}
+
+void TargetSpeedSketch::merge(const TargetSpeedSketch &other) {
+  CHECK(binCount() == other.binCount());
+  for (int i = 0; i < binCount(); i++) {
+    _bins[i].merge(other._bins[i]);
+  }
+}
+
+int64_t TargetSpeedSketch::count() const {
+  int64_t total = 0;
+  for (const auto &bin : _bins) {
+    total += bin.count();
+  }
+  return total;
+}
+
 TargetSpeed::TargetSpeed(bool isUpwind_, Array<Velocity<double> > tws,
     Array<Velocity<double> > vmg,
-    Array<Velocity<double> > bounds, Arrayd quantiles_) {
+    Array<Velocity<double> > bounds, Arrayd quantiles_)
+  : TargetSpeed(isUpwind_, makeSketch(tws, vmg, bounds), quantiles_) { }
+
+TargetSpeed::TargetSpeed(bool isUpwind_, const TargetSpeedSketch &sketch,
+                         Arrayd quantiles_) {
   isUpwind = isUpwind_;
   quantiles = quantiles_;
 
-
-  Arrayi bins = lookUp(bounds, tws);
-  int binCount = bounds.size() - 1;
-  Array<Array<Velocity<double > > > groups = groupVmg(binCount, bins, vmg);
-
+  const Array<Velocity<double> > &bounds = sketch.bounds();
+  int binCount = sketch.binCount();
   int qCount = quantiles.size();
   binCenters = Array<Velocity<double> >(binCount);
   medianValues = Array<Array<Velocity<double> > >::fill(qCount, [=](int i) {return Array<Velocity<double> >(binCount);});
   for (int i = 0; i < binCount; i++) {
     binCenters[i] = (bounds[i] + bounds[i + 1]).scaled(0.5);
-    outputMedianValues(
-        groups[i], quantiles, i,
-        15 * 60, // we need at least 15 minutes of measurement at this wind speed
-        medianValues);
+    const QuantileSketch &bin = sketch.bin(i);
+    for (int q = 0; q < qCount; q++) {
+      medianValues[q][i] = Velocity<double>::knots(
+          bin.count() >= minSamplesPerBin ? bin.quantile(quantiles[q]) : NAN);
+    }
   }
 }
 
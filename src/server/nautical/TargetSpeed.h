@@ -10,18 +10,43 @@
 #define TARGETSPEED_H_
 
 #include <ostream>
+#include <server/common/QuantileSketch.h>
 #include <server/nautical/NavCompatibility.h>
 
 namespace sail {
 
 
+// The VMG samples of one or several sessions, grouped in TWS bins
+// delimited by 'bounds', as one QuantileSketch (in knots) per bin.
+// It is filled in a single pass over the samples, and the sketches of
+// different sessions can be merged to update a table incrementally.
+class TargetSpeedSketch {
+ public:
+  TargetSpeedSketch(Array<Velocity<double> > bounds);
+
+  // Samples with a TWS outside the bounds are ignored.
+  void add(Velocity<double> tws, Velocity<double> vmg);
+
+  void merge(const TargetSpeedSketch &other);
 
+  int binCount() const { return _bins.size(); }
+  const Array<Velocity<double> > &bounds() const { return _bounds; }
+  const QuantileSketch &bin(int i) const { return _bins[i]; }
+
+  // The number of samples within the bounds.
+  int64_t count() const;
+ private:
+  Array<Velocity<double> > _bounds;
+  std::vector<QuantileSketch> _bins;
+};
 
 class TargetSpeed {
  public:
   static Arrayd makeDefaultQuantiles();
   TargetSpeed(bool isUpwind_, Array<Velocity<double> > tws, Array<Velocity<double> > vmg,
           Array<Velocity<double> > bounds, Arrayd quantiles_ = makeDefaultQuantiles());
+  TargetSpeed(bool isUpwind_, const TargetSpeedSketch &sketch,
+              Arrayd quantiles_ = makeDefaultQuantiles());
 
   Array<Velocity<double> > binCenters;
   Array<Array<Velocity<double> > > medianValues;
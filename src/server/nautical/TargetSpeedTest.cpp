@@ -4,6 +4,9 @@
  */
 #include <server/nautical/TargetSpeed.h>
 #include <gtest/gtest.h>
+#include <algorithm>
+#include <cmath>
+#include <vector>
 
 
 
@@ -44,3 +47,68 @@ TEST(TargetSpeedTest, BoundsTest) {
 
 
 
+
+namespace {
+  // The table computed by sorting the samples of every bin.
+  Velocity<double> exactQuantile(Array<Velocity<double> > tws,
+                                 Array<Velocity<double> > vmg,
+                                 Velocity<double> lower, Velocity<double> upper,
+                                 double q) {
+    std::vector<double> values;
+    for (int i = 0; i < tws.size(); i++) {
+      if (lower <= tws[i] && tws[i] < upper) {
+        values.push_back(vmg[i].knots());
+      }
+    }
+    std::sort(values.begin(), values.end());
+    return Velocity<double>::knots(values[int(floor(q*values.size()))]);
+  }
+}
+
+TEST(TargetSpeedTest, SketchMatchesSorting) {
+  Array<Velocity<double> > bounds = makeBoundsFromBinCenters(3,
+      Velocity<double>::knots(4), Velocity<double>::knots(12));
+
+  const int n = 30000;
+  Array<Velocity<double> > tws(n), vmg(n);
+  for (int i = 0; i < n; i++) {
+    tws[i] = Velocity<double>::knots(2 + 14*((i*7919) % n)/double(n));
+    vmg[i] = Velocity<double>::knots(
+        0.4*tws[i].knots() + sin(0.37*i) + 0.1*cos(1.3*i));
+  }
+
+  TargetSpeed table(true, tws, vmg, bounds);
+  for (int bin = 0; bin < 3; bin++) {
+    for (int q = 0; q < table.quantileCount(); q++) {
+      EXPECT_NEAR(exactQuantile(tws, vmg, bounds[bin], bounds[bin + 1],
+                                table.quantiles[q]).knots(),
+                  table.medianValues[q][bin].knots(), 0.001);
+    }
+  }
+
+  // Sketches of separate sessions merge into the same table.
+  TargetSpeedSketch first(bounds), second(bounds);
+  for (int i = 0; i < n; i++) {
+    (i < n/3 ? first : second).add(tws[i], vmg[i]);
+  }
+  first.merge(second);
+  TargetSpeed merged(true, first);
+  for (int bin = 0; bin < 3; bin++) {
+    for (int q = 0; q < table.quantileCount(); q++) {
+      EXPECT_EQ(table.medianValues[q][bin].knots(),
+                merged.medianValues[q][bin].knots());
+    }
+  }
+}
+
+TEST(TargetSpeedTest, NotEnoughData) {
+  Array<Velocity<double> > bounds = makeBoundsFromBinCenters(2,
+      Velocity<double>::knots(0), Velocity<double>::knots(1));
+  TargetSpeedSketch sketch(bounds);
+  for (int i = 0; i < 100; i++) {
+    sketch.add(Velocity<double>::knots(0.1), Velocity<double>::knots(3));
+  }
+  EXPECT_EQ(100, sketch.count());
+  TargetSpeed table(false, sketch);
+  EXPECT_TRUE(std::isnan(table.medianValues[0][0].knots()));
+}
@@ -0,0 +1,1225 @@
+// Times the stages of the processing of the logs of a boat, and the
+// primitives that they are built on, on a synthetic season of logs
+// (see SeasonDataset.h), on log files in the formats that can be
+// imported, and on the directories of logs in datasets/.
+//
+// Usage: benchmarks_SeasonBenchmark [--sessions=20] [--session_hours=2]
+//          [--seed=1] [--import_dir=<dir>]... [--allocations]
+//          [Google Benchmark options]
+//
+// Primitive_ImportDirectory times the import of every directory given
+// with --import_dir or, by default, of every directory of datasets/.
+//
+// With --allocations, every benchmark is run once more to count the
+// heap allocations of the thread that runs it (allocs_per_iter in the
+// results). The threads that it starts are not counted.
+//
+// To compare two commits, run it on both with the options
+//
+//   --benchmark_out=before.json --benchmark_out_format=json
+//   --benchmark_context=commit=$(git rev-parse HEAD)
+//
+// (after.json for the second one) and compare the results with
+// tools/compare.py of Google Benchmark:
+//
+//   compare.py benchmarks before.json after.json
+//
+// The 'benchmarks' target of the build runs all of them and writes
+// benchmarks.json in the build directory. --benchmark_filter=Stage_ or
+// --benchmark_filter=Primitive_ runs only the stages or the primitives.
+//
+// The inputs are generated once, before the first benchmark that uses
+// them, and are not included in the times. The log files are written
+// to /tmp/benchmarks_SeasonBenchmark, which is removed at the end.
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <functional>
+#include <limits>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <boost/iostreams/device/file.hpp>
+#include <boost/iostreams/filter/bzip2.hpp>
+#include <boost/iostreams/filter/gzip.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+#include <Poco/File.h>
+#include <device/anemobox/Dispatcher.h>
+#include <device/anemobox/DispatcherUtils.h>
+#include <device/anemobox/logger/Logger.h>
+#include <device/anemobox/simulator/SimulateBox.h>
+#include <server/common/CsvParser.h>
+#include <server/common/DOMUtils.h>
+#include <server/common/Env.h>
+#include <server/common/StageProfiler.h>
+#include <server/common/string.h>
+#include <server/math/band/BandedIrls.h>
+#include <server/math/band/BandedIrlsUtils.h>
+#include <server/math/hmm/StateAssign.h>
+#include <server/nautical/ColumnExport.h>
+#include <server/nautical/NavCompatibility.h>
+#include <server/nautical/benchmarks/SeasonDataset.h>
+#include <server/nautical/calib/Calibrator.h>
+#include <server/nautical/calib/CalibratorTestData.h>
+#include <server/nautical/filters/SmoothGpsFilter.h>
+#include <server/nautical/grammars/WindOrientedGrammar.h>
+#include <server/nautical/logimport/CsvLoader.h>
+#include <server/nautical/logimport/LogAccumulator.h>
+#include <server/nautical/logimport/LogLoader.h>
+#include <server/nautical/logimport/Nmea0183Loader.h>
+#include <server/nautical/logimport/SailmonDbLoader.h>
+#include <server/nautical/tgtspeed/TargetSpeedFit.h>
+#include <server/nautical/tiles/NavTileGenerator.h>
+#include <third_party/sqlite/sqlite3.h>
+
+#ifdef WITH_LZMA_DECOMPRESSION
+#include <boost/iostreams/filter/lzma.hpp>
+#endif
+
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+using namespace sail;
+
+namespace {
+
+SeasonSettings seasonSettings;
+
+// The log files in 'importDir' are all loaded by
+// Primitive_LogLoaderLoad.
+const char tempDir[] = "/tmp/benchmarks_SeasonBenchmark";
+const char importDir[] = "/tmp/benchmarks_SeasonBenchmark/import";
+const char logFilename[] =
+  "/tmp/benchmarks_SeasonBenchmark/import/session.log";
+
+// The directories of Primitive_ImportDirectory.
+std::vector<std::string> importDirs;
+
+// The size of the generated text logs.
+const int64_t textBytes = 32*1024*1024;
+
+std::string tempPath(const std::string &name) {
+  return std::string(tempDir) + "/" + name;
+}
+
+// The inputs of the benchmarks, computed when first needed.
+
+NavDataset season() {
+  static NavDataset season = makeSeasonDataset(seasonSettings);
+  return season;
+}
+
+NavDataset mergedGps() {
+  static NavDataset merged = season().createMergedChannels(
+      std::set<DataCode>{GPS_POS, GPS_SPEED, GPS_BEARING},
+      Duration<>::seconds(0.01));
+  return merged;
+}
+
+NavDataset mergedWind() {
+  static NavDataset merged = mergedGps().createMergedChannels(
+      std::set<DataCode>{AWA, AWS, MAG_HEADING}, Duration<>::seconds(.3));
+  return merged;
+}
+
+WindOrientedGrammar &grammar() {
+  static WindOrientedGrammarSettings settings;
+  static WindOrientedGrammar grammar(settings);
+  return grammar;
+}
+
+std::shared_ptr<HTree> grammarTree() {
+  static std::shared_ptr<HTree> tree = grammar().parse(mergedWind());
+  return tree;
+}
+
+// One session, written with the logger, as a log file of the anemobox.
+const LogFile &sessionLog() {
+  static LogFile logged = []() {
+    SeasonSettings settings = seasonSettings;
+    settings.sessionCount = 1;
+    NavDataset session = makeSeasonDataset(settings);
+
+    ReplayDispatcher replay;
+    Logger logger(&replay);
+    replay.replay(session.dispatcher().get());
+    LogFile dst;
+    logger.flushTo(&dst);
+    return dst;
+  }();
+  return logged;
+}
+
+const std::string &savedSessionLog() {
+  static std::string filename = []() {
+    CHECK(Logger::save(logFilename, sessionLog()));
+    return std::string(logFilename);
+  }();
+  return filename;
+}
+
+// NMEA 0183 text, one second of sailing per iteration, with positions
+// that are not always timed and rudder angles timed by the sentences
+// before.
+const std::string &nmeaFilename() {
+  static std::string filename = []() {
+    std::string filename = std::string(importDir) + "/nmea.txt";
+    std::ofstream out(filename, std::ios::out | std::ios::binary);
+    int64_t written = 0;
+    char line[512];
+    for (int i = 0; written < textBytes; i++) {
+      int s = i % 86400;
+      int n = snprintf(line, sizeof(line),
+          "$IIRMC,%02d%02d%02d,A,4629.737,N,00639.791,E,03.6,188,200808,,,A*48\n"
+          "$IIMWV,%03d.0,R,10.5,N,A*00\n"
+          "$IIVHW,,,192,M,03.4,N,,*69\n"
+          "$IIXDR,A,%.1f,D,RUDDER*00\n"
+          "$IIGLL,4629.736,N,00639.790,E,,A,A*00\n"
+          "$IIVWR,030,L,07.8,N,,,,*73\n"
+          "$IIVLW,01330,N,000.0,N*4D\n",
+          s/3600, (s/60) % 60, s % 60, (i*7) % 360, 0.1*(i % 200) - 10.0);
+      out.write(line, n);
+      written += n;
+    }
+    return filename;
+  }();
+  return filename;
+}
+
+// The NMEA 0183 text, compressed as 'ext': "gz", "bz2" or "xz".
+const std::string &compressedNmeaFilename(const std::string &ext) {
+  namespace io = boost::iostreams;
+  static std::map<std::string, std::string> filenames;
+  std::string &filename = filenames[ext];
+  if (filename.empty()) {
+    filename = tempPath("nmea.txt." + ext);
+    io::filtering_ostream out;
+    if (ext == "gz") {
+      out.push(io::gzip_compressor());
+    } else if (ext == "bz2") {
+      out.push(io::bzip2_compressor());
+#ifdef WITH_LZMA_DECOMPRESSION
+    } else if (ext == "xz") {
+      out.push(io::lzma_compressor());
+#endif
+    } else {
+      LOG(FATAL) << "Unsupported compression: " << ext;
+    }
+    out.push(io::file_sink(
+        filename, std::ios_base::out | std::ios_base::binary));
+    std::ifstream src(nmeaFilename(), std::ios::in | std::ios::binary);
+    out << src.rdbuf();
+  }
+  return filename;
+}
+
+// An Expedition export, with a line per second.
+const std::string &csvFilename() {
+  static std::string filename = []() {
+    std::string filename = std::string(importDir) + "/expedition.csv";
+    std::ofstream file(filename);
+    file << "Utc,BSP,AWA,AWS,TWA,TWS,TWD,Lat,Lon,Cog,Sog,HDG,Heel,Rudder\n";
+    char line[256];
+    for (int i = 0; file.tellp() < textBytes; i++) {
+      double utc = 42500.0 + i/86400.0;
+      int n = snprintf(line, sizeof(line),
+          "%.8f,%.2f,%.1f,%.2f,%.1f,%.2f,%.1f,%.7f,%.7f,%.1f,%.2f,%.1f,"
+          "%.1f,%.1f\n",
+          utc, 6.5 + 0.01*(i % 100), -35.0 + (i % 70), 12.0 + 0.1*(i % 30),
+          -42.0 + (i % 80), 10.5, 221.0, 46.2 + 1.0e-6*i, 6.15 + 1.0e-6*i,
+          185.0, 6.4, 180.0 + (i % 20), -12.5, 2.5);
+      file.write(line, n);
+    }
+    return filename;
+  }();
+  return filename;
+}
+
+// An hour of a Sailmon database. The GPS date and time are logged
+// every second, and all the other values at 10 Hz, by two sensors.
+const std::string &sailmonDbFilename() {
+  static std::string filename = []() {
+    std::string filename = tempPath("sailmon.db");
+    sqlite3 *db = nullptr;
+    CHECK_EQ(SQLITE_OK, sqlite3_open(filename.c_str(), &db));
+    sqlite3_exec(db, "CREATE TABLE LogData (sensorId INTEGER, "
+                 "rawId INTEGER, value REAL, log_time INTEGER); "
+                 "BEGIN TRANSACTION;", nullptr, nullptr, nullptr);
+    sqlite3_stmt *insert = nullptr;
+    sqlite3_prepare_v2(db, "INSERT INTO LogData VALUES (?1, ?2, ?3, ?4)",
+                       -1, &insert, nullptr);
+    auto add = [&](int sensorId, int rawId, double value, int64_t logTime) {
+      sqlite3_bind_int(insert, 1, sensorId);
+      sqlite3_bind_int(insert, 2, rawId);
+      sqlite3_bind_double(insert, 3, value);
+      sqlite3_bind_int64(insert, 4, logTime);
+      sqlite3_step(insert);
+      sqlite3_reset(insert);
+    };
+
+    const int day = 17438;  // 2017-09-29
+    const int startOfDay = 12*3600;
+    const int valueIds[] = {8, 13, 14, 17, 19, 21, 28, 29, 30, 31, 32, 39};
+    for (int64_t t = 0; t < 3600*1000; t += 100) {
+      for (int sensor = 1; sensor <= 2; sensor++) {
+        if (t % 1000 == 0) {
+          add(sensor, 0, day, t);
+          add(sensor, 1, startOfDay + t/1000, t);
+        }
+        double x = 0.001*t;
+        add(sensor, 4, 46.2 + 1.0e-6*x, t);
+        add(sensor, 5, 6.15 + 1.0e-6*x, t);
+        for (int rawId : valueIds) {
+          add(sensor, rawId, 10 + 5*sin(0.01*x + rawId), t);
+        }
+      }
+    }
+    sqlite3_finalize(insert);
+    sqlite3_exec(db, "COMMIT;", nullptr, nullptr, nullptr);
+    sqlite3_close(db);
+    return filename;
+  }();
+  return filename;
+}
+
+template <DataCode Code>
+const TimedSampleCollection<typename TypeForCode<Code>::type> &values(
+    const char *source) {
+  return season().dispatcher()->values<Code>(source);
+}
+
+// 'count' times spread over the 50 Hz heading, in a pseudo-random
+// order that is the same on every platform.
+std::vector<TimeStamp> queryTimes(int count) {
+  const auto &headings = values<MAG_HEADING>(
+      SeasonSettings::nmea2000Source).samples();
+  TimeStamp first = headings.front().time;
+  double span = (headings.back().time - first).seconds();
+  std::vector<TimeStamp> queries(count);
+  uint32_t x = 1;
+  for (auto &q : queries) {
+    x = 1664525*x + 1013904223;
+    q = first + Duration<double>::seconds(span*(x*(1.0/4294967296.0)));
+  }
+  return queries;
+}
+
+void setSamples(benchmark::State &state, int64_t in, int64_t out) {
+  state.SetItemsProcessed(state.iterations()*in);
+  state.counters["samples_in"] = in;
+  state.counters["samples_out"] = out;
+}
+
+int64_t fileSize(const std::string &filename) {
+  std::ifstream file(filename, std::ios::binary | std::ios::ate);
+  return file ? int64_t(file.tellg()) : 0;
+}
+
+// The size of a file, or of all the files of a directory.
+int64_t totalSize(const std::string &path) {
+  Poco::File file(path);
+  if (!file.isDirectory()) {
+    return fileSize(path);
+  }
+  std::vector<std::string> names;
+  file.list(names);
+  int64_t total = 0;
+  for (const auto &name : names) {
+    total += totalSize(path + "/" + name);
+  }
+  return total;
+}
+
+// The stages, in the order of BoatLogProcessor.
+
+void Stage_LoadLogs(benchmark::State &state) {
+  const std::string &filename = savedSessionLog();
+  int64_t out = 0;
+  for (auto _ : state) {
+    LogLoader loader;
+    loader.loadFile(filename);
+    NavDataset loaded = loader.takeNavDataset();
+    out = countSamples(loaded);
+  }
+  state.SetBytesProcessed(state.iterations()*fileSize(filename));
+  setSamples(state, out, out);
+}
+BENCHMARK(Stage_LoadLogs)->Unit(benchmark::kMillisecond);
+
+void Stage_MergeGpsChannels(benchmark::State &state) {
+  NavDataset input = season();
+  int64_t out = 0;
+  for (auto _ : state) {
+    NavDataset merged = input.createMergedChannels(
+        std::set<DataCode>{GPS_POS, GPS_SPEED, GPS_BEARING},
+        Duration<>::seconds(0.01));
+    out = countSamples(merged);
+  }
+  setSamples(state, countSamples(input), out);
+}
+BENCHMARK(Stage_MergeGpsChannels)->Unit(benchmark::kMillisecond);
+
+void Stage_FilterGps(benchmark::State &state) {
+  NavDataset input = mergedGps();
+  int64_t out = 0;
+  for (auto _ : state) {
+    DOM::Node noReport;
+    GpsFilterResults results = filterGpsData(input, &noReport);
+    out = results.positions.size();
+  }
+  setSamples(state, input.samples<GPS_POS>().size(), out);
+}
+BENCHMARK(Stage_FilterGps)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+void Stage_MergeWindChannels(benchmark::State &state) {
+  NavDataset input = mergedGps();
+  int64_t out = 0;
+  for (auto _ : state) {
+    NavDataset merged = input.createMergedChannels(
+        std::set<DataCode>{AWA, AWS, MAG_HEADING}, Duration<>::seconds(.3));
+    out = countSamples(merged);
+  }
+  setSamples(state, countSamples(input), out);
+}
+BENCHMARK(Stage_MergeWindChannels)->Unit(benchmark::kMillisecond);
+
+void Stage_ParseGrammar(benchmark::State &state) {
+  NavDataset input = mergedWind();
+  int64_t out = 0;
+  for (auto _ : state) {
+    std::shared_ptr<HTree> tree = grammar().parse(input);
+    out = tree ? tree->count() : 0;
+  }
+  setSamples(state, input.samples<GPS_POS>().size(), out);
+}
+BENCHMARK(Stage_ParseGrammar)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+void Stage_Calibrate(benchmark::State &state) {
+  NavDataset input = mergedWind();
+  std::shared_ptr<HTree> tree = grammarTree();
+  int64_t out = 0;
+  for (auto _ : state) {
+    Calibrator calibrator(grammar());
+    calibrator.calibrate(input, tree, "benchmark");
+    out = calibrator.maneuverCount();
+  }
+  setSamples(state, countSamples(input), out);
+}
+BENCHMARK(Stage_Calibrate)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+void Stage_SimulateTrueWind(benchmark::State &state) {
+  NavDataset input = mergedWind();
+  Calibrator calibrator(grammar());
+  int64_t out = 0;
+  for (auto _ : state) {
+    NavDataset simulated = calibrator.simulate(input);
+    out = countSamples(simulated);
+  }
+  setSamples(state, countSamples(input), out);
+}
+BENCHMARK(Stage_SimulateTrueWind)->Unit(benchmark::kMillisecond);
+
+// The tiles of the whole season as a single curve, without uploading
+// them. The parameters are the defaults of TileGeneratorParameters.
+void Stage_GenerateTiles(benchmark::State &state) {
+  NavDataset input = mergedWind();
+  int64_t out = 0;
+  for (auto _ : state) {
+    Array<Nav> navs = NavCompat::makeArray(input);
+    out = 0;
+    for (const auto &tile : tilesForNav(navs, 17)) {
+      out += generateTiles(tile.first, navs, tile.second,
+                           32, Duration<>::minutes(1)).size();
+    }
+  }
+  setSamples(state, input.samples<GPS_POS>().size(), out);
+}
+BENCHMARK(Stage_GenerateTiles)->Unit(benchmark::kMillisecond);
+
+// The primitives.
+
+// The 50 Hz heading, a minute at a time, as the log loaders insert it.
+void Primitive_TimedSampleCollectionInsert(benchmark::State &state) {
+  const auto &samples = values<MAG_HEADING>(
+      SeasonSettings::nmea2000Source).samples();
+  const int chunkSize = 3000;
+  for (auto _ : state) {
+    TimedSampleCollection<Angle<double>> dst;
+    for (size_t i = 0; i < samples.size(); i += chunkSize) {
+      dst.insert(TimedSampleCollection<Angle<double>>::TimedVector(
+          samples.begin() + i,
+          samples.begin() + std::min(samples.size(), i + chunkSize)));
+    }
+    benchmark::DoNotOptimize(dst.size());
+  }
+  state.SetItemsProcessed(state.iterations()*samples.size());
+}
+BENCHMARK(Primitive_TimedSampleCollectionInsert)
+  ->Unit(benchmark::kMillisecond);
+
+// The 50 Hz heading, a sample at a time, as the dispatcher receives it.
+void Primitive_TimedSampleCollectionAppend(benchmark::State &state) {
+  const auto &samples = values<MAG_HEADING>(
+      SeasonSettings::nmea2000Source).samples();
+  for (auto _ : state) {
+    TimedSampleCollection<Angle<double>> dst;
+    for (const auto &x : samples) {
+      dst.append(x);
+    }
+    benchmark::DoNotOptimize(dst.size());
+  }
+  state.SetItemsProcessed(state.iterations()*samples.size());
+}
+BENCHMARK(Primitive_TimedSampleCollectionAppend)
+  ->Unit(benchmark::kMillisecond);
+
+// The nearest 50 Hz heading at times spread over the season.
+void Primitive_TimedSampleCollectionLookup(benchmark::State &state) {
+  const auto &headings = values<MAG_HEADING>(SeasonSettings::nmea2000Source);
+  const int queryCount = 1000000;
+  std::vector<TimeStamp> queries = queryTimes(queryCount);
+  for (auto _ : state) {
+    int found = 0;
+    for (const auto &q : queries) {
+      found += headings.nearestTimedValue(q).defined();
+    }
+    benchmark::DoNotOptimize(found);
+  }
+  state.SetItemsProcessed(state.iterations()*queryCount);
+}
+BENCHMARK(Primitive_TimedSampleCollectionLookup)
+  ->Unit(benchmark::kMillisecond);
+
+template <DataCode Code>
+int64_t countSamples(const std::shared_ptr<DispatchData> &data) {
+  return toTypedDispatchData<Code>(data.get())->dispatcher()->values().size();
+}
+
+template <DataCode Code>
+void Primitive_MergeChannels(benchmark::State &state) {
+  const Dispatcher *d = season().dispatcher().get();
+  const auto &sources = d->allSources().at(Code);
+  int64_t in = 0;
+  for (const auto &kv : sources) {
+    in += countSamples<Code>(kv.second);
+  }
+  int64_t out = 0;
+  for (auto _ : state) {
+    auto merged = mergeChannels(Code, "merged", d->sourcePriority(), sources);
+    out = countSamples<Code>(merged);
+  }
+  setSamples(state, in, out);
+}
+BENCHMARK_TEMPLATE(Primitive_MergeChannels, GPS_POS)
+  ->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(Primitive_MergeChannels, MAG_HEADING)
+  ->Unit(benchmark::kMillisecond);
+
+// Whether the boat is upwind or downwind, on starboard or port,
+// from the apparent wind angle at 1 Hz.
+class PointOfSail : public StateAssign {
+ public:
+  PointOfSail(const TimedSampleCollection<Angle<double>> &awa)
+    : _awa(awa.samples()), _pred(listStateInds()) {}
+
+  double getStateCost(int stateIndex, int timeIndex) override {
+    static const double nominalAwa[] = {30, 330, 150, 210};
+    return std::abs(_awa[timeIndex].value.directionDifference(
+        Angle<double>::degrees(nominalAwa[stateIndex])).degrees());
+  }
+
+  double getTransitionCost(int from, int to, int fromTimeIndex) override {
+    return from == to ? 0.0 : 300.0;
+  }
+
+  int getStateCount() override {return 4;}
+  int getLength() override {return _awa.size();}
+
+  Arrayi getPrecedingStates(int stateIndex, int timeIndex) override {
+    return _pred;
+  }
+ private:
+  const TimedSampleCollection<Angle<double>>::TimedVector &_awa;
+  Arrayi _pred;
+};
+
+void Primitive_StateAssignSolve(benchmark::State &state) {
+  PointOfSail problem(values<AWA>(SeasonSettings::nmea0183Source));
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(problem.solve().size());
+  }
+  state.SetItemsProcessed(state.iterations()*problem.getLength());
+}
+BENCHMARK(Primitive_StateAssignSolve)->Unit(benchmark::kMillisecond);
+
+Eigen::Matrix<double, 1, 1> mat1x1(double x) {
+  Eigen::Matrix<double, 1, 1> m;
+  m(0, 0) = x;
+  return m;
+}
+
+// Robust smoothing of the first samples of the water speed, building
+// the costs and solving.
+void Primitive_BandedIrlsSolve(benchmark::State &state) {
+  using namespace BandedIrls;
+  const auto &speeds = values<WAT_SPEED>(
+      SeasonSettings::nmea0183Source).samples();
+  int n = std::min(int(state.range(0)), int(speeds.size()));
+  Settings settings;
+  Eigen::Matrix<double, 1, 3> secondOrder;
+  secondOrder << 1, -2, 1;
+  for (auto _ : state) {
+    ExponentialWeighting weights(settings.iterations, 0.1, 10000.0);
+    auto regularization = std::make_shared<StaticCostArray<1, 3, 1>>();
+    regularization->reserve(n - 2);
+    for (int i = 0; i < n - 2; i++) {
+      regularization->add(i, 10.0*secondOrder, mat1x1(0.0));
+    }
+    auto data = std::make_shared<RobustCostArray<1, 1, 1>>(weights, 0.5);
+    for (int i = 0; i < n; i++) {
+      data->add(i, mat1x1(1.0), mat1x1(speeds[i].value.knots()));
+    }
+    Results results = solve(settings, {regularization, data});
+    benchmark::DoNotOptimize(results.X.rows());
+  }
+  state.SetItemsProcessed(state.iterations()*n);
+}
+BENCHMARK(Primitive_BandedIrlsSolve)
+  ->Arg(1 << 12)->Arg(1 << 16)->Unit(benchmark::kMillisecond);
+
+// The session of the calibration tests, with more tacks.
+NavDataset tackingSession() {
+  static NavDataset session = CalibratorTestData::makeTackingSession(200);
+  return session;
+}
+
+std::shared_ptr<HTree> tackingSessionTree() {
+  static std::shared_ptr<HTree> tree =
+    Calibrator().grammar().parse(tackingSession());
+  return tree;
+}
+
+// calibrate() or, if 'full', calibrateFull(), with range(0) threads or
+// one per core if 0.
+void Primitive_Calibrate(benchmark::State &state, bool full) {
+  NavDataset navs = tackingSession();
+  std::shared_ptr<HTree> tree = tackingSessionTree();
+  int64_t out = 0;
+  for (auto _ : state) {
+    Calibrator calibrator;
+    calibrator.setThreadCount(state.range(0));
+    if (full) {
+      calibrateFull(&calibrator, navs, tree, "00000000");
+    } else {
+      calibrator.calibrate(navs, tree, "00000000");
+    }
+    out = calibrator.maneuverCount();
+  }
+  setSamples(state, countSamples(navs), out);
+}
+BENCHMARK_CAPTURE(Primitive_Calibrate, calibrate, false)->Arg(1)->Arg(0)
+  ->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK_CAPTURE(Primitive_Calibrate, calibrateFull, true)->Arg(1)->Arg(0)
+  ->Unit(benchmark::kMillisecond)->UseRealTime();
+
+// Samples of boat speed over a polar, in 200 sessions of 20000 samples.
+const int polarSessionCount = 200;
+const int polarSessionSamples = 20000;
+
+TargetSpeedParam polarParam() {
+  return TargetSpeedParam(true, false, 36, 27, Velocity<double>::knots(26));
+}
+
+struct PolarSamples {
+  Array<Angle<double>> twa;
+  Array<Velocity<double>> tws, boatSpeed;
+};
+
+const PolarSamples &polarSamples() {
+  static PolarSamples samples = []() {
+    int n = polarSessionCount*polarSessionSamples;
+    PolarSamples dst{Array<Angle<double>>(n),
+                     Array<Velocity<double>>(n), Array<Velocity<double>>(n)};
+    for (int k = 0; k < n; k++) {
+      auto a = Angle<double>::degrees(180*(1 + sin(0.731*k)));
+      auto w = Velocity<double>::knots(12*(1 + sin(0.377*k + 1.0)));
+      dst.twa[k] = a;
+      dst.tws[k] = w;
+      dst.boatSpeed[k] = 0.25*(1.0 - cos(a))*w
+        + Velocity<double>::knots(0.2*sin(2.3*k));
+    }
+    return dst;
+  }();
+  return samples;
+}
+
+TargetSpeedStats polarStats(int fromSession, int toSession) {
+  const PolarSamples &samples = polarSamples();
+  TargetSpeedStats stats(polarParam());
+  for (int k = fromSession*polarSessionSamples;
+       k < toSession*polarSessionSamples; k++) {
+    stats.add(samples.twa[k], samples.tws[k], samples.boatSpeed[k]);
+  }
+  return stats;
+}
+
+// Fitting the polar to all the samples.
+void Primitive_TargetSpeedRefit(benchmark::State &state) {
+  const PolarSamples &samples = polarSamples();
+  TargetSpeedParam param = polarParam();
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(fitTargetSpeedFunction(
+        param, samples.twa, samples.tws, samples.boatSpeed).vertices());
+  }
+  state.SetItemsProcessed(state.iterations()*samples.twa.size());
+}
+BENCHMARK(Primitive_TargetSpeedRefit)->Unit(benchmark::kMillisecond);
+
+// Updating the polar of all the sessions but the last one with the
+// statistics of the last one.
+void Primitive_TargetSpeedAddSession(benchmark::State &state) {
+  TargetSpeedStats history = polarStats(0, polarSessionCount - 1);
+  TargetSpeedFitter fitter(polarParam());
+  fitter.fit(history);
+  int iterations = 0;
+  for (auto _ : state) {
+    state.PauseTiming();
+    TargetSpeedStats updated = history;
+    TargetSpeedFitter updatedFitter = fitter;
+    state.ResumeTiming();
+    updated.add(polarStats(polarSessionCount - 1, polarSessionCount));
+    benchmark::DoNotOptimize(updatedFitter.fit(updated).vertices());
+    iterations = updatedFitter.iterationCount();
+  }
+  state.SetItemsProcessed(state.iterations()*polarSessionSamples);
+  state.counters["fit_iterations"] = iterations;
+}
+BENCHMARK(Primitive_TargetSpeedAddSession)->Unit(benchmark::kMillisecond);
+
+// The true wind of the season, estimated as on the anemobox.
+void Primitive_SimulateBox(benchmark::State &state, SimulateBoxMode mode) {
+  NavDataset input = season();
+  std::string boatDat = std::string(Env::SOURCE_DIR)
+    + "/src/device/Arduino/NMEAStats/test/boat.dat";
+  int64_t out = 0;
+  for (auto _ : state) {
+    out = SimulateBox(boatDat, input, mode).samples<TWS>().size();
+  }
+  setSamples(state, countSamples(input), out);
+}
+BENCHMARK_CAPTURE(Primitive_SimulateBox, Replay, SimulateBoxMode::Replay)
+  ->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK_CAPTURE(Primitive_SimulateBox, Batch, SimulateBoxMode::Batch)
+  ->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK_CAPTURE(Primitive_SimulateBox, Fast, SimulateBoxMode::Fast)
+  ->Unit(benchmark::kMillisecond)->UseRealTime();
+
+void Primitive_LoggerSave(benchmark::State &state) {
+  const LogFile &logged = sessionLog();
+  for (auto _ : state) {
+    CHECK(Logger::save(logFilename, logged));
+  }
+  state.SetBytesProcessed(state.iterations()*fileSize(logFilename));
+}
+BENCHMARK(Primitive_LoggerSave)->Unit(benchmark::kMillisecond);
+
+void Primitive_LoggerRead(benchmark::State &state) {
+  const std::string &filename = savedSessionLog();
+  for (auto _ : state) {
+    LogFile logged;
+    CHECK(Logger::read(filename, &logged));
+    benchmark::DoNotOptimize(logged.stream_size());
+  }
+  state.SetBytesProcessed(state.iterations()*fileSize(filename));
+}
+BENCHMARK(Primitive_LoggerRead)->Unit(benchmark::kMillisecond);
+
+// The primitives of the log import.
+
+// The previous implementation of LogLoader::loadFile for compressed
+// files: uncompressing them to a temporary file with an external program.
+void Primitive_LoadCompressedNmea0183ThroughFile(
+    benchmark::State &state, const char *ext, const char *uncompress) {
+  const std::string &filename = compressedNmeaFilename(ext);
+  std::string tmp = tempPath("uncompressed.txt");
+  std::string command = std::string(uncompress)
+    + " < '" + filename + "' > '" + tmp + "'";
+  for (auto _ : state) {
+    LogAccumulator acc;
+    CHECK(system(command.c_str()) == 0);
+    Nmea0183Loader::loadNmea0183File(tmp, &acc);
+    std::remove(tmp.c_str());
+  }
+  state.SetBytesProcessed(state.iterations()*fileSize(nmeaFilename()));
+}
+BENCHMARK_CAPTURE(Primitive_LoadCompressedNmea0183ThroughFile,
+                  gz, "gz", "gunzip")
+  ->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK_CAPTURE(Primitive_LoadCompressedNmea0183ThroughFile,
+                  bz2, "bz2", "bunzip2")
+  ->Unit(benchmark::kMillisecond)->UseRealTime();
+#ifdef WITH_LZMA_DECOMPRESSION
+BENCHMARK_CAPTURE(Primitive_LoadCompressedNmea0183ThroughFile,
+                  xz, "xz", "unxz")
+  ->Unit(benchmark::kMillisecond)->UseRealTime();
+#endif
+
+// Decompressing in-process while parsing, as LogLoader does.
+void Primitive_LoadCompressedNmea0183(
+    benchmark::State &state, const char *ext) {
+  const std::string &filename = compressedNmeaFilename(ext);
+  for (auto _ : state) {
+    LogLoader loader;
+    CHECK(loader.loadFile(filename));
+  }
+  state.SetBytesProcessed(state.iterations()*fileSize(nmeaFilename()));
+}
+BENCHMARK_CAPTURE(Primitive_LoadCompressedNmea0183, gz, "gz")
+  ->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK_CAPTURE(Primitive_LoadCompressedNmea0183, bz2, "bz2")
+  ->Unit(benchmark::kMillisecond)->UseRealTime();
+#ifdef WITH_LZMA_DECOMPRESSION
+BENCHMARK_CAPTURE(Primitive_LoadCompressedNmea0183, xz, "xz")
+  ->Unit(benchmark::kMillisecond)->UseRealTime();
+#endif
+
+void Primitive_Nmea0183LoadStream(benchmark::State &state) {
+  const std::string &filename = nmeaFilename();
+  for (auto _ : state) {
+    LogAccumulator acc;
+    std::ifstream file(filename, std::ios::in | std::ios::binary);
+    Nmea0183Loader::loadNmea0183Stream(&file, &acc,
+        Nmea0183Loader::getDefaultSourceName());
+  }
+  state.SetBytesProcessed(state.iterations()*fileSize(filename));
+}
+BENCHMARK(Primitive_Nmea0183LoadStream)->Unit(benchmark::kMillisecond);
+
+// The chunks of the file parsed in parallel by range(0) threads. The
+// chunks are smaller than by default, so that there are enough of them.
+void Primitive_Nmea0183LoadFile(benchmark::State &state) {
+  const std::string &filename = nmeaFilename();
+  Nmea0183Loader::Nmea0183ParallelSettings settings;
+  settings.threadCount = state.range(0);
+  settings.chunkBytes = textBytes/8;
+  for (auto _ : state) {
+    LogAccumulator acc;
+    Nmea0183Loader::loadNmea0183File(filename, &acc, settings);
+  }
+  state.SetBytesProcessed(state.iterations()*fileSize(filename));
+}
+BENCHMARK(Primitive_Nmea0183LoadFile)->Arg(1)->Arg(2)->Arg(4)
+  ->Unit(benchmark::kMillisecond)->UseRealTime();
+
+// Splitting the file into a table of strings, as the CSV loader
+// used to do first.
+void Primitive_CsvParse(benchmark::State &state) {
+  const std::string &filename = csvFilename();
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(parseCsv(filename).rows());
+  }
+  state.SetBytesProcessed(state.iterations()*fileSize(filename));
+}
+BENCHMARK(Primitive_CsvParse)->Unit(benchmark::kMillisecond);
+
+void Primitive_CsvLoad(benchmark::State &state) {
+  const std::string &filename = csvFilename();
+  for (auto _ : state) {
+    LogAccumulator acc;
+    CHECK(loadCsv(filename, &acc));
+  }
+  state.SetBytesProcessed(state.iterations()*fileSize(filename));
+}
+BENCHMARK(Primitive_CsvLoad)->Unit(benchmark::kMillisecond);
+
+// On range(0) connections, or one per core if 0.
+void Primitive_SailmonDbLoad(benchmark::State &state) {
+  const std::string &filename = sailmonDbFilename();
+  for (auto _ : state) {
+    LogAccumulator acc;
+    CHECK(sailmonDbLoad(filename, &acc, state.range(0)));
+  }
+  state.SetBytesProcessed(state.iterations()*fileSize(filename));
+}
+BENCHMARK(Primitive_SailmonDbLoad)->Arg(1)->Arg(0)
+  ->Unit(benchmark::kMillisecond)->UseRealTime();
+
+// The files of the import directory, with the format of every file
+// guessed from its first bytes if range(0) is 1, or found by trying
+// every loader in turn until one accepts the file.
+void Primitive_LogLoaderLoad(benchmark::State &state) {
+  int64_t bytes = fileSize(savedSessionLog()) + fileSize(nmeaFilename())
+    + fileSize(csvFilename());
+  for (auto _ : state) {
+    LogLoader loader;
+    loader.setDetectFormat(state.range(0) != 0);
+    CHECK(loader.load(std::string(importDir)));
+  }
+  state.SetBytesProcessed(state.iterations()*bytes);
+}
+BENCHMARK(Primitive_LogLoaderLoad)->Arg(0)->Arg(1)
+  ->Unit(benchmark::kMillisecond);
+
+// The total time to import one of 'importDirs', with the format of
+// every file found as in Primitive_LogLoaderLoad. Registered in main,
+// once per directory. The files that cannot be loaded are skipped, as
+// by the import.
+void Primitive_ImportDirectory(benchmark::State &state,
+                               const std::string &dir) {
+  for (auto _ : state) {
+    LogLoader loader;
+    loader.setDetectFormat(state.range(0) != 0);
+    loader.load(dir);
+  }
+  state.SetBytesProcessed(state.iterations()*totalSize(dir));
+}
+
+// Building the dataset from a loader that has loaded a session, by
+// moving the samples out of it or, if 'copy', by copying them.
+//
+// rss_growth_kb is how much the resident memory grows while building
+// the dataset, at most over the iterations. With glibc, the memory
+// freed by the previous iterations is first returned to the system,
+// so that the dataset cannot reuse it. peak_rss_kb is the peak
+// resident memory of the process at the end. The peak never decreases,
+// so compare it between the modes by running each one in its own
+// process, with --benchmark_filter.
+void Primitive_NavDatasetFromLoader(benchmark::State &state, bool copy) {
+  const std::string &filename = savedSessionLog();
+  int64_t out = 0;
+  long rssGrowthKb = 0;
+  for (auto _ : state) {
+    state.PauseTiming();
+    LogLoader loader;
+    loader.loadFile(filename);
+#ifdef __GLIBC__
+    malloc_trim(0);
+#endif
+    long rssBeforeKb = currentRssKb();
+    state.ResumeTiming();
+    NavDataset ds = copy ? loader.makeNavDataset() : loader.takeNavDataset();
+    state.PauseTiming();
+    rssGrowthKb = std::max(rssGrowthKb, currentRssKb() - rssBeforeKb);
+    out = countSamples(ds);
+    state.ResumeTiming();
+  }
+  setSamples(state, out, out);
+  state.counters["rss_growth_kb"] = rssGrowthKb;
+  state.counters["peak_rss_kb"] = peakRssKb();
+}
+BENCHMARK_CAPTURE(Primitive_NavDatasetFromLoader, move, false)
+  ->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(Primitive_NavDatasetFromLoader, copy, true)
+  ->Unit(benchmark::kMillisecond);
+
+// Counts the bytes written to it.
+class CountingBuffer : public std::streambuf {
+ public:
+  int64_t count = 0;
+ protected:
+  std::streamsize xsputn(const char *, std::streamsize n) override {
+    count += n;
+    return n;
+  }
+  int overflow(int c) override {
+    count++;
+    return c;
+  }
+};
+
+typedef std::function<void(const ChannelColumns &, std::ostream *)>
+  ColumnWriter;
+
+void writeCsv(const ChannelColumns &columns, std::ostream *dst) {
+  writeColumnsCsv(columns, ColumnExportSettings().decimals, dst);
+}
+
+void writeColumnsNpy(const ChannelColumns &columns, std::ostream *dst) {
+  writeNpy(columns.times, dst);
+  for (const auto &column : columns.values) {
+    writeNpy(column, dst);
+  }
+}
+
+// Every value formatted through a stringstream, as the row export
+// of exportNavs does.
+void writeWithStringstream(const ChannelColumns &columns, std::ostream *dst) {
+  for (int i = 0; i < columns.rowCount(); i++) {
+    *dst << columns.times[i];
+    for (const auto &column : columns.values) {
+      std::stringstream ss;
+      ss.precision(std::numeric_limits<double>::max_digits10);
+      ss << column[i];
+      *dst << "," << ss.str();
+    }
+    *dst << "\n";
+  }
+}
+
+// All the channels of the season, written by 'write'.
+void Primitive_ColumnExport(benchmark::State &state, ColumnWriter write) {
+  NavDataset input = season();
+  ColumnExportSettings settings;
+  int64_t bytes = 0;
+  for (auto _ : state) {
+    CountingBuffer buffer;
+    std::ostream dst(&buffer);
+    forEachChannelColumns(input, settings,
+        [&](const ChannelColumns &columns) {
+      write(columns, &dst);
+    });
+    bytes = buffer.count;
+  }
+  state.SetBytesProcessed(state.iterations()*bytes);
+}
+BENCHMARK_CAPTURE(Primitive_ColumnExport, csv, &writeCsv)
+  ->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(Primitive_ColumnExport, npy, &writeColumnsNpy)
+  ->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(Primitive_ColumnExport, stringstream,
+                  &writeWithStringstream)
+  ->Unit(benchmark::kMillisecond);
+
+// The times of the 50 Hz heading.
+const std::vector<TimeStamp> &headingTimes() {
+  static std::vector<TimeStamp> times = []() {
+    std::vector<TimeStamp> times;
+    for (const auto &x : values<MAG_HEADING>(
+             SeasonSettings::nmea2000Source).samples()) {
+      times.push_back(x.time);
+    }
+    return times;
+  }();
+  return times;
+}
+
+// Looking up times in the heading, as the sample collections do.
+void Primitive_TimeStampLowerBound(benchmark::State &state, bool checked) {
+  const std::vector<TimeStamp> &times = headingTimes();
+  std::vector<TimeStamp> queries = queryTimes(1000000);
+  for (auto _ : state) {
+    int64_t sum = 0;
+    for (const auto &q : queries) {
+      sum += (checked
+        ? std::lower_bound(times.begin(), times.end(), q,
+                           &TimeStamp::checkedLess)
+        : std::lower_bound(times.begin(), times.end(), q)) - times.begin();
+    }
+    benchmark::DoNotOptimize(sum);
+  }
+  state.SetItemsProcessed(state.iterations()*queries.size());
+}
+BENCHMARK_CAPTURE(Primitive_TimeStampLowerBound, operator_less, false)
+  ->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(Primitive_TimeStampLowerBound, checkedLess, true)
+  ->Unit(benchmark::kMillisecond);
+
+void Primitive_TimeStampDifference(benchmark::State &state, bool checked) {
+  const std::vector<TimeStamp> &times = headingTimes();
+  for (auto _ : state) {
+    double sum = 0;
+    for (size_t i = 1; i < times.size(); i++) {
+      sum += (checked
+        ? TimeStamp::checkedDifference(times[i], times[i - 1])
+        : times[i] - times[i - 1]).seconds();
+    }
+    benchmark::DoNotOptimize(sum);
+  }
+  state.SetItemsProcessed(state.iterations()*(times.size() - 1));
+}
+BENCHMARK_CAPTURE(Primitive_TimeStampDifference, operator_minus, false)
+  ->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(Primitive_TimeStampDifference, checkedDifference, true)
+  ->Unit(benchmark::kMillisecond);
+
+typedef TimeStamp (*ParseFunction)(const std::string &);
+
+TimeStamp parseIso8601(const std::string &s) {
+  return TimeStamp::parseIso8601(s);
+}
+
+TimeStamp parseAnyFormat(const std::string &s) {
+  return TimeStamp::parse(s);
+}
+
+TimeStamp parseFromRegex(const std::string &s) {
+  return TimeStamp::parseFromRegex(s);
+}
+
+TimeStamp parseIsoWithStrptime(const std::string &s) {
+  struct tm tm = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, nullptr};
+  strptime(s.c_str(), "%FT%T", &tm);
+  return TimeStamp::fromTM(tm);
+}
+
+TimeStamp parseDate(const std::string &s) {
+  return TimeStamp::parse("%d/%m/%y", s);
+}
+
+TimeStamp parseDateWithStrptime(const std::string &s) {
+  struct tm tm = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, nullptr};
+  strptime(s.c_str(), "%d/%m/%y", &tm);
+  return TimeStamp::fromTM(tm);
+}
+
+// Parsing times like 2016-05-01T09:00:00.020Z, or dates like 01/05/16,
+// of the heading.
+void Primitive_TimeStampParse(benchmark::State &state,
+                              ParseFunction parse, bool dates) {
+  const std::vector<TimeStamp> &times = headingTimes();
+  std::vector<std::string> strings;
+  for (size_t i = 0; i < times.size(); i += times.size()/100000 + 1) {
+    TimeStamp t = times[i];
+    strings.push_back(dates ? t.toString("%d/%m/%y")
+      : t.toIso8601String().substr(0, 19)
+        + stringFormat(".%03dZ", int(t.toMilliSecondsSince1970() % 1000)));
+  }
+  for (auto _ : state) {
+    int64_t sum = 0;
+    for (const auto &s : strings) {
+      sum += parse(s).toSecondsSince1970() % 1000;
+    }
+    benchmark::DoNotOptimize(sum);
+  }
+  state.SetItemsProcessed(state.iterations()*strings.size());
+}
+BENCHMARK_CAPTURE(Primitive_TimeStampParse, parseIso8601,
+                  &parseIso8601, false)->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(Primitive_TimeStampParse, parse,
+                  &parseAnyFormat, false)->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(Primitive_TimeStampParse, parseFromRegex,
+                  &parseFromRegex, false)->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(Primitive_TimeStampParse, strptime,
+                  &parseIsoWithStrptime, false)
+  ->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(Primitive_TimeStampParse, parse_date,
+                  &parseDate, true)->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(Primitive_TimeStampParse, strptime_date,
+                  &parseDateWithStrptime, true)
+  ->Unit(benchmark::kMillisecond);
+
+// Counts the heap allocations of the thread that runs a benchmark,
+// with common_AllocationCounter. Google Benchmark runs every benchmark
+// once more between Start and Stop, and reports the allocations per
+// iteration of that run.
+class AllocationManager : public benchmark::MemoryManager {
+ public:
+  void Start() override {
+    _profiler.reset(new StageProfiler(Duration<double>::seconds(0.0)));
+    _profiler->activate();
+    _before = threadAllocationCounts();
+  }
+
+  void Stop(Result &result) override {
+    const AllocationCounts &after = threadAllocationCounts();
+    result.num_allocs = after.count - _before.count;
+    result.total_allocated_bytes = after.bytes - _before.bytes;
+    _profiler->deactivate();
+    _profiler.reset();
+  }
+
+  // Deprecated, but still pure virtual in Google Benchmark 1.7.
+  void Stop(Result *result) override {
+    Stop(*result);
+  }
+ private:
+  std::unique_ptr<StageProfiler> _profiler;
+  AllocationCounts _before;
+};
+
+// Removes the options of this program from the arguments, and
+// leaves those of Google Benchmark.
+void readOptions(int *argc, char **argv, bool *countAllocations) {
+  int dst = 1;
+  for (int i = 1; i < *argc; i++) {
+    const char *arg = argv[i];
+    if (strcmp(arg, "--allocations") == 0) {
+      *countAllocations = true;
+    } else if (strncmp(arg, "--sessions=", 11) == 0) {
+      seasonSettings.sessionCount = atoi(arg + 11);
+    } else if (strncmp(arg, "--session_hours=", 16) == 0) {
+      seasonSettings.sessionDuration =
+        Duration<double>::hours(atof(arg + 16));
+    } else if (strncmp(arg, "--seed=", 7) == 0) {
+      seasonSettings.seed = strtoul(arg + 7, nullptr, 10);
+    } else if (strncmp(arg, "--import_dir=", 13) == 0) {
+      importDirs.push_back(arg + 13);
+    } else {
+      argv[dst++] = argv[i];
+    }
+  }
+  *argc = dst;
+}
+
+// The directories of datasets/, in alphabetical order.
+std::vector<std::string> datasetDirs() {
+  std::string datasets = std::string(Env::SOURCE_DIR) + "/datasets";
+  std::vector<std::string> dirs;
+  if (!Poco::File(datasets).exists()) {
+    LOG(WARNING) << "No " << datasets << " to import";
+    return dirs;
+  }
+  std::vector<std::string> names;
+  Poco::File(datasets).list(names);
+  std::sort(names.begin(), names.end());
+  for (const auto &name : names) {
+    std::string path = datasets + "/" + name;
+    if (Poco::File(path).isDirectory()) {
+      dirs.push_back(path);
+    }
+  }
+  return dirs;
+}
+
+// Named after the last part of the path of each directory.
+void registerImportDirectories() {
+  for (const auto &dir : importDirs) {
+    std::string name = dir.substr(0, dir.find_last_not_of('/') + 1);
+    name = name.substr(name.find_last_of('/') + 1);
+    benchmark::RegisterBenchmark(
+        ("Primitive_ImportDirectory/" + name).c_str(),
+        Primitive_ImportDirectory, dir)
+      ->Arg(0)->Arg(1)->Unit(benchmark::kMillisecond);
+  }
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  bool countAllocations = false;
+  readOptions(&argc, argv, &countAllocations);
+  if (importDirs.empty()) {
+    importDirs = datasetDirs();
+  }
+  registerImportDirectories();
+  benchmark::Initialize(&argc, argv);
+  if (benchmark::ReportUnrecognizedArguments(argc, argv)) {
+    return 1;
+  }
+  AllocationManager allocations;
+  if (countAllocations) {
+    benchmark::RegisterMemoryManager(&allocations);
+  }
+  benchmark::AddCustomContext("season_sessions",
+      stringFormat("%d", seasonSettings.sessionCount));
+  benchmark::AddCustomContext("season_session_hours",
+      stringFormat("%g", seasonSettings.sessionDuration.hours()));
+  benchmark::AddCustomContext("season_seed",
+      stringFormat("%u", seasonSettings.seed));
+  Poco::File(importDir).createDirectories();
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+  Poco::File(tempDir).remove(true);
+  return 0;
+}
@@ -0,0 +1,342 @@
+/*
+ * SeasonDataset.cpp
+ */
+
+#include <server/nautical/benchmarks/SeasonDataset.h>
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <random>
+#include <server/common/ArrayBuilder.h>
+#include <server/common/logging.h>
+#include <server/nautical/GeographicReference.h>
+#include <server/nautical/synthtest/BoatSim.h>
+#include <server/nautical/synthtest/Flow.h>
+
+namespace sail {
+
+const char SeasonSettings::nmea0183Source[] = "NMEA0183: /dev/ttyMFD1";
+const char SeasonSettings::internalGpsSource[] = "Internal GPS";
+const char SeasonSettings::nmea2000Source[] = "NMEA2000/c078be00";
+
+namespace {
+
+// The engine of <random> gives the same numbers everywhere, but its
+// distributions do not, so they are computed here.
+class Random {
+ public:
+  explicit Random(uint32_t seed) : _engine(seed) {}
+
+  double uniform() {
+    return (_engine() & 0xffffffffu)*(1.0/4294967296.0);
+  }
+
+  double uniform(double a, double b) {
+    return a + (b - a)*uniform();
+  }
+
+  // Close to a normal distribution with a standard deviation of 1.
+  double normal() {
+    double sum = 0.0;
+    for (int i = 0; i < 12; i++) {
+      sum += uniform();
+    }
+    return sum - 6.0;
+  }
+ private:
+  std::mt19937 _engine;
+};
+
+const Duration<double> simulationPeriod = Duration<double>::seconds(0.1);
+
+// What the instruments would measure without errors, at every
+// simulated state.
+struct Observation {
+  GeographicReference::ProjectedPosition pos;
+  HorizontalMotion<double> motion;
+  HorizontalMotion<double> apparentWind;
+  Angle<double> heading;
+  Velocity<double> waterSpeed;
+
+  Angle<double> awa() const {
+    return (apparentWind.angle() - Angle<double>::degrees(180)
+            - heading).positiveMinAngle();
+  }
+};
+
+template <typename T>
+T lerp(T a, T b, double f) {
+  return a + f*(b - a);
+}
+
+HorizontalMotion<double> lerp(const HorizontalMotion<double> &a,
+                              const HorizontalMotion<double> &b, double f) {
+  return HorizontalMotion<double>(lerp(a[0], b[0], f), lerp(a[1], b[1], f));
+}
+
+struct Session {
+  TimeStamp start;
+  GeographicReference geoRef;
+  std::vector<Observation> observations;
+
+  Duration<double> duration() const {
+    return double(observations.size() - 1)*simulationPeriod;
+  }
+
+  Observation at(Duration<double> t) const {
+    double x = t/simulationPeriod;
+    int i = std::min(int(x), int(observations.size()) - 2);
+    double f = x - i;
+    const Observation &a = observations[i];
+    const Observation &b = observations[i + 1];
+    Observation dst;
+    dst.pos[0] = lerp(a.pos[0], b.pos[0], f);
+    dst.pos[1] = lerp(a.pos[1], b.pos[1], f);
+    dst.motion = lerp(a.motion, b.motion, f);
+    dst.apparentWind = lerp(a.apparentWind, b.apparentWind, f);
+    dst.heading = a.heading + f*b.heading.directionDifference(a.heading);
+    dst.waterSpeed = lerp(a.waterSpeed, b.waterSpeed, f);
+    return dst;
+  }
+};
+
+// Legs upwind and downwind, tacking or gybing every few minutes.
+BoatSim::TwaFunction makeCourse(Duration<double> duration, Random *rnd) {
+  ArrayBuilder<Duration<double>> legs;
+  ArrayBuilder<Angle<double>> twas;
+  Duration<double> total = Duration<double>::seconds(0);
+  for (int i = 0; total < duration; i++) {
+    bool upwind = (i/6) % 2 == 0;
+    bool starboard = i % 2 == 0;
+    double twa = (upwind ? 45 : 150) + rnd->uniform(-3, 3);
+    auto leg = Duration<double>::minutes(rnd->uniform(2, 6));
+    legs.add(leg);
+    twas.add(Angle<double>::degrees(starboard ? twa : 360 - twa));
+    total += leg;
+  }
+  return BoatSim::makePiecewiseTwaFunction(legs.get(), twas.get());
+}
+
+Session simulateSession(const SeasonSettings &settings, int index,
+                        Random *rnd) {
+  // The start of the session varies by up to two hours.
+  Duration<double> margin = std::min(Duration<double>::hours(2.0),
+      settings.timeBetweenSessions - settings.sessionDuration);
+  CHECK(0.0 <= margin.seconds()) << "The sessions overlap";
+
+  Session session;
+  session.start = settings.seasonStart
+    + double(index)*settings.timeBetweenSessions + rnd->uniform()*margin;
+  session.geoRef = GeographicReference(GeographicPosition<double>(
+      Angle<double>::degrees(6.15 + rnd->uniform(-0.05, 0.05)),
+      Angle<double>::degrees(46.2 + rnd->uniform(-0.02, 0.02))));
+
+  auto windDirection = Angle<double>::degrees(rnd->uniform(0, 360));
+  Flow wind = Flow::constant(HorizontalMotion<double>::polar(
+      Velocity<double>::knots(rnd->uniform(6, 18)), windDirection))
+    + Flow(Flow::spatiallyChangingVelocity(
+               Velocity<double>::knots(2.0), windDirection,
+               Length<double>::meters(2000), Angle<double>::degrees(0)),
+           Flow::spatiallyChangingVelocity(
+               Velocity<double>::knots(2.0), windDirection,
+               Length<double>::meters(3000), Angle<double>::degrees(90)));
+  Flow current = Flow::constant(HorizontalMotion<double>::polar(
+      Velocity<double>::knots(rnd->uniform(0, 1)),
+      Angle<double>::degrees(rnd->uniform(0, 360))));
+
+  BoatSim simulator(wind.asFunction(), current.asFunction(),
+                    BoatCharacteristics(),
+                    makeCourse(settings.sessionDuration, rnd));
+  Array<BoatSim::FullState> states = simulator.simulate(
+      settings.sessionDuration, simulationPeriod, 2);
+
+  session.observations.reserve(states.size());
+  for (const auto &state : states) {
+    Observation x;
+    x.pos = state.pos;
+    x.motion = state.boatMotion;
+    x.apparentWind = state.apparentWind();
+    x.heading = state.boatOrientation;
+    x.waterSpeed = state.boatSpeedThroughWater;
+    session.observations.push_back(x);
+  }
+  return session;
+}
+
+// Times since the start of a session at which a source is not logged.
+struct Dropout {
+  Duration<double> begin, end;
+};
+
+std::vector<Dropout> makeDropouts(Duration<double> duration,
+                                  Duration<double> meanInterval,
+                                  Duration<double> maxLength,
+                                  Random *rnd) {
+  std::vector<Dropout> dropouts;
+  Duration<double> t = Duration<double>::seconds(0);
+  while (true) {
+    t += rnd->uniform(0.0, 2.0)*meanInterval;
+    if (duration <= t) {
+      return dropouts;
+    }
+    Dropout d;
+    d.begin = t;
+    d.end = t + rnd->uniform(0.05, 1.0)*maxLength;
+    dropouts.push_back(d);
+    t = d.end;
+  }
+}
+
+template <typename T>
+using Channels = std::map<std::pair<DataCode, std::string>,
+                          typename TimedSampleCollection<T>::TimedVector>;
+
+class SeasonBuilder {
+ public:
+  SeasonBuilder(uint32_t seed) : _rnd(seed) {}
+
+  // Calls 'f' with the time of the sample and what the instruments
+  // would measure at that time, at every 'period' of the session but
+  // during dropouts.
+  template <typename F>
+  void sample(const Session &session, Duration<double> period,
+              Duration<double> meanDropoutInterval,
+              Duration<double> maxDropoutLength, F f) {
+    auto dropouts = makeDropouts(session.duration(), meanDropoutInterval,
+                                 maxDropoutLength, &_rnd);
+    auto dropout = dropouts.begin();
+    int n = int(session.duration()/period);
+    for (int i = 0; i < n; i++) {
+      Duration<double> t = double(i)*period;
+      while (dropout != dropouts.end() && dropout->end <= t) {
+        dropout++;
+      }
+      if (dropout != dropouts.end() && dropout->begin <= t) {
+        continue;
+      }
+      f(session.start + t, session.at(t));
+    }
+  }
+
+  void addGps(const Session &session, const std::string &source,
+              Duration<double> period, Length<double> noise,
+              Duration<double> meanDropoutInterval,
+              Duration<double> maxDropoutLength) {
+    auto &positions = _positions[std::make_pair(GPS_POS, source)];
+    auto &speeds = _velocities[std::make_pair(GPS_SPEED, source)];
+    auto &bearings = _angles[std::make_pair(GPS_BEARING, source)];
+    sample(session, period, meanDropoutInterval, maxDropoutLength,
+           [&](TimeStamp time, const Observation &x) {
+      auto pos = x.pos;
+      pos[0] = pos[0] + _rnd.normal()*noise;
+      pos[1] = pos[1] + _rnd.normal()*noise;
+      positions.push_back(TimedValue<GeographicPosition<double>>(
+          time, session.geoRef.unmap(pos)));
+      speeds.push_back(TimedValue<Velocity<double>>(time, x.motion.norm()));
+      bearings.push_back(TimedValue<Angle<double>>(
+          time, x.motion.angle().positiveMinAngle()));
+    });
+  }
+
+  void addWind(const Session &session, const std::string &source,
+               Duration<double> period,
+               Duration<double> meanDropoutInterval,
+               Duration<double> maxDropoutLength) {
+    auto &awas = _angles[std::make_pair(AWA, source)];
+    auto &awss = _velocities[std::make_pair(AWS, source)];
+    sample(session, period, meanDropoutInterval, maxDropoutLength,
+           [&](TimeStamp time, const Observation &x) {
+      awas.push_back(TimedValue<Angle<double>>(time,
+          (x.awa() + Angle<double>::degrees(3 + _rnd.normal()))
+          .positiveMinAngle()));
+      awss.push_back(TimedValue<Velocity<double>>(time,
+          1.1*x.apparentWind.norm()
+          + Velocity<double>::knots(0.2*_rnd.normal())));
+    });
+  }
+
+  void addHeading(const Session &session, const std::string &source,
+                  Duration<double> period,
+                  Duration<double> meanDropoutInterval,
+                  Duration<double> maxDropoutLength) {
+    auto &headings = _angles[std::make_pair(MAG_HEADING, source)];
+    sample(session, period, meanDropoutInterval, maxDropoutLength,
+           [&](TimeStamp time, const Observation &x) {
+      headings.push_back(TimedValue<Angle<double>>(time,
+          (x.heading + Angle<double>::degrees(-2 + 0.5*_rnd.normal()))
+          .positiveMinAngle()));
+    });
+  }
+
+  void addWaterSpeed(const Session &session, const std::string &source,
+                     Duration<double> period,
+                     Duration<double> meanDropoutInterval,
+                     Duration<double> maxDropoutLength) {
+    auto &speeds = _velocities[std::make_pair(WAT_SPEED, source)];
+    sample(session, period, meanDropoutInterval, maxDropoutLength,
+           [&](TimeStamp time, const Observation &x) {
+      speeds.push_back(TimedValue<Velocity<double>>(time,
+          0.95*x.waterSpeed + Velocity<double>::knots(0.1*_rnd.normal())));
+    });
+  }
+
+  Random *random() {return &_rnd;}
+
+  NavDataset build() {
+    auto dispatcher = std::make_shared<Dispatcher>();
+    insert<GeographicPosition<double>>(&_positions, dispatcher.get());
+    insert<Angle<double>>(&_angles, dispatcher.get());
+    insert<Velocity<double>>(&_velocities, dispatcher.get());
+    return NavDataset(dispatcher).fitBounds();
+  }
+ private:
+  template <typename T>
+  static void insert(Channels<T> *channels, Dispatcher *dst) {
+    for (auto &kv : *channels) {
+      dst->insertValues<T>(kv.first.first, kv.first.second,
+                           std::move(kv.second));
+    }
+    channels->clear();
+  }
+
+  Random _rnd;
+  Channels<GeographicPosition<double>> _positions;
+  Channels<Angle<double>> _angles;
+  Channels<Velocity<double>> _velocities;
+};
+
+}  // namespace
+
+NavDataset makeSeasonDataset(const SeasonSettings &settings) {
+  SeasonBuilder builder(settings.seed);
+  auto seconds = [](double s) {return Duration<double>::seconds(s);};
+  auto minutes = [](double m) {return Duration<double>::minutes(m);};
+
+  for (int i = 0; i < settings.sessionCount; i++) {
+    Session session = simulateSession(settings, i, builder.random());
+
+    const std::string nmea0183 = SeasonSettings::nmea0183Source;
+    builder.addGps(session, nmea0183, seconds(1), Length<double>::meters(3),
+                   minutes(20), seconds(60));
+    builder.addWind(session, nmea0183, seconds(1), minutes(20), seconds(60));
+    builder.addHeading(session, nmea0183, seconds(1),
+                       minutes(20), seconds(60));
+    builder.addWaterSpeed(session, nmea0183, seconds(1),
+                          minutes(20), seconds(60));
+
+    if (settings.sessionCount <= 4*i) {
+      builder.addGps(session, SeasonSettings::internalGpsSource,
+                     seconds(0.2), Length<double>::meters(2),
+                     minutes(10), seconds(30));
+    }
+
+    const std::string nmea2000 = SeasonSettings::nmea2000Source;
+    builder.addHeading(session, nmea2000, seconds(0.02),
+                       minutes(30), seconds(20));
+    builder.addWind(session, nmea2000, seconds(0.1), minutes(30), seconds(20));
+  }
+  return builder.build();
+}
+
+}
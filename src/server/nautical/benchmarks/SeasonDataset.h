@@ -0,0 +1,50 @@
+/*
+ * SeasonDataset.h
+ *
+ *  Synthetic logs of a boat over a sailing season, simulated with
+ *  BoatSim, to measure the processing at the scale of production data.
+ *
+ *  Every session is a few hours of upwind and downwind legs with tacks
+ *  and gybes, in a wind that changes from one session to the next and
+ *  over the race area. The sessions are days apart. The instruments are
+ *  logged by several sources, as on a boat with an anemobox:
+ *
+ *    "NMEA0183: /dev/ttyMFD1"  GPS, wind, heading and water speed, 1 Hz
+ *    "Internal GPS"            GPS, 5 Hz, from the second quarter of the
+ *                              season
+ *    "NMEA2000/c078be00"       Heading at 50 Hz, wind at 10 Hz
+ *
+ *  Every source has dropouts of a few seconds to a minute. The wind,
+ *  heading and water speed are biased, so that there is something to
+ *  calibrate.
+ *
+ *  The dataset only depends on the settings: the same settings give
+ *  the same samples on every platform.
+ */
+
+#ifndef SERVER_NAUTICAL_BENCHMARKS_SEASONDATASET_H_
+#define SERVER_NAUTICAL_BENCHMARKS_SEASONDATASET_H_
+
+#include <cstdint>
+#include <server/nautical/NavDataset.h>
+
+namespace sail {
+
+struct SeasonSettings {
+  int sessionCount = 20;
+  Duration<double> sessionDuration = Duration<double>::hours(2.0);
+  Duration<double> timeBetweenSessions = Duration<double>::days(2.0);
+  TimeStamp seasonStart = TimeStamp::UTC(2016, 5, 1, 9, 0, 0);
+  uint32_t seed = 1;
+
+  // Names of the sources, as listed above.
+  static const char nmea0183Source[];
+  static const char internalGpsSource[];
+  static const char nmea2000Source[];
+};
+
+NavDataset makeSeasonDataset(const SeasonSettings &settings = SeasonSettings());
+
+}
+
+#endif /* SERVER_NAUTICAL_BENCHMARKS_SEASONDATASET_H_ */
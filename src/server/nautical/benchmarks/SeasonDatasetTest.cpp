@@ -0,0 +1,89 @@
+/*
+ * SeasonDatasetTest.cpp
+ */
+
+#include <gtest/gtest.h>
+#include <server/nautical/benchmarks/SeasonDataset.h>
+
+using namespace sail;
+
+namespace {
+
+SeasonSettings makeSmallSeason() {
+  SeasonSettings settings;
+  settings.sessionCount = 4;
+  settings.sessionDuration = Duration<double>::minutes(30);
+  return settings;
+}
+
+// The number of times without samples in 'values' that are longer
+// than 'minLength' and shorter than 'maxLength'.
+template <typename T>
+int countGaps(const TimedSampleCollection<T> &values,
+              Duration<double> minLength, Duration<double> maxLength) {
+  int count = 0;
+  const auto &samples = values.samples();
+  for (size_t i = 1; i < samples.size(); i++) {
+    auto gap = samples[i].time - samples[i - 1].time;
+    if (minLength < gap && gap < maxLength) {
+      count++;
+    }
+  }
+  return count;
+}
+
+}  // namespace
+
+TEST(SeasonDatasetTest, Deterministic) {
+  NavDataset a = makeSeasonDataset(makeSmallSeason());
+  NavDataset b = makeSeasonDataset(makeSmallSeason());
+  const auto &positionsA = a.dispatcher()->values<GPS_POS>(
+      SeasonSettings::nmea0183Source).samples();
+  const auto &positionsB = b.dispatcher()->values<GPS_POS>(
+      SeasonSettings::nmea0183Source).samples();
+  ASSERT_EQ(positionsA.size(), positionsB.size());
+  for (size_t i = 0; i < positionsA.size(); i++) {
+    EXPECT_EQ(positionsA[i].time, positionsB[i].time);
+    EXPECT_EQ(positionsA[i].value.lon().degrees(),
+              positionsB[i].value.lon().degrees());
+    EXPECT_EQ(positionsA[i].value.lat().degrees(),
+              positionsB[i].value.lat().degrees());
+  }
+
+  SeasonSettings other = makeSmallSeason();
+  other.seed = 2;
+  NavDataset c = makeSeasonDataset(other);
+  EXPECT_NE(a.dispatcher()->values<MAG_HEADING>(
+                SeasonSettings::nmea2000Source).size(),
+            c.dispatcher()->values<MAG_HEADING>(
+                SeasonSettings::nmea2000Source).size());
+}
+
+TEST(SeasonDatasetTest, SourcesRatesAndGaps) {
+  SeasonSettings settings = makeSmallSeason();
+  NavDataset season = makeSeasonDataset(settings);
+  const Dispatcher *d = season.dispatcher().get();
+
+  EXPECT_TRUE(d->hasSource(GPS_POS, SeasonSettings::nmea0183Source));
+  EXPECT_TRUE(d->hasSource(GPS_POS, SeasonSettings::internalGpsSource));
+  EXPECT_TRUE(d->hasSource(AWA, SeasonSettings::nmea0183Source));
+  EXPECT_TRUE(d->hasSource(AWA, SeasonSettings::nmea2000Source));
+  EXPECT_TRUE(d->hasSource(WAT_SPEED, SeasonSettings::nmea0183Source));
+
+  // Counting with the dropouts.
+  double seconds = settings.sessionCount*settings.sessionDuration.seconds();
+  auto rate = [&](int count) {return count/seconds;};
+  EXPECT_NEAR(1.0, rate(d->values<GPS_POS>(
+      SeasonSettings::nmea0183Source).size()), 0.2);
+  EXPECT_NEAR(10.0, rate(d->values<AWA>(
+      SeasonSettings::nmea2000Source).size()), 2.0);
+  EXPECT_NEAR(50.0, rate(d->values<MAG_HEADING>(
+      SeasonSettings::nmea2000Source).size()), 10.0);
+
+  // Days between the sessions, and dropouts in a session.
+  const auto &headings = d->values<MAG_HEADING>(SeasonSettings::nmea2000Source);
+  EXPECT_EQ(settings.sessionCount - 1, countGaps(headings,
+      Duration<double>::days(1), Duration<double>::days(3)));
+  EXPECT_LT(0, countGaps(headings,
+      Duration<double>::seconds(0.5), Duration<double>::minutes(1)));
+}
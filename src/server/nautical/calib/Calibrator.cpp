@@ -7,26 +7,33 @@
  */
 
 #include "Calibrator.h"
+#include <algorithm>
 
 
 #include <ceres/ceres.h>
 #include <cmath>
+#include <condition_variable>
+#include <cstdint>
 #include <device/Arduino/libraries/ChunkFile/ChunkFile.h>
 #include <device/Arduino/libraries/Corrector/Corrector.h>
 #include <device/Arduino/libraries/FixedPoint/FixedPoint.h>
 #include <device/Arduino/libraries/TrueWindEstimator/InstrumentFilter.h>
 #include <device/Arduino/libraries/TrueWindEstimator/TrueWindEstimator.h>
 #include <device/anemobox/simulator/SimulateBox.h>
+#include <functional>
 #include <iostream>
+#include <mutex>
 #include <server/common/ArrayBuilder.h>
 #include <server/common/Histogram.h>
 #include <server/common/math.h>
 #include <server/common/string.h>
 #include <server/nautical/DownsampleGps.h>
 #include <server/nautical/FlowErrors.h>
+#include <server/nautical/calib/TackCost.h>
 #include <server/nautical/logimport/LogLoader.h>
 #include <server/plot/extra.h>
 #include <string>
+#include <thread>
 
 using ceres::AutoDiffCostFunction;
 using ceres::CostFunction;
@@ -50,104 +57,50 @@ namespace {
   Angle<double> externalTrueWindDirection(const Nav& nav) {
     return nav.externalTwa() + nav.gpsBearing();
   }
-
-  template <typename T, int N>
-  bool isnan(const ceres::Jet<T, N>& f) { return ceres::IsNaN(f); }
-
-  using std::isnan;
 } // namespace
 
-class TackCost {
-  public:
-    TackCost(NavDataset before, NavDataset after, double weight_, TimeStamp time)
-      : _before(makeFilter(before)), _after(makeFilter(after)),
-      _beforeNav(before), _afterNav(after), _weight(weight_),
-      _time(time) { }
-
-    template<typename T>
-    bool operator()(const T* const x, T* residual) const {
-      HorizontalMotion<T> windBefore =
-        TrueWindEstimator::computeTrueWind<T, ServerFilter>(x, _before);
-      HorizontalMotion<T> windAfter =
-        TrueWindEstimator::computeTrueWind<T, ServerFilter>(x, _after);
-
-      if (1) {
-        HorizontalMotion<T> difference = windAfter - windBefore;
-        residual[0] = T(_weight) * difference[0].knots();
-        residual[1] = T(_weight) * difference[1].knots();
-      } else {
-        residual[0] = T(_weight) * (windAfter.angle().directionDifference(
-                windBefore.angle()).degrees());
-
-        T strengthBefore = windBefore.norm().metersPerSecond();
-        T strengthAfter = windAfter.norm().metersPerSecond();
-
-        // The strength has to be normalized. Otherwise, the optimizer will
-        // be rewarded for underestimating the wind.
-        residual[1] = T(_weight * 360.0 * 2.0) * (
-            (strengthAfter - strengthBefore) / (strengthAfter));
-      }
-      assert(!isnan(residual[0]));
-      assert(!isnan(residual[1]));
-      return true;
-    }
-
-    void printCost(const double* params) {
-      HorizontalMotion<double> windBefore =
-        TrueWindEstimator::computeTrueWind<double, ServerFilter>(params, _before);
-      HorizontalMotion<double> windAfter =
-        TrueWindEstimator::computeTrueWind<double, ServerFilter>(params, _after);
-      std::cout << "Wind: " << showWind(windBefore) << " and "
-        << showWind(windAfter)
-        << " at " << _before.oldestUpdate().toString()
-        << " and " << _after.oldestUpdate().toString()
-        << " w=" << _weight << "\n";
-    }
-
-    void angularError(const double *params,
-                         double *sumDegrees, double *sumKnots,
-                         double *sumExternalDegrees, double *sumExternalKnots) {
-      HorizontalMotion<double> windBefore =
-        TrueWindEstimator::computeTrueWind<double, ServerFilter>(params, _before);
-      HorizontalMotion<double> windAfter =
-        TrueWindEstimator::computeTrueWind<double, ServerFilter>(params, _after);
-      *sumDegrees = std::fabs(windAfter.angle().directionDifference(
-              windBefore.angle()).degrees());
-      *sumKnots = std::fabs((windAfter.norm() - windBefore.norm()).knots());
-      
-      *sumExternalDegrees = std::fabs(
-          externalTrueWindDirection(getLast(_beforeNav)).directionDifference(
-              externalTrueWindDirection(getLast(_afterNav))).degrees());
-      *sumExternalKnots = std::fabs(
-          (getLast(_beforeNav).externalTws() - getLast(_afterNav).externalTws()).knots());
-    }
-
-
-
-
-    const ServerFilter &before() const {
-      return _before;
-    }
-
-    const ServerFilter &after() const {
-      return _after;
-    }
-
-    double weight() const {
-      return _weight;
-    }
-
-    TimeStamp time() const { return _time; }
-  private:
-    ServerFilter _before;
-    ServerFilter _after;
+TackCost::TackCost(const std::shared_ptr<ManeuverTable> &table,
+                   NavDataset before, NavDataset after, double weight_,
+                   TimeStamp time)
+  : _table(table),
+  _before(table->add(makeFilter(before))),
+  _after(table->add(makeFilter(after))),
+  _beforeNav(before), _afterNav(after), _weight(weight_),
+  _time(time) { }
+
+void TackCost::printCost(const double* params) {
+  HorizontalMotion<double> windBefore =
+    TrueWindEstimator::computeTrueWind<double, ManeuverTable::Inputs>(
+        params, before());
+  HorizontalMotion<double> windAfter =
+    TrueWindEstimator::computeTrueWind<double, ManeuverTable::Inputs>(
+        params, after());
+  std::cout << "Wind: " << showWind(windBefore) << " and "
+    << showWind(windAfter)
+    << " at " << before().oldestUpdate().toString()
+    << " and " << after().oldestUpdate().toString()
+    << " w=" << _weight << "\n";
+}
 
-    // For debugging only.
-    NavDataset _beforeNav;
-    NavDataset _afterNav;
-    double _weight;
-    TimeStamp _time;
-};
+void TackCost::angularError(const double *params,
+                     double *sumDegrees, double *sumKnots,
+                     double *sumExternalDegrees, double *sumExternalKnots) {
+  HorizontalMotion<double> windBefore =
+    TrueWindEstimator::computeTrueWind<double, ManeuverTable::Inputs>(
+        params, before());
+  HorizontalMotion<double> windAfter =
+    TrueWindEstimator::computeTrueWind<double, ManeuverTable::Inputs>(
+        params, after());
+  *sumDegrees = std::fabs(windAfter.angle().directionDifference(
+          windBefore.angle()).degrees());
+  *sumKnots = std::fabs((windAfter.norm() - windBefore.norm()).knots());
+
+  *sumExternalDegrees = std::fabs(
+      externalTrueWindDirection(getLast(_beforeNav)).directionDifference(
+          externalTrueWindDirection(getLast(_afterNav))).degrees());
+  *sumExternalKnots = std::fabs(
+      (getLast(_beforeNav).externalTws() - getLast(_afterNav).externalTws()).knots());
+}
 
 void Calibrator::addTack(int pos, double weight) {
   const Duration<> length = Duration<>::seconds(5);
@@ -223,7 +176,7 @@ void Calibrator::addTack(int pos, double weight) {
   }
   */
 
-  TackCost *cost = new TackCost(beforeds, afterds, weight, tackTime);
+  TackCost *cost = new TackCost(_table, beforeds, afterds, weight, tackTime);
   _maneuvers.push_back(cost);
   CostFunction* cost_function =
       new AutoDiffCostFunction<
@@ -379,6 +332,9 @@ bool Calibrator::calibrate(const NavDataset& navs,
   options.max_num_iterations = 500;
   options.function_tolerance = 1e-7;
   options.minimizer_progress_to_stdout = _verbose;
+
+  // Every maneuver is a residual block: ceres evaluates them in parallel.
+  options.num_threads = threadCount();
   Solver::Summary summary;
   Solve(options, &_problem, &summary);
 
@@ -500,6 +456,14 @@ void Calibrator::clear() {
   TrueWindEstimator::initializeParameters(_calibrationValues);
 
   _maneuvers.clear();
+  _table = std::make_shared<ManeuverTable>();
+}
+
+int Calibrator::threadCount() const {
+  if (_threadCount > 0) {
+    return _threadCount;
+  }
+  return std::max(1, int(std::thread::hardware_concurrency()));
 }
 
 NavDataset Calibrator::simulate(const NavDataset &src) const {
@@ -511,34 +475,23 @@ NavDataset Calibrator::simulate(const NavDataset &src) const {
 }
 
 namespace {
-  class Objf {
-   public:
-    Objf(const std::vector<TackCost*> &maneuvers) : _maneuvers(maneuvers) {}
-
-    template<typename T>
-    bool operator()(T const* const* parameters, T* residuals) const {
-      const Corrector<T> *corr = (Corrector<T> *)parameters[0];
-      return eval(*corr, residuals);
-    }
+  static constexpr int correctorParamCount =
+    sizeof(Corrector<double>)/sizeof(double);
 
-    // Difference in true {wind, current} in {x, y} directions.
-    static constexpr int residualsPerManeuver = 4;
+  // Difference in true {wind, current} in {x, y} directions
+  // for a single maneuver.
+  class ManeuverResiduals {
+   public:
+    static constexpr int count = 4;
 
-    int outDims() const {
-      return maneuverCount()*residualsPerManeuver;
-    }
-
-    int maneuverCount() const {
-      return _maneuvers.size();
-    }
-   private:
-    const std::vector<TackCost*> &_maneuvers;
+    ManeuverResiduals(const TackCost *cost) : _cost(cost) {}
 
     template <typename T>
-    bool evalSub(const Corrector<T> &corr, const TackCost *cost, T *residuals) const {
-      auto before = corr.correct(cost->before());
-      auto after = corr.correct(cost->after());
-      double weight = cost->weight();
+    bool operator()(const T *parameters, T *residuals) const {
+      const Corrector<T> &corr = *((const Corrector<T> *)parameters);
+      auto before = corr.correct(_cost->before());
+      auto after = corr.correct(_cost->after());
+      double weight = _cost->weight();
 
       auto windDif = before.trueWindOverGround() - after.trueWindOverGround();
       auto currentDif = before.trueCurrentOverGround() - after.trueCurrentOverGround();
@@ -549,11 +502,145 @@ namespace {
       }
       return true;
     }
+   private:
+    const TackCost *_cost;
+  };
 
-    template <typename T>
-    bool eval(const Corrector<T> &corr, T *residuals) const {
-      for (int i = 0; i < maneuverCount(); i++) {
-        if (!evalSub(corr, _maneuvers[i], residuals + i*residualsPerManeuver)) {
+  typedef ceres::AutoDiffCostFunction<ManeuverResiduals,
+          ManeuverResiduals::count, correctorParamCount> ManeuverCost;
+
+  // Threads that run a function on a fixed split of [0, count) into
+  // ranges, one per thread. They are started once and wait between the
+  // runs, so that a run only costs a notification and not the creation
+  // of threads. The calling thread takes the first range.
+  class RangeWorkers {
+   public:
+    typedef std::function<bool(int, int)> RangeFunction;
+
+    RangeWorkers(int threadCount, int count) :
+      _threadCount(std::max(1, std::min(threadCount, count))),
+      _count(count), _ok(_threadCount, 0) {
+      for (int t = 1; t < _threadCount; t++) {
+        _threads.push_back(std::thread([this, t]() { work(t); }));
+      }
+    }
+
+    ~RangeWorkers() {
+      {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stop = true;
+      }
+      _start.notify_all();
+      for (auto &t : _threads) {
+        t.join();
+      }
+    }
+
+    // Returns true if f returned true for every range.
+    bool run(const RangeFunction &f) {
+      std::lock_guard<std::mutex> runLock(_runMutex);
+      {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _f = &f;
+        _pending = _threadCount - 1;
+        _generation++;
+      }
+      _start.notify_all();
+      _ok[0] = runRange(0);
+      {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _done.wait(lock, [this]() { return _pending == 0; });
+        _f = nullptr;
+      }
+      return std::all_of(_ok.begin(), _ok.end(),
+                         [](char x) { return x != 0; });
+    }
+
+   private:
+    int _threadCount, _count;
+    std::vector<char> _ok;
+    std::vector<std::thread> _threads;
+
+    std::mutex _runMutex;
+    std::mutex _mutex;
+    std::condition_variable _start, _done;
+    const RangeFunction *_f = nullptr;
+    int _pending = 0;
+    int64_t _generation = 0;
+    bool _stop = false;
+
+    bool runRange(int t) const {
+      return (*_f)((t*_count)/_threadCount, ((t + 1)*_count)/_threadCount);
+    }
+
+    void work(int t) {
+      int64_t generation = 0;
+      while (true) {
+        {
+          std::unique_lock<std::mutex> lock(_mutex);
+          _start.wait(lock, [&]() {
+            return _stop || _generation != generation;
+          });
+          if (_stop) {
+            return;
+          }
+          generation = _generation;
+        }
+        _ok[t] = runRange(t);
+        {
+          std::lock_guard<std::mutex> lock(_mutex);
+          _pending--;
+        }
+        _done.notify_one();
+      }
+    }
+  };
+
+  // All maneuvers as a single residual block, so that the robust loss is
+  // applied to the total cost. The maneuvers are independent of each
+  // other: they are split in one range per thread, and each range writes
+  // its own rows of the residuals and of the jacobian. The threads are
+  // kept for all the evaluations of a solve.
+  class Objf : public ceres::CostFunction {
+   public:
+    Objf(const std::vector<TackCost*> &maneuvers, int threadCount)
+      : _workers(threadCount, maneuvers.size()) {
+      for (auto m : maneuvers) {
+        _costs.push_back(std::unique_ptr<ManeuverCost>(
+              new ManeuverCost(new ManeuverResiduals(m))));
+      }
+      set_num_residuals(outDims());
+      mutable_parameter_block_sizes()->push_back(correctorParamCount);
+    }
+
+    int outDims() const {
+      return maneuverCount()*ManeuverResiduals::count;
+    }
+
+    int maneuverCount() const {
+      return _costs.size();
+    }
+
+    bool Evaluate(double const* const* parameters,
+                  double* residuals, double** jacobians) const override {
+      return _workers.run([=](int from, int to) {
+        return evaluateRange(from, to, parameters, residuals, jacobians);
+      });
+    }
+   private:
+    std::vector<std::unique_ptr<ManeuverCost>> _costs;
+
+    // Evaluate is const for ceres.
+    mutable RangeWorkers _workers;
+
+    bool evaluateRange(int from, int to, double const* const* parameters,
+                       double* residuals, double** jacobians) const {
+      for (int i = from; i < to; i++) {
+        int row = i*ManeuverResiduals::count;
+        double *jacobian = (jacobians != nullptr && jacobians[0] != nullptr?
+            jacobians[0] + row*correctorParamCount : nullptr);
+        if (!_costs[i]->Evaluate(parameters, residuals + row,
+                                 jacobians == nullptr? nullptr : &jacobian)) {
           return false;
         }
       }
@@ -599,17 +686,16 @@ Corrector<double> calibrateFull(Calibrator *calib0,
   LOG(INFO) << "Number of maneuvers: " << calib.maneuverCount();
 
   ceres::Problem problem;
-  auto objf = new Objf(calib.maneuvers());
-  auto cost = new ceres::DynamicAutoDiffCostFunction<Objf>(objf);
-  cost->AddParameterBlock(Corrector<double>::paramCount());
-  cost->SetNumResiduals(objf->outDims());
-  LOG(INFO) << "NUMBER OF RESIDUALS: " << objf->outDims();
+  auto cost = new Objf(calib.maneuvers(), calib.threadCount());
+  LOG(INFO) << "NUMBER OF RESIDUALS: " << cost->outDims();
 
 
   bool squareLoss = false;
   ceres::LossFunction *loss = (squareLoss? nullptr : new ceres::CauchyLoss(1));
 
   Corrector<double> corr;
+  static_assert(sizeof(corr) == correctorParamCount*sizeof(double),
+                "Corrector must be a plain array of parameters");
   problem.AddResidualBlock(cost, loss, (double *)(&corr));
   ceres::Solver::Options options;
   options.minimizer_progress_to_stdout = true;
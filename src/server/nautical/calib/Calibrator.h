@@ -14,6 +14,7 @@
 namespace sail {
 
 class TackCost;
+class ManeuverTable;
 class GnuplotExtra;
 
 
@@ -32,6 +33,9 @@ class Calibrator  {
 
     void saveCalibration(std::ostream *file) const;
 
+    //! The TrueWindEstimator parameters of the last calibration.
+    const double *calibrationValues() const { return _calibrationValues; }
+
     //! Print last calibration results.
     void print() const;
 
@@ -48,6 +52,11 @@ class Calibrator  {
     //  minimization. It will call gnuplot to display errors.
     void setVerbose() { _verbose = true; }
 
+    //! The number of threads used to evaluate the maneuver costs.
+    //  0, the default, means one per core.
+    void setThreadCount(int count) { _threadCount = count; }
+    int threadCount() const;
+
     //! Use the calibration to compute true wind on the given navigation data.
     NavDataset simulate(const NavDataset &array) const;
 
@@ -82,7 +91,11 @@ class Calibrator  {
     // The pointers stored in this vector are owned by "_problem".
     vector<TackCost*> _maneuvers;
 
+    // The filtered values of _maneuvers.
+    std::shared_ptr<ManeuverTable> _table;
+
     bool _verbose;
+    int _threadCount = 0;
 };
 
 // Calibrates a Corrector<double> by using a Calibrator.
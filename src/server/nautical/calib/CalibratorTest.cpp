@@ -0,0 +1,169 @@
+#include <ceres/ceres.h>
+#include <device/Arduino/libraries/Corrector/Corrector.h>
+#include <device/Arduino/libraries/TrueWindEstimator/InstrumentFilter.h>
+#include <device/Arduino/libraries/TrueWindEstimator/TrueWindEstimator.h>
+#include <gtest/gtest.h>
+#include <server/common/Array.h>
+#include <server/nautical/calib/Calibrator.h>
+#include <server/nautical/calib/CalibratorTestData.h>
+#include <server/nautical/calib/TackCost.h>
+
+using namespace sail;
+
+namespace {
+
+  const int tackCount = 40;
+  const int threadCount = 4;
+
+  // The parameters found with different thread counts, or with the
+  // serial objectives below, only differ by the round-off in the sums
+  // of the solver.
+  void expectSameParameters(Arrayd expected, Arrayd actual) {
+    ASSERT_EQ(expected.size(), actual.size());
+    for (int i = 0; i < expected.size(); i++) {
+      EXPECT_NEAR(expected[i], actual[i],
+                  1.0e-4*(1.0 + std::abs(expected[i]))) << "at " << i;
+    }
+  }
+
+  Arrayd calibrationValues(const Calibrator &calib) {
+    return Arrayd(TrueWindEstimator::NUM_PARAMS, calib.calibrationValues());
+  }
+
+  // The cost of calibrate() for one maneuver the way it was computed
+  // before the ManeuverTable: on ServerFilters of the navs around the
+  // maneuver.
+  class SerialTackCost {
+   public:
+    SerialTackCost(const TackCost *cost) :
+      _before(makeFilter(cost->beforeNavs())),
+      _after(makeFilter(cost->afterNavs())),
+      _weight(cost->weight()) {}
+
+    template <typename T>
+    bool operator()(const T* const x, T* residual) const {
+      HorizontalMotion<T> difference =
+        TrueWindEstimator::computeTrueWind<T, ServerFilter>(x, _after)
+        - TrueWindEstimator::computeTrueWind<T, ServerFilter>(x, _before);
+      residual[0] = T(_weight)*difference[0].knots();
+      residual[1] = T(_weight)*difference[1].knots();
+      return true;
+    }
+   private:
+    ServerFilter _before, _after;
+    double _weight;
+  };
+
+  // Solves the problem of calibrate() with one residual block per
+  // maneuver and a single thread, as before the parallel evaluation.
+  Arrayd solveSerialTackCosts(const Calibrator &calib) {
+    Arrayd params(TrueWindEstimator::NUM_PARAMS);
+    TrueWindEstimator::initializeParameters(params.ptr());
+
+    ceres::Problem problem;
+    for (auto maneuver : calib.maneuvers()) {
+      problem.AddResidualBlock(
+          new ceres::AutoDiffCostFunction<SerialTackCost, 2,
+              TrueWindEstimator::NUM_PARAMS>(new SerialTackCost(maneuver)),
+          new ceres::CauchyLoss(1), params.ptr());
+    }
+    ceres::Solver::Options options;
+    options.max_num_iterations = 500;
+    options.function_tolerance = 1e-7;
+    ceres::Solver::Summary summary;
+    ceres::Solve(options, &problem, &summary);
+    return params;
+  }
+
+  // The objective of calibrateFull() the way it was evaluated before the
+  // parallel evaluation: all maneuvers in a single loop, with dynamic
+  // autodiff.
+  class SerialFullObjective {
+   public:
+    static constexpr int residualsPerManeuver = 4;
+
+    SerialFullObjective(const std::vector<TackCost*> &maneuvers) {
+      for (auto m : maneuvers) {
+        _before.push_back(makeFilter(m->beforeNavs()));
+        _after.push_back(makeFilter(m->afterNavs()));
+        _weights.push_back(m->weight());
+      }
+    }
+
+    int outDims() const {
+      return _weights.size()*residualsPerManeuver;
+    }
+
+    template <typename T>
+    bool operator()(T const* const* parameters, T* residuals) const {
+      const Corrector<T> &corr = *((const Corrector<T> *)parameters[0]);
+      for (int i = 0; i < int(_weights.size()); i++) {
+        auto before = corr.correct(_before[i]);
+        auto after = corr.correct(_after[i]);
+        auto windDif = before.trueWindOverGround() - after.trueWindOverGround();
+        auto currentDif = before.trueCurrentOverGround()
+          - after.trueCurrentOverGround();
+        T *dst = residuals + i*residualsPerManeuver;
+        for (int j = 0; j < 2; j++) {
+          dst[2*j + 0] = _weights[i]*windDif[j].knots();
+          dst[2*j + 1] = _weights[i]*currentDif[j].knots();
+        }
+      }
+      return true;
+    }
+   private:
+    std::vector<ServerFilter> _before, _after;
+    std::vector<double> _weights;
+  };
+
+  Corrector<double> solveSerialFullObjective(const Calibrator &calib) {
+    auto objf = new SerialFullObjective(calib.maneuvers());
+    auto cost = new ceres::DynamicAutoDiffCostFunction<SerialFullObjective>(objf);
+    cost->AddParameterBlock(Corrector<double>::paramCount());
+    cost->SetNumResiduals(objf->outDims());
+
+    Corrector<double> corr;
+    ceres::Problem problem;
+    problem.AddResidualBlock(cost, new ceres::CauchyLoss(1),
+                             (double *)(&corr));
+    ceres::Solver::Options options;
+    options.max_num_iterations = 60;
+    ceres::Solver::Summary summary;
+    ceres::Solve(options, &problem, &summary);
+    return corr;
+  }
+}
+
+TEST(CalibratorTest, CalibrateWithThreads) {
+  NavDataset navs = CalibratorTestData::makeTackingSession(tackCount);
+  Calibrator single, parallel;
+  single.setThreadCount(1);
+  parallel.setThreadCount(threadCount);
+  auto tree = single.grammar().parse(navs);
+
+  ASSERT_TRUE(single.calibrate(navs, tree, "00000000"));
+  ASSERT_TRUE(parallel.calibrate(navs, tree, "00000000"));
+  EXPECT_EQ(single.maneuverCount(), parallel.maneuverCount());
+
+  Arrayd expected = solveSerialTackCosts(single);
+  expectSameParameters(expected, calibrationValues(single));
+  expectSameParameters(expected, calibrationValues(parallel));
+}
+
+TEST(CalibratorTest, CalibrateFullWithThreads) {
+  NavDataset navs = CalibratorTestData::makeTackingSession(tackCount);
+  Calibrator single, parallel;
+  single.setThreadCount(1);
+  parallel.setThreadCount(threadCount);
+  auto tree = single.grammar().parse(navs);
+
+  Corrector<double> singleCorr = calibrateFull(&single, navs, tree, "00000000");
+  Corrector<double> parallelCorr = calibrateFull(
+      &parallel, navs, tree, "00000000");
+  ASSERT_LE(30, single.maneuverCount());
+  EXPECT_EQ(single.maneuverCount(), parallel.maneuverCount());
+
+  Arrayd expected = solveSerialFullObjective(single).toArray().dup();
+  expectSameParameters(expected, singleCorr.toArray());
+  expectSameParameters(expected, parallelCorr.toArray());
+}
@@ -0,0 +1,89 @@
+#include <server/nautical/calib/CalibratorTestData.h>
+
+#include <device/anemobox/Dispatcher.h>
+#include <server/nautical/GeographicReference.h>
+#include <server/nautical/synthtest/BoatSim.h>
+
+namespace sail {
+namespace CalibratorTestData {
+
+namespace {
+
+std::function<HorizontalMotion<double>(BoatSim::ProjectedPosition,
+                                       Duration<double>)>
+  makeConstantFlow(Velocity<double> speed, Angle<double> angle) {
+  return [=](BoatSim::ProjectedPosition, Duration<double>) {
+    return HorizontalMotion<double>::polar(speed, angle);
+  };
+}
+
+template <typename T>
+void insert(DataCode code, const TimedSampleCollection<T> &values,
+            Dispatcher *dst) {
+  dst->insertValues<T>(code, "BoatSim", values.samples());
+}
+
+}  // namespace
+
+NavDataset makeTackingSession(int tackCount) {
+  // The helmsman of BoatSim turns towards the sign of the TWA error,
+  // so the TWA alternates between 45 and -45 degrees: from 45 to 315,
+  // the boat would bear away through the wind instead of tacking.
+  Duration<double> leg = Duration<double>::minutes(3);
+  Array<Duration<double>> legs(tackCount + 1);
+  Array<Angle<double>> twas(tackCount + 1);
+  for (int i = 0; i <= tackCount; i++) {
+    legs[i] = leg;
+    twas[i] = Angle<double>::degrees(i % 2 == 0 ? 45 : -45);
+  }
+
+  BoatSim simulator(
+      makeConstantFlow(Velocity<double>::knots(12),
+                       Angle<double>::degrees(0)),
+      makeConstantFlow(Velocity<double>::knots(0.5),
+                       Angle<double>::degrees(90)),
+      BoatCharacteristics(),
+      BoatSim::makePiecewiseTwaFunction(legs, twas));
+
+  // Fewer steps per second make the turns of the boat diverge.
+  Array<BoatSim::FullState> states = simulator.simulate(
+      double(tackCount + 1)*leg, Duration<double>::seconds(1), 20);
+
+  GeographicReference geoRef(GeographicPosition<double>(
+      Angle<double>::degrees(6.15), Angle<double>::degrees(46.2)));
+  TimeStamp start = TimeStamp::UTC(2016, 6, 1, 12, 0, 0);
+  TimedSampleCollection<GeographicPosition<double>> gpsPos;
+  TimedSampleCollection<Angle<double>> awa, magHdg, gpsBearing;
+  TimedSampleCollection<Velocity<double>> aws, watSpeed, gpsSpeed;
+  for (const auto &state : states) {
+    TimeStamp time = start + state.time;
+    awa.append(TimedValue<Angle<double>>(
+            time, state.awa() + Angle<double>::degrees(3)));
+    aws.append(TimedValue<Velocity<double>>(
+            time, 1.1*state.apparentWind().norm()));
+    magHdg.append(TimedValue<Angle<double>>(
+            time, state.boatOrientation - Angle<double>::degrees(2)));
+    watSpeed.append(TimedValue<Velocity<double>>(
+            time, 0.95*state.boatSpeedThroughWater));
+    gpsPos.append(TimedValue<GeographicPosition<double>>(
+            time, geoRef.unmap(state.pos)));
+    gpsBearing.append(TimedValue<Angle<double>>(
+            time, state.boatMotion.angle()));
+    gpsSpeed.append(TimedValue<Velocity<double>>(
+            time, state.boatMotion.norm()));
+  }
+
+  // The navs are sampled at the GPS positions.
+  auto dispatcher = std::make_shared<Dispatcher>();
+  insert(AWA, awa, dispatcher.get());
+  insert(AWS, aws, dispatcher.get());
+  insert(MAG_HEADING, magHdg, dispatcher.get());
+  insert(WAT_SPEED, watSpeed, dispatcher.get());
+  insert(GPS_POS, gpsPos, dispatcher.get());
+  insert(GPS_BEARING, gpsBearing, dispatcher.get());
+  insert(GPS_SPEED, gpsSpeed, dispatcher.get());
+  return NavDataset(dispatcher).fitBounds();
+}
+
+}
+}
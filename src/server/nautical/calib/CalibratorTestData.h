@@ -0,0 +1,17 @@
+#ifndef SERVER_NAUTICAL_CALIB_CALIBRATORTESTDATA_H_
+#define SERVER_NAUTICAL_CALIB_CALIBRATORTESTDATA_H_
+
+#include <server/nautical/NavDataset.h>
+
+namespace sail {
+namespace CalibratorTestData {
+
+// A simulated session beating upwind in constant wind and current,
+// with 'tackCount' tacks three minutes apart. The instruments are
+// biased, so that there is something to calibrate.
+NavDataset makeTackingSession(int tackCount);
+
+}
+}
+
+#endif /* SERVER_NAUTICAL_CALIB_CALIBRATORTESTDATA_H_ */
@@ -0,0 +1,145 @@
+#ifndef SERVER_NAUTICAL_CALIB_TACKCOST_H_
+#define SERVER_NAUTICAL_CALIB_TACKCOST_H_
+
+#include <cassert>
+#include <ceres/jet.h>
+#include <cmath>
+#include <device/Arduino/libraries/TrueWindEstimator/InstrumentFilter.h>
+#include <device/Arduino/libraries/TrueWindEstimator/TrueWindEstimator.h>
+#include <memory>
+#include <server/nautical/NavDataset.h>
+#include <vector>
+
+namespace sail {
+
+// The filtered instrument values before and after every maneuver.
+// They are computed once, when the maneuver is added, and stored with
+// one array per quantity: the cost functions read them at every
+// evaluation of the solver, which is much more frequent.
+class ManeuverTable {
+ public:
+  // The values of one row, with the same interface as ServerFilter, so
+  // that it can be given to TrueWindEstimator::computeTrueWind and to
+  // Corrector::correct.
+  class Inputs {
+   public:
+    typedef double type;
+
+    Inputs(const ManeuverTable *table, int row) : _table(table), _row(row) { }
+
+    Angle<double> awa() const { return _table->_awa[_row]; }
+    Velocity<double> aws() const { return _table->_aws[_row]; }
+    Angle<double> magHdg() const { return _table->_magHdg[_row]; }
+    Velocity<double> watSpeed() const { return _table->_watSpeed[_row]; }
+    Velocity<double> gpsSpeed() const { return _table->_gpsSpeed[_row]; }
+    Angle<double> gpsBearing() const { return _table->_gpsBearing[_row]; }
+    HorizontalMotion<double> gpsMotion() const {
+      return _table->_gpsMotion[_row];
+    }
+    TimeStamp oldestUpdate() const { return _table->_oldestUpdate[_row]; }
+
+   private:
+    const ManeuverTable *_table;
+    int _row;
+  };
+
+  // Returns the row of the new values.
+  int add(const ServerFilter &filter) {
+    _awa.push_back(filter.awa());
+    _aws.push_back(filter.aws());
+    _magHdg.push_back(filter.magHdg());
+    _watSpeed.push_back(filter.watSpeed());
+    _gpsSpeed.push_back(filter.gpsSpeed());
+    _gpsBearing.push_back(filter.gpsBearing());
+    _gpsMotion.push_back(filter.gpsMotion());
+    _oldestUpdate.push_back(filter.oldestUpdate());
+    return _awa.size() - 1;
+  }
+
+  Inputs at(int row) const { return Inputs(this, row); }
+
+ private:
+  std::vector<Angle<double>> _awa, _magHdg, _gpsBearing;
+  std::vector<Velocity<double>> _aws, _watSpeed, _gpsSpeed;
+  std::vector<HorizontalMotion<double>> _gpsMotion;
+  std::vector<TimeStamp> _oldestUpdate;
+};
+
+// The difference in true wind before and after a maneuver, as a
+// function of the TrueWindEstimator parameters.
+class TackCost {
+  public:
+    TackCost(const std::shared_ptr<ManeuverTable> &table,
+             NavDataset before, NavDataset after, double weight_, TimeStamp time);
+
+    template<typename T>
+    bool operator()(const T* const x, T* residual) const {
+      HorizontalMotion<T> windBefore =
+        TrueWindEstimator::computeTrueWind<T, ManeuverTable::Inputs>(x, before());
+      HorizontalMotion<T> windAfter =
+        TrueWindEstimator::computeTrueWind<T, ManeuverTable::Inputs>(x, after());
+
+      if (1) {
+        HorizontalMotion<T> difference = windAfter - windBefore;
+        residual[0] = T(_weight) * difference[0].knots();
+        residual[1] = T(_weight) * difference[1].knots();
+      } else {
+        residual[0] = T(_weight) * (windAfter.angle().directionDifference(
+                windBefore.angle()).degrees());
+
+        T strengthBefore = windBefore.norm().metersPerSecond();
+        T strengthAfter = windAfter.norm().metersPerSecond();
+
+        // The strength has to be normalized. Otherwise, the optimizer will
+        // be rewarded for underestimating the wind.
+        residual[1] = T(_weight * 360.0 * 2.0) * (
+            (strengthAfter - strengthBefore) / (strengthAfter));
+      }
+      assert(!isnan(residual[0]));
+      assert(!isnan(residual[1]));
+      return true;
+    }
+
+    void printCost(const double* params);
+
+    void angularError(const double *params,
+                         double *sumDegrees, double *sumKnots,
+                         double *sumExternalDegrees, double *sumExternalKnots);
+
+    ManeuverTable::Inputs before() const {
+      return _table->at(_before);
+    }
+
+    ManeuverTable::Inputs after() const {
+      return _table->at(_after);
+    }
+
+    // The navigation data that before() and after() are filtered from.
+    const NavDataset &beforeNavs() const { return _beforeNav; }
+    const NavDataset &afterNavs() const { return _afterNav; }
+
+    double weight() const {
+      return _weight;
+    }
+
+    TimeStamp time() const { return _time; }
+  private:
+    std::shared_ptr<const ManeuverTable> _table;
+    int _before;
+    int _after;
+
+    // For debugging and tests only.
+    NavDataset _beforeNav;
+    NavDataset _afterNav;
+    double _weight;
+    TimeStamp _time;
+
+    template <typename T, int N>
+    static bool isnan(const ceres::Jet<T, N>& f) { return ceres::IsNaN(f); }
+
+    static bool isnan(double x) { return std::isnan(x); }
+};
+
+}  // namespace sail
+
+#endif /* SERVER_NAUTICAL_CALIB_TACKCOST_H_ */
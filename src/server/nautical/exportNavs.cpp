@@ -9,6 +9,8 @@
 #include <server/common/ArgMap.h>
 #include <server/common/Functional.h>
 #include <server/common/TimeStamp.h>
+#include <Poco/File.h>
+#include <server/nautical/ColumnExport.h>
 #include <server/nautical/DownsampleGps.h>
 #include <server/nautical/calib/Calibrator.h>
 #include <server/nautical/logimport/LogLoader.h>
@@ -17,7 +19,7 @@
 using namespace sail;
 using namespace sail::NavCompat;
 
-enum Format  {CSV, MATLAB, JSON};
+enum Format  {CSV, MATLAB, JSON, CSV_COLUMNS, NPY};
 
 struct ExportSettings {
   Format format = CSV;
@@ -29,16 +31,35 @@ struct ExportSettings {
   bool preferInternalGps = false;
   std::string preferredSource;
   std::string timeFormat = "us";
+
+  // Time range and channels. Only the column formats select channels.
+  ColumnExportSettings columns;
 };
 
-NavDataset loadNavsFromArgs(Array<ArgMap::Arg*> args) {
+NavDataset loadNavsFromArgs(Array<ArgMap::Arg*> args,
+                            const ExportSettings& settings) {
+  // Directories are loaded through their index when only a part of the
+  // data is exported. The calibration needs all of it.
+  LogFilter filter;
+  filter.from = settings.columns.from;
+  filter.to = settings.columns.to;
+  if (settings.format == CSV_COLUMNS || settings.format == NPY) {
+    filter.channels = settings.columns.channels;
+  }
+  bool filtered = !settings.simulatedTrueWindData && (filter.from.defined()
+      || filter.to.defined() || !filter.channels.empty());
+
   LogLoader loader;
   for (auto arg: args) {
     auto p = arg->value();
     LOG(INFO) << "Load navs from " << p;
-    loader.load(p);
+    if (filtered && Poco::File(p).isDirectory()) {
+      loader.load(p, filter);
+    } else {
+      loader.load(p);
+    }
   }
-  return loader.makeNavDataset();
+  return loader.takeNavDataset();
 }
 
 struct NavField {
@@ -270,7 +291,7 @@ NavDataset performCalibration(NavDataset navs0,const ExportSettings& settings) {
 }
 
 int exportNavs(Array<ArgMap::Arg*> args, const ExportSettings& settings, std::string output) {
-  NavDataset navs = removeStrangeGpsPositions(loadNavsFromArgs(args));
+  NavDataset navs = removeStrangeGpsPositions(loadNavsFromArgs(args, settings));
 
   if (settings.preferredSource.size() > 0) {
     navs.preferSourceAll(settings.preferredSource);
@@ -291,6 +312,24 @@ int exportNavs(Array<ArgMap::Arg*> args, const ExportSettings& settings, std::st
     navs = performCalibration(navs, settings);
   }
   const std::string& format = settings.formatStr;
+
+  if (settings.format == CSV_COLUMNS || settings.format == NPY) {
+    Poco::File(output).createDirectories();
+    int count = exportColumns(navs, settings.columns,
+        settings.format == NPY? ColumnFormat::Npy : ColumnFormat::Csv, output);
+    if (count < 0) {
+      return -1;
+    }
+    LOG(INFO) << "Exported " << count << " channels to " << output;
+    return 0;
+  }
+
+  if (settings.columns.from.defined()) {
+    navs = navs.sliceFrom(settings.columns.from);
+  }
+  if (settings.columns.to.defined()) {
+    navs = navs.sliceTo(settings.columns.to);
+  }
   LOG(INFO) << "Navs successfully loaded, export them to "
       << output << " with format " << format;
   std::ofstream file(output);
@@ -307,15 +346,25 @@ int exportNavs(Array<ArgMap::Arg*> args, const ExportSettings& settings, std::st
 
   auto sampled = makeArray(navs);
   LOG(INFO) << "Number of navs to export: " << sampled.size();
+  int result = 0;
   if (format == "csv") {
-    return exportCsv(settings.withHeader, fields, sampled, &file);
+    result = exportCsv(settings.withHeader, fields, sampled, &file);
   } else if (format == "json") {
-    return exportJson(settings.withHeader, fields, sampled, &file);
+    result = exportJson(settings.withHeader, fields, sampled, &file);
   } else if (format == "matlab") {
-    return exportMatlab(settings.withHeader, fields, sampled, &file);
+    result = exportMatlab(settings.withHeader, fields, sampled, &file);
+  } else {
+    LOG(ERROR) << ("Export format not recognized: " + format);
+    return -1;
   }
-  LOG(ERROR) << ("Export format not recognized: " + format);
-  return -1;
+
+  // Closing flushes the end of the data, so the state is checked after it.
+  file.close();
+  if (!file.good()) {
+    LOG(ERROR) << "Failed to write " << output;
+    return -1;
+  }
+  return result;
 }
 
 int main(int argc, const char **argv) {
@@ -324,10 +373,19 @@ int main(int argc, const char **argv) {
   std::string output = "/tmp/exported_navs.txt";
 
   ArgMap amap;
-  amap.registerOption("--format", "What export format to use: (matlab, json, csv). Defaults to " + settings.formatStr)
+  std::string from, to, channels;
+  amap.registerOption("--format", "What export format to use: (matlab, json, csv, csv-columns, npy). Defaults to " + settings.formatStr
+      + ". With csv-columns and npy, every channel is exported to its own files in the output directory,"
+      " straight from its samples.")
       .store(&settings.formatStr);
   amap.registerOption("--output", "Where to put the exported data. Defaults to " + output)
     .store(&output);
+  amap.registerOption("--from", "Only export data from this time, e.g. 2016-06-01T12:00:00Z")
+    .store(&from);
+  amap.registerOption("--to", "Only export data until this time")
+    .store(&to);
+  amap.registerOption("--channels", "Comma separated channels to export with csv-columns and npy, e.g. awa,aws,pos")
+    .store(&channels);
   amap.registerOption("--no-header", "Omit header labels for data columns");
   amap.registerOption("--no-simulate", "Skip simulated true wind columns");
   amap.registerOption("-v", "Verbose output");
@@ -352,7 +410,26 @@ int main(int argc, const char **argv) {
         return 0;
       } else {
         settings.format = (settings.formatStr == "csv"?
-                           CSV : (settings.formatStr == "json"? JSON : MATLAB));
+                           CSV : (settings.formatStr == "json"? JSON
+                           : (settings.formatStr == "csv-columns"? CSV_COLUMNS
+                           : (settings.formatStr == "npy"? NPY : MATLAB))));
+        if (!from.empty()) {
+          settings.columns.from = TimeStamp::parse(from);
+          if (!settings.columns.from.defined()) {
+            LOG(ERROR) << "Failed to parse time " << from;
+            return -1;
+          }
+        }
+        if (!to.empty()) {
+          settings.columns.to = TimeStamp::parse(to);
+          if (!settings.columns.to.defined()) {
+            LOG(ERROR) << "Failed to parse time " << to;
+            return -1;
+          }
+        }
+        if (!parseChannelNames(channels, &settings.columns.channels)) {
+          return -1;
+        }
         settings.withHeader = !amap.optionProvided("--no-header");
         settings.verbose = amap.optionProvided("-v");
 	settings.preferInternalGps = amap.optionProvided("-i");
@@ -5,6 +5,7 @@
  *      Author: jonas
  */
 
+#include <server/common/ArrayArena.h>
 #include <server/common/ArrayBuilder.h>
 #include <server/transducers/Transducer.h>
 #include <server/common/logging.h>
@@ -28,7 +29,6 @@ template <typename T>
 using Vec2 = sail::Curve2dFilter::Vec2<T>;
 
 typedef Vec2<Length<double>> Position2d;
-typedef Vec2<Velocity<double>> Motion2d;
 
 Curve2dFilter::Settings makeDefaultOptSettings() {
   Curve2dFilter::Settings s;
@@ -57,7 +57,7 @@ namespace {
 
     for (int i = 0; i < n; i++) {
       auto &y = dst[i];
-      auto x = positions[i];
+      const auto &x = positions[i];
       y.time = x.time;
       y.value = geoRef.map(x.value);
       if (prog.endOfIteration()) {
@@ -68,19 +68,6 @@ namespace {
   }
 }
 
-Array<TimedValue<Vec2<Velocity<double>>>> toLocalMotions(
-    const Array<TimedValue<HorizontalMotion<double>>> &motions) {
-  int n = motions.size();
-  Array<TimedValue<Vec2<Velocity<double>>>> dst(n);
-  for (int i = 0; i < n; i++) {
-    const auto& m = motions[i];
-    dst[i] = TimedValue<Vec2<Velocity<double>>>(
-        m.time, Vec2<Velocity<double>>(m.value));
-  }
-  return dst;
-}
-
-
 Array<TimedValue<Position2d>> removePositionsFarAway(
     const Array<TimedValue<Position2d>> &src,
     Length<double> maxLen) {
@@ -94,27 +81,6 @@ Array<TimedValue<Position2d>> removePositionsFarAway(
   return dst.get();
 }
 
-Array<TimedValue<Position2d>> to2dPositions(
-    const GeographicReference& ref,
-    const Array<TimedValue<GeographicPosition<double>>>& src) {
-  using namespace Curve2dFilter;
-  int n = src.size();
-  Array<TimedValue<Position2d>> dst(n);
-  for (int i = 0; i < n; i++) {
-    dst[i] = TimedValue<Position2d>(src[i].time, ref.map(src[i].value));
-  }
-  return dst;
-}
-
-TimedValue<Motion2d> toMotion2d(const TimedValue<HorizontalMotion<double>>& x) {
-  return TimedValue<Motion2d>(x.time, Motion2d{x.value[0], x.value[1]});
-}
-
-Array<TimedValue<Motion2d>> to2dMotions(
-    const Array<TimedValue<HorizontalMotion<double>>>& src) {
-  return transduce(src, trMap(&toMotion2d), IntoArray<TimedValue<Motion2d>>());
-}
-
 Array<TimedValue<GeographicPosition<double>>>
   LocalGpsFilterResults::samplePositions() const {
   ArrayBuilder<TimedValue<GeographicPosition<double>>> dst(
@@ -371,15 +337,14 @@ LocalGpsFilterResults solveGpsSubproblem(
   auto referencePosition = GpsUtils::getReferencePosition(rawPositions);
   GeographicReference geoRef(referencePosition);
 
+  // This is the only projection pass: the same local positions are
+  // optimized over and kept in the results for plotting.
   auto rawLocalPositions = getLocalPositions(geoRef, rawPositions);
 
-
   TimeStamp start = TimeStamp::now();
-  auto positionsForFilter = to2dPositions(geoRef, rawPositions);
-  auto motionsForFilter = to2dMotions(motions);
   LOG(INFO) << "Optimizing sub problem on " << mapper.sampleCount() << " samples...";
   Curve2dFilter::Results results = Curve2dFilter::optimize(mapper,
-      positionsForFilter, motionsForFilter,
+      rawLocalPositions, motions,
       settings.curveFilterSettings);
   if (!results.OK()) {
     return LocalGpsFilterResults();
@@ -390,7 +355,7 @@ LocalGpsFilterResults solveGpsSubproblem(
       settings.medianWindowLength,
       dst);
 
-  CHECK(rawPositions.size() == positionsForFilter.size());
+  CHECK(rawPositions.size() == rawLocalPositions.size());
 
   for (auto curve: curves) {
     auto motion = curve.derivative();
@@ -592,7 +557,7 @@ GpsFilterResults mergeSubResults(
 
   for (int i = 0; i < subResults.size(); i++) {
     auto body = DOM::makeSubNode(log, "pre");
-    auto x = subResults[i];
+    const auto &x = subResults[i];
     auto pos = x.samplePositions();
     auto mot = x.sampleMotions();
     DOM::addLine(&body, stringFormat("  * Sub results %d", i));
@@ -755,16 +720,18 @@ void append(ArrayBuilder<T> *dst, const Array<T> &src) {
   }
 }
 
-TimeStamp getCuttingTime(
-    const Array<TimedValue<GeographicPosition<double>>>& src,
-    int index) {
-  TimeStamp a = src[index-1].time;
-  TimeStamp b = src[index].time;
+// The raw positions are read in place from the dataset.
+typedef TimedSampleRange<GeographicPosition<double>> PositionRange;
+
+TimeStamp getCuttingTime(const PositionRange& src, int index) {
+  auto p = src.begin();
+  TimeStamp a = p[index-1].time;
+  TimeStamp b = p[index].time;
   return a + 0.5*(b - a);
 }
 
 Array<Span<TimeStamp>> makeBadSpans(
-    const Array<TimedValue<GeographicPosition<double>>>& src,
+    const PositionRange& src,
     const std::vector<int>& inds) {
   ArrayBuilder<Span<TimeStamp>> dst;
   if (inds.empty()) {
@@ -788,7 +755,7 @@ Array<Span<TimeStamp>> makeBadSpans(
 }
 
 PositionPrefiltering removeSingleOutliers(
-    const Array<TimedValue<GeographicPosition<double>>> &src,
+    const PositionRange &src,
     DOM::Node *log) {
 
   DOM::addSubTextNode(log, "h4", "Single outlier removal");
@@ -803,10 +770,11 @@ PositionPrefiltering removeSingleOutliers(
 
   ArrayBuilder<TimedValue<GeographicPosition<double>>> dst(src.size());
   int n = src.size();
+  auto p = src.begin();
   std::vector<int> badIndices;
   for (int i = 1; i < n-1; i++) {
-    auto x = src[i];
-    if (!isSingleOutlier(src[i-1], x, src[i+1])) {
+    const auto &x = p[i];
+    if (!isSingleOutlier(p[i-1], x, p[i+1])) {
       dst.add(x);
     } else {
       badIndices.push_back(i);
@@ -821,7 +789,7 @@ PositionPrefiltering removeSingleOutliers(
 }
 
 PositionPrefiltering prefilterPositions(
-    const Array<TimedValue<GeographicPosition<double>>> &src0,
+    const PositionRange &src0,
     DOM::Node *log) {
 
   if (src0.empty()) {
@@ -963,29 +931,17 @@ TimeSeg segmentTime(
   };
 }
 
-Array<TimedValue<GeographicPosition<double>>> getPositions(
-    const NavDataset &src) {
-  auto src0 = src.samples<GPS_POS>();
-  int n = src0.size();
-  Array<TimedValue<GeographicPosition<double>>> dst(n);
-  std::copy(src0.begin(), src0.end(), dst.begin());
-  return dst;
-}
-
-GpsData getGpsData(const NavDataset &src) {
-  return GpsData{
-    getPositions(src),
-    GpsUtils::getGpsMotions(src)
-  };
-}
-
-
+// The positions are prefiltered straight from the dataset, so that
+// only the good positions are copied. The sub problems then refer to
+// slices of that array.
 GpsData prefilterAllData(
-    const GpsData &data,
+    const PositionRange &positions,
+    const NavDataset &ds,
     const GpsFilterSettings &settings,
     DOM::Node *log) {
-  auto pp = prefilterPositions(data.positions, log);
-  auto pm = maskUnreliable(pp.unreliableSpans, data.motions, log);
+  auto pp = prefilterPositions(positions, log);
+  auto pm = maskUnreliable(pp.unreliableSpans,
+      GpsUtils::getGpsMotions(ds), log);
   return GpsData{pp.goodPositions, pm};
 }
 
@@ -1002,13 +958,13 @@ GpsFilterResults filterGpsData(
     return GpsFilterResults();
   }
 
-  auto rawData = getGpsData(ds);
-  if (rawData.positions.empty()) {
+  auto rawPositions = ds.samples<GPS_POS>();
+  if (rawPositions.empty()) {
     LOG(ERROR) << "No GPS positions in dataset, cannot filter";
     return GpsFilterResults();
   }
 
-  auto cleanData = prefilterAllData(rawData, settings, log);
+  auto cleanData = prefilterAllData(rawPositions, ds, settings, log);
 
   auto time = segmentTime(cleanData, settings, false);
   auto positionSlices = applySplits(cleanData.positions, time.splits);
@@ -1026,10 +982,13 @@ GpsFilterResults filterGpsData(
   for (int i = 0; i < n; i++) {
     LOG(INFO) << "Running GPS filter for span "
         << i+1 << "/" << time.spans.size();
-    auto positionSlice = positionSlices[i];
-    auto motionSlice = motionSlices[i];
+    const auto &positionSlice = positionSlices[i];
+    const auto &motionSlice = motionSlices[i];
     auto li = DOM::makeSubNode(&ol, "li");
 
+    // The temporary arrays of the subproblem are released in bulk.
+    ScopedArrayArena arena;
+
     auto span = time.spans[i];
     auto from = span.minv() - 0.5_s;
     auto to = span.maxv() + 0.5_s;
@@ -4,6 +4,8 @@
  */
 
 #include "HintedStateAssign.h"
+#include <algorithm>
+#include <server/common/ArrayBuilder.h>
 #include <server/common/Span.h>
 #include <server/common/logging.h>
 #include <server/transducers/Transducer.h>
@@ -90,5 +92,65 @@ double HintedStateAssign::getTransitionCost(int fromStateIndex,
   return cost;
 }
 
+Arrayi HintedStateAssign::getAllowedStates(int timeIndex) {
+  Arrayi allowed = _ref->getAllowedStates(timeIndex);
+  int i = _stateTable[timeIndex];
+  if (i == -1) {
+    return allowed;
+  }
+
+  std::vector<int> dst(allowed.begin(), allowed.end());
+  for (auto x : _stateOverlaps[i].objects()) {
+    Arrayi hinted = x->getAllowedStates(timeIndex);
+    if (hinted.hasData()) {
+      auto last = std::set_intersection(dst.begin(), dst.end(),
+          hinted.begin(), hinted.end(), dst.begin());
+      dst.erase(last, dst.end());
+    }
+  }
+  if (dst.empty()) {
+    LOG(WARNING) << "The hints allow no state at time index " << timeIndex
+      << ", ignoring them as constraints there";
+    return allowed;
+  }
+  return Arrayi(dst.size(), dst.data()).dup();
+}
+
+Arrayi HintedStateAssign::getPrecedingStates(int stateIndex, int timeIndex) {
+  Arrayi preds = _ref->getPrecedingStates(stateIndex, timeIndex);
+  int fromTimeIndex = timeIndex - 1;
+  int i = _transitionTable[calcTIndex(fromTimeIndex)];
+  if (i == -1) {
+    return preds;
+  }
+
+  // Only the predecessors that are allowed at the previous time index
+  // can be used, and among those the transitions that the hints allow.
+  Arrayi allowedBefore = getAllowedStates(fromTimeIndex);
+  const Array<LocalStateAssignPtr> &X = _transitionOverlaps[i].objects();
+  ArrayBuilder<int> reachable(preds.size()), dst(preds.size());
+  for (auto pred : preds) {
+    if (!std::binary_search(allowedBefore.begin(), allowedBefore.end(), pred)) {
+      continue;
+    }
+    reachable.add(pred);
+    bool allowed = true;
+    for (auto x : X) {
+      allowed = allowed && x->isAllowedTransition(pred, stateIndex, fromTimeIndex);
+    }
+    if (allowed) {
+      dst.add(pred);
+    }
+  }
+  if (dst.size() > 0) {
+    return dst.get();
+  }
+  return reachable.size() > 0? reachable.get() : preds;
+}
+
+Arrayi HintedStateAssign::getUnconstrainedPrecedingStates(
+    int stateIndex, int timeIndex) {
+  return _ref->getUnconstrainedPrecedingStates(stateIndex, timeIndex);
+}
 
 } /* namespace mmm */
@@ -31,6 +31,22 @@ class LocalStateAssign {
   virtual double getStateCost(int stateIndex, int timeIndex) = 0;
   virtual double getTransitionCost(int fromStateIndex, int toStateIndex, int fromTimeIndex) = 0;
 
+  /*
+   * Methods to override for hints that are hard constraints. Those
+   * shrink the set of states and transitions that the decoder visits,
+   * instead of only adding a HardPenalty to the ones that are not allowed.
+   */
+
+  // The sorted indices of the only states allowed at 'timeIndex',
+  // or an empty array if this hint does not restrict them.
+  virtual Arrayi getAllowedStates(int timeIndex) {
+    return Arrayi();
+  }
+
+  virtual bool isAllowedTransition(int fromStateIndex, int toStateIndex, int fromTimeIndex) {
+    return true;
+  }
+
   /*
    * Other methods
    */
@@ -66,7 +82,11 @@ class LocalStateAssign {
  * and augments it with hints of type LocalStateAssign.
  *
  * Every hint adds a local cost to the costs originally computed
- * by 'ref'.
+ * by 'ref'. The states and transitions that a hint does not allow are
+ * removed from the problem, unless that would leave no state at some time,
+ * or no predecessor to a state. Where contradictory hints still leave no
+ * path, solve() falls back to the states and predecessors of 'ref' with
+ * the HardPenalty costs of the hints.
  *
  * This object is a StateAssign object itself and calling
  * its method 'solve' will solve the problem specified by 'ref'
@@ -91,9 +111,9 @@ class HintedStateAssign : public StateAssign {
   int getLength() {
     return _ref->getLength();
   }
-  Arrayi getPrecedingStates(int stateIndex, int timeIndex) {
-    return _ref->getPrecedingStates(stateIndex, timeIndex);
-  }
+  Arrayi getPrecedingStates(int stateIndex, int timeIndex);
+  Arrayi getUnconstrainedPrecedingStates(int stateIndex, int timeIndex);
+  Arrayi getAllowedStates(int timeIndex);
  private:
   std::shared_ptr<StateAssign> _ref;
 
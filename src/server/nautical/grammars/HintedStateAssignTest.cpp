@@ -155,3 +155,146 @@ TEST(HintedStateAssignTest, NoHintsTest) {
 }
 
 
+
+namespace {
+  // Same as Hint, but as a hard constraint.
+  class HardHint : public Hint {
+   public:
+    Arrayi getAllowedStates(int timeIndex) {
+      return Arrayi{timeIndex == 15? 0 : 1};
+    }
+
+    bool isAllowedTransition(int fromStateIndex, int toStateIndex, int fromTimeIndex) {
+      return fromStateIndex == 0 && toStateIndex == 1;
+    }
+  };
+}
+
+TEST(HintedStateAssignTest, HardHintTest) {
+  Ref ref;
+  Hint hint;
+  HardHint hardHint;
+
+  HintedStateAssign soft(makeSharedPtrToStack(ref),
+      Array<HintedStateAssign::LocalStateAssignPtr>{makeSharedPtrToStack(hint)});
+  HintedStateAssign hard(makeSharedPtrToStack(ref),
+      Array<HintedStateAssign::LocalStateAssignPtr>{makeSharedPtrToStack(hardHint)});
+  EXPECT_EQ(soft.solve(), hard.solve());
+
+  EXPECT_EQ(Arrayi{0}, hard.getAllowedStates(15));
+  EXPECT_EQ(Arrayi{1}, hard.getAllowedStates(16));
+  EXPECT_EQ(2, hard.getAllowedStates(17).size());
+  EXPECT_EQ(Arrayi{0}, hard.getPrecedingStates(1, 16));
+
+  // The states that are not allowed are never visited.
+  MDArray2d costs = hard.makeCostMatrix();
+  EXPECT_TRUE(std::isinf(costs(1, 15)));
+  EXPECT_TRUE(std::isinf(costs(0, 16)));
+  EXPECT_FALSE(std::isinf(costs(0, 17)));
+}
+
+namespace {
+  // Three states, where state 2 can only follow itself, unless 'anyPred'.
+  class Ref3 : public StateAssign {
+   public:
+    Ref3(bool anyPred) : _anyPred(anyPred) {}
+
+    double getStateCost(int stateIndex, int timeIndex) {
+      return 1.0 + sin(234.989*timeIndex + 100*stateIndex);
+    }
+
+    double getTransitionCost(int fromStateIndex, int toStateIndex, int fromTimeIndex) {
+      return std::abs(fromStateIndex - toStateIndex);
+    }
+
+    int getStateCount() {return 3;}
+
+    int getLength() {return 30;}
+
+    Arrayi getPrecedingStates(int stateIndex, int timeIndex) {
+      return stateIndex == 2 && !_anyPred? Arrayi{2} : listStateInds();
+    }
+   private:
+    bool _anyPred;
+  };
+
+  // Allows only the transition from 'from' at 'timeIndex'
+  // to 'to' at the next time index. Unless 'restrictFrom', all
+  // states are allowed at 'timeIndex'.
+  class HardTransitionHint : public LocalStateAssign {
+   public:
+    HardTransitionHint(int timeIndex, int from, int to,
+                       bool restrictFrom = true) :
+      _timeIndex(timeIndex), _from(from), _to(to),
+      _restrictFrom(restrictFrom) {}
+
+    int getStateCount() {return 3;}
+    int begin() const {return _timeIndex;}
+    int end() const {return _timeIndex + 2;}
+
+    double getStateCost(int stateIndex, int timeIndex) {
+      return 0;
+    }
+
+    double getTransitionCost(int fromStateIndex, int toStateIndex, int fromTimeIndex) {
+      return isAllowedTransition(fromStateIndex, toStateIndex, fromTimeIndex)?
+          0 : HardPenalty;
+    }
+
+    Arrayi getAllowedStates(int timeIndex) {
+      if (timeIndex == _timeIndex) {
+        return _restrictFrom? Arrayi{_from} : Arrayi();
+      }
+      return Arrayi{_to};
+    }
+
+    bool isAllowedTransition(int fromStateIndex, int toStateIndex, int fromTimeIndex) {
+      return fromStateIndex == _from && toStateIndex == _to;
+    }
+   private:
+    int _timeIndex, _from, _to;
+    bool _restrictFrom;
+  };
+
+  bool isValidAssignment(StateAssign *sa, Arrayi states) {
+    if (states.size() != sa->getLength()) {
+      return false;
+    }
+    for (int i = 0; i < states.size(); i++) {
+      if (states[i] < 0 || sa->getStateCount() <= states[i]) {
+        return false;
+      }
+      if (0 < i) {
+        Arrayi preds = sa->getUnconstrainedPrecedingStates(states[i], i);
+        if (std::find(preds.begin(), preds.end(), states[i-1]) == preds.end()) {
+          return false;
+        }
+      }
+    }
+    return true;
+  }
+}
+
+TEST(HintedStateAssignTest, ContradictoryHardHints) {
+  {
+    // The first hint ends in state 1 at time 16, from where
+    // the second one does not allow to continue.
+    Ref3 ref(true);
+    HardTransitionHint a(15, 0, 1), b(16, 0, 2, false);
+    HintedStateAssign hinted(makeSharedPtrToStack(ref),
+        Array<HintedStateAssign::LocalStateAssignPtr>{
+          makeSharedPtrToStack(a), makeSharedPtrToStack(b)});
+    Arrayi states = hinted.solve();
+    EXPECT_TRUE(isValidAssignment(&hinted, states));
+    EXPECT_EQ(states, hinted.solveInChunks(Arrayi{10, 20}, 5, 2));
+  }{
+    // The hinted transition to state 2 is not one of the grammar.
+    Ref3 ref(false);
+    HardTransitionHint a(15, 0, 2);
+    HintedStateAssign hinted(makeSharedPtrToStack(ref),
+        Array<HintedStateAssign::LocalStateAssignPtr>{makeSharedPtrToStack(a)});
+    Arrayi states = hinted.solve();
+    EXPECT_TRUE(isValidAssignment(&hinted, states));
+    EXPECT_EQ(states, hinted.solveInChunks(Arrayi{10, 20}, 5, 2));
+  }
+}
@@ -5,6 +5,7 @@
 
 #include "TransitionHint.h"
 #include <server/common/logging.h>
+#include <server/common/ArrayBuilder.h>
 #include <algorithm>
 #include <server/nautical/grammars/Grammar.h>
 #include <server/common/string.h>
@@ -23,6 +24,21 @@ double TransitionHint::getTransitionCost(int fromStateIndex,
     return HardPenalty;
 }
 
+Arrayi TransitionHint::getAllowedStates(int timeIndex) {
+  bool from = (timeIndex == _timeIndex);
+  int n = _validTransitions.rows();
+  ArrayBuilder<int> dst(n);
+  for (int i = 0; i < n; i++) {
+    for (int j = 0; j < n; j++) {
+      if (from? _validTransitions(i, j) : _validTransitions(j, i)) {
+        dst.add(i);
+        break;
+      }
+    }
+  }
+  return dst.get();
+}
+
 namespace {
   std::shared_ptr<LocalStateAssign> makeNonEmpty(TimeStamp ts, MDArray2b table, const Array<Nav> &navs) {
     if (!table.empty()) {
@@ -40,6 +40,14 @@ class TransitionHint : public LocalStateAssign {
 
   double getTransitionCost(int fromStateIndex, int toStateIndex, int fromTimeIndex);
 
+  // Only the states with a valid transition are allowed before
+  // and after the transition.
+  Arrayi getAllowedStates(int timeIndex);
+
+  bool isAllowedTransition(int fromStateIndex, int toStateIndex, int fromTimeIndex) {
+    return _validTransitions(fromStateIndex, toStateIndex);
+  }
+
   static std::shared_ptr<LocalStateAssign> make(const UserHint &hint,
       const Array<Nav> &navs, const Grammar &dst);
   private:
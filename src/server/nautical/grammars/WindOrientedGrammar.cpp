@@ -14,6 +14,8 @@
 #include <server/nautical/grammars/StaticCostFactory.h>
 #include <server/nautical/grammars/HintedStateAssignFactory.h>
 #include <server/common/SharedPtrUtils.h>
+#include <server/common/ArrayBuilder.h>
+#include <thread>
 
 namespace sail {
 
@@ -30,6 +32,9 @@ WindOrientedGrammarSettings::WindOrientedGrammarSettings() {
   onOffCost = 2*majorTransitionCost;
   majorStateCost = 1.0;
   switchOnOffDuringRace = true;
+  threadCount = std::max(1u, std::thread::hardware_concurrency());
+  chunkLength = 20000;
+  chunkOverlap = 2000;
 }
 
 
@@ -342,6 +347,33 @@ double G001SA::getTransitionCost(int fromStateIndex, int toStateIndex, int fromT
   return getG001StateTransitionCost(_settings, fromStateIndex, toStateIndex, fromTimeIndex, _navs);
 }
 
+namespace {
+  // Staying on across a long gap between navs costs perSecondCost per second,
+  // so the device is switched off there and overlapping chunks agree on the
+  // costs soon after it. Those gaps are the cuts.
+  Arrayi findChunkCuts(const Array<Nav> &navs, int chunkLength) {
+    if (chunkLength <= 0) {
+      return Arrayi();
+    }
+    int n = navs.size();
+    int margin = chunkLength/4;
+    ArrayBuilder<int> cuts;
+    for (int nominal = chunkLength; nominal + margin < n; nominal += chunkLength) {
+      int best = nominal;
+      double bestGap = -1;
+      for (int i = std::max(1, nominal - margin); i < nominal + margin; i++) {
+        double gap = (navs[i].time() - navs[i-1].time()).seconds();
+        if (gap > bestGap) {
+          bestGap = gap;
+          best = i;
+        }
+      }
+      cuts.add(best);
+    }
+    return cuts.get();
+  }
+}
+
 std::shared_ptr<HTree> WindOrientedGrammar::parse(NavDataset navs0,
     Array<UserHint> hints) {
   auto navs = NavCompat::makeArray(navs0);
@@ -350,7 +382,9 @@ std::shared_ptr<HTree> WindOrientedGrammar::parse(NavDataset navs0,
     return std::shared_ptr<HTree>();
   }
   G001SA sa(_settings, navs);
-  Arrayi states = makeHintedStateAssign(*this, makeSharedPtrToStack(sa), hints, navs).solve();
+  Arrayi states = makeHintedStateAssign(*this, makeSharedPtrToStack(sa), hints, navs)
+    .solveInChunks(findChunkCuts(navs, _settings.chunkLength),
+                   _settings.chunkOverlap, _settings.threadCount);
   return _hierarchy.parse(states);
 }
 
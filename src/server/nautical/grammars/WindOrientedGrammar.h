@@ -24,6 +24,15 @@ struct WindOrientedGrammarSettings {
   double onOffCost;           // cost for being in the off-state
   double majorStateCost;
   bool switchOnOffDuringRace;
+
+  // Long sequences are split into chunks of about 'chunkLength' navs,
+  // decoded in parallel by 'threadCount' threads. The chunks are cut at
+  // the longest gap between navs near their nominal boundaries, and
+  // overlap by 'chunkOverlap' navs (see StateAssign::solveInChunks).
+  // The result is the same as with a single thread.
+  int threadCount;
+  int chunkLength;
+  int chunkOverlap;
 };
 
 class WindOrientedGrammar : public Grammar {
@@ -126,3 +126,25 @@ TEST(WindOrientedGrammarTest, Hinting) {
 
   */
 }
+
+TEST(WindOrientedGrammarTest, ParseInChunks) {
+  Poco::Path path = PathBuilder::makeDirectory(Env::SOURCE_DIR)
+    .pushDirectory("datasets")
+    .pushDirectory("Irene")
+    .pushDirectory("2007")
+    .pushDirectory("regate_1_dec_07")
+    .makeFile("IreneLog.txt").get();
+
+  auto navs = LogLoader::loadNavDataset(path);
+
+  WindOrientedGrammarSettings settings;
+  settings.threadCount = 1;
+  std::shared_ptr<HTree> expected = WindOrientedGrammar(settings).parse(navs);
+
+  settings.threadCount = 4;
+  settings.chunkLength = getNavSize(navs)/7;
+  settings.chunkOverlap = settings.chunkLength/4;
+  std::shared_ptr<HTree> chunked = WindOrientedGrammar(settings).parse(navs);
+
+  EXPECT_TRUE(expected->equals(chunked));
+}
@@ -6,8 +6,8 @@
 #include <server/nautical/logimport/CsvLoader.h>
 #include <server/nautical/logimport/LogLoader.h>
 #include <server/common/logging.h>
-#include <Poco/String.h>
-#include <server/common/CsvParser.h>
+#include <fstream>
+#include <server/common/CsvReader.h>
 #include <server/nautical/logimport/SourceGroup.h>
 #include <server/common/string.h>
 
@@ -21,39 +21,36 @@ Angle<double> degrees = Angle<double>::degrees(1.0);
 Velocity<double> knots = Velocity<double>::knots(1.0);
 Velocity<double> metersPerSecond = Velocity<double>::metersPerSecond(1.0);
 
+typedef std::function<void(CsvField)> CsvSetter;
+
 template <typename T>
-std::function<void(std::string)> makeSetter(T unit, T *dst) {
-  return [=](const std::string &s) {
+CsvSetter makeSetter(T unit, T *dst) {
+  return [=](CsvField s) {
     double x = 0;
-    if (!tryParseDouble(s, &x)) {
+    if (!tryParseCsvDouble(s, &x)) {
       x = std::numeric_limits<double>::signaling_NaN();
     }
     *dst = x*unit;
   };
 }
 
-std::function<void(std::string)> makeTimeSetter(TimeStamp *dst) {
-  return [=](const std::string &s) {
-    *dst = TimeStamp::parse(s);
+CsvSetter makeTimeSetter(TimeStamp *dst) {
+  return [=](CsvField s) {
+    // Most logs have ISO 8601 times, that are parsed without a string.
+    TimeStamp t = TimeStamp::parseIso8601(s.begin, s.end);
+    *dst = (t.defined()? t : TimeStamp::parse(s.str()));
   };
 }
 
-void doNothing(const std::string &s) {}
-
-std::string trimCsvString(const std::string& s) {
-  std::string h = Poco::trim(s);
-  if (h[0] == '"' && h.size() > 2 && h[h.size() - 1] == '"') {
-    h = h.substr(1, h.size() - 2);
-  }
-  return h;
-}
+void doNothing(CsvField s) {}
 
 }  // namespace
 
 class CsvRowProcessor {
  public:
-  CsvRowProcessor(const MDArray<std::string, 2> &header);
-  void process(const MDArray<std::string, 2> &row, SourceGroup *dst);
+  CsvRowProcessor(const std::vector<CsvField> &header,
+                  bool verbose = true);
+  void process(const std::vector<CsvField> &row, SourceGroup *dst);
 
   bool hasValidHeader() const { return _validHeader; }
  private:
@@ -61,7 +58,8 @@ class CsvRowProcessor {
   CsvRowProcessor &operator=(const CsvRowProcessor &other) = delete;
   CsvRowProcessor(const CsvRowProcessor &other) = delete;
 
-  std::vector<std::function<void(std::string)> > _setters;
+  // One per column of the header, compiled once.
+  std::vector<CsvSetter> _setters;
 
   Angle<double> _awa, _twa, _magHdg, _gpsBearing, _lon, _lat, _pitch, _roll;
   Angle<double> _twdir, _rudder;
@@ -77,8 +75,9 @@ class CsvRowProcessor {
 
 };
 
-CsvRowProcessor::CsvRowProcessor(const MDArray<std::string, 2> &header) {
-  std::map<std::string, std::function<void(std::string)> > m;
+CsvRowProcessor::CsvRowProcessor(const std::vector<CsvField> &header,
+                                 bool verbose) {
+  std::map<std::string, CsvSetter> m;
   m["DATE/TIME(UTC)"] = makeTimeSetter(&_time);
   m["Lat."] = makeSetter(degrees, &_lat);
   m["Long."] = makeSetter(degrees, &_lon);
@@ -123,9 +122,9 @@ CsvRowProcessor::CsvRowProcessor(const MDArray<std::string, 2> &header) {
   m["eCompass"] = makeSetter(degrees, &_magHdg);
 
   // Support for Expedition
-  m["Utc"] = [&](const std::string& s) {
+  m["Utc"] = [&](CsvField s) {
     double x = 0;
-    if (tryParseDouble(s, &x)) {
+    if (tryParseCsvDouble(s, &x)) {
       // Microsoft DATE format
       // https://msdn.microsoft.com/en-us/library/82ab7w69.aspx
       _time = TimeStamp::fromMilliSecondsSince1970(
@@ -148,14 +147,13 @@ CsvRowProcessor::CsvRowProcessor(const MDArray<std::string, 2> &header) {
   m["bearing"] = makeSetter(degrees, &_gpsBearing);
   m["speed"] = makeSetter(metersPerSecond, &_gpsSpeed);
 
-  assert(header.rows() == 1);
-  int cols = header.cols();
+  int cols = header.size();
   _validHeader = false;
 
   std::vector<std::string> ignoredHeaders;
 
   for (int i = 0; i < cols; i++) {
-    auto h = trimCsvString(header(0, i));
+    auto h = trimCsvField(header[i]).str();
     auto found = m.find(h);
     bool wasFound = found != m.end();
     _setters.push_back(wasFound? found->second : doNothing);
@@ -165,7 +163,7 @@ CsvRowProcessor::CsvRowProcessor(const MDArray<std::string, 2> &header) {
       ignoredHeaders.push_back(h);
     }
   }
-  if (_validHeader) {
+  if (_validHeader && verbose) {
     // It seems to be a valid CSV, but we ignored some columns.
     // It is worth notifying the user.
       LOG(INFO) << "CSV header ignored: "
@@ -176,10 +174,14 @@ CsvRowProcessor::CsvRowProcessor(const MDArray<std::string, 2> &header) {
   }
 }
 
-void CsvRowProcessor::process(const MDArray<std::string, 2> &row, SourceGroup *dst) {
-  assert(_setters.size() == row.cols());
-  for (int i = 0; i < _setters.size(); i++) {
-    _setters[i](trimCsvString(row(0, i)));
+void CsvRowProcessor::process(const std::vector<CsvField> &row, SourceGroup *dst) {
+  // Missing cells at the end of a row are empty.
+  int n = std::min(_setters.size(), row.size());
+  for (int i = 0; i < n; i++) {
+    _setters[i](trimCsvField(row[i]));
+  }
+  for (int i = n; i < _setters.size(); i++) {
+    _setters[i](CsvField());
   }
   _pushBack(_awa, dst->AWA);
   _pushBack(_aws, dst->AWS);
@@ -199,28 +201,45 @@ void CsvRowProcessor::process(const MDArray<std::string, 2> &row, SourceGroup *d
   _pushBack(pos, dst->GPS_POS);
 }
 
-bool loadCsv(const MDArray<std::string, 2> &table,
-             const std::string& source, LogAccumulator *dst) {
-  if (table.rows() == 0 || table.cols() == 0) {
+namespace {
+
+bool loadCsv(CsvReader *reader, const std::string& source,
+             LogAccumulator *dst) {
+  if (!reader->next()) {
     return false;
   }
-  SourceGroup toPopulate(source, dst);
-  CsvRowProcessor processor(table.sliceRow(0));
-
+  CsvRowProcessor processor(reader->fields());
   if (!processor.hasValidHeader()) {
     return false;
   }
 
-  int n = table.rows();
-  for (int i = 1; i < n; i++) {
-    processor.process(table.sliceRow(i), &toPopulate);
+  SourceGroup toPopulate(source, dst);
+  while (reader->next()) {
+    processor.process(reader->fields(), &toPopulate);
   }
   return true;
 }
 
+}  // namespace
+
+bool isCsvLogHeader(const std::string &line) {
+  std::vector<CsvField> header;
+  splitCsvLine(line.data(), line.data() + line.size(), ',', &header);
+  if (header.empty()) {
+    return false;
+  }
+  return CsvRowProcessor(header, false).hasValidHeader();
+}
+
 bool loadCsv(const std::string &filename, LogAccumulator *dst) {
+  std::ifstream file(filename, std::ios::in | std::ios::binary);
+  return loadCsv(&file, dst);
+}
+
+bool loadCsv(std::istream *stream, LogAccumulator *dst) {
   std::string sourceName("CSV imported");
-  return loadCsv(parseCsv(filename), sourceName, dst);
+  CsvReader reader(stream);
+  return loadCsv(&reader, sourceName, dst);
 }
 
 bool loadCsvFromPipe(const std::string& cmd, const std::string& sourceName,
@@ -230,7 +249,8 @@ bool loadCsvFromPipe(const std::string& cmd, const std::string& sourceName,
     LOG(ERROR) << "Failed to run command: " << cmd;
     return false;
   }
-  return loadCsv(parseCsv(&pipe), sourceName, dst);
+  CsvReader reader(&pipe);
+  return loadCsv(&reader, sourceName, dst);
 }
 
 } /* namespace sail */
@@ -6,13 +6,19 @@
 #ifndef SERVER_NAUTICAL_LOGIMPORT_CSVLOADER_H_
 #define SERVER_NAUTICAL_LOGIMPORT_CSVLOADER_H_
 
+#include <iosfwd>
 #include <string>
 
 namespace sail {
 
 class LogAccumulator;
 
+// True if the line is the header of a CSV file that we can load,
+// that is, if at least one column is recognized.
+bool isCsvLogHeader(const std::string &line);
+
 bool loadCsv(const std::string &filename, LogAccumulator *dst);
+bool loadCsv(std::istream *stream, LogAccumulator *dst);
 
 bool loadCsvFromPipe(const std::string& cmd, const std::string& sourceName,
                      LogAccumulator *dst);
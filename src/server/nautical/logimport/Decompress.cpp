@@ -0,0 +1,86 @@
+#include <server/nautical/logimport/Decompress.h>
+
+#include <boost/iostreams/device/file.hpp>
+#include <boost/iostreams/filter/bzip2.hpp>
+#include <boost/iostreams/filter/gzip.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+#include <fstream>
+#include <Poco/Path.h>
+#include <server/common/logging.h>
+#include <server/common/string.h>
+
+#ifdef WITH_LZMA_DECOMPRESSION
+#include <boost/iostreams/filter/lzma.hpp>
+#endif
+
+namespace sail {
+
+Compression compressionOfFile(const std::string& filename) {
+  std::string ext = toLower(Poco::Path(filename).getExtension());
+  if (ext == "gz") {
+    return Compression::Gzip;
+  } else if (ext == "bz2") {
+    return Compression::Bzip2;
+  } else if (ext == "xz") {
+    return Compression::Xz;
+  }
+  return Compression::None;
+}
+
+bool canDecompressInProcess(Compression c) {
+  switch (c) {
+    case Compression::Gzip:
+    case Compression::Bzip2:
+      return true;
+    case Compression::Xz:
+#ifdef WITH_LZMA_DECOMPRESSION
+      return true;
+#else
+      return false;
+#endif
+    default:
+      return false;
+  };
+}
+
+std::string stripCompressionExtension(const std::string& filename) {
+  if (compressionOfFile(filename) == Compression::None) {
+    return filename;
+  }
+  return filename.substr(0, filename.find_last_of('.'));
+}
+
+std::shared_ptr<std::istream> openDecompressingStream(
+    const std::string& filename, Compression c, int bufferSize) {
+  namespace io = boost::iostreams;
+  if (!canDecompressInProcess(c)) {
+    return std::shared_ptr<std::istream>();
+  }
+  io::file_source file(filename, std::ios_base::in | std::ios_base::binary);
+  if (!file.is_open()) {
+    LOG(ERROR) << filename << ": can't read file";
+    return std::shared_ptr<std::istream>();
+  }
+
+  auto stream = std::make_shared<io::filtering_istream>();
+  switch (c) {
+    case Compression::Gzip:
+      stream->push(io::gzip_decompressor(
+              io::gzip::default_window_bits, bufferSize), bufferSize);
+      break;
+    case Compression::Bzip2:
+      stream->push(io::bzip2_decompressor(false, bufferSize), bufferSize);
+      break;
+#ifdef WITH_LZMA_DECOMPRESSION
+    case Compression::Xz:
+      stream->push(io::lzma_decompressor(bufferSize), bufferSize);
+      break;
+#endif
+    default:
+      return std::shared_ptr<std::istream>();
+  };
+  stream->push(file, bufferSize);
+  return stream;
+}
+
+}
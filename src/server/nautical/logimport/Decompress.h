@@ -0,0 +1,42 @@
+/*
+ * Reading compressed log files (.gz, .bz2 and .xz) as streams, so that
+ * the loaders can parse them without first writing the uncompressed
+ * data to a temporary file.
+ */
+
+#ifndef SERVER_NAUTICAL_LOGIMPORT_DECOMPRESS_H_
+#define SERVER_NAUTICAL_LOGIMPORT_DECOMPRESS_H_
+
+#include <istream>
+#include <memory>
+#include <string>
+
+namespace sail {
+
+enum class Compression {
+  None,
+  Gzip,
+  Bzip2,
+  Xz
+};
+
+// Only the extension is inspected.
+Compression compressionOfFile(const std::string& filename);
+
+// True if we can decompress this format in-process. Otherwise, the
+// file has to be uncompressed with an external program.
+bool canDecompressInProcess(Compression c);
+
+// "boat/log.txt.gz" -> "boat/log.txt"
+std::string stripCompressionExtension(const std::string& filename);
+
+// Opens a compressed file for reading. The data is decompressed
+// on the fly, through buffers of 'bufferSize' bytes. Returns
+// nullptr if the file cannot be opened or the format is not supported.
+std::shared_ptr<std::istream> openDecompressingStream(
+    const std::string& filename, Compression c,
+    int bufferSize = 1024*1024);
+
+}
+
+#endif /* SERVER_NAUTICAL_LOGIMPORT_DECOMPRESS_H_ */
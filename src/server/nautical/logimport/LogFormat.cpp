@@ -0,0 +1,150 @@
+#include <server/nautical/logimport/LogFormat.h>
+
+#include <boost/iostreams/device/array.hpp>
+#include <boost/iostreams/filter/gzip.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+#include <istream>
+#include <server/common/string.h>
+#include <server/nautical/logimport/CsvLoader.h>
+#include <server/nautical/logimport/astra/AstraLoader.h>
+#include <sstream>
+#include <vector>
+
+namespace sail {
+
+const char* logFormatName(LogFormat format) {
+  switch (format) {
+    case LogFormat::Iwatch: return "iwatch";
+    case LogFormat::Protobuf: return "protobuf";
+    case LogFormat::Nmea0183: return "NMEA 0183";
+    case LogFormat::Csv: return "CSV";
+    case LogFormat::Astra: return "Astra";
+    default: return "unknown";
+  };
+}
+
+constexpr double LogFormatGuess::minimumConfidence;
+
+namespace {
+
+  LogFormatGuess guess(LogFormat format, double confidence) {
+    LogFormatGuess g;
+    g.format = format;
+    g.confidence = confidence;
+    return g;
+  }
+
+  // The complete lines of the head. The last line is
+  // dropped if it was cut.
+  std::vector<std::string> completeLines(const std::string& head) {
+    std::vector<std::string> lines;
+    std::istringstream stream(head);
+    std::string line;
+    while (std::getline(stream, line)) {
+      if (stream.eof() && head.size() == logFormatSniffBytes) {
+        break;
+      }
+      if (!line.empty() && line.back() == '\r') {
+        line.pop_back();
+      }
+      if (!line.empty()) {
+        lines.push_back(line);
+      }
+    }
+    return lines;
+  }
+
+  // Anemobox logs are gzipped LogFile messages. The first
+  // byte of the message should be the key of one of its fields.
+  LogFormatGuess detectProtobuf(const std::string& head) {
+    if (head.size() < 2 || uint8_t(head[0]) != 0x1f
+        || uint8_t(head[1]) != 0x8b) {
+      return LogFormatGuess();
+    }
+    namespace io = boost::iostreams;
+    io::filtering_istream stream;
+    stream.push(io::gzip_decompressor());
+    stream.push(io::array_source(head.data(), head.size()));
+    int key = stream.get();
+    if (!stream.good()) {
+      // Something else that was gzipped.
+      return guess(LogFormat::Protobuf, 0.3);
+    }
+    int field = key >> 3;
+    int wireType = key & 7;
+    bool isLogFileKey = (field == 6 && wireType == 0)
+      || (1 <= field && field <= 7 && field != 6 && wireType == 2);
+    return guess(LogFormat::Protobuf, isLogFileKey? 1.0 : 0.3);
+  }
+
+  // A sentence is a '$' or '!' followed by the talker
+  // and sentence identifiers, and a comma.
+  bool hasNmeaSentence(const std::string& line) {
+    for (size_t i = 0; i < line.size(); i++) {
+      if (line[i] != '$' && line[i] != '!') {
+        continue;
+      }
+      size_t j = i + 1;
+      while (j < line.size() && j - i <= 6 && isalnum(line[j])) {
+        j++;
+      }
+      if (j - i >= 4 && j < line.size() && line[j] == ',') {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  LogFormatGuess detectNmea0183(const std::vector<std::string>& lines) {
+    if (lines.empty()) {
+      return LogFormatGuess();
+    }
+    int count = 0;
+    for (const auto& line: lines) {
+      count += hasNmeaSentence(line)? 1 : 0;
+    }
+    return guess(LogFormat::Nmea0183, double(count)/lines.size());
+  }
+}
+
+LogFormatGuess detectLogFormat(const std::string& head) {
+  if (head.empty()) {
+    return LogFormatGuess();
+  }
+
+  LogFormatGuess best = detectProtobuf(head);
+  auto consider = [&](const LogFormatGuess& g) {
+    if (best.confidence < g.confidence) {
+      best = g;
+    }
+  };
+
+  if (2 <= head.size() && head[0] == '{' && head[1] == '"') {
+    consider(guess(LogFormat::Iwatch, 0.9));
+  }
+
+  auto lines = completeLines(head);
+  if (!lines.empty()) {
+    if (tryParseAstraHeader(lines.front()).defined()) {
+      consider(guess(LogFormat::Astra, 0.9));
+    }
+    if (isCsvLogHeader(lines.front())) {
+      consider(guess(LogFormat::Csv, 0.9));
+    }
+  }
+  consider(detectNmea0183(lines));
+
+  if (best.confidence < LogFormatGuess::minimumConfidence) {
+    best.format = LogFormat::Unknown;
+  }
+  return best;
+}
+
+LogFormatGuess detectLogFormat(std::istream* stream) {
+  std::string head(logFormatSniffBytes, '\0');
+  stream->read(&head[0], logFormatSniffBytes);
+  head.resize(stream->gcount());
+  return detectLogFormat(head);
+}
+
+}
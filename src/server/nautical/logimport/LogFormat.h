@@ -0,0 +1,46 @@
+/*
+ * Guessing the format of a log file from its first few kilobytes, so that
+ * LogLoader can hand it directly to the right loader instead of trying
+ * every loader in turn.
+ */
+
+#ifndef SERVER_NAUTICAL_LOGIMPORT_LOGFORMAT_H_
+#define SERVER_NAUTICAL_LOGIMPORT_LOGFORMAT_H_
+
+#include <iosfwd>
+#include <string>
+
+namespace sail {
+
+enum class LogFormat {
+  Unknown,
+  Iwatch,
+  Protobuf,
+  Nmea0183,
+  Csv,
+  Astra
+};
+
+const char* logFormatName(LogFormat format);
+
+struct LogFormatGuess {
+  LogFormat format = LogFormat::Unknown;
+
+  // Between 0 and 1. Guesses below minimumConfidence are
+  // reported as LogFormat::Unknown.
+  double confidence = 0.0;
+
+  static constexpr double minimumConfidence = 0.5;
+};
+
+// How much of a file we look at.
+static const int logFormatSniffBytes = 4096;
+
+LogFormatGuess detectLogFormat(const std::string& head);
+
+// Reads at most logFormatSniffBytes from the stream.
+LogFormatGuess detectLogFormat(std::istream* stream);
+
+}
+
+#endif /* SERVER_NAUTICAL_LOGIMPORT_LOGFORMAT_H_ */
@@ -0,0 +1,65 @@
+#include <server/nautical/logimport/LogFormat.h>
+
+#include <fstream>
+#include <gtest/gtest.h>
+#include <server/common/Env.h>
+#include <server/nautical/logimport/LogLoader.h>
+
+using namespace sail;
+
+namespace {
+  LogFormat formatOfDataset(const std::string &name) {
+    std::ifstream file(std::string(Env::SOURCE_DIR) + "/datasets/" + name,
+                       std::ios::in | std::ios::binary);
+    EXPECT_TRUE(file.good());
+    return detectLogFormat(&file).format;
+  }
+}
+
+TEST(LogFormatTest, Strings) {
+  EXPECT_EQ(LogFormat::Unknown, detectLogFormat(std::string()).format);
+  EXPECT_EQ(LogFormat::Unknown,
+            detectLogFormat("Hello world\nThis is not a log\n").format);
+  EXPECT_EQ(LogFormat::Iwatch,
+            detectLogFormat("{\"time\": 1}").format);
+  EXPECT_EQ(LogFormat::Nmea0183, detectLogFormat(
+      "$IIRMC,112233,A,4629.737,N,00639.791,E,03.6,188,200808,,,A*48\r\n"
+      "$IIMWV,023.0,R,10.5,N,A*00\r\n"
+      "garbage\r\n").format);
+  EXPECT_EQ(LogFormat::Unknown, detectLogFormat(
+      "garbage\ngarbage\n$IIMWV,023.0,R,10.5,N,A*00\n").format);
+  EXPECT_EQ(LogFormat::Csv,
+            detectLogFormat("DATE/TIME(UTC),AWA,AWS\n"
+                            "09/21/2015 01:13:21.80 pm,12,13\n").format);
+  EXPECT_EQ(LogFormat::Astra, detectLogFormat(
+      "-------- log1Hz20170708_1239.log ------\nDate\tTime\n").format);
+}
+
+TEST(LogFormatTest, Datasets) {
+  EXPECT_EQ(LogFormat::Protobuf,
+            formatOfDataset("protobuflog/0000000055EAE82E.log"));
+  EXPECT_EQ(LogFormat::Nmea0183, formatOfDataset("tinylog.txt"));
+  EXPECT_EQ(LogFormat::Iwatch, formatOfDataset("iwatch_wind.json"));
+  EXPECT_EQ(LogFormat::Csv, formatOfDataset("csvlog/rowdy_part.csv"));
+  EXPECT_EQ(LogFormat::Astra,
+            formatOfDataset("astradata/Regata/log1Hz20170708_1239.log"));
+}
+
+// Detection should only change which loader is tried first,
+// not what is loaded.
+TEST(LogFormatTest, SameDataWithAndWithoutDetection) {
+  for (auto name: {"tinylog.txt", "csvlog/rowdy_part.csv",
+                   "protobuflog/0000000055EAE82E.log"}) {
+    std::string filename = std::string(Env::SOURCE_DIR) + "/datasets/" + name;
+    LogLoader detecting, trying;
+    trying.setDetectFormat(false);
+    EXPECT_TRUE(detecting.loadFile(filename));
+    EXPECT_TRUE(trying.loadFile(filename));
+    EXPECT_EQ(trying.accumulator()._AWAsources.size(),
+              detecting.accumulator()._AWAsources.size());
+    for (const auto &kv: trying.accumulator()._AWAsources) {
+      EXPECT_EQ(kv.second.size(),
+                detecting.accumulator()._AWAsources.at(kv.first).size());
+    }
+  }
+}
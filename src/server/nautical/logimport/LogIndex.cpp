@@ -0,0 +1,283 @@
+#include <server/nautical/logimport/LogIndex.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <Poco/File.h>
+#include <Poco/Path.h>
+#include <server/common/filesystem.h>
+#include <server/common/logging.h>
+#include <server/nautical/logimport/LogLoader.h>
+#include <sstream>
+
+namespace sail {
+
+const char *LogIndex::filename = ".logindex";
+
+namespace {
+  const char header[] = "anemomind-logindex 1";
+
+  bool codeForShortName(const std::string &name, DataCode *dst) {
+#define FIND_CODE(HANDLE, CODE, SHORTNAME, TYPE, DESCRIPTION) \
+    if (name == SHORTNAME) { \
+      *dst = HANDLE; \
+      return true; \
+    }
+    FOREACH_CHANNEL(FIND_CODE)
+#undef FIND_CODE
+    return false;
+  }
+
+  void writeTime(TimeStamp t, std::ostream *dst) {
+    if (t.defined()) {
+      *dst << t.toMilliSecondsSince1970();
+    } else {
+      *dst << "-";
+    }
+  }
+
+  bool readTime(std::istream *src, TimeStamp *dst) {
+    std::string s;
+    *src >> s;
+    if (s == "-") {
+      *dst = TimeStamp();
+      return true;
+    }
+    std::stringstream ss(s);
+    int64_t ms = 0;
+    if (!(ss >> ms)) {
+      return false;
+    }
+    *dst = TimeStamp::fromMilliSecondsSince1970(ms);
+    return true;
+  }
+
+  // The rest of the line, after the separating space.
+  std::string readRest(std::istream *src) {
+    std::string s;
+    std::getline(*src, s);
+    return s.empty()? s : s.substr(1);
+  }
+
+  template <typename T>
+  void addCounts(DataCode code,
+      const std::map<std::string, typename TimedSampleCollection<T>::TimedVector> &src,
+      LogIndexEntry *dst) {
+    for (const auto &kv : src) {
+      if (kv.second.empty()) {
+        continue;
+      }
+      dst->sampleCounts[std::make_pair(code, kv.first)] += kv.second.size();
+      for (const auto &x : kv.second) {
+        if (!dst->lowerBound.defined() || x.time < dst->lowerBound) {
+          dst->lowerBound = x.time;
+        }
+        if (!dst->upperBound.defined() || dst->upperBound < x.time) {
+          dst->upperBound = x.time;
+        }
+      }
+    }
+  }
+
+  void indexFile(const std::string &filename, LogIndexEntry *dst) {
+    LogLoader loader;
+    dst->loaded = loader.loadFile(filename);
+    dst->lowerBound = TimeStamp();
+    dst->upperBound = TimeStamp();
+    dst->sampleCounts.clear();
+    const LogAccumulator &acc = loader.accumulator();
+#define ADD_COUNTS(HANDLE, CODE, SHORTNAME, TYPE, DESCRIPTION) \
+    addCounts<TYPE>(HANDLE, acc._##HANDLE##sources, dst);
+    FOREACH_CHANNEL(ADD_COUNTS)
+#undef ADD_COUNTS
+  }
+
+  std::string directoryPrefix(const std::string &dir) {
+    return Poco::Path(dir).makeDirectory().toString();
+  }
+}
+
+bool LogIndexEntry::overlaps(const LogFilter &filter) const {
+  if (!lowerBound.defined() || !upperBound.defined()
+      || (filter.from.defined() && upperBound < filter.from)
+      || (filter.to.defined() && filter.to < lowerBound)) {
+    return false;
+  }
+  for (const auto &kv : sampleCounts) {
+    if (filter.accepts(kv.first.first)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+LogIndex LogIndex::update(const std::string &dir) {
+  LogIndex index;
+  std::string prefix = directoryPrefix(dir);
+  std::string indexFilename = prefix + filename;
+
+  std::map<std::string, LogIndexEntry> previous;
+  {
+    std::ifstream file(indexFilename);
+    if (file.good()) {
+      if (index.read(&file)) {
+        for (const auto &entry : index._entries) {
+          previous[entry.path] = entry;
+        }
+      } else {
+        LOG(WARNING) << "Rebuilding the corrupt log index " << indexFilename;
+      }
+    }
+  }
+  index._dir = dir;
+  index._entries.clear();
+
+  bool changed = false;
+  FileTraverseSettings settings;
+  settings.visitDirectories = false;
+  settings.visitFiles = true;
+  traverseDirectory(Poco::Path(dir), [&](const Poco::Path &path) {
+    std::string full = path.toString();
+    if (!LogLoader::acceptFile(full) || path.getFileName() == filename) {
+      return;
+    }
+    std::string relative = (full.compare(0, prefix.size(), prefix) == 0?
+        full.substr(prefix.size()) : full);
+
+    Poco::File file(path);
+    LogIndexEntry entry;
+    entry.path = relative;
+    entry.size = file.getSize();
+    entry.modified = file.getLastModified().epochMicroseconds();
+
+    auto found = previous.find(relative);
+    if (found != previous.end() && found->second.size == entry.size
+        && found->second.modified == entry.modified) {
+      index._entries.push_back(found->second);
+      return;
+    }
+    changed = true;
+    entry.checksum = checksum(full);
+    if (found != previous.end() && found->second.size == entry.size
+        && found->second.checksum == entry.checksum) {
+      // Only touched, or copied.
+      entry.loaded = found->second.loaded;
+      entry.lowerBound = found->second.lowerBound;
+      entry.upperBound = found->second.upperBound;
+      entry.sampleCounts = found->second.sampleCounts;
+    } else {
+      indexFile(full, &entry);
+      index._indexedCount++;
+    }
+    index._entries.push_back(entry);
+  }, settings);
+
+  changed = changed || index._entries.size() != previous.size();
+  std::sort(index._entries.begin(), index._entries.end(),
+      [](const LogIndexEntry &a, const LogIndexEntry &b) {
+    return a.path < b.path;
+  });
+
+  if (changed) {
+    // Written next to the index and renamed, so that an interrupted
+    // update doesn't leave a truncated index.
+    std::string tmp = indexFilename + ".tmp";
+    bool saved = false;
+    {
+      std::ofstream file(tmp);
+      index.write(&file);
+      saved = file.good();
+    }
+    if (!saved || std::rename(tmp.c_str(), indexFilename.c_str()) != 0) {
+      LOG(WARNING) << "Failed to save the log index " << indexFilename;
+      std::remove(tmp.c_str());
+    }
+  }
+  return index;
+}
+
+std::vector<std::string> LogIndex::select(const LogFilter &filter) const {
+  std::string prefix = directoryPrefix(_dir);
+  std::vector<std::string> dst;
+  for (const auto &entry : _entries) {
+    if (entry.overlaps(filter)) {
+      dst.push_back(prefix + entry.path);
+    }
+  }
+  return dst;
+}
+
+void LogIndex::write(std::ostream *dst) const {
+  *dst << header << "\n";
+  for (const auto &entry : _entries) {
+    *dst << "file " << entry.size << " " << entry.modified << " "
+      << std::hex << entry.checksum << std::dec << " "
+      << (entry.loaded? 1 : 0) << " ";
+    writeTime(entry.lowerBound, dst);
+    *dst << " ";
+    writeTime(entry.upperBound, dst);
+    *dst << " " << entry.sampleCounts.size() << " " << entry.path << "\n";
+    for (const auto &kv : entry.sampleCounts) {
+      *dst << "channel " << wordIdentifierForCode(kv.first.first) << " "
+        << kv.second << " " << kv.first.second << "\n";
+    }
+  }
+}
+
+bool LogIndex::read(std::istream *src) {
+  _entries.clear();
+  std::string line;
+  if (!std::getline(*src, line) || line != header) {
+    return false;
+  }
+  while (std::getline(*src, line)) {
+    std::stringstream ss(line);
+    std::string what;
+    LogIndexEntry entry;
+    int channelCount = 0;
+    int loaded = 0;
+    if (!(ss >> what >> entry.size >> entry.modified
+          >> std::hex >> entry.checksum >> std::dec >> loaded)
+        || what != "file"
+        || !readTime(&ss, &entry.lowerBound)
+        || !readTime(&ss, &entry.upperBound)
+        || !(ss >> channelCount)) {
+      return false;
+    }
+    entry.loaded = (loaded != 0);
+    entry.path = readRest(&ss);
+    for (int i = 0; i < channelCount; i++) {
+      std::string name;
+      int count = 0;
+      DataCode code;
+      if (!std::getline(*src, line)) {
+        return false;
+      }
+      std::stringstream cs(line);
+      if (!(cs >> what >> name >> count) || what != "channel"
+          || !codeForShortName(name, &code)) {
+        return false;
+      }
+      entry.sampleCounts[std::make_pair(code, readRest(&cs))] = count;
+    }
+    _entries.push_back(entry);
+  }
+  return true;
+}
+
+uint64_t LogIndex::checksum(const std::string &filename) {
+  std::ifstream file(filename, std::ios::binary);
+  uint64_t hash = 14695981039346656037ull;
+  std::vector<char> buffer(1 << 16);
+  while (file) {
+    file.read(buffer.data(), buffer.size());
+    int n = file.gcount();
+    for (int i = 0; i < n; i++) {
+      hash = (hash ^ (unsigned char)buffer[i])*1099511628211ull;
+    }
+  }
+  return hash;
+}
+
+}
@@ -0,0 +1,85 @@
+/*
+ * An index of the log files of a boat directory, saved in the directory,
+ * with the time span and the channels and sources of every file. It lets
+ * LogLoader open only the files that matter for a time window or a few
+ * channels, instead of loading everything and slicing afterwards.
+ */
+
+#ifndef SERVER_NAUTICAL_LOGIMPORT_LOGINDEX_H_
+#define SERVER_NAUTICAL_LOGIMPORT_LOGINDEX_H_
+
+#include <device/anemobox/Dispatcher.h>
+#include <iosfwd>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace sail {
+
+// Selects samples by time and channel. Undefined bounds are open,
+// and no channels means all channels.
+struct LogFilter {
+  TimeStamp from, to;
+  std::set<DataCode> channels;
+
+  bool accepts(DataCode code) const {
+    return channels.empty() || channels.find(code) != channels.end();
+  }
+
+  bool accepts(TimeStamp t) const {
+    return (!from.defined() || from <= t) && (!to.defined() || t <= to);
+  }
+};
+
+struct LogIndexEntry {
+  // Relative to the directory of the index.
+  std::string path;
+
+  // To tell if the file changed since it was indexed.
+  int64_t size = 0;
+  int64_t modified = 0; // Microseconds since 1970
+  uint64_t checksum = 0;
+
+  // Whether LogLoader could load the file.
+  bool loaded = false;
+
+  TimeStamp lowerBound, upperBound;
+  std::map<std::pair<DataCode, std::string>, int> sampleCounts;
+
+  // Whether the file may have samples selected by the filter.
+  bool overlaps(const LogFilter &filter) const;
+};
+
+class LogIndex {
+ public:
+  // The name of the index file in the directory.
+  static const char *filename;
+
+  // Reads the index of a directory, if there is one. Files that are new
+  // or that have changed since are loaded and indexed, and removed files
+  // are dropped. The index is saved if anything changed.
+  static LogIndex update(const std::string &dir);
+
+  const std::vector<LogIndexEntry> &entries() const { return _entries; }
+
+  // The number of files loaded by the last update.
+  int indexedCount() const { return _indexedCount; }
+
+  // The paths of the files that may have samples selected by the filter.
+  std::vector<std::string> select(const LogFilter &filter) const;
+
+  void write(std::ostream *dst) const;
+  bool read(std::istream *src);
+
+  // 64-bit FNV-1a hash of the contents of a file.
+  static uint64_t checksum(const std::string &filename);
+ private:
+  std::string _dir;
+  std::vector<LogIndexEntry> _entries;
+  int _indexedCount = 0;
+};
+
+}
+
+#endif /* SERVER_NAUTICAL_LOGIMPORT_LOGINDEX_H_ */
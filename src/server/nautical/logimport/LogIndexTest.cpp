@@ -0,0 +1,122 @@
+#include <server/nautical/logimport/LogIndex.h>
+
+#include <device/anemobox/FakeClockDispatcher.h>
+#include <device/anemobox/logger/Logger.h>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <Poco/File.h>
+#include <Poco/Path.h>
+#include <server/nautical/logimport/LogLoader.h>
+#include <sstream>
+
+using namespace sail;
+
+namespace {
+  TimeStamp hour(int h) {
+    return TimeStamp::UTC(2016, 6, 3, h, 0, 0);
+  }
+
+  // One sample per second during ten seconds, starting at 'start'
+  void saveLogFile(const std::string &filename, TimeStamp start) {
+    FakeClockDispatcher dispatcher;
+    Logger logger(&dispatcher);
+    dispatcher.setTime(start);
+    for (int i = 0; i < 10; i++) {
+      dispatcher.publishValue(AWA, "test", Angle<double>::degrees(i));
+      dispatcher.publishValue(AWS, "test", Velocity<double>::knots(i));
+      dispatcher.advance(Duration<>::seconds(1));
+    }
+    LogFile data;
+    logger.flushTo(&data);
+    EXPECT_TRUE(Logger::save(filename, data));
+  }
+
+  std::string makeDirectory() {
+    std::string dir = Poco::Path::temp() + "/LogIndexTest";
+    Poco::File(dir).createDirectories();
+    for (int i = 0; i < 3; i++) {
+      saveLogFile(dir + "/" + std::to_string(i) + ".log", hour(10 + i));
+    }
+    return dir;
+  }
+}
+
+TEST(LogIndexTest, IncrementalUpdate) {
+  std::string dir = makeDirectory();
+
+  LogIndex index = LogIndex::update(dir);
+  EXPECT_EQ(3, index.indexedCount());
+  ASSERT_EQ(3, index.entries().size());
+  const LogIndexEntry &entry = index.entries()[1];
+  EXPECT_EQ("1.log", entry.path);
+  EXPECT_TRUE(entry.loaded);
+  EXPECT_EQ(hour(11), entry.lowerBound);
+  EXPECT_EQ(hour(11) + Duration<double>::seconds(9), entry.upperBound);
+  EXPECT_EQ(10, (entry.sampleCounts.at(std::make_pair(AWA, std::string("test")))));
+
+  // Nothing changed
+  EXPECT_EQ(0, LogIndex::update(dir).indexedCount());
+
+  // Rewritten with the same contents
+  {
+    std::string filename = dir + "/2.log";
+    std::string contents;
+    {
+      std::ifstream file(filename, std::ios::binary);
+      contents.assign(std::istreambuf_iterator<char>(file),
+                      std::istreambuf_iterator<char>());
+    }
+    std::ofstream file(filename, std::ios::binary);
+    file << contents;
+  }
+  EXPECT_EQ(0, LogIndex::update(dir).indexedCount());
+
+  // A new file
+  saveLogFile(dir + "/3.log", hour(13));
+  index = LogIndex::update(dir);
+  EXPECT_EQ(1, index.indexedCount());
+  EXPECT_EQ(4, index.entries().size());
+
+  // A removed file
+  Poco::File(dir + "/0.log").remove();
+  index = LogIndex::update(dir);
+  EXPECT_EQ(0, index.indexedCount());
+  ASSERT_EQ(3, index.entries().size());
+  EXPECT_EQ("1.log", index.entries()[0].path);
+
+  std::stringstream ss;
+  index.write(&ss);
+  LogIndex loaded;
+  EXPECT_TRUE(loaded.read(&ss));
+  ASSERT_EQ(3, loaded.entries().size());
+  EXPECT_EQ(index.entries()[2].checksum, loaded.entries()[2].checksum);
+  EXPECT_EQ(index.entries()[2].upperBound, loaded.entries()[2].upperBound);
+  EXPECT_EQ(index.entries()[2].sampleCounts, loaded.entries()[2].sampleCounts);
+
+  std::stringstream corrupt("anemomind-logindex 1\nfile x\n");
+  EXPECT_FALSE(loaded.read(&corrupt));
+
+  Poco::File(dir).remove(true);
+}
+
+TEST(LogIndexTest, FilteredLoad) {
+  std::string dir = makeDirectory();
+
+  LogFilter filter;
+  filter.from = hour(11) + Duration<double>::seconds(5);
+  filter.to = hour(12) + Duration<double>::seconds(2);
+  EXPECT_EQ(2, LogIndex::update(dir).select(filter).size());
+
+  filter.channels.insert(AWA);
+  LogLoader loader;
+  EXPECT_TRUE(loader.load(dir, filter));
+  NavDataset ds = loader.makeNavDataset();
+  EXPECT_EQ(5 + 3, ds.samples<AWA>().size());
+  EXPECT_EQ(0, ds.samples<AWS>().size());
+
+  filter.channels.insert(GPS_POS);
+  filter.channels.erase(AWA);
+  EXPECT_EQ(0, LogIndex::update(dir).select(filter).size());
+
+  Poco::File(dir).remove(true);
+}
@@ -15,6 +15,8 @@
 #include <server/nautical/logimport/iwatch.h>
 #include <server/nautical/logimport/LogLoader.h>
 #include <server/nautical/logimport/CsvLoader.h>
+#include <server/nautical/logimport/Decompress.h>
+#include <server/nautical/logimport/LogFormat.h>
 #include <server/nautical/logimport/SailmonDbLoader.h>
 #include <server/nautical/logimport/SourceGroup.h>
 #include <device/anemobox/DispatcherUtils.h>
@@ -68,16 +70,117 @@ std::string uncompressFile(const std::string& filename) {
 }
 
 
-bool LogLoader::loadFile(const std::string &filename) {
-  bool r = false;
+// These formats are read by external programs or by sqlite,
+// that need a file on disk.
+bool needsUncompressedFile(const std::string& filename) {
+  return hasExtension(filename, "xls") || hasExtension(filename, "vdr")
+    || hasExtension(filename, "db");
+}
+
+typedef std::function<std::shared_ptr<std::istream>()> StreamOpener;
+
+// Tries the same loaders as LogLoader::loadFile, but reading from a
+// stream. The stream is reopened for every loader that is tried.
+//
+// If detectFormat is set, the loader of the format guessed from the
+// head of the stream is tried first, and the others only if it fails.
+// If the stream reads a plain file, 'path' is that file, so that NMEA
+// 0183 logs can be parsed in parallel. Otherwise it is empty.
+bool loadStream(const std::string& filename,
+                const std::string& path,
+                const StreamOpener& open,
+                bool detectFormat,
+                LogAccumulator* acc) {
+  if (hasExtension(filename, "vkx")) {
+    auto s = open();
+    return s && readVakaros(s.get(), acc);
+  }
+  std::pair<LogFormat, std::function<bool(std::istream*)>> loaders[] = {
+    {LogFormat::Iwatch,
+      [&](std::istream* s) { return parseIwatch(s, acc); }},
+    {LogFormat::Protobuf,
+      [&](std::istream* s) { return ProtobufLogLoader::load(s, acc); }},
+    {LogFormat::Nmea0183, [&](std::istream* s) {
+      return path.empty()
+        ? Nmea0183Loader::loadNmea0183Stream(
+            s, acc, Nmea0183Loader::getDefaultSourceName())
+        : Nmea0183Loader::loadNmea0183File(path, acc);
+    }},
+    {LogFormat::Csv,
+      [&](std::istream* s) { return loadCsv(s, acc); }},
+    {LogFormat::Astra,
+      [&](std::istream* s) { return accumulateAstraLogs(s, acc); }}
+  };
+
+  LogFormat detected = LogFormat::Unknown;
+  if (detectFormat) {
+    auto s = open();
+    if (!s) {
+      return false;
+    }
+    LogFormatGuess guess = detectLogFormat(s.get());
+    detected = guess.format;
+    LOG(INFO) << filename << ": detected format "
+      << logFormatName(guess.format) << " (confidence "
+      << guess.confidence << ")";
+    for (const auto& loader: loaders) {
+      if (loader.first == detected) {
+        s = open();
+        if (s && loader.second(s.get())) {
+          return true;
+        }
+        LOG(WARNING) << filename << ": failed to load as "
+          << logFormatName(detected) << ", trying the other loaders.";
+      }
+    }
+  }
+
+  for (const auto& loader: loaders) {
+    if (loader.first == detected) {
+      continue;
+    }
+    auto s = open();
+    if (!s) {
+      return false;
+    }
+    if (loader.second(s.get())) {
+      return true;
+    }
+  }
+  return false;
+}
 
-  std::string newFilename = uncompressFile(filename);
-  if (!newFilename.empty()) {
-    r = loadFile(newFilename);
+bool LogLoader::loadCompressedFile(const std::string &filename) {
+  Compression compression = compressionOfFile(filename);
+  std::string innerName = stripCompressionExtension(filename);
+  if (!canDecompressInProcess(compression)
+      || needsUncompressedFile(innerName)) {
+    std::string newFilename = uncompressFile(filename);
+    if (newFilename.empty()) {
+      LOG(ERROR) << filename << ": failed to uncompress.";
+      return false;
+    }
+    bool r = loadFile(newFilename);
     Poco::File(newFilename).remove();
     return r;
   }
 
+  bool r = loadStream(innerName, "", [&]() {
+    return openDecompressingStream(filename, compression);
+  }, _detectFormat, &_acc);
+  if (!r) {
+    LOG(ERROR) << filename << ": file empty or format not recognized.";
+  }
+  return r;
+}
+
+bool LogLoader::loadFile(const std::string &filename) {
+  bool r = false;
+
+  if (compressionOfFile(filename) != Compression::None) {
+    return loadCompressedFile(filename);
+  }
+
   if (hasExtension(filename, "xls")) {
     r = loadCsvFromPipe(std::string("xls2csv -x '") + filename + "'",
                         "Imported from XLS file", &_acc);
@@ -89,12 +192,15 @@ bool LogLoader::loadFile(const std::string &filename) {
   } else if (hasExtension(filename, "vkx")) {
     r = readVakaros(filename, &_acc);
   } else {
-    r =
-      parseIwatch(filename, &_acc)
-      || ProtobufLogLoader::load(filename, &_acc)
-      || Nmea0183Loader::loadNmea0183File(filename, &_acc)
-      || loadCsv(filename, &_acc)
-      || accumulateAstraLogs(filename, &_acc);
+    auto open = [&]() -> std::shared_ptr<std::istream> {
+      auto s = std::make_shared<std::ifstream>(
+          filename, std::ios::in | std::ios::binary);
+      if (!s->good()) {
+        return nullptr;
+      }
+      return s;
+    };
+    r = loadStream(filename, filename, open, _detectFormat, &_acc);
   }
 
   if (!r) {
@@ -157,16 +263,60 @@ bool LogLoader::load(const Poco::Path &name) {
   return 0 == failCount;
 }
 
+namespace {
+  template <typename T>
+  void addSelected(DataCode code, const LogFilter &filter,
+      const std::map<std::string, typename TimedSampleCollection<T>::TimedVector> &src,
+      std::map<std::string, typename TimedSampleCollection<T>::TimedVector> *dst) {
+    if (!filter.accepts(code)) {
+      return;
+    }
+    for (const auto &kv : src) {
+      for (const auto &x : kv.second) {
+        if (filter.accepts(x.time)) {
+          (*dst)[kv.first].push_back(x);
+        }
+      }
+    }
+  }
+}
+
+bool LogLoader::load(const std::string &dir, const LogFilter &filter) {
+  LogIndex index = LogIndex::update(dir);
+  std::vector<std::string> files = index.select(filter);
+  LOG(INFO) << "Loading " << files.size() << " of the "
+    << index.entries().size() << " files in " << dir;
+
+  LogLoader selected;
+  selected.setDetectFormat(_detectFormat);
+  bool success = true;
+  for (const auto &file : files) {
+    if (!selected.loadFile(file)) {
+      success = false;
+    }
+  }
+
+  for (auto kv: selected._acc._sourcePriority) {
+    _acc._sourcePriority[kv.first] = kv.second;
+  }
+#define ADD_SELECTED(HANDLE, CODE, SHORTNAME, TYPE, DESCRIPTION) \
+  addSelected<TYPE>(HANDLE, filter, selected._acc._##HANDLE##sources, \
+                    &_acc._##HANDLE##sources);
+  FOREACH_CHANNEL(ADD_SELECTED)
+#undef ADD_SELECTED
+  return success;
+}
+
 NavDataset LogLoader::loadNavDataset(const std::string &name) {
   LogLoader loader;
   loader.load(name);
-  return loader.makeNavDataset();
+  return loader.takeNavDataset();
 }
 
 NavDataset LogLoader::loadNavDataset(const Poco::Path &name) {
   LogLoader loader;
   loader.load(name);
-  return loader.makeNavDataset();
+  return loader.takeNavDataset();
 }
 
 
@@ -174,11 +324,21 @@ template <typename T>
 void insertValues(DataCode code,
     const std::map<std::string, typename TimedSampleCollection<T>::TimedVector> &src,
     Dispatcher *dst) {
-  for (auto kv: src) {
+  for (const auto &kv: src) {
     dst->insertValues<T>(code, kv.first, kv.second);
   }
 }
 
+template <typename T>
+void moveValues(DataCode code,
+    std::map<std::string, typename TimedSampleCollection<T>::TimedVector> *src,
+    Dispatcher *dst) {
+  for (auto &kv: *src) {
+    dst->insertValues<T>(code, kv.first, std::move(kv.second));
+  }
+  src->clear();
+}
+
 void LogLoader::addToDispatcher(Dispatcher *dst) const {
 
   // Set the priorities first!
@@ -192,10 +352,27 @@ void LogLoader::addToDispatcher(Dispatcher *dst) const {
 #undef  INSERT_VALUES
 }
 
+void LogLoader::moveToDispatcher(Dispatcher *dst) {
+  for (auto kv: _acc._sourcePriority) {
+    dst->setSourcePriority(kv.first, kv.second);
+  }
+
+#define MOVE_VALUES(HANDLE, CODE, SHORTNAME, TYPE, DESCRIPTION) \
+    moveValues<TYPE>(HANDLE, &_acc._##HANDLE##sources, dst);
+    FOREACH_CHANNEL(MOVE_VALUES);
+#undef  MOVE_VALUES
+}
+
 NavDataset LogLoader::makeNavDataset() const {
   auto d = std::make_shared<Dispatcher>();
   addToDispatcher(d.get());
   return NavDataset(d);
 }
 
+NavDataset LogLoader::takeNavDataset() {
+  auto d = std::make_shared<Dispatcher>();
+  moveToDispatcher(d.get());
+  return NavDataset(d);
+}
+
 }
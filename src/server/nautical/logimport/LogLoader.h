@@ -8,6 +8,7 @@
 
 #include <server/nautical/NavDataset.h>
 #include <server/nautical/logimport/LogAccumulator.h>
+#include <server/nautical/logimport/LogIndex.h>
 
 namespace Poco {class Path;}
 
@@ -35,6 +36,11 @@ class LogLoader {
   bool load(const std::string &name);
   bool load(const Poco::Path &name);
 
+  // Load only the samples of a directory selected by the filter. The
+  // index of the directory (see LogIndex) is updated first, and only the
+  // files that it lists as having such samples are opened.
+  bool load(const std::string &dir, const LogFilter &filter);
+
   // Conveniency functions when there is just one thing
   // to load.
   static NavDataset loadNavDataset(const std::string &name);
@@ -43,6 +49,13 @@ class LogLoader {
   void addToDispatcher(Dispatcher *dst) const;
   NavDataset makeNavDataset() const;
 
+  // Same as above, but the samples are moved out of this loader
+  // instead of being copied, which leaves it without samples. The
+  // source priorities are copied, and kept. Use these when the loader
+  // is not needed afterwards, to avoid holding two copies of the data.
+  void moveToDispatcher(Dispatcher *dst);
+  NavDataset takeNavDataset();
+
   // These methods are needed by the various parsers in order
   // to populate this object with data.
 
@@ -52,8 +65,17 @@ class LogLoader {
   // Check if extension is accepted. Only the filename is inspected.
   static bool acceptFile(const std::string& filename);
 
+  const LogAccumulator &accumulator() const { return _acc; }
+
+  // Guess the format of a file from its first bytes and only try
+  // the matching loader, instead of trying every loader in turn
+  // until one succeeds. On by default.
+  void setDetectFormat(bool detect) { _detectFormat = detect; }
+
  private:
   LogAccumulator _acc;
+  bool _detectFormat = true;
+  bool loadCompressedFile(const std::string &filename);
   void loadValueSet(const ValueSet &set);
   void loadTextData(const ValueSet &stream);
 };
@@ -4,7 +4,14 @@
 #include <device/anemobox/logger/Logger.h>
 #include <gtest/gtest.h>
 #include <server/nautical/logimport/LogLoader.h>
+#include <server/nautical/logimport/Decompress.h>
 
+#include <boost/iostreams/copy.hpp>
+#include <boost/iostreams/device/file.hpp>
+#include <boost/iostreams/filter/bzip2.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+#include <cstdio>
+#include <Poco/Path.h>
 #include <server/common/Env.h>
 
 using namespace sail;
@@ -57,3 +64,35 @@ TEST(LogLoaderTest, DecompressTest) {
   EXPECT_TRUE(loader.loadFile(std::string(Env::SOURCE_DIR) + "/datasets/tinylog.txt.gz"));
 }
 
+
+TEST(LogLoaderTest, DecompressInProcess) {
+  std::string gz = std::string(Env::SOURCE_DIR) + "/datasets/tinylog.txt.gz";
+  EXPECT_EQ(Compression::Gzip, compressionOfFile(gz));
+  EXPECT_EQ(std::string(Env::SOURCE_DIR) + "/datasets/tinylog.txt",
+            stripCompressionExtension(gz));
+
+  LogLoader reference;
+  EXPECT_TRUE(reference.loadFile(gz));
+  auto expected = reference.makeNavDataset();
+  EXPECT_LT(0, expected.samples<AWA>().size());
+
+  // Recompress the same log with bzip2.
+  std::string bz2 = Poco::Path::temp() + "/LogLoaderTest_tinylog.txt.bz2";
+  {
+    namespace io = boost::iostreams;
+    auto src = openDecompressingStream(gz, Compression::Gzip);
+    ASSERT_TRUE(bool(src));
+    io::filtering_ostream dst;
+    dst.push(io::bzip2_compressor());
+    dst.push(io::file_sink(bz2, std::ios_base::out | std::ios_base::binary));
+    io::copy(*src, dst);
+  }
+
+  LogLoader loader;
+  EXPECT_TRUE(loader.loadFile(bz2));
+  auto navs = loader.makeNavDataset();
+  EXPECT_EQ(expected.samples<AWA>().size(), navs.samples<AWA>().size());
+  EXPECT_EQ(expected.samples<GPS_POS>().size(),
+            navs.samples<GPS_POS>().size());
+  std::remove(bz2.c_str());
+}
@@ -10,7 +10,13 @@
 #include <device/Arduino/libraries/NmeaParser/NmeaParser.h>
 #include <device/anemobox/Nmea0183Adaptor.h>
 #include <server/nautical/logimport/SourceGroup.h>
+#include <atomic>
+#include <condition_variable>
 #include <fstream>
+#include <mutex>
+#include <server/common/StageProfiler.h>
+#include <server/common/logging.h>
+#include <thread>
 
 namespace sail {
 namespace Nmea0183Loader {
@@ -26,7 +32,7 @@ TimeStamp updateLastTime(const TimeStamp &current, const TimeStamp &candidate) {
 
 void Nmea0183TimeFuser::bufferOperation(TimedOperation op) {
   if (_lastTimeSinceMidnight.defined()) {
-    _delayedOps.push_back({_lastTimeSinceMidnight.get(), op});
+    _delayedOps.emplace_back(_lastTimeSinceMidnight.get(), std::move(op));
   } else if (_lastTime.defined()) {
     op(_lastTime);
   } else {
@@ -37,7 +43,7 @@ void Nmea0183TimeFuser::bufferOperation(TimedOperation op) {
 void Nmea0183TimeFuser::flush() {
   if (_lastTime.defined() && !_delayedOps.empty()) {
     CHECK(_lastTimeSinceMidnight.defined());
-    for (auto op: _delayedOps) {
+    for (const auto &op: _delayedOps) {
 
       // _lastTime - estimatedTimeOfOp(?) = _lastTimeSinceMidnight - op.first
       //    / where op.first is time since midnight of op /
@@ -107,8 +113,21 @@ void streamToNmeaParser(TimeStamp endTime,
 
 void streamToNmeaParser(std::istream *src, NmeaParser *dstParser,
     Nmea0183LogLoaderAdaptor *adaptor) {
+  // Reading blocks instead of calling get() for every byte matters for
+  // decompressing streams, where each get() goes through the filter chain.
+  // As get() would, the EOF is passed on once the stream has ended.
+  char block[1 << 16];
   while (src->good()) {
-    Nmea0183ProcessByte(adaptor->sourceName(), src->get(), dstParser, adaptor);
+    src->read(block, sizeof(block));
+    std::streamsize n = src->gcount();
+    for (std::streamsize i = 0; i < n; i++) {
+      Nmea0183ProcessByte(adaptor->sourceName(), block[i],
+                          dstParser, adaptor);
+    }
+    if (!src->good()) {
+      Nmea0183ProcessByte(adaptor->sourceName(),
+                          std::char_traits<char>::eof(), dstParser, adaptor);
+    }
   }
 }
 
@@ -123,9 +142,310 @@ bool loadNmea0183Stream(std::istream *stream, LogAccumulator *dst,
   return parser.numSentences() > 0;
 }
 
-bool loadNmea0183File(const std::string &filename, LogAccumulator *dst) {
-  std::ifstream file(filename);
-  return loadNmea0183Stream(&file, dst, defaultNmea0183SourceName);
+namespace {
+
+// What Nmea0183ProcessByte reports for a chunk of a file, in the
+// order it is reported, to be passed on to a Nmea0183LogLoaderAdaptor
+// once the chunks before have been passed on.
+struct Nmea0183Chunk {
+  enum EventKind : uint8_t {Add, TimeOfDay};
+  struct Event {
+    EventKind kind;
+    DataCode code;
+    uint32_t index;
+  };
+  struct Clock {
+    int hour, minute, second;
+  };
+
+  int64_t warmUpBegin = 0, begin = 0, end = 0;
+
+  std::vector<Event> events;
+  std::vector<TimeStamp> times;
+  std::vector<Angle<double>> angles;
+  std::vector<Velocity<double>> velocities;
+  std::vector<Length<double>> lengths;
+  std::vector<GeographicPosition<double>> positions;
+  std::vector<Clock> clocks;
+
+  // Written to by LogLoaderNmea0183Parser::onXDRRudder.
+  LogAccumulator rudder;
+
+  NmeaParser startState, endState;
+  DWord sentences = 0;
+};
+
+std::vector<TimeStamp> *valuesOf(Nmea0183Chunk *c, const TimeStamp &) {
+  return &(c->times);
+}
+
+std::vector<Angle<double>> *valuesOf(Nmea0183Chunk *c, const Angle<double> &) {
+  return &(c->angles);
+}
+
+std::vector<Velocity<double>> *valuesOf(
+    Nmea0183Chunk *c, const Velocity<double> &) {
+  return &(c->velocities);
+}
+
+std::vector<Length<double>> *valuesOf(
+    Nmea0183Chunk *c, const Length<double> &) {
+  return &(c->lengths);
+}
+
+std::vector<GeographicPosition<double>> *valuesOf(
+    Nmea0183Chunk *c, const GeographicPosition<double> &) {
+  return &(c->positions);
+}
+
+// Handler for Nmea0183ProcessByte that records the calls
+// a Nmea0183LogLoaderAdaptor would receive.
+class Nmea0183ChunkRecorder {
+ public:
+  Nmea0183ChunkRecorder(Nmea0183Chunk *dst) : _dst(dst) {}
+
+  template <DataCode Code>
+  void add(const std::string &, const typename TypeForCode<Code>::type &value) {
+    auto values = valuesOf(_dst, value);
+    _dst->events.push_back(Nmea0183Chunk::Event{
+      Nmea0183Chunk::Add, Code, uint32_t(values->size())});
+    values->push_back(value);
+  }
+
+  void setTimeOfDay(int hour, int minute, int second) {
+    _dst->events.push_back(Nmea0183Chunk::Event{
+      Nmea0183Chunk::TimeOfDay, DATE_TIME, uint32_t(_dst->clocks.size())});
+    _dst->clocks.push_back(Nmea0183Chunk::Clock{hour, minute, second});
+  }
+ private:
+  Nmea0183Chunk *_dst;
+};
+
+void replay(const Nmea0183Chunk &chunk, Nmea0183LogLoaderAdaptor *dst) {
+  const std::string &src = dst->sourceName();
+  for (const auto &e: chunk.events) {
+    if (e.kind == Nmea0183Chunk::TimeOfDay) {
+      const auto &c = chunk.clocks[e.index];
+      dst->setTimeOfDay(c.hour, c.minute, c.second);
+      continue;
+    }
+    switch (e.code) {
+#define REPLAY_ADD(CODE, VALUES) \
+      case CODE: dst->add<CODE>(src, chunk.VALUES[e.index]); break;
+      REPLAY_ADD(AWA, angles)
+      REPLAY_ADD(AWS, velocities)
+      REPLAY_ADD(TWA, angles)
+      REPLAY_ADD(TWS, velocities)
+      REPLAY_ADD(GPS_SPEED, velocities)
+      REPLAY_ADD(GPS_BEARING, angles)
+      REPLAY_ADD(MAG_HEADING, angles)
+      REPLAY_ADD(WAT_SPEED, velocities)
+      REPLAY_ADD(WAT_DIST, lengths)
+      REPLAY_ADD(GPS_POS, positions)
+      REPLAY_ADD(DATE_TIME, times)
+#undef REPLAY_ADD
+      default:
+        LOG(FATAL) << "Unexpected NMEA 0183 value: "
+          << wordIdentifierForCode(e.code);
+    }
+  }
+}
+
+void appendRudder(LogAccumulator *src, LogAccumulator *dst) {
+  auto dstSources = dst->getRUDDER_ANGLEsources();
+  for (auto &kv: *(src->getRUDDER_ANGLEsources())) {
+    auto &values = (*dstSources)[kv.first];
+    values.insert(values.end(), kv.second.begin(), kv.second.end());
+  }
+}
+
+// Apart from the time, every value reported by Nmea0183ProcessByte is
+// set by the sentence that reports it. A time can be left over from
+// earlier sentences, as with GLL sentences without a time or XDR
+// rudder angles. So a chunk parsed from a state with the right time
+// gives the same result as when parsing the whole file.
+bool sameTime(const NmeaParser &a, const NmeaParser &b) {
+  return a.year() == b.year() && a.month() == b.month()
+    && a.day() == b.day() && a.hour() == b.hour()
+    && a.min() == b.min() && a.sec() == b.sec();
+}
+
+int64_t fileSize(std::istream *file) {
+  file->clear();
+  file->seekg(0, std::ios::end);
+  return file->tellg();
+}
+
+std::string readRange(std::istream *file, int64_t begin, int64_t end) {
+  std::string bytes(end - begin, '\0');
+  file->clear();
+  file->seekg(begin);
+  file->read(&(bytes[0]), bytes.size());
+  bytes.resize(file->gcount());
+  return bytes;
+}
+
+// The first position at or after 'pos' that follows a line end. There,
+// the parser is searching for the start of a sentence whatever came
+// before, except after a '*' where it would read the '\n' as a checksum.
+int64_t nextSentenceBoundary(std::istream *file, int64_t pos, int64_t size) {
+  if (pos <= 0) {
+    return 0;
+  }
+  const int64_t blockSize = 4096;
+  char previous = 0;
+  for (int64_t at = std::max<int64_t>(0, pos - 2); at < size; at += blockSize) {
+    std::string block = readRange(file, at, std::min(size, at + blockSize));
+    for (size_t i = 0; i < block.size(); i++) {
+      int64_t next = at + i + 1;
+      if (block[i] == '\n' && previous != '*' && pos <= next) {
+        return next;
+      }
+      previous = block[i];
+    }
+  }
+  return size;
+}
+
+std::vector<Nmea0183Chunk> splitIntoChunks(
+    std::istream *file, const Nmea0183ParallelSettings &settings) {
+  int64_t size = fileSize(file);
+  std::vector<Nmea0183Chunk> chunks;
+  int64_t begin = 0;
+  while (begin < size) {
+    Nmea0183Chunk chunk;
+    chunk.begin = begin;
+    chunk.end = nextSentenceBoundary(
+        file, std::max(begin + 1, begin + settings.chunkBytes), size);
+    chunk.warmUpBegin = std::min(begin, nextSentenceBoundary(
+        file, begin - settings.warmUpBytes, size));
+    chunks.push_back(std::move(chunk));
+    begin = chunks.back().end;
+  }
+  return chunks;
+}
+
+// Parses the chunk starting from 'state', which should
+// be the parser state at the beginning of 'bytes'.
+void parseChunk(const std::string &bytes, const std::string &srcName,
+                NmeaParser state, bool lastChunk, Nmea0183Chunk *dst) {
+  size_t warmUpSize = dst->begin - dst->warmUpBegin;
+  for (size_t i = 0; i < warmUpSize; i++) {
+    state.processByte(bytes[i]);
+  }
+  dst->events.clear();
+  dst->times.clear();
+  dst->angles.clear();
+  dst->velocities.clear();
+  dst->lengths.clear();
+  dst->positions.clear();
+  dst->clocks.clear();
+  dst->rudder = LogAccumulator();
+  dst->startState = state;
+
+  LogLoaderNmea0183Parser parser(&(dst->rudder), srcName);
+  static_cast<NmeaParser &>(parser) = state;
+  Nmea0183ChunkRecorder recorder(dst);
+  for (size_t i = warmUpSize; i < bytes.size(); i++) {
+    Nmea0183ProcessByte(srcName, bytes[i], &parser, &recorder);
+  }
+  if (lastChunk) {
+    // Like streamToNmeaParser, that also passes on the EOF from
+    // the stream, before noticing that the stream has ended.
+    Nmea0183ProcessByte(srcName, std::char_traits<char>::eof(),
+                        &parser, &recorder);
+  }
+  dst->endState = parser;
+  dst->sentences = parser.numSentences() - state.numSentences();
+}
+
+}  // namespace
+
+bool loadNmea0183File(const std::string &filename, LogAccumulator *dst,
+                      const Nmea0183ParallelSettings &settings) {
+  const std::string &srcName = defaultNmea0183SourceName;
+  std::vector<Nmea0183Chunk> chunks;
+  {
+    std::ifstream file(filename, std::ios::in | std::ios::binary);
+    if (!file.good()) {
+      return false;
+    }
+    chunks = splitIntoChunks(&file, settings);
+    if (chunks.size() <= 1) {
+      file.clear();
+      file.seekg(0);
+      return loadNmea0183Stream(&file, dst, srcName);
+    }
+  }
+
+  NmeaParser initialState;
+  initialState.setIgnoreWrongChecksum(true);
+
+  // The chunks are parsed in parallel, each starting from the state
+  // after its warm-up bytes, while this thread passes on the parsed
+  // chunks in order.
+  int threadCount = settings.threadCount;
+  if (threadCount <= 0) {
+    threadCount = std::max(1u, std::thread::hardware_concurrency());
+  }
+  threadCount = std::min(threadCount, int(chunks.size()));
+  std::atomic<int> nextChunk(0);
+  std::mutex mutex;
+  std::condition_variable parsed;
+  std::vector<bool> done(chunks.size(), false);
+  auto work = [&]() {
+    std::ifstream file(filename, std::ios::in | std::ios::binary);
+    for (int i = nextChunk++; i < int(chunks.size()); i = nextChunk++) {
+      Nmea0183Chunk *chunk = &(chunks[i]);
+      ScopedStage stage("Parse NMEA 0183 chunk");
+      parseChunk(readRange(&file, chunk->warmUpBegin, chunk->end),
+                 srcName, initialState, i + 1 == int(chunks.size()), chunk);
+      stage.setSamplesIn(chunk->sentences);
+      stage.finish();
+      std::lock_guard<std::mutex> lock(mutex);
+      done[i] = true;
+      parsed.notify_one();
+    }
+  };
+  std::vector<std::thread> threads;
+  for (int i = 0; i < threadCount; i++) {
+    threads.push_back(std::thread(work));
+  }
+
+  int64_t sentences = 0;
+  int reparsed = 0;
+  {
+    std::ifstream file(filename, std::ios::in | std::ios::binary);
+    Nmea0183LogLoaderAdaptor adaptor(true, nullptr, dst, srcName);
+    NmeaParser state = initialState;
+    for (int i = 0; i < int(chunks.size()); i++) {
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        parsed.wait(lock, [&]() { return bool(done[i]); });
+      }
+      Nmea0183Chunk *chunk = &(chunks[i]);
+      if (!sameTime(chunk->startState, state)) {
+        // The warm-up was too short: Parse it again from the right state.
+        chunk->warmUpBegin = chunk->begin;
+        parseChunk(readRange(&file, chunk->begin, chunk->end), srcName,
+                   state, i + 1 == int(chunks.size()), chunk);
+        reparsed++;
+      }
+      replay(*chunk, &adaptor);
+      appendRudder(&(chunk->rudder), dst);
+      sentences += chunk->sentences;
+      state = chunk->endState;
+      *chunk = Nmea0183Chunk();
+    }
+  }
+  for (auto &t: threads) {
+    t.join();
+  }
+  if (reparsed > 0) {
+    LOG(INFO) << filename << ": parsed " << reparsed << " of "
+      << chunks.size() << " chunks again after a too short warm-up.";
+  }
+  return sentences > 0;
 }
 
 
@@ -8,6 +8,7 @@
 #ifndef SERVER_NAUTICAL_LOGIMPORT_NMEA0183LOADER_H_
 #define SERVER_NAUTICAL_LOGIMPORT_NMEA0183LOADER_H_
 
+#include <cstdint>
 #include <iosfwd>
 #include <server/nautical/logimport/LogAccumulator.h>
 #include <device/Arduino/libraries/NmeaParser/NmeaParser.h>
@@ -150,7 +151,21 @@ bool loadNmea0183Stream(
     LogAccumulator *dst,
     const std::string &srcName);
 
-bool loadNmea0183File(const std::string &filename, LogAccumulator *dst);
+// How loadNmea0183File splits a file into chunks that are parsed in
+// parallel. Every chunk starts at a sentence boundary, and is parsed
+// starting from the parser state obtained from the 'warmUpBytes'
+// preceding it.
+struct Nmea0183ParallelSettings {
+  int threadCount = 0; // One thread per core if 0.
+  int64_t chunkBytes = 16*1024*1024;
+  int64_t warmUpBytes = 64*1024;
+};
+
+// Loads a file with the same result as loadNmea0183Stream, but
+// parsing chunks of it in parallel. The timing of the parsed values
+// is then resolved in a sequential pass over the chunks, in order.
+bool loadNmea0183File(const std::string &filename, LogAccumulator *dst,
+    const Nmea0183ParallelSettings &settings = Nmea0183ParallelSettings());
 
 
 }
@@ -3,7 +3,11 @@
  *      Author: Jonas Östlund <uppfinnarjonas@gmail.com>
  */
 
+#include <fstream>
 #include <gtest/gtest.h>
+#include <Poco/File.h>
+#include <Poco/Path.h>
+#include <server/common/Env.h>
 #include <sstream>
 #include <server/nautical/logimport/LogLoader.h>
 #include <server/nautical/logimport/Nmea0183Loader.h>
@@ -116,3 +120,133 @@ TEST(Nmea0183Test, TestIncludeLastTwo) {
 }
 
 
+namespace {
+  void expectSameValue(const Angle<double> &a, const Angle<double> &b) {
+    EXPECT_EQ(a.degrees(), b.degrees());
+  }
+
+  void expectSameValue(const Velocity<double> &a, const Velocity<double> &b) {
+    EXPECT_EQ(a.knots(), b.knots());
+  }
+
+  void expectSameValue(const Length<double> &a, const Length<double> &b) {
+    EXPECT_EQ(a.meters(), b.meters());
+  }
+
+  void expectSameValue(const GeographicPosition<double> &a,
+                       const GeographicPosition<double> &b) {
+    EXPECT_EQ(a.lon().degrees(), b.lon().degrees());
+    EXPECT_EQ(a.lat().degrees(), b.lat().degrees());
+  }
+
+  void expectSameValue(const TimeStamp &a, const TimeStamp &b) {
+    EXPECT_EQ(a, b);
+  }
+
+  template <DataCode Code>
+  void expectSameChannel(LogAccumulator *expected, LogAccumulator *actual) {
+    SCOPED_TRACE(wordIdentifierForCode(Code));
+    auto a = getChannels<Code>(expected);
+    auto b = getChannels<Code>(actual);
+    ASSERT_EQ(a->size(), b->size());
+    for (auto i = a->begin(), j = b->begin(); i != a->end(); i++, j++) {
+      EXPECT_EQ(i->first, j->first);
+      ASSERT_EQ(i->second.size(), j->second.size());
+      for (int k = 0; k < i->second.size(); k++) {
+        EXPECT_EQ(i->second[k].time, j->second[k].time);
+        expectSameValue(i->second[k].value, j->second[k].value);
+      }
+    }
+  }
+
+  void expectSameNmea0183Channels(LogAccumulator *expected,
+                                  LogAccumulator *actual) {
+    expectSameChannel<AWA>(expected, actual);
+    expectSameChannel<AWS>(expected, actual);
+    expectSameChannel<TWA>(expected, actual);
+    expectSameChannel<TWS>(expected, actual);
+    expectSameChannel<GPS_SPEED>(expected, actual);
+    expectSameChannel<GPS_BEARING>(expected, actual);
+    expectSameChannel<MAG_HEADING>(expected, actual);
+    expectSameChannel<WAT_SPEED>(expected, actual);
+    expectSameChannel<WAT_DIST>(expected, actual);
+    expectSameChannel<GPS_POS>(expected, actual);
+    expectSameChannel<DATE_TIME>(expected, actual);
+    expectSameChannel<RUDDER_ANGLE>(expected, actual);
+  }
+
+  // Loads 'data' with loadNmea0183Stream, and as a file cut into
+  // chunks of various sizes, some of which need to be parsed again
+  // because their warm-up is too short. Returns what was loaded.
+  LogAccumulator expectSameAsSequential(
+      const std::string &name, const std::string &data) {
+    std::string filename = Poco::Path::temp() + "/Nmea0183Test_" + name;
+    {
+      std::ofstream file(filename, std::ios::out | std::ios::binary);
+      file << data;
+    }
+
+    LogAccumulator expected;
+    std::stringstream stream(data);
+    bool expectedResult = Nmea0183Loader::loadNmea0183Stream(
+        &stream, &expected, Nmea0183Loader::getDefaultSourceName());
+
+    for (int chunkBytes: {1, 30, 200, 1000}) {
+      for (int warmUpBytes: {0, 100, 1000}) {
+        SCOPED_TRACE(name + ", chunks of " + std::to_string(chunkBytes)
+            + " bytes, warm-up of " + std::to_string(warmUpBytes));
+        Nmea0183Loader::Nmea0183ParallelSettings settings;
+        settings.threadCount = 3;
+        settings.chunkBytes = chunkBytes;
+        settings.warmUpBytes = warmUpBytes;
+        LogAccumulator actual;
+        EXPECT_EQ(expectedResult,
+            Nmea0183Loader::loadNmea0183File(filename, &actual, settings));
+        expectSameNmea0183Channels(&expected, &actual);
+      }
+    }
+    Poco::File(filename).remove();
+    return expected;
+  }
+}
+
+TEST(Nmea0183Test, ParallelLoadingOfTestData) {
+  auto loaded = expectSameAsSequential("data001", data001);
+  EXPECT_FALSE((*loaded.getGPS_POSsources())["NMEA0183"].empty());
+  loaded = expectSameAsSequential("data002", data002);
+  EXPECT_FALSE((*loaded.getAWAsources())["NMEA0183"].empty());
+
+  std::ifstream file(std::string(Env::SOURCE_DIR) + "/datasets/tinylog.txt");
+  std::stringstream tinylog;
+  tinylog << file.rdbuf();
+  loaded = expectSameAsSequential("tinylog", tinylog.str());
+  EXPECT_FALSE((*loaded.getDATE_TIMEsources())["NMEA0183"].empty());
+}
+
+TEST(Nmea0183Test, ParallelLoadingStitchesTime) {
+  // Values before any time, GLL sentences without a time and rudder
+  // angles, that depend on the time of earlier sentences, a checksum
+  // without a line end and a last sentence without a checksum.
+  const char data[] =
+    "$IIMWV,248,T,05.8,N,A*16\n"
+    "$IIGLL,4612.939,N,00610.108,E,113704,A,A*5C\n"
+    "$IIVHW,,,147,M,03.4,N,,*61\n"
+    "$IIXDR,A,-12.5,D,RUDDER*00\n"
+    "$IIRMC,113704,A,4612.939,N,00610.108,E,03.5,157,100708,,,A*4E\n"
+    "$IIXDR,A,-11.5,D,RUDDER*00\n"
+    "$IIMWV,283,R,05.4,N,A*1B\n"
+    "$IIGLL,4612.938,N,00610.112,E,,A,A*00\n"
+    "$IIVLW,01330,N,000.0,N*4D\n"
+    "$IIXDR,A,-10.5,D,RUDDER*00\n"
+    "$IIMWV,283,R,05.4,N,A*\n"
+    "$IIVTG,157,T,,M,03.5,N,06.5,K*00"
+    "$IIZDA,113710.00,10,07,2008,,*00\n"
+    "$IIXDR,A,-9.5,D,RUDDER*00\n"
+    "$IIGLL,4612.937,N,00610.114,E,,A,A*00\n"
+    "$IIMWV,281,R,05.7,N,A*1A\n"
+    "$IIMWV,247,T,05.9,N,A";
+  auto loaded = expectSameAsSequential("stitching", data);
+
+  // The first rudder angle comes before any date.
+  EXPECT_EQ(3, (*loaded.getRUDDER_ANGLEsources())["NMEA0183"].size());
+}
@@ -240,5 +240,14 @@ bool load(const std::string &filename, LogAccumulator *dst) {
   return false;
 }
 
+bool load(std::istream *src, LogAccumulator *dst) {
+  LogFile file;
+  if (Logger::read(src, &file)) {
+    load(file, dst);
+    return true;
+  }
+  return false;
+}
+
 }
 } /* namespace sail */
@@ -17,6 +17,7 @@ namespace ProtobufLogLoader {
 
 void load(const LogFile &data, LogAccumulator *dst);
 bool load(const std::string &filename, LogAccumulator *dst);
+bool load(std::istream *file, LogAccumulator *dst);
 
 }
 } /* namespace sail */
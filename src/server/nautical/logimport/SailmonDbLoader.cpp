@@ -1,5 +1,10 @@
 #include <server/nautical/logimport/SailmonDbLoader.h>
+#include <algorithm>
+#include <atomic>
+#include <map>
 #include <server/common/logging.h>
+#include <sstream>
+#include <thread>
 #include <third_party/sqlite/sqlite3.h>
 #include <server/common/TimeStamp.h>
 #include <server/nautical/logimport/LogAccumulator.h>
@@ -114,118 +119,193 @@ std::vector<LocalAndAbsoluteTimePair> getSailmonTimeCorrectionTable(
 }
 
 
-std::string sensorIdToSourceString(char* c) {
+std::string sensorIdToSourceString(const char* c) {
   return std::string("sailmonSensorId(") + c + ")";
 }
 
+namespace {
 
-struct Acc {
-  std::vector<LocalAndAbsoluteTimePair> timePairs;
-  LogAccumulator* dst = nullptr;
+// The rows of one channel, with the times already corrected.
+struct SailmonRows {
+  bool ok = false;
+  std::vector<std::string> sources;
+  std::vector<int> sourceIndex;
+  std::vector<TimeStamp> times;
+  std::vector<double> values;
 
-  TimeStamp toAbsoluteTime(int64_t i) const {
-    return estimateTime(timePairs, i);
-  }
-
-  template <DataCode code>
-  void accumulate(
-      const std::string& source,
-      TimeStamp time,
-      typename TypeForCode<code>::type value) {
-    (*getChannels<code>(dst))[source].push_back({time, value});
-  }
+  // Only for GPS positions: values are latitudes.
+  std::vector<double> longitudes;
 };
 
-int gpsQueryCallback(
-    void *data, int argc, char **argv,
-    char **azColName) {
-  auto acc = reinterpret_cast<Acc*>(data);
-  CHECK(argc == 4);
-  auto sensorId = sensorIdToSourceString(argv[0]);
-  auto logTime = stringToX<int64_t>(argv[1]);
-  auto lat = stringToX<double>(argv[2]);
-  auto lon = stringToX<double>(argv[3]);
-
-  acc->dst->_GPS_POSsources[sensorId].push_back({
-    acc->toAbsoluteTime(logTime),
-    GeographicPosition<double>(
-        Angle<double>::degrees(lon),
-        Angle<double>::degrees(lat))
-  });
+const char gpsQuery[] = "select "
+    "a.sensorId, "
+    "a.log_time, "
+    "a.value as latitude, "
+    "b.value as longitude FROM "
+    "LogData as a, LogData as b WHERE "
+    "a.sensorId = b.sensorId AND a.log_time = b.log_time "
+    "AND a.rawId = 4 AND b.rawId = 5 order by a.log_time asc";
 
-  return 0;
-}
-
-bool accumulateGpsData(
-    const std::shared_ptr<sqlite3>& db,
-    Acc* dst) {
-  const char query[] = "select "
-      "a.sensorId, "
-      "a.log_time, "
-      "a.value as latitude, "
-      "b.value as longitude FROM "
-      "LogData as a, LogData as b WHERE "
-      "a.sensorId = b.sensorId AND a.log_time = b.log_time "
-      "AND a.rawId = 4 AND b.rawId = 5 order by a.log_time asc";
-  char* errMsg = nullptr;
-  auto rc = sqlite3_exec(db.get(), query, &gpsQueryCallback, dst, &errMsg);
-  if (rc != SQLITE_OK ) {
-    LOG(ERROR) << "Failed to select data\n";
-    LOG(ERROR) << "SQL error: %s\n", errMsg;
-    sqlite3_free(errMsg);
-    return false;
-  }
-  return true;
-}
+const char valueQuery[] =
+    "SELECT sensorId, value, log_time FROM LogData WHERE rawId = ?1";
 
-template<DataCode Code, class Converter>
-int accumulateCallback(
-    void *data, int argc, char **argv,
-    char **azColName) {
-  auto acc = reinterpret_cast<Acc*>(data);
-  CHECK(argc == 3);
-  std::string source = sensorIdToSourceString(argv[0]);
-  auto logTime = stringToX<int64_t>(argv[2]);
-  Converter converter;
-  auto value = converter(argv[1]);
+typedef std::shared_ptr<sqlite3_stmt> Statement;
 
-  acc-> template accumulate<Code>(source,
-                                  acc->toAbsoluteTime(logTime),
-                                  value);
-  return 0;
+Statement prepare(const std::shared_ptr<sqlite3>& db, const char* sql) {
+  sqlite3_stmt* stmt = nullptr;
+  if (sqlite3_prepare_v2(db.get(), sql, -1, &stmt, nullptr) != SQLITE_OK) {
+    LOG(ERROR) << "SQL error: " << sqlite3_errmsg(db.get())
+      << "\nIn query: " << sql;
+    return Statement();
+  }
+  return Statement(stmt, &sqlite3_finalize);
 }
 
-template<DataCode Code, class Converter>
-bool accumulateValues(const std::shared_ptr<sqlite3>& db,
-                      int rawId,
-                      Acc* dst) {
-  std::string sql =
-    "SELECT sensorId, value, log_time "
-    "FROM LogData WHERE rawId = ";
-  sql += objectToString(rawId) + ";";
-
-  int (*callback)(void*,int,char**,char**) = accumulateCallback<Code, Converter>;
-  return sqlQuery(db, sql, callback, dst);
+// Steps through the rows of a prepared statement, and resets it.
+// The columns are those of valueQuery, or of gpsQuery if 'gps' is set.
+bool readRows(sqlite3_stmt* stmt, bool gps, SailmonTimeMap timeMap,
+              SailmonRows* dst) {
+  std::map<std::string, int> sourceIndices;
+  std::string lastSensorId;
+  int lastIndex = -1;
+  int rc = SQLITE_OK;
+  while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+    const char* sensorId = reinterpret_cast<const char*>(
+        sqlite3_column_text(stmt, 0));
+    if (sensorId == nullptr) {
+      sensorId = "";
+    }
+    if (lastIndex < 0 || lastSensorId != sensorId) {
+      lastSensorId = sensorId;
+      auto found = sourceIndices.find(lastSensorId);
+      if (found == sourceIndices.end()) {
+        lastIndex = dst->sources.size();
+        sourceIndices[lastSensorId] = lastIndex;
+        dst->sources.push_back(sensorIdToSourceString(sensorId));
+      } else {
+        lastIndex = found->second;
+      }
+    }
+    dst->sourceIndex.push_back(lastIndex);
+    if (gps) {
+      dst->times.push_back(timeMap(int(sqlite3_column_int64(stmt, 1))));
+      dst->values.push_back(sqlite3_column_double(stmt, 2));
+      dst->longitudes.push_back(sqlite3_column_double(stmt, 3));
+    } else {
+      dst->values.push_back(sqlite3_column_double(stmt, 1));
+      dst->times.push_back(timeMap(int(sqlite3_column_int64(stmt, 2))));
+    }
+  }
+  sqlite3_reset(stmt);
+  dst->ok = (rc == SQLITE_DONE);
+  return dst->ok;
 }
 
 struct AngleConverter {
-  Angle<double> operator()(const char* str) {
-    return Angle<double>::degrees(stringToX<double>(str));
+  Angle<double> operator()(double x) const {
+    return Angle<double>::degrees(x);
   }
 };
 
 struct LengthConverter {
-  Length<double> operator()(const char* str) {
-    return Length<double>::meters(stringToX<double>(str));
+  Length<double> operator()(double x) const {
+    return Length<double>::meters(x);
   }
 };
 
 struct SpeedConverter {
-  Velocity<double> operator()(const char* str) {
-    return Velocity<double>::metersPerSecond(stringToX<double>(str));
+  Velocity<double> operator()(double x) const {
+    return Velocity<double>::metersPerSecond(x);
+  }
+};
+
+template<DataCode Code, class Converter>
+void accumulateRows(const SailmonRows& rows, LogAccumulator* dst) {
+  Converter converter;
+  std::vector<typename TimedSampleCollection<
+    typename TypeForCode<Code>::type>::TimedVector*> channels;
+  for (const auto& source: rows.sources) {
+    channels.push_back(&(*getChannels<Code>(dst))[source]);
+  }
+  for (size_t i = 0; i < rows.times.size(); i++) {
+    channels[rows.sourceIndex[i]]->push_back(
+        {rows.times[i], converter(rows.values[i])});
+  }
+}
+
+void accumulateGpsRows(const SailmonRows& rows, LogAccumulator* dst) {
+  std::vector<TimedSampleCollection<GeographicPosition<double>>::TimedVector*>
+    channels;
+  for (const auto& source: rows.sources) {
+    channels.push_back(&dst->_GPS_POSsources[source]);
+  }
+  for (size_t i = 0; i < rows.times.size(); i++) {
+    channels[rows.sourceIndex[i]]->push_back({
+      rows.times[i],
+      GeographicPosition<double>(
+          Angle<double>::degrees(rows.longitudes[i]),
+          Angle<double>::degrees(rows.values[i]))
+    });
   }
+}
+
+struct SailmonChannel {
+  int rawId;
+  void (*accumulate)(const SailmonRows&, LogAccumulator*);
 };
 
+// The rawId of GPS positions, which are read with their own query.
+const int gpsRawId = SM_LATITUDE;
+
+const SailmonChannel sailmonChannels[] = {
+  {gpsRawId, &accumulateGpsRows},
+  {SM_COURSE_OVER_GROUND_TRUE, &accumulateRows<GPS_BEARING, AngleConverter>},
+  {SM_SPEED_OVER_WATER, &accumulateRows<WAT_SPEED, SpeedConverter>},
+  {SM_SPEED_OVER_GROUND, &accumulateRows<GPS_SPEED, SpeedConverter>},
+  {SM_HEADING_MAGNETIC, &accumulateRows<MAG_HEADING, AngleConverter>},
+  {SM_VELOCITY_MADE_GOOD, &accumulateRows<VMG, SpeedConverter>},
+  {SM_RUDDER_ANGLE_PORT, &accumulateRows<RUDDER_ANGLE, AngleConverter>},
+  {SM_WIND_ANGLE_APPARENT, &accumulateRows<AWA, AngleConverter>},
+  {SM_WIND_SPEED_APPARENT, &accumulateRows<AWS, SpeedConverter>},
+  {SM_WIND_ANGLE_TRUE, &accumulateRows<TWA, AngleConverter>},
+  {SM_WIND_SPEED_TRUE, &accumulateRows<TWS, SpeedConverter>},
+  {SM_WIND_DIRECTION_TRUE, &accumulateRows<TWDIR, AngleConverter>},
+  {SM_DISTANCE_TRAVELED_TRIP, &accumulateRows<WAT_DIST, LengthConverter>},
+};
+
+const int sailmonChannelCount =
+  sizeof(sailmonChannels)/sizeof(sailmonChannels[0]);
+
+// Reads channels on its own connection, with one prepared statement
+// per query, until there are no channels left.
+void readChannels(const std::string& filename,
+                  const SailmonTimeMap& timeMap,
+                  std::atomic<int>* nextChannel,
+                  std::vector<SailmonRows>* dst) {
+  auto db = openSailmonDb(filename);
+  if (!db) {
+    return;
+  }
+  Statement gps, values;
+  int i = 0;
+  while ((i = (*nextChannel)++) < sailmonChannelCount) {
+    int rawId = sailmonChannels[i].rawId;
+    Statement& stmt = (rawId == gpsRawId? gps : values);
+    if (!stmt) {
+      stmt = prepare(db, rawId == gpsRawId? gpsQuery : valueQuery);
+      if (!stmt) {
+        continue;
+      }
+    }
+    if (rawId != gpsRawId) {
+      sqlite3_bind_int(stmt.get(), 1, rawId);
+    }
+    readRows(stmt.get(), rawId == gpsRawId, timeMap, &(*dst)[i]);
+  }
+}
+
+}  // namespace
+
 LocalAndAbsoluteTimePair findClosest(
     const std::vector<LocalAndAbsoluteTimePair>& pairs,
     int logTime) {
@@ -249,47 +329,89 @@ TimeStamp estimateTime(
 }
 
 
+SailmonTimeMap::SailmonTimeMap(
+    const std::vector<LocalAndAbsoluteTimePair>* pairs) : _pairs(pairs) {
+  CHECK(!pairs->empty());
+}
+
+TimeStamp SailmonTimeMap::operator()(int logTime) {
+  const auto& pairs = *_pairs;
+  if (logTime < _lastLogTime) {
+    LocalAndAbsoluteTimePair p;
+    p.logTime = logTime;
+    _next = std::lower_bound(pairs.begin(), pairs.end(), p) - pairs.begin();
+  } else {
+    while (_next < pairs.size() && pairs[_next].logTime < logTime) {
+      _next++;
+    }
+  }
+  _lastLogTime = logTime;
+  const auto& closest = pairs[std::min(_next, pairs.size() - 1)];
+  return closest.absoluteTime + double(logTime - closest.logTime)*logTimeUnit;
+}
+
 std::shared_ptr<sqlite3> openSailmonDb(const std::string& filename) {
   sqlite3 *db = nullptr;
-  int rc = sqlite3_open(filename.c_str(), &db);
+  int rc = sqlite3_open_v2(filename.c_str(), &db,
+                           SQLITE_OPEN_READONLY, nullptr);
 
   if (rc) {
     LOG(ERROR) << "Can't open database: " << filename << ": "
       << sqlite3_errmsg(db);
+    sqlite3_close(db);
     return std::shared_ptr<sqlite3>();
-  } else {
-    return std::shared_ptr<sqlite3>(db, &sqlite3_close);
   }
+  // Read through a memory mapping of up to 1 GB, with a 64 MB
+  // page cache. These are hints: failures are not errors.
+  sqlite3_exec(db, "PRAGMA mmap_size = 1073741824; "
+               "PRAGMA cache_size = -65536;", nullptr, nullptr, nullptr);
+  return std::shared_ptr<sqlite3>(db, &sqlite3_close);
 }
 
-bool sailmonDbLoad(const std::string &filename, LogAccumulator *dst) {
-  auto db = openSailmonDb(filename);
-  if (!db) {
-    return false;
+bool sailmonDbLoad(const std::string &filename, LogAccumulator *dst,
+                   int threadCount) {
+  std::vector<LocalAndAbsoluteTimePair> timePairs;
+  {
+    auto db = openSailmonDb(filename);
+    if (!db) {
+      return false;
+    }
+    timePairs = getSailmonTimeCorrectionTable(db);
   }
-  Acc acc;
-  acc.dst = dst;
-  acc.timePairs = getSailmonTimeCorrectionTable(db);
-  if (acc.timePairs.empty()) {
+  if (timePairs.empty()) {
     return false;
   }
-  if (!accumulateGpsData(db, &acc)) {
+
+  // Every channel is read on a connection of its own thread, and
+  // the rows are then added to 'dst' in a fixed order.
+  if (threadCount <= 0) {
+    threadCount = std::max(1u, std::thread::hardware_concurrency());
+  }
+  threadCount = std::min(threadCount, sailmonChannelCount);
+  SailmonTimeMap timeMap(&timePairs);
+  std::atomic<int> nextChannel(0);
+  std::vector<SailmonRows> rows(sailmonChannelCount);
+  auto work = [&]() {
+    readChannels(filename, timeMap, &nextChannel, &rows);
+  };
+  std::vector<std::thread> threads;
+  for (int i = 1; i < threadCount; i++) {
+    threads.push_back(std::thread(work));
+  }
+  work();
+  for (auto &t : threads) {
+    t.join();
+  }
+
+  if (!rows[0].ok) {
     LOG(ERROR) << filename << ": no GPS time information";
     return false;
   }
-
-  accumulateValues<GPS_BEARING, AngleConverter>(db, SM_COURSE_OVER_GROUND_TRUE, &acc);
-  accumulateValues<WAT_SPEED, SpeedConverter>(db, SM_SPEED_OVER_WATER, &acc);
-  accumulateValues<GPS_SPEED, SpeedConverter>(db, SM_SPEED_OVER_GROUND, &acc);
-  accumulateValues<MAG_HEADING, AngleConverter>(db, SM_HEADING_MAGNETIC, &acc);
-  accumulateValues<VMG, SpeedConverter>(db, SM_VELOCITY_MADE_GOOD, &acc);
-  accumulateValues<RUDDER_ANGLE, AngleConverter>(db, SM_RUDDER_ANGLE_PORT, &acc);
-  accumulateValues<AWA, AngleConverter>(db, SM_WIND_ANGLE_APPARENT, &acc);
-  accumulateValues<AWS, SpeedConverter>(db, SM_WIND_SPEED_APPARENT, &acc);
-  accumulateValues<TWA, AngleConverter>(db, SM_WIND_ANGLE_TRUE, &acc);
-  accumulateValues<TWS, SpeedConverter>(db, SM_WIND_SPEED_TRUE, &acc);
-  accumulateValues<TWDIR, AngleConverter>(db, SM_WIND_DIRECTION_TRUE, &acc);
-  accumulateValues<WAT_DIST, LengthConverter>(db, SM_DISTANCE_TRAVELED_TRIP, &acc);
+  for (int i = 0; i < sailmonChannelCount; i++) {
+    if (rows[i].ok) {
+      sailmonChannels[i].accumulate(rows[i], dst);
+    }
+  }
   return true;
 }
 
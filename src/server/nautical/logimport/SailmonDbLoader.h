@@ -1,6 +1,7 @@
 #ifndef SERVER_NAUTICAL_LOGIMPORT_SAILMONDBLOADER_H_
 #define SERVER_NAUTICAL_LOGIMPORT_SAILMONDBLOADER_H_
 
+#include <limits>
 #include <string>
 #include <memory>
 #include <vector>
@@ -23,11 +24,32 @@ struct LocalAndAbsoluteTimePair {
 
 std::vector<LocalAndAbsoluteTimePair> getSailmonTimeCorrectionTable(
     std::shared_ptr<sqlite3> db);
+
+// Opens the database read-only, reading it through mmap.
 std::shared_ptr<sqlite3> openSailmonDb(const std::string& filename);
 TimeStamp estimateTime(
     const std::vector<LocalAndAbsoluteTimePair>& pairs,
     int logTime);
-bool sailmonDbLoad(const std::string &filename, LogAccumulator *dst);
+
+// Same as estimateTime, for many log times. When they come in
+// increasing order, as the rows of a channel do, it walks forward
+// through the table instead of searching it for every time.
+class SailmonTimeMap {
+ public:
+  // 'pairs' must be sorted and non-empty, and outlive this object.
+  SailmonTimeMap(const std::vector<LocalAndAbsoluteTimePair>* pairs);
+
+  TimeStamp operator()(int logTime);
+ private:
+  const std::vector<LocalAndAbsoluteTimePair>* _pairs;
+  size_t _next = 0;
+  int _lastLogTime = std::numeric_limits<int>::min();
+};
+
+// The channels are read in parallel on 'threadCount' connections,
+// or one per core if 0.
+bool sailmonDbLoad(const std::string &filename, LogAccumulator *dst,
+                   int threadCount = 0);
 
 }  // namespace sail
 
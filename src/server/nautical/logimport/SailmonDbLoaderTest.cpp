@@ -2,7 +2,10 @@
 #include <server/common/Env.h>
 #include <server/nautical/logimport/LogAccumulator.h>
 #include <server/common/logging.h>
+#include <cstdio>
 #include <gtest/gtest.h>
+#include <sstream>
+#include <third_party/sqlite/sqlite3.h>
 
 using namespace sail;
 
@@ -69,3 +72,77 @@ TEST(SailmonDbLoaderTest, SmokeTest) {
 }
 
 
+TEST(SailmonDbLoaderTest, TimeMap) {
+  std::vector<LocalAndAbsoluteTimePair> pairs;
+  for (int i = 0; i < 10; i++) {
+    LocalAndAbsoluteTimePair p;
+    p.logTime = 1000*i + (i % 3)*7;
+    p.absoluteTime = TimeStamp::UTC(2017, 9, 29, 12, 0, i);
+    pairs.push_back(p);
+  }
+  SailmonTimeMap timeMap(&pairs);
+  // Increasing, then going back in time, and beyond the table.
+  for (int logTime: {-500, 0, 3, 999, 1000, 1007, 4500, 4500, 2000, 2014,
+                     9014, 9500, 20000, 100}) {
+    EXPECT_EQ(estimateTime(pairs, logTime).toMilliSecondsSince1970(),
+              timeMap(logTime).toMilliSecondsSince1970());
+  }
+}
+
+namespace {
+  // Two sensors, GPS time every second and AWA at 5 Hz.
+  std::string makeSyntheticDb() {
+    std::string filename = "/tmp/SailmonDbLoaderTest.db";
+    std::remove(filename.c_str());
+    sqlite3 *db = nullptr;
+    EXPECT_EQ(SQLITE_OK, sqlite3_open(filename.c_str(), &db));
+    std::stringstream sql;
+    sql << "CREATE TABLE LogData (sensorId INTEGER, rawId INTEGER, "
+      "value REAL, log_time INTEGER); BEGIN TRANSACTION;";
+    for (int t = 0; t < 60000; t += 200) {
+      for (int sensor = 1; sensor <= 2; sensor++) {
+        auto add = [&](int rawId, double value) {
+          sql << "INSERT INTO LogData VALUES (" << sensor << ", " << rawId
+            << ", " << value << ", " << t << ");";
+        };
+        if (t % 1000 == 0) {
+          add(0, 17438);
+          add(1, 12*3600 + t/1000);
+        }
+        add(4, 46.2);
+        add(5, 6.15);
+        add(31, sensor*t/1000.0);
+      }
+    }
+    sql << "COMMIT;";
+    EXPECT_EQ(SQLITE_OK,
+              sqlite3_exec(db, sql.str().c_str(), nullptr, nullptr, nullptr));
+    sqlite3_close(db);
+    return filename;
+  }
+}
+
+TEST(SailmonDbLoaderTest, SyntheticParallel) {
+  auto filename = makeSyntheticDb();
+  LogAccumulator sequential, parallel;
+  EXPECT_TRUE(sailmonDbLoad(filename, &sequential, 1));
+  EXPECT_TRUE(sailmonDbLoad(filename, &parallel, 4));
+
+  for (auto acc: {&sequential, &parallel}) {
+    EXPECT_EQ(2, acc->_GPS_POSsources.size());
+    ASSERT_EQ(2, acc->_AWAsources.size());
+    const auto& awa = acc->_AWAsources["sailmonSensorId(2)"];
+    ASSERT_EQ(300, awa.size());
+    EXPECT_NEAR(awa[5].value.degrees(), 2.0, 1.0e-9);
+    auto expected = TimeStamp::UTC(2017, 9, 29, 12, 0, 1);
+    EXPECT_NEAR((awa[5].time - expected).seconds(), 0.0, 1.0e-6);
+  }
+  for (const auto& kv: sequential._AWAsources) {
+    const auto& other = parallel._AWAsources[kv.first];
+    ASSERT_EQ(kv.second.size(), other.size());
+    for (int i = 0; i < other.size(); i++) {
+      EXPECT_EQ(kv.second[i].time, other[i].time);
+    }
+  }
+  std::remove(filename.c_str());
+}
@@ -401,6 +401,15 @@ Array<AstraData> loadAstraFile(const std::string& filename) {
       IntoArray<AstraData>());
 }
 
+Array<AstraData> loadAstraStream(std::istream* stream) {
+  // The stream is owned by the caller.
+  return transduce(
+      makeOptional(std::shared_ptr<std::istream>(
+          stream, [](std::istream*) {})),
+      astraParser,
+      IntoArray<AstraData>());
+}
+
 namespace {
   std::string stringOrQ(const Optional<std::string>& s) {
     return s.defined()? s.get() : "?";
@@ -496,6 +505,20 @@ namespace {
     copyIfDefined(sourceName, src.fullTimestamp(),
         src.TWS, &(dst->_TWSsources));
   }
+
+  bool accumulateAstraData(
+      const Array<AstraData>& data, LogAccumulator* dst) {
+    if (data.empty()) {
+      return false;
+    }
+
+    for (const AstraData& x: data) {
+      accumulateRegatta(x, dst);
+
+      // TODO: Switch based on x.logType
+    }
+    return true;
+  }
 }
 
 /**
@@ -506,17 +529,11 @@ namespace {
  *
  */
 bool accumulateAstraLogs(const std::string& filename, LogAccumulator* dst) {
-  Array<AstraData> data = loadAstraFile(filename);
-  if (data.empty()) {
-    return false;
-  }
-
-  for (const AstraData& x: data) {
-    accumulateRegatta(x, dst);
+  return accumulateAstraData(loadAstraFile(filename), dst);
+}
 
-    // TODO: Switch based on x.logType
-  }
-  return true;
+bool accumulateAstraLogs(std::istream* stream, LogAccumulator* dst) {
+  return accumulateAstraData(loadAstraStream(stream), dst);
 }
 
 
@@ -8,6 +8,7 @@
 #ifndef SERVER_NAUTICAL_LOGIMPORT_ASTRALOADER_H_
 #define SERVER_NAUTICAL_LOGIMPORT_ASTRALOADER_H_
 
+#include <iosfwd>
 #include <string>
 #include <server/transducers/Transducer.h>
 #include <server/common/Optional.h>
@@ -193,8 +194,10 @@ inline GenericTransducer<AstraDataStepper> trMakeAstraData() {
 }
 
 Array<AstraData> loadAstraFile(const std::string& filename);
+Array<AstraData> loadAstraStream(std::istream* stream);
 
 bool accumulateAstraLogs(const std::string& filename, LogAccumulator* dst);
+bool accumulateAstraLogs(std::istream* stream, LogAccumulator* dst);
 
 template <typename FieldAccess>
 AstraValueParser geographicAngle(
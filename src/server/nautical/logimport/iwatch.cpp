@@ -24,14 +24,21 @@ bool parseIwatch(const std::string& filename, LogAccumulator* dst) {
     LOG(ERROR) << filename << ": can't read file\n";
     return false;
   }
+  return parseIwatch(&stream, dst);
+}
+
+bool parseIwatch(std::istream* streamPtr, LogAccumulator* dst) {
+  std::istream& stream = *streamPtr;
 
-  // quickly fail if the filetype is wrong.
-  char header[2];
-  stream.read(header, 2);
-  if (!stream.good() || header[0] != '{' || header[1] != '"') {
+  // quickly fail if the filetype is wrong. The stream might not
+  // be seekable (e.g. when decompressing), so peek instead.
+  if (stream.get() != '{' || stream.peek() != '"') {
+    return false;
+  }
+  stream.unget();
+  if (!stream.good()) {
     return false;
   }
-  stream.seekg(0, stream.beg);
 
   Poco::JSON::Parser parser;
   Var json = parser.parse(stream);
@@ -1,4 +1,5 @@
 
+#include <iosfwd>
 #include <string>
 
 namespace sail {
@@ -6,5 +7,6 @@ namespace sail {
 class LogAccumulator;
 
 bool parseIwatch(const std::string& filename, LogAccumulator* dst);
+bool parseIwatch(std::istream* stream, LogAccumulator* dst);
 
 }  // namespace sail
@@ -43,6 +43,17 @@ bool readVakaros(const std::string& path, LogAccumulator *dst)
     return true;
 }
 
+bool readVakaros(std::istream* stream, LogAccumulator *dst)
+{
+    VakarosImporter importer(dst);
+    std::string result = importer.readStream(*stream);
+    if (!result.empty()) {
+        std::cerr << "vakaros stream: " << result << std::endl;
+        return false;
+    }
+    return true;
+}
+
 VakarosImporter::VakarosImporter(LogAccumulator *dst) : _sourceGroup("Vakaros", dst) { }
 
 static GeographicPosition<double> posFromLatLon(int32_t lat, int32_t lon) {
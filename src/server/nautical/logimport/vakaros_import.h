@@ -4,6 +4,7 @@
 namespace sail {
 
 bool readVakaros(const std::string& path, LogAccumulator *dst);
+bool readVakaros(std::istream* stream, LogAccumulator *dst);
 
 }  // namespace sail
 
@@ -0,0 +1,274 @@
+// Processes the logs of many boats with a single long-running driver,
+// several boats at the same time. See FleetProcessor.
+//
+// Boat ids are read from a file (--queue, '-' for stdin), or from a
+// local socket (--socket) to which one id per line can be written, e.g.
+//
+//   echo 5992fcc6035eb352cf36d594 | nc -U /tmp/fleet.sock
+//
+// Every argument after '--' is given to the processing of each boat, with
+// the same meaning as for nautical_processBoatLogs:
+//
+//   nautical_processFleet --queue boats.txt --log-root /db/anemologs
+//     --dst-root /home/anemomind/processed -j 4 --max-memory-mb 8000
+//     --report /tmp/fleet.tsv -- -t -c --clean --mongo-uri ...
+//
+// With --stage-report, every boat is processed with --profile, and the
+// totals of every processing stage over the boats that succeeded are
+// kept up to date in the given file, see StageProfiler.
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <Poco/File.h>
+#include <server/common/ArgMap.h>
+#include <server/common/StageProfiler.h>
+#include <server/common/logging.h>
+#include <server/nautical/BoatLogProcessor.h>
+#include <server/nautical/FleetProcessor.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace sail;
+
+namespace {
+
+std::string boatDir(const std::string &root, const std::string &boatId) {
+  return root + "/boat" + boatId;
+}
+
+std::string processedDir(const std::string &dstRoot,
+                         const std::string &boatId) {
+  return boatDir(dstRoot, boatId) + "/processed";
+}
+
+int processBoat(const std::string &boatId,
+                const std::string &logRoot, const std::string &dstRoot,
+                const std::vector<std::string> &extraArgs) {
+  std::string dst = processedDir(dstRoot, boatId);
+  Poco::File(dst).createDirectories();
+
+  std::vector<std::string> args{
+    "nautical_processBoatLogs",
+    "--boatid", boatId,
+    "--dir", boatDir(logRoot, boatId),
+    "--dst", dst
+  };
+  args.insert(args.end(), extraArgs.begin(), extraArgs.end());
+
+  std::vector<const char *> argv;
+  for (const auto &arg : args) {
+    argv.push_back(arg.c_str());
+  }
+  return mainProcessBoatLogs(argv.size(), argv.data());
+}
+
+int listenOn(const std::string &path) {
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0) {
+    return -1;
+  }
+  struct sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+  unlink(path.c_str());
+  if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0
+      || listen(fd, 8) != 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+// Waits at most 'seconds' for something to read on fd.
+bool waitForInput(int fd, int seconds) {
+  fd_set fds;
+  FD_ZERO(&fds);
+  FD_SET(fd, &fds);
+  struct timeval timeout = {seconds, 0};
+  return select(fd + 1, &fds, nullptr, nullptr, &timeout) > 0;
+}
+
+// A client that stops sending for this long is disconnected, so that
+// it does not hold up the boats in the queue.
+const int clientTimeoutSeconds = 5;
+
+// Reads the boat ids sent on a connection, until the client closes it
+// or times out. After a time out, only the complete lines are used.
+std::vector<std::string> readConnection(int fd) {
+  std::string received;
+  char buffer[4096];
+  while (true) {
+    if (!waitForInput(fd, clientTimeoutSeconds)) {
+      LOG(WARNING) << "Client sent nothing for " << clientTimeoutSeconds
+        << " seconds, disconnecting.";
+      received.erase(received.find_last_of('\n') + 1);
+      break;
+    }
+    ssize_t n = read(fd, buffer, sizeof(buffer));
+    if (n <= 0) {
+      break;
+    }
+    received.append(buffer, n);
+  }
+  std::stringstream ids(received);
+  return readBoatIds(&ids);
+}
+
+// Waits at most one second for a client.
+bool waitForClient(int fd) {
+  return waitForInput(fd, 1);
+}
+
+// Opens the --report file to append to it. The header is only
+// written to a new or empty file.
+std::unique_ptr<std::ofstream> openReport(const std::string &path) {
+  bool empty = std::ifstream(path, std::ios::ate).tellg() <= 0;
+  std::unique_ptr<std::ofstream> report(
+      new std::ofstream(path, std::ios::app));
+  if (empty) {
+    *report << boatReportHeader() << std::endl;
+  }
+  return report;
+}
+
+}  // namespace
+
+int main(int argc, const char **argv) {
+  // Everything after '--' is for the processing of each boat.
+  std::vector<std::string> extraArgs;
+  int ownArgc = argc;
+  for (int i = 1; i < argc; i++) {
+    if (std::string(argv[i]) == "--") {
+      ownArgc = i;
+      extraArgs.assign(argv + i + 1, argv + argc);
+      break;
+    }
+  }
+
+  FleetSettings settings;
+  std::string queuePath, socketPath, reportPath, stageReportPath;
+  std::string logRoot = "/db/anemologs/anemologs";
+  std::string dstRoot = "/tmp/processed";
+
+  ArgMap amap;
+  amap.setHelpInfo("Processes the logs of several boats at the same time.\n"
+                   "Arguments after '--' are given to each boat, see "
+                   "nautical_processBoatLogs --help.");
+  amap.registerOption("--queue", "File with one boat id per line, - for stdin")
+    .store(&queuePath);
+  amap.registerOption("--socket",
+                      "Keep running and read boat ids from this local socket")
+    .store(&socketPath);
+  amap.registerOption("--log-root",
+                      "Directory containing the log directories boat<id>")
+    .store(&logRoot);
+  amap.registerOption("--dst-root",
+                      "Output goes to <dst-root>/boat<id>/processed")
+    .store(&dstRoot);
+  amap.registerOption("-j", "Number of boats processed at the same time, "
+                      "default is one per core")
+    .store(&settings.concurrency);
+  amap.registerOption("--max-memory-mb",
+                      "Memory limit for the processing of each boat")
+    .store(&settings.maxMemoryMb);
+  amap.registerOption("--report",
+                      "Append a line with timing and status for every boat "
+                      "to this file")
+    .store(&reportPath);
+  amap.registerOption("--stage-report",
+                      "Profile the processing of every boat, and write the "
+                      "totals of every stage over all boats to this file")
+    .store(&stageReportPath);
+  amap.disableFreeArgs();
+
+  switch (amap.parse(ownArgc, argv)) {
+    case ArgMap::Error: return -1;
+    case ArgMap::Done: return 0;
+    case ArgMap::Continue: break;
+    default:
+      LOG(FATAL) << "Unhandled ParseStatus code";
+      return -1;
+  }
+
+  if (queuePath.empty() == socketPath.empty()) {
+    LOG(ERROR) << "Please give either --queue or --socket";
+    return -1;
+  }
+
+  if (!stageReportPath.empty()) {
+    extraArgs.push_back("--profile");
+  }
+
+  FleetProcessor fleet(settings, [&](const std::string &boatId) {
+    return processBoat(boatId, logRoot, dstRoot, extraArgs);
+  });
+
+  std::unique_ptr<std::ofstream> report;
+  if (!reportPath.empty()) {
+    report = openReport(reportPath);
+  }
+  int failures = 0;
+  StageTotals stages;
+  fleet.setReportCallback([&](const BoatReport &r) {
+    if (report) {
+      *report << r << std::endl;
+    }
+    if (!r.ok()) {
+      failures++;
+    } else if (!stageReportPath.empty()) {
+      std::ifstream profile(processedDir(dstRoot, r.boatId) + "/profile.tsv");
+      if (!readStageTotals(&profile, &stages)) {
+        LOG(WARNING) << "No stage totals for boat " << r.boatId;
+      }
+      std::ofstream stageReport(stageReportPath);
+      writeStageTotals(stages, &stageReport);
+    }
+  });
+
+  if (!queuePath.empty()) {
+    std::vector<std::string> ids;
+    if (queuePath == "-") {
+      ids = readBoatIds(&std::cin);
+    } else {
+      std::ifstream file(queuePath);
+      if (!file) {
+        LOG(ERROR) << "Cannot read " << queuePath;
+        return -1;
+      }
+      ids = readBoatIds(&file);
+    }
+    for (const auto &id : ids) {
+      fleet.enqueue(id);
+    }
+    fleet.finish();
+    LOG(INFO) << fleet.reports().size() << " boats processed, "
+      << failures << " failed.";
+    return failures == 0 ? 0 : 1;
+  }
+
+  int server = listenOn(socketPath);
+  if (server < 0) {
+    LOG(ERROR) << "Cannot listen on " << socketPath;
+    return -1;
+  }
+  LOG(INFO) << "Waiting for boat ids on " << socketPath;
+  while (true) {
+    if (waitForClient(server)) {
+      int client = accept(server, nullptr, nullptr);
+      if (client >= 0) {
+        for (const auto &id : readConnection(client)) {
+          fleet.enqueue(id);
+        }
+        close(client);
+      }
+    }
+    fleet.poll(false);
+  }
+  return 0;
+}
@@ -0,0 +1,199 @@
+#include <server/nautical/tgtspeed/TargetSpeedFit.h>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <server/common/ArrayBuilder.h>
+#include <server/common/logging.h>
+
+namespace sail {
+
+TargetSpeedStats::TargetSpeedStats(const TargetSpeedParam &param) :
+  _param(param),
+  _AtA(arma::zeros(param.vertexCount(), param.vertexCount())),
+  _Atb(arma::zeros<arma::vec>(param.vertexCount())) {}
+
+void TargetSpeedStats::add(Angle<double> twa, Velocity<double> tws,
+                           Velocity<double> boatSpeed) {
+  double b = boatSpeed.knots();
+  if (std::isnan(b)) {
+    return;
+  }
+  auto w = _param.calcBilinearWeights(twa, tws);
+  if (!w.valid()) {
+    return;
+  }
+  for (int i = 0; i < 4; i++) {
+    for (int j = 0; j < 4; j++) {
+      _AtA(w.inds[i], w.inds[j]) += w.weights[i]*w.weights[j];
+    }
+    _Atb(w.inds[i]) += w.weights[i]*b;
+  }
+  _btb += b*b;
+  _sampleCount++;
+}
+
+void TargetSpeedStats::add(const TargetSpeedStats &other) {
+  CHECK(vertexCount() == other.vertexCount());
+  _AtA += other._AtA;
+  _Atb += other._Atb;
+  _btb += other._btb;
+  _sampleCount += other._sampleCount;
+}
+
+bool TargetSpeedStats::save(std::ostream *dst) const {
+  dst->write((const char *)&_sampleCount, sizeof(_sampleCount));
+  dst->write((const char *)&_btb, sizeof(_btb));
+  return _AtA.save(*dst, arma::arma_binary)
+    && _Atb.save(*dst, arma::arma_binary)
+    && dst->good();
+}
+
+bool TargetSpeedStats::load(std::istream *src) {
+  int sampleCount = 0;
+  double btb = 0;
+  src->read((char *)&sampleCount, sizeof(sampleCount));
+  src->read((char *)&btb, sizeof(btb));
+  arma::mat AtA;
+  arma::vec Atb;
+  if (!src->good()
+      || !AtA.load(*src, arma::arma_binary)
+      || !Atb.load(*src, arma::arma_binary)
+      || AtA.n_rows != _param.vertexCount()
+      || AtA.n_cols != _param.vertexCount()
+      || Atb.n_elem != _param.vertexCount()) {
+    LOG(WARNING) << "Failed to load target speed statistics";
+    return false;
+  }
+  _sampleCount = sampleCount;
+  _btb = btb;
+  _AtA = AtA;
+  _Atb = Atb;
+  return true;
+}
+
+namespace {
+  // Minimizes x'Hx - 2g'x subject to x >= 0, starting from x.
+  int solveNonNegative(const arma::mat &H, const arma::vec &g,
+                       const TargetSpeedFitSettings &settings, arma::vec *xPtr) {
+    arma::vec &x = *xPtr;
+    int n = x.n_elem;
+
+    // Half the gradient, kept up to date as x changes.
+    arma::vec r = H*x - g;
+    for (int iter = 0; iter < settings.maxIterations; iter++) {
+      double maxChange = 0;
+      for (int i = 0; i < n; i++) {
+        double h = H(i, i);
+        if (h <= 0) {
+          continue;
+        }
+        double next = std::max(0.0, x(i) - r(i)/h);
+        double change = next - x(i);
+        if (change != 0) {
+          r += change*H.col(i);
+          x(i) = next;
+          maxChange = std::max(maxChange, std::abs(change));
+        }
+      }
+      if (maxChange < settings.tolerance) {
+        return iter + 1;
+      }
+    }
+    return settings.maxIterations;
+  }
+
+  // P'MP, with the rows of the sparse P. Only the non-zero elements of M,
+  // which is sparse for A'A, contribute.
+  arma::mat projectToParams(const arma::mat &M,
+                            const Array<Array<MatrixElementd> > &rows,
+                            int paramCount) {
+    arma::mat dst = arma::zeros(paramCount, paramCount);
+    for (int k = 0; k < int(M.n_cols); k++) {
+      for (int i = 0; i < int(M.n_rows); i++) {
+        double m = M(i, k);
+        if (m == 0) {
+          continue;
+        }
+        for (auto a: rows[i]) {
+          for (auto b: rows[k]) {
+            dst(a.j, b.j) += a.value*m*b.value;
+          }
+        }
+      }
+    }
+    return dst;
+  }
+}
+
+TargetSpeedFitter::TargetSpeedFitter(const TargetSpeedParam &param,
+    const TargetSpeedFitSettings &settings) :
+  _param(param), _settings(settings) {
+  Array<ArrayBuilder<MatrixElementd> > rows(param.vertexCount());
+  for (auto e: param.makeNonNegativeVertexParam()) {
+    rows[e.i].add(e);
+  }
+  _rows = Array<Array<MatrixElementd> >(rows.size());
+  for (int i = 0; i < rows.size(); i++) {
+    _rows[i] = rows[i].get();
+  }
+
+  arma::mat reg =
+    param.assembleReg(param.makeRadialSubRegs(), settings.regOrder)
+    + param.assembleReg(param.makeAngularSubRegs(), settings.regOrder);
+  _paramReg = settings.regWeight*projectToParams(
+      reg, _rows, param.paramCount());
+
+  Arrayd init = param.initializeNonNegativeParams();
+  _params = arma::vec(init.ptr(), init.size());
+}
+
+TargetSpeedFunction TargetSpeedFitter::fit(const TargetSpeedStats &stats) {
+  CHECK(stats.vertexCount() == _param.vertexCount());
+  int paramCount = _param.paramCount();
+  arma::mat H = _paramReg + projectToParams(stats.AtA(), _rows, paramCount);
+  arma::vec g = arma::zeros<arma::vec>(paramCount);
+  for (int i = 0; i < _rows.size(); i++) {
+    for (auto e: _rows[i]) {
+      g(e.j) += e.value*stats.Atb()(i);
+    }
+  }
+
+  _iterationCount = solveNonNegative(H, g, _settings, &_params);
+  if (_iterationCount == _settings.maxIterations) {
+    LOG(WARNING) << "Target speed fit did not converge in "
+      << _iterationCount << " iterations";
+  }
+
+  Array<Velocity<double> > vertices(_param.vertexCount());
+  for (int i = 0; i < vertices.size(); i++) {
+    double v = 0;
+    for (auto e: _rows[i]) {
+      v += e.value*_params(e.j);
+    }
+    vertices[i] = Velocity<double>::knots(v);
+  }
+  return TargetSpeedFunction(_param, vertices);
+}
+
+TargetSpeedFunction fitTargetSpeedFunction(
+    const TargetSpeedStats &stats,
+    const TargetSpeedFitSettings &settings) {
+  return TargetSpeedFitter(stats.param(), settings).fit(stats);
+}
+
+TargetSpeedFunction fitTargetSpeedFunction(
+    const TargetSpeedParam &param,
+    Array<Angle<double> > twa,
+    Array<Velocity<double> > tws,
+    Array<Velocity<double> > boatSpeed,
+    const TargetSpeedFitSettings &settings) {
+  TargetSpeedStats stats(param);
+  int n = std::min(twa.size(), std::min(tws.size(), boatSpeed.size()));
+  for (int i = 0; i < n; i++) {
+    stats.add(twa[i], tws[i], boatSpeed[i]);
+  }
+  return fitTargetSpeedFunction(stats, settings);
+}
+
+}
@@ -0,0 +1,108 @@
+#ifndef SERVER_NAUTICAL_TGTSPEED_TARGETSPEEDFIT_H_
+#define SERVER_NAUTICAL_TGTSPEED_TARGETSPEEDFIT_H_
+
+#include <armadillo>
+#include <iosfwd>
+#include <server/nautical/tgtspeed/TargetSpeedParam.h>
+
+namespace sail {
+
+// The sufficient statistics of a set of (TWA, TWS, boat speed) samples
+// for a least-squares fit of the vertices of a TargetSpeedParam:
+// with A the matrix of bilinear weights of the samples and b their boat
+// speeds, only A'A, A'b and b'b are kept. The size of these is fixed by
+// the grid, not by the number of samples.
+//
+// The statistics of different sessions can be added to each other and
+// saved, so that a polar can be updated with the samples of a new session
+// without going through the samples of the previous ones.
+class TargetSpeedStats {
+ public:
+  TargetSpeedStats() {}
+  TargetSpeedStats(const TargetSpeedParam &param);
+
+  // Samples outside of the grid are ignored.
+  void add(Angle<double> twa, Velocity<double> tws, Velocity<double> boatSpeed);
+
+  // Adds the samples of 'other', that must have the same grid.
+  void add(const TargetSpeedStats &other);
+
+  int sampleCount() const { return _sampleCount; }
+  int vertexCount() const { return _AtA.n_rows; }
+
+  const TargetSpeedParam &param() const { return _param; }
+  const arma::mat &AtA() const { return _AtA; }
+  const arma::vec &Atb() const { return _Atb; }
+  double btb() const { return _btb; }
+
+  bool save(std::ostream *dst) const;
+  // Loads statistics saved with the same grid.
+  bool load(std::istream *src);
+ private:
+  TargetSpeedParam _param;
+  arma::mat _AtA;
+  arma::vec _Atb;
+  double _btb = 0;
+  int _sampleCount = 0;
+};
+
+struct TargetSpeedFitSettings {
+  // Weight of the smoothness of the polar, in the angular
+  // and in the radial direction of the grid.
+  double regWeight = 1.0;
+
+  // The order of the differences used for the regularization.
+  int regOrder = 2;
+
+  // The non-negative parameters are solved by projected Gauss-Seidel
+  // iterations, until no parameter changes more than 'tolerance' knots.
+  int maxIterations = 2000;
+  double tolerance = 1.0e-6;
+};
+
+// Fits the vertices of a grid, using its non-negative parameterization
+// (see makeNonNegativeVertexParam) and a regularization of the
+// differences between neighbouring vertices (see assembleReg).
+//
+// Everything that depends only on the grid is computed once, and each
+// fit starts from the solution of the previous one: refitting after
+// adding a session to the statistics only takes a few iterations.
+// The cost of a fit does not depend on the number of samples.
+class TargetSpeedFitter {
+ public:
+  TargetSpeedFitter(const TargetSpeedParam &param,
+      const TargetSpeedFitSettings &settings = TargetSpeedFitSettings());
+
+  TargetSpeedFunction fit(const TargetSpeedStats &stats);
+
+  // The number of iterations of the last fit.
+  int iterationCount() const { return _iterationCount; }
+ private:
+  TargetSpeedParam _param;
+  TargetSpeedFitSettings _settings;
+
+  // The non-zero elements of each row of the vertex parameterization.
+  Array<Array<MatrixElementd> > _rows;
+
+  // The regularization, in terms of the parameters.
+  arma::mat _paramReg;
+
+  arma::vec _params;
+  int _iterationCount = 0;
+};
+
+TargetSpeedFunction fitTargetSpeedFunction(
+    const TargetSpeedStats &stats,
+    const TargetSpeedFitSettings &settings = TargetSpeedFitSettings());
+
+// Same as above, from the samples.
+TargetSpeedFunction fitTargetSpeedFunction(
+    const TargetSpeedParam &param,
+    Array<Angle<double> > twa,
+    Array<Velocity<double> > tws,
+    Array<Velocity<double> > boatSpeed,
+    const TargetSpeedFitSettings &settings = TargetSpeedFitSettings());
+
+}
+
+#endif /* SERVER_NAUTICAL_TGTSPEED_TARGETSPEEDFIT_H_ */
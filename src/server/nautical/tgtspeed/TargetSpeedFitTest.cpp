@@ -0,0 +1,112 @@
+#include <server/nautical/tgtspeed/TargetSpeedFit.h>
+
+#include <cmath>
+#include <gtest/gtest.h>
+#include <sstream>
+
+using namespace sail;
+
+namespace {
+  TargetSpeedParam makeParam() {
+    return TargetSpeedParam(true, false, 24, 11, Velocity<double>::knots(20));
+  }
+
+  Velocity<double> truePolar(Angle<double> twa, Velocity<double> tws) {
+    return 0.25*(1.0 - cos(twa))*tws;
+  }
+
+  struct Samples {
+    Array<Angle<double> > twa;
+    Array<Velocity<double> > tws, boatSpeed;
+  };
+
+  Samples makeSamples(int n, int seed) {
+    Samples s{Array<Angle<double> >(n), Array<Velocity<double> >(n),
+              Array<Velocity<double> >(n)};
+    for (int i = 0; i < n; i++) {
+      int k = seed*n + i;
+      s.twa[i] = Angle<double>::degrees(180*(1 + sin(0.731*k)));
+      s.tws[i] = Velocity<double>::knots(9.5*(1 + sin(0.377*k + 1.0)));
+      s.boatSpeed[i] = truePolar(s.twa[i], s.tws[i])
+        + Velocity<double>::knots(0.05*sin(2.3*k));
+    }
+    return s;
+  }
+
+  TargetSpeedStats makeStats(const TargetSpeedParam &param, const Samples &s) {
+    TargetSpeedStats stats(param);
+    for (int i = 0; i < s.twa.size(); i++) {
+      stats.add(s.twa[i], s.tws[i], s.boatSpeed[i]);
+    }
+    return stats;
+  }
+}
+
+TEST(TargetSpeedFitTest, IncrementalEqualsFullRefit) {
+  auto param = makeParam();
+  const int sessionCount = 4;
+  const int n = 3000;
+
+  // All samples at once.
+  Samples all = makeSamples(sessionCount*n, 0);
+  TargetSpeedFunction full = fitTargetSpeedFunction(
+      param, all.twa, all.tws, all.boatSpeed);
+
+  // One session at a time.
+  TargetSpeedStats stats(param);
+  for (int i = 0; i < sessionCount; i++) {
+    Samples session{all.twa.slice(i*n, (i + 1)*n),
+                    all.tws.slice(i*n, (i + 1)*n),
+                    all.boatSpeed.slice(i*n, (i + 1)*n)};
+    stats.add(makeStats(param, session));
+  }
+  EXPECT_EQ(sessionCount*n, stats.sampleCount());
+  TargetSpeedFunction incremental = fitTargetSpeedFunction(stats);
+
+  ASSERT_EQ(full.vertices().size(), incremental.vertices().size());
+  for (int i = 0; i < full.vertices().size(); i++) {
+    EXPECT_NEAR(full.vertices()[i].knots(),
+                incremental.vertices()[i].knots(), 1.0e-6);
+  }
+}
+
+TEST(TargetSpeedFitTest, RecoversPolar) {
+  auto param = makeParam();
+  TargetSpeedFitSettings settings;
+  settings.regWeight = 0.01;
+  Samples s = makeSamples(20000, 1);
+  TargetSpeedFunction f = fitTargetSpeedFunction(
+      param, s.twa, s.tws, s.boatSpeed, settings);
+
+  for (double twa : {40.0, 90.0, 150.0, 210.0, 300.0}) {
+    for (double tws : {4.0, 8.0, 14.0}) {
+      auto alpha = Angle<double>::degrees(twa);
+      auto v = Velocity<double>::knots(tws);
+      EXPECT_NEAR(truePolar(alpha, v).knots(),
+                  f.calcBoatSpeed(alpha, v).knots(), 0.3);
+    }
+  }
+  for (auto v : f.vertices()) {
+    EXPECT_LE(0.0, v.knots());
+  }
+}
+
+TEST(TargetSpeedFitTest, SaveAndLoad) {
+  auto param = makeParam();
+  TargetSpeedStats stats = makeStats(param, makeSamples(500, 2));
+
+  std::stringstream file;
+  EXPECT_TRUE(stats.save(&file));
+
+  TargetSpeedStats loaded(param);
+  EXPECT_TRUE(loaded.load(&file));
+  EXPECT_EQ(stats.sampleCount(), loaded.sampleCount());
+  EXPECT_EQ(stats.btb(), loaded.btb());
+  EXPECT_EQ(0.0, arma::accu(arma::abs(stats.AtA() - loaded.AtA())));
+
+  // Statistics of another grid are rejected.
+  TargetSpeedStats other(TargetSpeedParam(
+      true, false, 12, 5, Velocity<double>::knots(20)));
+  file.seekg(0);
+  EXPECT_FALSE(other.load(&file));
+}